@@ -0,0 +1,161 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: Detection of artifacts in windows of a signal: amplitudes
+//   beyond a threshold, excessive peak-to-peak differences, and flat
+//   signals. Bad windows are merged into intervals per channel, and across
+//   channels, in a single pass over the signal.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#include "PCHIncludes.h"
+#pragma hdrstop
+
+#include "ArtifactDetector.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+ArtifactDetector::ArtifactDetector( int inChannels, int inLength, int inStep, long long inOrigin, bool inConditions )
+: WindowedAccumulator( inChannels, inLength, inStep, inOrigin, inConditions, false ),
+  mAmplitude( numeric_limits<double>::infinity() ),
+  mPeakToPeak( numeric_limits<double>::infinity() ),
+  mFlat( -numeric_limits<double>::infinity() ),
+  mMin( inChannels + 1 ),
+  mMax( inChannels + 1 ),
+  mChannelIntervals( inChannels )
+{
+}
+
+ArtifactDetector&
+ArtifactDetector::SetAmplitude( double inThreshold )
+{
+  mAmplitude = inThreshold;
+  return *this;
+}
+
+ArtifactDetector&
+ArtifactDetector::SetPeakToPeak( double inThreshold )
+{
+  mPeakToPeak = inThreshold;
+  return *this;
+}
+
+ArtifactDetector&
+ArtifactDetector::SetFlat( double inThreshold )
+{
+  mFlat = inThreshold;
+  return *this;
+}
+
+// **************************************************************************
+// Function:   Merge
+// Purpose:    Merges results of the range that follows. Windows that span
+//             the boundary are processed first, so intervals are appended
+//             in the order of their windows.
+// Parameters: other - detector of the range that follows
+// Returns:    N/A
+// **************************************************************************
+void
+ArtifactDetector::Merge( const ArtifactDetector& inOther )
+{
+  MergeWindows( inOther );
+  for( size_t ch = 0; ch < mChannelIntervals.size(); ++ch )
+    for( size_t i = 0; i < inOther.mChannelIntervals[ ch ].size(); ++i )
+      Append( mChannelIntervals[ ch ], inOther.mChannelIntervals[ ch ][ i ] );
+  for( size_t i = 0; i < inOther.mGlobalIntervals.size(); ++i )
+    Append( mGlobalIntervals, inOther.mGlobalIntervals[ i ] );
+  for( ConditionMap::const_iterator i = inOther.mConditions.begin(); i != inOther.mConditions.end(); ++i )
+  {
+    Condition& c = mConditions[ i->first ];
+    c.windows += i->second.windows;
+    c.bad += i->second.bad;
+  }
+}
+
+// **************************************************************************
+// Function:   Window
+// Purpose:    Evaluates the criteria for each channel from the window's
+//             extrema, which are computed in a single pass with channels
+//             innermost.
+// Parameters: start - first sample of the window
+//             data - Length() samples, with channels innermost
+//             condition - condition of the window's first sample
+// Returns:    N/A
+// **************************************************************************
+void
+ArtifactDetector::Window( long long inStart, const double* inData, double inCondition )
+{
+  const int C = Channels(),
+            n = Length();
+  double* mn = &mMin[ 0 ],
+        * mx = &mMax[ 0 ];
+  for( int ch = 0; ch < C; ++ch )
+    mn[ ch ] = mx[ ch ] = inData[ ch ];
+  for( int t = 1; t < n; ++t )
+  {
+    const double* x = inData + t * C;
+    for( int ch = 0; ch < C; ++ch )
+    {
+      mn[ ch ] = x[ ch ] < mn[ ch ] ? x[ ch ] : mn[ ch ];
+      mx[ ch ] = x[ ch ] > mx[ ch ] ? x[ ch ] : mx[ ch ];
+    }
+  }
+  Interval window = { inStart, inStart + n, 0 };
+  int any = 0;
+  for( int ch = 0; ch < C; ++ch )
+  {
+    const double range = mx[ ch ] - mn[ ch ];
+    window.criteria = 0;
+    if( max( ::fabs( mn[ ch ] ), ::fabs( mx[ ch ] ) ) > mAmplitude )
+      window.criteria |= Amplitude;
+    if( range > mPeakToPeak )
+      window.criteria |= PeakToPeak;
+    if( range <= mFlat )
+      window.criteria |= Flat;
+    if( window.criteria )
+      Append( mChannelIntervals[ ch ], window );
+    any |= window.criteria;
+  }
+  window.criteria = any;
+  if( any )
+    Append( mGlobalIntervals, window );
+  Condition& c = mConditions[ inCondition ];
+  ++c.windows;
+  c.bad += ( any != 0 );
+}
+
+// Appends an interval, or extends the last interval if they overlap or
+// touch.
+void
+ArtifactDetector::Append( Intervals& ioIntervals, const Interval& inInterval )
+{
+  if( !ioIntervals.empty() && ioIntervals.back().end >= inInterval.begin )
+  {
+    Interval& last = ioIntervals.back();
+    last.end = max( last.end, inInterval.end );
+    last.criteria |= inInterval.criteria;
+  }
+  else
+    ioIntervals.push_back( inInterval );
+}
@@ -0,0 +1,97 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: Detection of artifacts in windows of a signal: amplitudes
+//   beyond a threshold, excessive peak-to-peak differences, and flat
+//   signals. Bad windows are merged into intervals per channel, and across
+//   channels, in a single pass over the signal.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#ifndef ARTIFACT_DETECTOR_H
+#define ARTIFACT_DETECTOR_H
+
+#include "WindowedAccumulator.h"
+
+#include <vector>
+#include <map>
+
+// A window is bad for a channel if the channel's largest absolute value
+// exceeds the amplitude threshold, if the difference between its maximum
+// and minimum exceeds the peak-to-peak threshold, or if that difference is
+// at most the flat threshold. Criteria are disabled by default.
+// Bad windows that overlap or touch are merged into intervals, which hold
+// the criteria met by any of their windows. Windows are counted per
+// condition of their first sample.
+class ArtifactDetector : public WindowedAccumulator
+{
+ public:
+  enum Criterion
+  {
+    Amplitude = 1,
+    PeakToPeak = 2,
+    Flat = 4,
+  };
+  struct Interval
+  {
+    long long begin,
+              end;
+    int criteria;
+  };
+  typedef std::vector<Interval> Intervals;
+  struct Condition
+  {
+    long long windows,
+              bad;
+  };
+  typedef std::map<double, Condition> ConditionMap;
+
+  ArtifactDetector( int channels, int length, int step, long long origin, bool conditions );
+
+  ArtifactDetector& SetAmplitude( double );
+  ArtifactDetector& SetPeakToPeak( double );
+  ArtifactDetector& SetFlat( double );
+
+  void Merge( const ArtifactDetector& );
+
+  // Intervals of bad windows of a channel, and of windows that are bad for
+  // any channel.
+  const Intervals& ChannelIntervals( int ch ) const
+    { return mChannelIntervals[ ch ]; }
+  const Intervals& GlobalIntervals() const
+    { return mGlobalIntervals; }
+  const ConditionMap& Conditions() const
+    { return mConditions; }
+
+ private:
+  void Window( long long start, const double* data, double condition );
+  static void Append( Intervals&, const Interval& );
+
+  double mAmplitude,
+         mPeakToPeak,
+         mFlat;
+  std::vector<double> mMin,
+                      mMax;
+  std::vector<Intervals> mChannelIntervals;
+  Intervals mGlobalIntervals;
+  ConditionMap mConditions;
+};
+
+#endif // ARTIFACT_DETECTOR_H
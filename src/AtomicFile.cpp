@@ -0,0 +1,100 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: A file that is written under a temporary name, and replaces
+//   the file of its actual name when complete, so readers never see a
+//   partial file.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#include "PCHIncludes.h"
+#pragma hdrstop
+
+#include "AtomicFile.h"
+
+#include <atomic>
+#include <sstream>
+
+#if _WIN32
+# include <process.h>
+# define getpid _getpid
+#else // _WIN32
+# include <unistd.h>
+#endif // _WIN32
+
+using namespace std;
+
+// Temporary files are named after the process and a counter, so writers
+// of the same file in different processes or threads do not interfere.
+string
+AtomicFile::TempName( const string& inName )
+{
+  static atomic<unsigned long> counter( 0 );
+  ostringstream oss;
+  oss << inName << "." << ::getpid() << "." << counter++ << ".tmp";
+  return oss.str();
+}
+
+AtomicFile::AtomicFile( const string& inName, const char* inMode )
+: mName( inName ),
+  mTempName( TempName( inName ) ),
+  mpFile( ::fopen( mTempName.c_str(), inMode ) )
+{
+}
+
+AtomicFile::~AtomicFile()
+{
+  if( mpFile )
+    Commit( false );
+}
+
+bool
+AtomicFile::Commit( bool inOk )
+{
+  if( !mpFile )
+    return false;
+  bool ok = ( 0 == ::fclose( mpFile ) ) && inOk;
+  mpFile = NULL;
+  if( ok )
+    return Replace( mTempName, mName );
+  ::remove( mTempName.c_str() );
+  return false;
+}
+
+bool
+AtomicFile::Replace( const string& inTempName, const string& inName )
+{
+#if _WIN32
+  // rename() does not replace existing files on Windows
+  ::remove( inName.c_str() );
+#endif // _WIN32
+  bool ok = ( 0 == ::rename( inTempName.c_str(), inName.c_str() ) );
+  if( !ok )
+    ::remove( inTempName.c_str() );
+  return ok;
+}
+
+bool
+AtomicFile::Write( const string& inName, const string& inData )
+{
+  AtomicFile file( inName );
+  return file.File()
+         && file.Commit( ::fwrite( inData.data(), 1, inData.size(), file.File() ) == inData.size() );
+}
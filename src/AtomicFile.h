@@ -0,0 +1,68 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: A file that is written under a temporary name, and replaces
+//   the file of its actual name when complete, so readers never see a
+//   partial file.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#ifndef ATOMIC_FILE_H
+#define ATOMIC_FILE_H
+
+#include <string>
+#include <cstdio>
+
+class AtomicFile
+{
+ public:
+  // Opens a temporary file next to the file, with a name unique to the
+  // process and object; File() is NULL if that fails.
+  explicit AtomicFile( const std::string& name, const char* mode = "wb" );
+  // Removes the temporary file unless it was committed.
+  ~AtomicFile();
+
+ private:
+  AtomicFile( const AtomicFile& );
+  AtomicFile& operator=( const AtomicFile& );
+
+ public:
+  std::FILE* File() const
+    { return mpFile; }
+  // Closes the temporary file. If ok is true, and closing succeeds, the
+  // temporary file replaces the file of the actual name; otherwise, it is
+  // removed. Returns true if the file was replaced.
+  bool Commit( bool ok );
+
+  // Writes data into a file as a whole. Returns true on success.
+  static bool Write( const std::string& name, const std::string& data );
+  // For writers that open files by name: a unique temporary name for a
+  // file, and replacing the file with the temporary file once it is
+  // complete. Returns true if the file was replaced.
+  static std::string TempName( const std::string& name );
+  static bool Replace( const std::string& tempName, const std::string& name );
+
+ private:
+  std::string mName,
+              mTempName;
+  std::FILE* mpFile;
+};
+
+#endif // ATOMIC_FILE_H
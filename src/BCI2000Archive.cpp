@@ -0,0 +1,668 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: A compressed container for BCI2000 data files. Records are
+//   grouped into blocks of a fixed number of samples, and each block is
+//   compressed on its own, so any sample can be reached by decompressing a
+//   single block. BCI2000FileReader opens archives like data files.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#include "PCHIncludes.h"
+#pragma hdrstop
+
+#include "BCI2000Archive.h"
+#include "BCI2000FileReader.h"
+#include "BCIException.h"
+#include "Serialization.h"
+#include "AtomicFile.h"
+#include "PositionalIO.h"
+#include "ByteOrder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <exception>
+#include <sstream>
+#include <thread>
+#include <sys/stat.h>
+
+using namespace std;
+
+static const char cArchiveMagic[] = "BCI2000Archive";
+static const uint32_t cArchiveVersion = 1;
+
+namespace
+{
+
+// Values of a column are coded in frames of fixed length, each holding
+// residuals packed with a common bit width. Decoding a frame is a loop
+// without data-dependent branches.
+const int cFrameLength = 128;
+// Compressed blocks are read into buffers with this many bytes of padding,
+// so bit fields may be extracted with 64 bit loads up to the end of data.
+const size_t cPadding = 16;
+// Predictors: none, previous value, linear extrapolation of the previous
+// two values.
+const int cNumPredictors = 3;
+
+// A column of a block: a channel's values, or one byte of the state vector.
+struct Column
+{
+  int offset,
+      bytes;
+};
+
+vector<Column>
+Columns( int inChannels, int inValueSize, int inStateVectorLength )
+{
+  vector<Column> columns;
+  for( int ch = 0; ch < inChannels; ++ch )
+  {
+    Column c = { ch * inValueSize, inValueSize };
+    columns.push_back( c );
+  }
+  for( int i = 0; i < inStateVectorLength; ++i )
+  {
+    Column c = { inChannels * inValueSize + i, 1 };
+    columns.push_back( c );
+  }
+  return columns;
+}
+
+inline uint64_t
+LoadValue( const char* p, int inBytes )
+{
+  switch( inBytes )
+  {
+    case 1:
+      return static_cast<unsigned char>( *p );
+    case 2:
+      return LoadLittleEndian<uint16_t>( p );
+    case 4:
+      return LoadLittleEndian<uint32_t>( p );
+  }
+  return LoadLittleEndian( reinterpret_cast<const unsigned char*>( p ), inBytes );
+}
+
+inline void
+StoreValue( char* p, int inBytes, uint64_t inValue )
+{
+  switch( inBytes )
+  {
+    case 1:
+      *p = static_cast<char>( inValue );
+      return;
+    case 2:
+      StoreLittleEndian<uint16_t>( p, static_cast<uint16_t>( inValue ) );
+      return;
+    case 4:
+      StoreLittleEndian<uint32_t>( p, static_cast<uint32_t>( inValue ) );
+      return;
+  }
+  StoreLittleEndian( reinterpret_cast<unsigned char*>( p ), inBytes, inValue );
+}
+
+// Residuals are differences modulo 2^bits, mapped to small unsigned
+// numbers when close to zero in either direction.
+inline uint64_t
+ZigZag( uint64_t inResidual, int inBits )
+{
+  int64_t s = static_cast<int64_t>( inResidual << ( 64 - inBits ) ) >> ( 64 - inBits );
+  return ( static_cast<uint64_t>( s ) << 1 ) ^ static_cast<uint64_t>( s >> 63 );
+}
+
+inline uint64_t
+UnZigZag( uint64_t inValue )
+{
+  return ( inValue >> 1 ) ^ ( 0 - ( inValue & 1 ) );
+}
+
+inline int
+BitWidth( uint64_t inValue )
+{
+  int width = 0;
+  while( inValue != 0 )
+  {
+    ++width;
+    inValue >>= 1;
+  }
+  return width;
+}
+
+// Computes zigzag coded residuals of a column's values for a predictor.
+void
+Residuals( const uint64_t* inValues, size_t inCount, int inPredictor, int inBits, uint64_t* outResiduals )
+{
+  for( size_t i = 0; i < inCount; ++i )
+  {
+    uint64_t prediction = 0;
+    if( i >= 2 && inPredictor == 2 )
+      prediction = 2 * inValues[ i - 1 ] - inValues[ i - 2 ];
+    else if( i >= 1 && inPredictor >= 1 )
+      prediction = inValues[ i - 1 ];
+    outResiduals[ i ] = ZigZag( inValues[ i ] - prediction, inBits );
+  }
+}
+
+// Number of bytes needed to store residuals in frames.
+size_t
+PackedSize( const uint64_t* inResiduals, size_t inCount )
+{
+  size_t size = 0;
+  for( size_t begin = 0; begin < inCount; begin += cFrameLength )
+  {
+    size_t end = min<size_t>( begin + cFrameLength, inCount );
+    uint64_t bits = 0;
+    for( size_t i = begin; i < end; ++i )
+      bits |= inResiduals[ i ];
+    size += 1 + ( ( end - begin ) * BitWidth( bits ) + 7 ) / 8;
+  }
+  return size;
+}
+
+// Appends residuals to a buffer, frame by frame: a byte holding the bit
+// width, followed by the frame's residuals as a little endian bit stream.
+void
+Pack( const uint64_t* inResiduals, size_t inCount, vector<char>& ioData )
+{
+  for( size_t begin = 0; begin < inCount; begin += cFrameLength )
+  {
+    size_t end = min<size_t>( begin + cFrameLength, inCount );
+    uint64_t bits = 0;
+    for( size_t i = begin; i < end; ++i )
+      bits |= inResiduals[ i ];
+    const int width = BitWidth( bits );
+    ioData.push_back( static_cast<char>( width ) );
+    if( width == 0 )
+      continue;
+    uint64_t acc = 0;
+    int fill = 0;
+    char word[ sizeof( uint64_t ) ];
+    for( size_t i = begin; i < end; ++i )
+    {
+      acc |= inResiduals[ i ] << fill;
+      if( fill + width >= 64 )
+      {
+        StoreLittleEndian<uint64_t>( word, acc );
+        ioData.insert( ioData.end(), word, word + sizeof( word ) );
+        acc = fill == 0 ? 0 : inResiduals[ i ] >> ( 64 - fill );
+        fill += width - 64;
+      }
+      else
+        fill += width;
+    }
+    StoreLittleEndian<uint64_t>( word, acc );
+    ioData.insert( ioData.end(), word, word + ( fill + 7 ) / 8 );
+  }
+}
+
+// Extracts residuals from frames. Returns the position following the
+// frames, or NULL if the data is malformed.
+const char*
+Unpack( const char* inData, const char* inEnd, size_t inCount, uint64_t* outResiduals )
+{
+  const char* p = inData;
+  for( size_t begin = 0; begin < inCount; begin += cFrameLength )
+  {
+    const size_t n = min<size_t>( cFrameLength, inCount - begin );
+    if( p >= inEnd )
+      return NULL;
+    const int width = static_cast<unsigned char>( *p++ );
+    const size_t length = ( n * width + 7 ) / 8;
+    if( width > 64 || length > static_cast<size_t>( inEnd - p ) )
+      return NULL;
+    uint64_t* out = outResiduals + begin;
+    if( width == 0 )
+      ::memset( out, 0, n * sizeof( uint64_t ) );
+    else if( width <= 57 )
+    { // a single load covers any field of up to 57 bits
+      const uint64_t mask = ( uint64_t( 1 ) << width ) - 1;
+      for( size_t i = 0, bit = 0; i < n; ++i, bit += width )
+        out[ i ] = ( LoadLittleEndian<uint64_t>( p + bit / 8 ) >> ( bit % 8 ) ) & mask;
+    }
+    else
+    {
+      const uint64_t mask = width == 64 ? ~uint64_t( 0 ) : ( uint64_t( 1 ) << width ) - 1;
+      for( size_t i = 0, bit = 0; i < n; ++i, bit += width )
+      {
+        const int shift = bit % 8;
+        uint64_t value = LoadLittleEndian<uint64_t>( p + bit / 8 ) >> shift;
+        if( shift )
+          value |= uint64_t( static_cast<unsigned char>( p[ bit / 8 + 8 ] ) ) << ( 64 - shift );
+        out[ i ] = value & mask;
+      }
+    }
+    p += length;
+  }
+  return p;
+}
+
+// Compresses a block of records. Each column is coded with the predictor
+// that gives the smallest output, stored as a byte in front of its frames.
+void
+EncodeBlock( const char* inRecords, size_t inCount, size_t inRecordSize,
+             const vector<Column>& inColumns, vector<char>& outData )
+{
+  outData.clear();
+  vector<uint64_t> values( inCount ),
+                   residuals[ cNumPredictors ];
+  for( int k = 0; k < cNumPredictors; ++k )
+    residuals[ k ].resize( inCount );
+  for( size_t c = 0; c < inColumns.size(); ++c )
+  {
+    const Column& column = inColumns[ c ];
+    const int bits = 8 * column.bytes;
+    const char* p = inRecords + column.offset;
+    for( size_t i = 0; i < inCount; ++i, p += inRecordSize )
+      values[ i ] = LoadValue( p, column.bytes );
+    int best = 0;
+    size_t bestSize = 0;
+    for( int k = 0; k < cNumPredictors; ++k )
+    {
+      Residuals( &values[ 0 ], inCount, k, bits, &residuals[ k ][ 0 ] );
+      size_t size = PackedSize( &residuals[ k ][ 0 ], inCount );
+      if( k == 0 || size < bestSize )
+      {
+        best = k;
+        bestSize = size;
+      }
+    }
+    outData.push_back( static_cast<char>( best ) );
+    Pack( &residuals[ best ][ 0 ], inCount, outData );
+  }
+}
+
+// Reconstructs a column's values from residuals, and stores them into
+// records. Values are reconstructed modulo 2^64, and truncated to their
+// size when stored.
+template<int Bytes>
+void
+Reconstruct( const uint64_t* inResiduals, size_t inCount, int inPredictor,
+             char* outRecords, size_t inRecordSize )
+{
+  uint64_t previous = 0,
+           beforePrevious = 0;
+  char* out = outRecords;
+  for( size_t i = 0; i < inCount; ++i, out += inRecordSize )
+  {
+    uint64_t prediction = 0;
+    if( inPredictor == 1 || ( inPredictor == 2 && i == 1 ) )
+      prediction = previous;
+    else if( inPredictor == 2 && i > 1 )
+      prediction = 2 * previous - beforePrevious;
+    const uint64_t value = prediction + UnZigZag( inResiduals[ i ] );
+    StoreValue( out, Bytes, value );
+    beforePrevious = previous;
+    previous = value;
+  }
+}
+
+// Decompresses a block of records. Returns false if the data is malformed.
+bool
+DecodeBlockData( const char* inData, size_t inLength, size_t inCount, size_t inRecordSize,
+                 const vector<Column>& inColumns, char* outRecords )
+{
+  const char* p = inData,
+            * end = inData + inLength;
+  vector<uint64_t> residuals( inCount );
+  for( size_t c = 0; c < inColumns.size(); ++c )
+  {
+    const Column& column = inColumns[ c ];
+    if( p >= end )
+      return false;
+    const int predictor = *p++;
+    if( predictor < 0 || predictor >= cNumPredictors )
+      return false;
+    p = Unpack( p, end, inCount, &residuals[ 0 ] );
+    if( p == NULL )
+      return false;
+    char* out = outRecords + column.offset;
+    switch( column.bytes )
+    {
+      case 1:
+        Reconstruct<1>( &residuals[ 0 ], inCount, predictor, out, inRecordSize );
+        break;
+      case 2:
+        Reconstruct<2>( &residuals[ 0 ], inCount, predictor, out, inRecordSize );
+        break;
+      case 3:
+        Reconstruct<3>( &residuals[ 0 ], inCount, predictor, out, inRecordSize );
+        break;
+      case 4:
+        Reconstruct<4>( &residuals[ 0 ], inCount, predictor, out, inRecordSize );
+        break;
+      default:
+        Reconstruct<8>( &residuals[ 0 ], inCount, predictor, out, inRecordSize );
+    }
+  }
+  return p == end;
+}
+
+} // namespace
+
+BCI2000Archive::BCI2000Archive()
+: mpFile( NULL )
+{
+  Close();
+}
+
+BCI2000Archive::~BCI2000Archive()
+{
+  Close();
+}
+
+bool
+BCI2000Archive::IsArchive( std::FILE* inFile )
+{
+  const size_t length = sizeof( uint32_t ) + sizeof( cArchiveMagic ) - 1;
+  char data[ length ];
+  if( PositionalIO::Read( inFile, 0, data, length ) != length )
+    return false;
+  const uint32_t magicLength = LoadLittleEndian<uint32_t>( data );
+  return magicLength == sizeof( cArchiveMagic ) - 1
+         && 0 == ::memcmp( data + sizeof( uint32_t ), cArchiveMagic, magicLength );
+}
+
+// **************************************************************************
+// Function:   Create
+// Purpose:    Compresses a reader's data file into an archive.
+//             The archive consists of a preamble that describes the record
+//             layout and holds the positions of blocks, the data file's
+//             header, and the compressed blocks.
+//             Within a block, each channel and each byte of the state vector
+//             is a column of values. A column's values are replaced with
+//             residuals from a predictor, residuals are zigzag coded, and
+//             packed into frames of 128 values with the smallest bit width
+//             that holds all of a frame's residuals. Slowly varying signals
+//             and constant state bytes thus take few bits per value, and
+//             coding is lossless for all data formats.
+// Parameters: reader - an open reader
+//             fileName - name of the archive file
+//             blockSamples - number of samples per block
+//             threads - number of threads, or 0 for one per processor
+// Returns:    True if the archive was written.
+// **************************************************************************
+bool
+BCI2000Archive::Create( const BCI2000FileReader& inReader, const string& inFileName,
+                        int inBlockSamples, int inThreads )
+{
+  using namespace Serialization;
+
+  const RecordDecoder* decoder = inReader.Decoder();
+  if( !inReader.IsOpen() || decoder == NULL )
+    return false;
+
+  const int channels = decoder->Channels(),
+            valueSize = decoder->Type().Size(),
+            stateVectorLength = inReader.StateVectorLength();
+  const long long numSamples = inReader.NumSamples(),
+                  blockSamples = max( inBlockSamples, 1 ),
+                  numBlocks = ( numSamples + blockSamples - 1 ) / blockSamples;
+  const size_t recordSize = decoder->RecordSize();
+  const vector<Column> columns = Columns( channels, valueSize, stateVectorLength );
+
+  vector<char> header( inReader.HeaderLength() );
+  if( !header.empty() && inReader.ReadAt( 0, &header[ 0 ], header.size() ) != header.size() )
+    return false;
+
+  // the preamble is little endian, like the compressed blocks
+  ostringstream os;
+  PutLittleEndian( os, static_cast<uint32_t>( sizeof( cArchiveMagic ) - 1 ) );
+  os.write( cArchiveMagic, sizeof( cArchiveMagic ) - 1 );
+  PutLittleEndian( os, cArchiveVersion );
+  PutLittleEndian( os, static_cast<int32_t>( header.size() ) );
+  PutLittleEndian( os, static_cast<int32_t>( channels ) );
+  PutLittleEndian( os, static_cast<int32_t>( valueSize ) );
+  PutLittleEndian( os, static_cast<int32_t>( stateVectorLength ) );
+  PutLittleEndian( os, static_cast<int64_t>( numSamples ) );
+  PutLittleEndian( os, static_cast<int64_t>( blockSamples ) );
+  PutLittleEndian( os, static_cast<uint64_t>( numBlocks ) );
+  const long long indexPosition = os.tellp();
+  vector<uint64_t> positions( static_cast<size_t>( numBlocks + 1 ) );
+  positions[ 0 ] = indexPosition + positions.size() * sizeof( uint64_t ) + header.size();
+
+  AtomicFile output( inFileName );
+  std::FILE* pFile = output.File();
+  if( !pFile )
+    return false;
+  // block positions are filled in when all blocks are written
+  string preamble = os.str();
+  preamble.resize( static_cast<size_t>( indexPosition ) + positions.size() * sizeof( uint64_t ) );
+  bool ok = ( ::fwrite( preamble.data(), 1, preamble.size(), pFile ) == preamble.size() );
+  ok = ok && ( header.empty() || ::fwrite( &header[ 0 ], 1, header.size(), pFile ) == header.size() );
+
+  // blocks are compressed in batches, one block per thread at a time,
+  // and written in order when a batch is complete
+  int threads = inThreads > 0 ? inThreads : static_cast<int>( thread::hardware_concurrency() );
+  threads = static_cast<int>( max<long long>( 1, min<long long>( threads, numBlocks ) ) );
+  const long long batchSize = 4 * threads;
+  vector< vector<char> > encoded( static_cast<size_t>( batchSize ) );
+  for( long long batch = 0; ok && batch < numBlocks; batch += batchSize )
+  {
+    const long long batchEnd = min( batch + batchSize, numBlocks );
+    atomic<long long> next( batch );
+    atomic<bool> readOk( true );
+    auto work = [&]()
+    {
+      vector<char> records;
+      for( long long k = next++; k < batchEnd; k = next++ )
+      {
+        const long long first = k * blockSamples,
+                        count = min( blockSamples, numSamples - first );
+        const size_t length = static_cast<size_t>( count ) * recordSize;
+        records.resize( length );
+        if( inReader.ReadAt( inReader.HeaderLength() + first * recordSize, &records[ 0 ], length ) != length )
+          readOk = false;
+        else
+          EncodeBlock( &records[ 0 ], static_cast<size_t>( count ), recordSize, columns,
+                       encoded[ static_cast<size_t>( k - batch ) ] );
+      }
+    };
+    vector<thread> workers;
+    for( int i = 1; i < threads; ++i )
+      workers.push_back( thread( work ) );
+    work();
+    for( size_t i = 0; i < workers.size(); ++i )
+      workers[ i ].join();
+    ok = readOk;
+    for( long long k = batch; ok && k < batchEnd; ++k )
+    {
+      const vector<char>& data = encoded[ static_cast<size_t>( k - batch ) ];
+      ok = data.empty() || ::fwrite( &data[ 0 ], 1, data.size(), pFile ) == data.size();
+      positions[ static_cast<size_t>( k + 1 ) ] = positions[ static_cast<size_t>( k ) ] + data.size();
+    }
+  }
+  if( ok )
+  {
+    ostringstream index;
+    for( size_t i = 0; i < positions.size(); ++i )
+      PutLittleEndian( index, positions[ i ] );
+    string data = index.str();
+    ok = ( 0 == ::fseek( pFile, static_cast<long>( indexPosition ), SEEK_SET ) )
+         && ::fwrite( data.data(), 1, data.size(), pFile ) == data.size();
+  }
+  return output.Commit( ok );
+}
+
+// **************************************************************************
+// Function:   Open
+// Purpose:    Reads an archive's preamble, and the data file's header.
+// Parameters: file - an open archive file
+// Returns:    True if the file is an archive, and its preamble is valid.
+// **************************************************************************
+bool
+BCI2000Archive::Open( std::FILE* inFile )
+{
+  Close();
+  if( inFile == NULL || !IsArchive( inFile ) || 0 != ::fseek( inFile, 0, SEEK_SET ) )
+    return false;
+
+  using namespace Serialization;
+  uint32_t magicLength = 0,
+           version = 0;
+  string magic;
+  bool ok = GetLittleEndian( inFile, magicLength ) && magicLength == sizeof( cArchiveMagic ) - 1;
+  if( ok )
+  {
+    magic.resize( magicLength );
+    ok = ( ::fread( &magic[ 0 ], 1, magicLength, inFile ) == magicLength );
+  }
+  int32_t headerLength = 0,
+          channels = 0,
+          valueSize = 0,
+          stateVectorLength = 0;
+  int64_t numSamples = 0,
+          blockSamples = 0;
+  uint64_t numBlocks = 0;
+  ok = ok && magic == cArchiveMagic
+          && GetLittleEndian( inFile, version ) && version == cArchiveVersion
+          && GetLittleEndian( inFile, headerLength ) && headerLength > 0
+          && GetLittleEndian( inFile, channels ) && channels >= 0
+          && GetLittleEndian( inFile, valueSize ) && valueSize > 0 && valueSize <= static_cast<int32_t>( sizeof( uint64_t ) )
+          && GetLittleEndian( inFile, stateVectorLength ) && stateVectorLength >= 0
+          && GetLittleEndian( inFile, numSamples ) && numSamples >= 0
+          && GetLittleEndian( inFile, blockSamples ) && blockSamples > 0
+          && GetLittleEndian( inFile, numBlocks )
+          && numBlocks == static_cast<uint64_t>( ( numSamples + blockSamples - 1 ) / blockSamples );
+  // the block index and header must fit into the file, so a corrupt
+  // preamble cannot cause a large allocation
+  struct stat fileStat;
+  const long long position = ok ? ::ftell( inFile ) : 0;
+  ok = ok && 0 == ::fstat( ::fileno( inFile ), &fileStat ) && position >= 0
+          && numBlocks < static_cast<uint64_t>( fileStat.st_size ) / sizeof( uint64_t )
+          && ( numBlocks + 1 ) * sizeof( uint64_t ) + headerLength <= static_cast<uint64_t>( fileStat.st_size - position );
+  if( ok )
+  {
+    vector<char> index( static_cast<size_t>( numBlocks + 1 ) * sizeof( uint64_t ) );
+    ok = ::fread( &index[ 0 ], 1, index.size(), inFile ) == index.size();
+    mBlockPositions.resize( static_cast<size_t>( numBlocks + 1 ) );
+    for( size_t i = 0; ok && i < mBlockPositions.size(); ++i )
+      mBlockPositions[ i ] = LoadLittleEndian<uint64_t>( &index[ i * sizeof( uint64_t ) ] );
+  }
+  if( ok )
+  {
+    mHeader.resize( headerLength );
+    ok = ::fread( &mHeader[ 0 ], 1, mHeader.size(), inFile ) == mHeader.size();
+  }
+  for( size_t i = 1; ok && i < mBlockPositions.size(); ++i )
+    ok = mBlockPositions[ i ] >= mBlockPositions[ i - 1 ];
+  ok = ok && mBlockPositions.back() <= static_cast<uint64_t>( fileStat.st_size );
+  if( !ok )
+  {
+    Close();
+    return false;
+  }
+  mpFile = inFile;
+  mNumSamples = numSamples;
+  mBlockSamples = blockSamples;
+  mChannels = channels;
+  mValueSize = valueSize;
+  mStateVectorLength = stateVectorLength;
+  mRecordSize = static_cast<long long>( channels ) * valueSize + stateVectorLength;
+  return true;
+}
+
+void
+BCI2000Archive::Close()
+{
+  mpFile = NULL;
+  mChannels = 0;
+  mValueSize = 0;
+  mStateVectorLength = 0;
+  mRecordSize = 0;
+  mNumSamples = 0;
+  mBlockSamples = 0;
+  mHeader.clear();
+  mBlockPositions.clear();
+}
+
+long long
+BCI2000Archive::BlockBegin( long long inPosition ) const
+{
+  const long long dataBegin = HeaderLength(),
+                  blockSize = mBlockSamples * mRecordSize;
+  if( inPosition < dataBegin || blockSize <= 0 )
+    return 0;
+  return dataBegin + ( inPosition - dataBegin ) / blockSize * blockSize;
+}
+
+// **************************************************************************
+// Function:   ReadAt
+// Purpose:    Reads bytes of the uncompressed data file.
+// Parameters: position - position in the uncompressed data file
+//             data - destination buffer
+//             length - number of bytes to read
+// Returns:    Number of bytes read.
+// **************************************************************************
+size_t
+BCI2000Archive::ReadAt( long long inPosition, char* outData, size_t inLength ) const
+{
+  if( !IsOpen() || inPosition < 0 )
+    return 0;
+  size_t done = 0;
+  if( inPosition < HeaderLength() )
+  {
+    done = min<size_t>( inLength, static_cast<size_t>( HeaderLength() - inPosition ) );
+    ::memcpy( outData, &mHeader[ 0 ] + inPosition, done );
+  }
+  const long long blockSize = mBlockSamples * mRecordSize,
+                  end = HeaderLength() + mNumSamples * mRecordSize;
+  vector<char> block;
+  while( done < inLength && inPosition + static_cast<long long>( done ) < end && blockSize > 0 )
+  {
+    const long long offset = inPosition + done - HeaderLength(),
+                    k = offset / blockSize,
+                    inBlock = offset - k * blockSize,
+                    size = min( mBlockSamples, mNumSamples - k * mBlockSamples ) * mRecordSize;
+    const size_t count = static_cast<size_t>( min<long long>( inLength - done, size - inBlock ) );
+    if( inBlock == 0 && static_cast<long long>( count ) == size )
+      DecodeBlock( k, outData + done );
+    else
+    {
+      block.resize( static_cast<size_t>( size ) );
+      DecodeBlock( k, &block[ 0 ] );
+      ::memcpy( outData + done, &block[ 0 ] + inBlock, count );
+    }
+    done += count;
+  }
+  return done;
+}
+
+// **************************************************************************
+// Function:   DecodeBlock
+// Purpose:    Reads and decompresses a block.
+// Parameters: block - block index
+//             records - output buffer for the block's records
+// Returns:    N/A
+// **************************************************************************
+void
+BCI2000Archive::DecodeBlock( long long inBlock, char* outRecords ) const
+{
+  const size_t k = static_cast<size_t>( inBlock ),
+               length = static_cast<size_t>( mBlockPositions[ k + 1 ] - mBlockPositions[ k ] ),
+               count = static_cast<size_t>( min( mBlockSamples, mNumSamples - inBlock * mBlockSamples ) );
+  vector<char> data( length + cPadding );
+  if( PositionalIO::Read( mpFile, mBlockPositions[ k ], &data[ 0 ], length ) != length )
+    throw std_runtime_error( "Could not read archive block " << inBlock );
+  if( !DecodeBlockData( &data[ 0 ], length, count, static_cast<size_t>( mRecordSize ),
+                        Columns( mChannels, mValueSize, mStateVectorLength ), outRecords ) )
+    throw std_runtime_error( "Archive block " << inBlock << " is corrupt" );
+}
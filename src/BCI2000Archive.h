@@ -0,0 +1,101 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: A compressed container for BCI2000 data files. Records are
+//   grouped into blocks of a fixed number of samples, and each block is
+//   compressed on its own, so any sample can be reached by decompressing a
+//   single block. BCI2000FileReader opens archives like data files.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#ifndef BCI2000_ARCHIVE_H
+#define BCI2000_ARCHIVE_H
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <stdint.h>
+
+class BCI2000FileReader;
+
+class BCI2000Archive
+{
+ public:
+  static const int cDefaultBlockSamples = 4096;
+
+ public:
+  BCI2000Archive();
+  ~BCI2000Archive();
+
+ private:
+  BCI2000Archive( const BCI2000Archive& );
+  BCI2000Archive& operator=( const BCI2000Archive& );
+
+ public:
+  // Whether a file starts with the signature of an archive.
+  static bool IsArchive( std::FILE* );
+  // Compresses the data file opened by a reader into an archive.
+  // Blocks are compressed in parallel, using as many threads as there
+  // are processors if threads is 0.
+  // Returns false if the archive could not be written.
+  static bool Create( const BCI2000FileReader&, const std::string& fileName,
+                      int blockSamples = cDefaultBlockSamples, int threads = 0 );
+
+  // Reads the archive's index from an open file. The file remains owned by
+  // the caller, and must stay open while the archive is in use.
+  bool  Open( std::FILE* );
+  void  Close();
+  bool  IsOpen() const
+        { return mpFile != NULL; }
+  long long NumSamples() const
+        { return mNumSamples; }
+  long long BlockSamples() const
+        { return mBlockSamples; }
+  long long RecordSize() const
+        { return mRecordSize; }
+  int   HeaderLength() const
+        { return static_cast<int>( mHeader.size() ); }
+  // Position of the first byte of the block that holds a byte of the
+  // uncompressed data file.
+  long long BlockBegin( long long position ) const;
+
+  // Reads bytes of the uncompressed data file, i.e. its header followed
+  // by its records, decompressing the blocks involved. Reads covering
+  // whole blocks are decompressed into the destination without copying.
+  // This function may be called from multiple threads at once.
+  // Returns the number of bytes read; less than length at the end of data.
+  size_t ReadAt( long long position, char* data, size_t length ) const;
+
+ private:
+  void  DecodeBlock( long long block, char* records ) const;
+
+ private:
+  std::FILE*         mpFile;
+  int                mChannels,
+                     mValueSize,
+                     mStateVectorLength;
+  long long          mRecordSize,
+                     mNumSamples,
+                     mBlockSamples;
+  std::vector<char>  mHeader;
+  std::vector<uint64_t> mBlockPositions;
+};
+
+#endif // BCI2000_ARCHIVE_H
@@ -0,0 +1,317 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: A sidecar file holding the data of a BCI2000 data file in
+//   columns, one per channel and state, chunked by time. Reading a subset
+//   of channels or states only touches the columns involved.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#include "PCHIncludes.h"
+#pragma hdrstop
+
+#include "BCI2000ColumnStore.h"
+#include "BCI2000FileReader.h"
+#include "RecordDecoder.h"
+#include "BCIException.h"
+#include "Serialization.h"
+#include "AtomicFile.h"
+#include "PositionalIO.h"
+#include "ByteOrder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+using namespace std;
+
+static const char cColumnStoreMagic[] = "BCI2000ColumnStore";
+static const uint32_t cColumnStoreVersion = 2;
+
+BCI2000ColumnStore::BCI2000ColumnStore()
+: mpFile( NULL )
+{
+  Close();
+}
+
+BCI2000ColumnStore::~BCI2000ColumnStore()
+{
+  Close();
+}
+
+string
+BCI2000ColumnStore::FileName( const string& inDataFile )
+{
+  return inDataFile + ".bcicol";
+}
+
+// **************************************************************************
+// Function:   Create
+// Purpose:    Writes the sidecar file for a reader's data file.
+//             The file consists of a header that identifies the data file,
+//             describes the columns, and holds the positions of chunks,
+//             followed by the chunks. Each chunk holds the values of a
+//             range of samples, one column after the other. Signal values
+//             are stored in the data file's format, and state values as
+//             little endian integers of as many bytes as they need.
+// Parameters: reader - an open reader
+//             chunkSamples - number of samples per chunk
+// Returns:    True if the file was written.
+// **************************************************************************
+bool
+BCI2000ColumnStore::Create( const BCI2000FileReader& inReader, int inChunkSamples )
+{
+  using namespace Serialization;
+
+  const RecordDecoder* decoder = inReader.Decoder();
+  if( !inReader.IsOpen() || decoder == NULL )
+    return false;
+
+  const int channels = decoder->Channels(),
+            numStates = inReader.States()->Size(),
+            valueSize = decoder->Type().Size();
+  const long long numSamples = inReader.NumSamples(),
+                  chunkSamples = max( inChunkSamples, 1 ),
+                  numChunks = ( numSamples + chunkSamples - 1 ) / chunkSamples;
+  vector<int> widths( channels, valueSize ),
+              offsets;
+  for( int i = 0; i < numStates; ++i )
+    widths.push_back( max( ( ( *inReader.States() )[ i ].Length() + 7 ) / 8, 1 ) );
+  int rowBytes = 0;
+  for( size_t i = 0; i < widths.size(); ++i )
+  {
+    offsets.push_back( rowBytes );
+    rowBytes += widths[ i ];
+  }
+
+  ostringstream os;
+  PutString( os, cColumnStoreMagic );
+  Put( os, cColumnStoreVersion );
+  const BCI2000FileReader::Identity identity = inReader.FileIdentity();
+  Put( os, identity.size );
+  Put( os, identity.time );
+  Put( os, identity.headerHash );
+  Put( os, static_cast<int32_t>( decoder->Type() ) );
+  Put( os, static_cast<int32_t>( channels ) );
+  Put( os, static_cast<int32_t>( numStates ) );
+  Put( os, numSamples );
+  Put( os, chunkSamples );
+  for( size_t i = 0; i < widths.size(); ++i )
+    Put( os, static_cast<int32_t>( widths[ i ] ) );
+  Put( os, static_cast<uint64_t>( numChunks ) );
+  const unsigned long long dataBegin = static_cast<unsigned long long>( os.tellp() ) + numChunks * sizeof( uint64_t );
+  for( long long k = 0; k < numChunks; ++k )
+    Put( os, static_cast<uint64_t>( dataBegin + k * chunkSamples * rowBytes ) );
+
+  AtomicFile output( FileName( inReader.FileName() ) );
+  std::FILE* pFile = output.File();
+  if( !pFile )
+    return false;
+  string header = os.str();
+  bool ok = ( ::fwrite( header.data(), 1, header.size(), pFile ) == header.size() );
+
+  const size_t recordSize = decoder->RecordSize();
+  vector<char> records( static_cast<size_t>( min( chunkSamples, max( numSamples, 1LL ) ) ) * recordSize ),
+               chunk( static_cast<size_t>( min( chunkSamples, max( numSamples, 1LL ) ) ) * rowBytes );
+  vector<double> states( static_cast<size_t>( min( chunkSamples, max( numSamples, 1LL ) ) ) * numStates );
+  for( long long k = 0; ok && k < numChunks; ++k )
+  {
+    const long long first = k * chunkSamples,
+                    count = min( chunkSamples, numSamples - first );
+    const size_t length = static_cast<size_t>( count ) * recordSize;
+    ok = ( inReader.ReadAt( inReader.HeaderLength() + first * recordSize, &records[ 0 ], length ) == length );
+    // signal values are copied as they are
+    for( int ch = 0; ch < channels; ++ch )
+    {
+      char* dest = &chunk[ 0 ] + count * offsets[ ch ];
+      const char* src = &records[ 0 ] + ch * valueSize;
+      for( long long i = 0; i < count; ++i, dest += valueSize, src += recordSize )
+        ::memcpy( dest, src, valueSize );
+    }
+    // state values are taken from the decoder
+    if( numStates > 0 )
+    {
+      RecordDecoder::Output output;
+      output.states = &states[ 0 ];
+      output.stateStride = static_cast<size_t>( count );
+      decoder->Decode( &records[ 0 ], static_cast<size_t>( count ), output );
+      for( int s = 0; s < numStates; ++s )
+      {
+        const int column = channels + s;
+        unsigned char* dest = reinterpret_cast<unsigned char*>( &chunk[ 0 ] ) + count * offsets[ column ];
+        const double* src = &states[ 0 ] + s * count;
+        for( long long i = 0; i < count; ++i, dest += widths[ column ] )
+          StoreLittleEndian( dest, widths[ column ], static_cast<uint64_t>( src[ i ] ) );
+      }
+    }
+    const size_t chunkLength = static_cast<size_t>( count ) * rowBytes;
+    ok = ok && ( ::fwrite( &chunk[ 0 ], 1, chunkLength, pFile ) == chunkLength );
+  }
+  return output.Commit( ok );
+}
+
+// **************************************************************************
+// Function:   Open
+// Purpose:    Opens the sidecar file of a reader's data file, and reads
+//             its header.
+// Parameters: reader - an open reader
+// Returns:    True if the sidecar file exists, and matches the data file.
+// **************************************************************************
+bool
+BCI2000ColumnStore::Open( const BCI2000FileReader& inReader )
+{
+  using namespace Serialization;
+
+  Close();
+  if( !inReader.IsOpen() || inReader.Decoder() == NULL )
+    return false;
+  mpFile = ::fopen( FileName( inReader.FileName() ).c_str(), "rb" );
+  if( !mpFile )
+    return false;
+
+  uint32_t magicLength = 0,
+           version = 0;
+  string magic;
+  bool ok = Get( mpFile, magicLength ) && magicLength == sizeof( cColumnStoreMagic ) - 1;
+  if( ok )
+  {
+    magic.resize( magicLength );
+    ok = ( ::fread( &magic[ 0 ], 1, magicLength, mpFile ) == magicLength );
+  }
+  long long fileSize = 0,
+            fileTime = 0;
+  unsigned long long headerHash = 0;
+  int32_t type = 0,
+          channels = 0,
+          numStates = 0;
+  uint64_t numChunks = 0;
+  ok = ok && magic == cColumnStoreMagic
+          && Get( mpFile, version ) && version == cColumnStoreVersion
+          && Get( mpFile, fileSize ) && fileSize == inReader.FileIdentity().size
+          && Get( mpFile, fileTime ) && fileTime == inReader.FileIdentity().time
+          && Get( mpFile, headerHash ) && headerHash == inReader.FileIdentity().headerHash
+          && Get( mpFile, type ) && type == static_cast<int32_t>( inReader.Decoder()->Type() )
+          && Get( mpFile, channels ) && channels == inReader.Decoder()->Channels()
+          && Get( mpFile, numStates ) && numStates == inReader.States()->Size()
+          && Get( mpFile, mNumSamples ) && mNumSamples <= inReader.NumSamples()
+          && Get( mpFile, mChunkSamples ) && mChunkSamples > 0;
+  for( int i = 0; ok && i < channels + numStates; ++i )
+  {
+    int32_t width = 0;
+    ok = Get( mpFile, width ) && width > 0 && width <= static_cast<int32_t>( sizeof( uint64_t ) );
+    mColumnOffsets.push_back( mColumnWidths.empty() ? 0 : mColumnOffsets.back() + mColumnWidths.back() );
+    mColumnWidths.push_back( width );
+  }
+  ok = ok && Get( mpFile, numChunks )
+          && numChunks == static_cast<uint64_t>( ( mNumSamples + mChunkSamples - 1 ) / mChunkSamples );
+  if( ok )
+  {
+    mChunkPositions.resize( static_cast<size_t>( numChunks ) );
+    ok = numChunks == 0
+         || ::fread( &mChunkPositions[ 0 ], sizeof( uint64_t ), mChunkPositions.size(), mpFile ) == mChunkPositions.size();
+  }
+  if( !ok )
+  {
+    Close();
+    return false;
+  }
+  mSignalType = SignalType::Type( type );
+  mChannels = channels;
+  return true;
+}
+
+void
+BCI2000ColumnStore::Close()
+{
+  if( mpFile )
+    ::fclose( mpFile );
+  mpFile = NULL;
+  mSignalType = SignalType::int16;
+  mChannels = 0;
+  mNumSamples = 0;
+  mChunkSamples = 0;
+  mColumnWidths.clear();
+  mColumnOffsets.clear();
+  mChunkPositions.clear();
+}
+
+void
+BCI2000ColumnStore::ReadChannel( int inChannel, long long inSample, long long inCount,
+                                 GenericSignal::ValueType* outValues ) const
+{
+  if( inChannel < 0 || inChannel >= mChannels )
+    throw std_range_error( "Channel index " << inChannel << " out of range" );
+  ReadColumn( inChannel, inSample, inCount, outValues );
+}
+
+void
+BCI2000ColumnStore::ReadState( int inState, long long inSample, long long inCount,
+                               double* outValues ) const
+{
+  if( inState < 0 || mChannels + inState >= static_cast<int>( mColumnWidths.size() ) )
+    throw std_range_error( "State index " << inState << " out of range" );
+  ReadColumn( mChannels + inState, inSample, inCount, outValues );
+}
+
+// **************************************************************************
+// Function:   ReadColumn
+// Purpose:    Reads and decodes a range of values from a column, one read
+//             per chunk involved.
+// Parameters: column - column index; channels come before states
+//             sample - first sample
+//             count - number of samples
+//             values - output array
+// Returns:    N/A
+// **************************************************************************
+void
+BCI2000ColumnStore::ReadColumn( int inColumn, long long inSample, long long inCount, double* outValues ) const
+{
+  if( !IsOpen() )
+    throw std_runtime_error( "Column store is not open" );
+  if( inSample < 0 || inSample + inCount > mNumSamples )
+    throw std_range_error( "Sample range " << inSample << ".." << inSample + inCount
+                           << " exceeds column store size of " << mNumSamples );
+  const int width = mColumnWidths[ inColumn ];
+  vector<char> buffer;
+  long long done = 0;
+  while( done < inCount )
+  {
+    const long long sample = inSample + done,
+                    k = sample / mChunkSamples,
+                    chunkSize = min( mChunkSamples, mNumSamples - k * mChunkSamples ),
+                    offset = sample - k * mChunkSamples,
+                    count = min( chunkSize - offset, inCount - done );
+    const size_t length = static_cast<size_t>( count * width );
+    buffer.resize( length );
+    long long position = mChunkPositions[ static_cast<size_t>( k ) ] + ColumnOffset( inColumn, chunkSize ) + offset * width;
+    if( PositionalIO::Read( mpFile, position, &buffer[ 0 ], length ) != length )
+      throw std_runtime_error( "Could not read column data at position " << position );
+    double* out = outValues + done;
+    if( inColumn < mChannels )
+      RecordDecoder::DecodeValues( mSignalType, &buffer[ 0 ], static_cast<size_t>( count ), out );
+    else
+    {
+      const unsigned char* p = reinterpret_cast<const unsigned char*>( &buffer[ 0 ] );
+      for( long long i = 0; i < count; ++i, p += width )
+        out[ i ] = static_cast<double>( LoadLittleEndian( p, width ) );
+    }
+    done += count;
+  }
+}
@@ -0,0 +1,100 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: A sidecar file holding the data of a BCI2000 data file in
+//   columns, one per channel and state, chunked by time. Reading a subset
+//   of channels or states only touches the columns involved.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#ifndef BCI2000_COLUMN_STORE_H
+#define BCI2000_COLUMN_STORE_H
+
+#include "GenericSignal.h"
+#include "SignalType.h"
+
+#include <vector>
+#include <string>
+#include <cstdio>
+
+class BCI2000FileReader;
+
+class BCI2000ColumnStore
+{
+ public:
+  static const int cDefaultChunkSamples = 64 * 1024;
+
+ public:
+  BCI2000ColumnStore();
+  ~BCI2000ColumnStore();
+
+ private:
+  BCI2000ColumnStore( const BCI2000ColumnStore& );
+  BCI2000ColumnStore& operator=( const BCI2000ColumnStore& );
+
+ public:
+  // Name of the sidecar file that belongs to a data file.
+  static std::string FileName( const std::string& dataFile );
+  // Writes the sidecar file for the data file opened by a reader.
+  // Returns false if the file could not be written.
+  static bool Create( const BCI2000FileReader&, int chunkSamples = cDefaultChunkSamples );
+
+  // Opens the sidecar file of a reader's data file. Fails if there is no
+  // sidecar file, or if it does not match the data file's size,
+  // modification time, and header.
+  bool  Open( const BCI2000FileReader& );
+  void  Close();
+  bool  IsOpen() const
+        { return mpFile != NULL; }
+  long long NumSamples() const
+        { return mNumSamples; }
+  long long ChunkSamples() const
+        { return mChunkSamples; }
+
+  // Column access
+  //  Raw signal values of a channel, or values of a state in the order of
+  //  the state list, for count samples starting at sample.
+  //  These functions may be called from multiple threads at once.
+  void  ReadChannel( int channel, long long sample, long long count,
+                     GenericSignal::ValueType* values ) const;
+  void  ReadState( int state, long long sample, long long count,
+                   double* values ) const;
+
+ private:
+  // Position of a column's values within a chunk, relative to the chunk's
+  // start, for a chunk of the given number of samples.
+  long long ColumnOffset( int column, long long chunkSize ) const
+    { return chunkSize * mColumnOffsets[ column ]; }
+  void  ReadColumn( int column, long long sample, long long count, double* values ) const;
+
+ private:
+  std::FILE*         mpFile;
+  SignalType         mSignalType;
+  int                mChannels;
+  long long          mNumSamples,
+                     mChunkSamples;
+  // Bytes per value for each column, and the sum of bytes per value of
+  // all columns before a column.
+  std::vector<int>   mColumnWidths,
+                     mColumnOffsets;
+  std::vector<unsigned long long> mChunkPositions;
+};
+
+#endif // BCI2000_COLUMN_STORE_H
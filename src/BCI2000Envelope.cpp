@@ -0,0 +1,470 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: A sidecar file holding the minimum, maximum, and mean of each
+//   channel over bins of samples, at bin sizes that double from one level to
+//   the next. Envelopes of any range of samples at any resolution are read
+//   with I/O bounded by the resolution, rather than by the range.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#include "PCHIncludes.h"
+#pragma hdrstop
+
+#include "BCI2000Envelope.h"
+#include "BCI2000FileReader.h"
+#include "BCIException.h"
+#include "Serialization.h"
+#include "AtomicFile.h"
+#include "PositionalIO.h"
+
+#include <algorithm>
+#include <limits>
+#include <sstream>
+
+using namespace std;
+
+static const char cEnvelopeMagic[] = "BCI2000Envelope";
+static const uint32_t cEnvelopeVersion = 2;
+
+namespace
+{
+
+// Running minimum, maximum, and sum of each channel over a bin.
+struct Bin
+{
+  vector<double> min, max, sum;
+  long long count;
+  int parts;
+
+  explicit Bin( int channels = 0 )
+  : min( channels ), max( channels ), sum( channels ), count( 0 ), parts( 0 )
+  {}
+  void Merge( const Bin& b )
+  {
+    for( size_t ch = 0; ch < sum.size(); ++ch )
+    {
+      min[ ch ] = count ? std::min( min[ ch ], b.min[ ch ] ) : b.min[ ch ];
+      max[ ch ] = count ? std::max( max[ ch ], b.max[ ch ] ) : b.max[ ch ];
+      sum[ ch ] += b.sum[ ch ];
+    }
+    count += b.count;
+    ++parts;
+  }
+  void Clear()
+  {
+    std::fill( sum.begin(), sum.end(), 0 );
+    count = 0;
+    parts = 0;
+  }
+};
+
+// Bins of all levels, written to their levels' positions in the file as
+// they are completed. Each completed bin is merged into the next level's
+// pending bin, which is complete after two bins.
+class LevelWriter
+{
+ public:
+  LevelWriter( std::FILE* file, int channels, const vector<unsigned long long>& positions )
+  : mpFile( file ), mChannels( channels ), mPositions( positions ),
+    mWritten( positions.size(), 0 ), mBuffers( positions.size() ), mPending( positions.size(), Bin( channels ) ),
+    mOk( true )
+  {}
+  bool Ok() const
+    { return mOk; }
+  void Emit( size_t level, const Bin& bin )
+  {
+    vector<float>& buffer = mBuffers[ level ];
+    for( int ch = 0; ch < mChannels; ++ch )
+      buffer.push_back( static_cast<float>( bin.min[ ch ] ) );
+    for( int ch = 0; ch < mChannels; ++ch )
+      buffer.push_back( static_cast<float>( bin.max[ ch ] ) );
+    for( int ch = 0; ch < mChannels; ++ch )
+      buffer.push_back( static_cast<float>( bin.sum[ ch ] / bin.count ) );
+    if( buffer.size() >= 64 * 1024 )
+      Flush( level );
+    if( level + 1 < mPending.size() )
+    {
+      Bin& next = mPending[ level + 1 ];
+      next.Merge( bin );
+      if( next.parts == 2 )
+      {
+        Emit( level + 1, next );
+        next.Clear();
+      }
+    }
+  }
+  // Emits incomplete bins at the end of data, lowest level first, so each
+  // includes the bins emitted below it.
+  void Finish()
+  {
+    for( size_t level = 1; level < mPending.size(); ++level )
+      if( mPending[ level ].parts > 0 )
+      {
+        Bin bin = mPending[ level ];
+        mPending[ level ].Clear();
+        Emit( level, bin );
+      }
+    for( size_t level = 0; level < mBuffers.size(); ++level )
+      Flush( level );
+  }
+
+ private:
+  void Flush( size_t level )
+  {
+    vector<float>& buffer = mBuffers[ level ];
+    const size_t length = buffer.size() * sizeof( float );
+    if( length > 0 )
+      mOk = mOk && PositionalIO::Write( mpFile, mPositions[ level ] + mWritten[ level ],
+                                        reinterpret_cast<const char*>( &buffer[ 0 ] ), length ) == length;
+    mWritten[ level ] += length;
+    buffer.clear();
+  }
+
+  std::FILE* mpFile;
+  int mChannels;
+  vector<unsigned long long> mPositions,
+                             mWritten;
+  vector< vector<float> > mBuffers;
+  vector<Bin> mPending;
+  bool mOk;
+};
+
+} // namespace
+
+BCI2000Envelope::BCI2000Envelope()
+: mpFile( NULL )
+{
+  Close();
+}
+
+BCI2000Envelope::~BCI2000Envelope()
+{
+  Close();
+}
+
+string
+BCI2000Envelope::FileName( const string& inDataFile )
+{
+  return inDataFile + ".bcienv";
+}
+
+// **************************************************************************
+// Function:   Create
+// Purpose:    Writes the sidecar file for a reader's data file.
+//             The file consists of a header that identifies the data file,
+//             and holds the positions of levels, followed by the levels.
+//             A level holds a record per bin, with the minimum, maximum, and
+//             mean of raw values of all channels as floats. Level 0 bins
+//             are computed from the data, and bins of higher levels from
+//             pairs of bins of the level below, as the data are read.
+// Parameters: reader - an open reader
+//             binSamples - number of samples per bin on level 0
+// Returns:    True if the file was written.
+// **************************************************************************
+bool
+BCI2000Envelope::Create( const BCI2000FileReader& inReader, int inBinSamples )
+{
+  using namespace Serialization;
+
+  if( !inReader.IsOpen() || inReader.Decoder() == NULL )
+    return false;
+  const int channels = inReader.SignalProperties().Channels();
+  const long long numSamples = inReader.NumSamples(),
+                  binSamples = max( inBinSamples, 1 ),
+                  recordSize = 3 * channels * sizeof( float );
+
+  ostringstream os;
+  PutString( os, cEnvelopeMagic );
+  Put( os, cEnvelopeVersion );
+  const BCI2000FileReader::Identity identity = inReader.FileIdentity();
+  Put( os, identity.size );
+  Put( os, identity.time );
+  Put( os, identity.headerHash );
+  Put( os, static_cast<int32_t>( channels ) );
+  Put( os, numSamples );
+  Put( os, binSamples );
+  vector<long long> bins;
+  for( long long size = binSamples; numSamples > 0; size *= 2 )
+  {
+    bins.push_back( ( numSamples + size - 1 ) / size );
+    if( bins.back() == 1 )
+      break;
+  }
+  Put( os, static_cast<uint32_t>( bins.size() ) );
+  vector<unsigned long long> positions;
+  unsigned long long position = static_cast<unsigned long long>( os.tellp() ) + bins.size() * sizeof( uint64_t );
+  for( size_t level = 0; level < bins.size(); ++level )
+  {
+    positions.push_back( position );
+    Put( os, static_cast<uint64_t>( position ) );
+    position += bins[ level ] * recordSize;
+  }
+
+  AtomicFile output( FileName( inReader.FileName() ), "wb+" );
+  std::FILE* pFile = output.File();
+  if( !pFile )
+    return false;
+  string header = os.str();
+  bool ok = ( ::fwrite( header.data(), 1, header.size(), pFile ) == header.size() );
+  ok = ok && 0 == ::fflush( pFile );
+
+  // data are read in chunks of whole bins
+  const long long chunkSamples = max( binSamples, 16384 / binSamples * binSamples );
+  vector<GenericSignal::ValueType> signal( static_cast<size_t>( chunkSamples * channels + 1 ) );
+  BCI2000FileReader::Cursor cursor( inReader );
+  LevelWriter writer( pFile, channels, positions );
+  Bin bin( channels );
+  for( long long first = 0; ok && first < numSamples; first += chunkSamples )
+  {
+    const long long count = min( chunkSamples, numSamples - first );
+    cursor.ReadBlock( first, count, &signal[ 0 ], chunkSamples, false );
+    for( long long begin = 0; begin < count; begin += binSamples )
+    {
+      const long long n = min( binSamples, count - begin );
+      for( int ch = 0; ch < channels; ++ch )
+      {
+        const GenericSignal::ValueType* x = &signal[ ch * chunkSamples + begin ];
+        double mn = x[ 0 ], mx = x[ 0 ], sum = 0;
+        for( long long i = 0; i < n; ++i )
+        {
+          mn = x[ i ] < mn ? x[ i ] : mn;
+          mx = x[ i ] > mx ? x[ i ] : mx;
+          sum += x[ i ];
+        }
+        bin.min[ ch ] = mn;
+        bin.max[ ch ] = mx;
+        bin.sum[ ch ] = sum;
+      }
+      bin.count = n;
+      writer.Emit( 0, bin );
+    }
+    ok = writer.Ok();
+  }
+  writer.Finish();
+  ok = ok && writer.Ok();
+  return output.Commit( ok );
+}
+
+// **************************************************************************
+// Function:   Open
+// Purpose:    Opens the sidecar file of a reader's data file, and reads
+//             its header.
+// Parameters: reader - an open reader
+// Returns:    True if the sidecar file exists, and matches the data file.
+// **************************************************************************
+bool
+BCI2000Envelope::Open( const BCI2000FileReader& inReader )
+{
+  using namespace Serialization;
+
+  Close();
+  if( !inReader.IsOpen() )
+    return false;
+  mpFile = ::fopen( FileName( inReader.FileName() ).c_str(), "rb" );
+  if( !mpFile )
+    return false;
+
+  uint32_t magicLength = 0,
+           version = 0,
+           levels = 0;
+  string magic;
+  bool ok = Get( mpFile, magicLength ) && magicLength == sizeof( cEnvelopeMagic ) - 1;
+  if( ok )
+  {
+    magic.resize( magicLength );
+    ok = ( ::fread( &magic[ 0 ], 1, magicLength, mpFile ) == magicLength );
+  }
+  long long fileSize = 0,
+            fileTime = 0;
+  unsigned long long headerHash = 0;
+  int32_t channels = 0;
+  ok = ok && magic == cEnvelopeMagic
+          && Get( mpFile, version ) && version == cEnvelopeVersion
+          && Get( mpFile, fileSize ) && fileSize == inReader.FileIdentity().size
+          && Get( mpFile, fileTime ) && fileTime == inReader.FileIdentity().time
+          && Get( mpFile, headerHash ) && headerHash == inReader.FileIdentity().headerHash
+          && Get( mpFile, channels ) && channels == inReader.SignalProperties().Channels()
+          && Get( mpFile, mNumSamples ) && mNumSamples <= inReader.NumSamples()
+          && Get( mpFile, mBinSamples ) && mBinSamples > 0
+          && Get( mpFile, levels ) && levels < 64;
+  for( uint32_t level = 0; ok && level < levels; ++level )
+  {
+    uint64_t position = 0;
+    ok = Get( mpFile, position );
+    mLevelPositions.push_back( position );
+  }
+  if( !ok )
+  {
+    Close();
+    return false;
+  }
+  mChannels = channels;
+  return true;
+}
+
+void
+BCI2000Envelope::Close()
+{
+  if( mpFile )
+    ::fclose( mpFile );
+  mpFile = NULL;
+  mChannels = 0;
+  mNumSamples = 0;
+  mBinSamples = 0;
+  mLevelPositions.clear();
+}
+
+// **************************************************************************
+// Function:   Query
+// Purpose:    Computes an envelope at a given resolution, from the coarsest
+//             level with bins not larger than a pixel. A level's bins are
+//             at most half as large as pixels unless it is the top level,
+//             so the number of bins read is bounded by about twice the
+//             number of pixels.
+// Parameters: reader - reader of the data file
+//             from, to - range of samples
+//             width - number of pixels
+//             channels - list of channels
+//             calibrated - whether values are calibrated
+//             min, max, mean - output arrays
+//             stride - distance between channels in output arrays
+// Returns:    Level used, or -1 if computed from data.
+// **************************************************************************
+int
+BCI2000Envelope::Query( const BCI2000FileReader& inReader, long long inFrom, long long inTo, int inWidth,
+                        const vector<int>& inChannels, bool inCalibrated,
+                        double* outMin, double* outMax, double* outMean, size_t inStride ) const
+{
+  const long long available = IsOpen() ? mNumSamples : inReader.NumSamples();
+  if( inFrom < 0 || inTo > available || inFrom >= inTo )
+    throw std_range_error( "Invalid sample range " << inFrom << ".." << inTo
+                           << " for envelope of " << available << " samples" );
+  if( inWidth < 1 )
+    throw std_range_error( "Envelope width must be at least 1, is " << inWidth );
+  for( size_t i = 0; i < inChannels.size(); ++i )
+    if( inChannels[ i ] < 0 || inChannels[ i ] >= inReader.SignalProperties().Channels() )
+      throw std_range_error( "Channel index " << inChannels[ i ] << " out of range" );
+
+  const long long range = inTo - inFrom;
+  int level = -1;
+  for( int l = 0; IsOpen() && l < Levels() && BinSamples( l ) * inWidth <= range; ++l )
+    level = l;
+
+  const size_t C = inChannels.size();
+  vector<double> mn( C ), mx( C ), sum( C );
+  if( level < 0 )
+  {
+    // pixels are read in chunks of about cChunkSamples samples, and at least
+    // one pixel each
+    const long long cChunkSamples = 16384;
+    vector<GenericSignal::ValueType> data;
+    vector<int> none;
+    BCI2000FileReader::Cursor cursor( inReader );
+    for( int p0 = 0; p0 < inWidth; )
+    {
+      const long long begin0 = inFrom + range * p0 / inWidth;
+      int p1 = p0 + 1;
+      while( p1 < inWidth && inFrom + range * ( p1 + 1 ) / inWidth - begin0 <= cChunkSamples )
+        ++p1;
+      const long long count = max( inFrom + range * p1 / inWidth, inFrom + range * ( p1 - 1 ) / inWidth + 1 ) - begin0;
+      data.resize( static_cast<size_t>( count * C + 1 ) );
+      cursor.ReadColumns( begin0, count, inChannels, &data[ 0 ], count, false, none, NULL, 0 );
+      for( int p = p0; p < p1; ++p )
+      {
+        const long long begin = inFrom + range * p / inWidth - begin0,
+                        end = max( inFrom + range * ( p + 1 ) / inWidth - begin0, begin + 1 );
+        for( size_t i = 0; i < C; ++i )
+        {
+          const GenericSignal::ValueType* x = &data[ i * count ];
+          double a = x[ begin ], b = x[ begin ], s = 0;
+          for( long long j = begin; j < end; ++j )
+          {
+            a = x[ j ] < a ? x[ j ] : a;
+            b = x[ j ] > b ? x[ j ] : b;
+            s += x[ j ];
+          }
+          outMin[ i * inStride + p ] = a;
+          outMax[ i * inStride + p ] = b;
+          outMean[ i * inStride + p ] = s / ( end - begin );
+        }
+      }
+      p0 = p1;
+    }
+  }
+  else
+  {
+    const long long binSamples = BinSamples( level ),
+                    firstBin = inFrom / binSamples,
+                    lastBin = ( inTo - 1 ) / binSamples;
+    const size_t recordValues = 3 * mChannels,
+                 length = static_cast<size_t>( lastBin - firstBin + 1 ) * recordValues * sizeof( float );
+    vector<float> bins( static_cast<size_t>( lastBin - firstBin + 1 ) * recordValues );
+    const long long position = mLevelPositions[ level ] + firstBin * recordValues * sizeof( float );
+    if( PositionalIO::Read( mpFile, position, reinterpret_cast<char*>( &bins[ 0 ] ), length ) != length )
+      throw std_runtime_error( "Could not read envelope data at position " << position );
+    for( int p = 0; p < inWidth; ++p )
+    {
+      const long long begin = inFrom + range * p / inWidth,
+                      end = max( inFrom + range * ( p + 1 ) / inWidth, begin + 1 ),
+                      b0 = begin / binSamples,
+                      b1 = ( end - 1 ) / binSamples;
+      long long count = 0;
+      for( long long b = b0; b <= b1; ++b )
+      {
+        const float* record = &bins[ static_cast<size_t>( ( b - firstBin ) * recordValues ) ];
+        const long long n = min( binSamples, mNumSamples - b * binSamples );
+        for( size_t i = 0; i < C; ++i )
+        {
+          const int ch = inChannels[ i ];
+          mn[ i ] = count ? min<double>( mn[ i ], record[ ch ] ) : record[ ch ];
+          mx[ i ] = count ? max<double>( mx[ i ], record[ mChannels + ch ] ) : record[ mChannels + ch ];
+          sum[ i ] = ( count ? sum[ i ] : 0 ) + n * static_cast<double>( record[ 2 * mChannels + ch ] );
+        }
+        count += n;
+      }
+      for( size_t i = 0; i < C; ++i )
+      {
+        outMin[ i * inStride + p ] = mn[ i ];
+        outMax[ i * inStride + p ] = mx[ i ];
+        outMean[ i * inStride + p ] = sum[ i ] / count;
+      }
+    }
+  }
+
+  if( inCalibrated )
+    for( size_t i = 0; i < C; ++i )
+    {
+      const double offset = inReader.SourceOffsets()[ inChannels[ i ] ],
+                   gain = inReader.SourceGains()[ inChannels[ i ] ];
+      for( int p = 0; p < inWidth; ++p )
+      {
+        double& a = outMin[ i * inStride + p ],
+              & b = outMax[ i * inStride + p ],
+              & m = outMean[ i * inStride + p ];
+        a = ( a - offset ) * gain;
+        b = ( b - offset ) * gain;
+        m = ( m - offset ) * gain;
+        if( gain < 0 )
+          swap( a, b );
+      }
+    }
+  return level;
+}
@@ -0,0 +1,94 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: A sidecar file holding the minimum, maximum, and mean of each
+//   channel over bins of samples, at bin sizes that double from one level to
+//   the next. Envelopes of any range of samples at any resolution are read
+//   with I/O bounded by the resolution, rather than by the range.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#ifndef BCI2000_ENVELOPE_H
+#define BCI2000_ENVELOPE_H
+
+#include <vector>
+#include <string>
+#include <cstdio>
+
+class BCI2000FileReader;
+
+class BCI2000Envelope
+{
+ public:
+  static const int cDefaultBinSamples = 64;
+
+ public:
+  BCI2000Envelope();
+  ~BCI2000Envelope();
+
+ private:
+  BCI2000Envelope( const BCI2000Envelope& );
+  BCI2000Envelope& operator=( const BCI2000Envelope& );
+
+ public:
+  // Name of the sidecar file that belongs to a data file.
+  static std::string FileName( const std::string& dataFile );
+  // Writes the sidecar file for the data file opened by a reader, in a
+  // single pass over the data. Level 0 has bins of binSamples samples.
+  // Returns false if the file could not be written.
+  static bool Create( const BCI2000FileReader&, int binSamples = cDefaultBinSamples );
+
+  // Opens the sidecar file of a reader's data file. Fails if there is no
+  // sidecar file, or if it does not match the data file's size,
+  // modification time, and header. The reader must stay open while the
+  // envelope is in use.
+  bool  Open( const BCI2000FileReader& );
+  void  Close();
+  bool  IsOpen() const
+        { return mpFile != NULL; }
+  long long NumSamples() const
+        { return mNumSamples; }
+  long long BinSamples( int level ) const
+        { return mBinSamples << level; }
+  int   Levels() const
+        { return static_cast<int>( mLevelPositions.size() ); }
+
+  // Computes the envelope of samples [from, to) of the listed channels at a
+  // resolution of width pixels. Pixel p covers samples from
+  // from + ( to - from ) * p / width up to the next pixel's first sample.
+  // Envelopes are taken from the coarsest level whose bins are not larger
+  // than a pixel, and extend to the bins a pixel overlaps. When pixels are
+  // smaller than level 0 bins, or without a sidecar file, the envelope is
+  // computed from the reader's data, which is exact.
+  // Results go into column-major arrays: min[ i * stride + p ] for the
+  // i-th listed channel. Returns the level used, or -1 for data.
+  int   Query( const BCI2000FileReader&, long long from, long long to, int width,
+               const std::vector<int>& channels, bool calibrated,
+               double* min, double* max, double* mean, size_t stride ) const;
+
+ private:
+  std::FILE*         mpFile;
+  int                mChannels;
+  long long          mNumSamples,
+                     mBinSamples;
+  std::vector<unsigned long long> mLevelPositions;
+};
+
+#endif // BCI2000_ENVELOPE_H
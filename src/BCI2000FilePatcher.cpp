@@ -0,0 +1,184 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: Changes state values in an existing BCI2000 data file. Only
+//   the bytes holding a state are modified, and written back in place, so
+//   event markers can be recoded without rewriting the file.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#include "PCHIncludes.h"
+#pragma hdrstop
+
+#include "BCI2000FilePatcher.h"
+#include "BCI2000ColumnStore.h"
+#include "StateVectorSample.h"
+#include "BCIException.h"
+#include "PositionalIO.h"
+
+#include <algorithm>
+
+using namespace std;
+
+BCI2000FilePatcher::BCI2000FilePatcher()
+: mpFile( NULL ),
+  mErrorState( NoError ),
+  mModified( false )
+{
+}
+
+BCI2000FilePatcher::~BCI2000FilePatcher()
+{
+  if( mpFile )
+    ::fclose( mpFile );
+}
+
+// **************************************************************************
+// Function:   Open
+// Purpose:    Reads a data file's header, and opens the file for writing.
+// Parameters: fileName - name of the file to modify
+//             bufferSize - size of the buffer for record data
+// Returns:    *this
+// **************************************************************************
+BCI2000FilePatcher&
+BCI2000FilePatcher::Open( const char* inFileName, int inBufferSize )
+{
+  if( mpFile )
+    Close();
+  mErrorState = NoError;
+
+  mReader.Open( inFileName );
+  if( mReader.ErrorState() != BCI2000FileReader::NoError )
+  {
+    mErrorState = mReader.ErrorState() == BCI2000FileReader::FileOpenError ? FileOpenError : MalformedHeader;
+    return *this;
+  }
+  // compressed files cannot be modified in place
+  if( mReader.IsCompressed() )
+  {
+    mReader.Open( NULL );
+    mErrorState = CompressedFile;
+    return *this;
+  }
+  mpFile = ::fopen( inFileName, "r+b" );
+  if( mpFile == NULL )
+  {
+    mErrorState = FileOpenError;
+    return *this;
+  }
+  mFilename = inFileName;
+  mModified = false;
+  mBuffer.resize( max( inBufferSize, 1 ) );
+  return *this;
+}
+
+// **************************************************************************
+// Function:   Close
+// Purpose:    Closes the file.
+// Parameters: N/A
+// Returns:    *this
+// **************************************************************************
+BCI2000FilePatcher&
+BCI2000FilePatcher::Close()
+{
+  if( mpFile )
+  {
+    bool ok = ( 0 == ::fclose( mpFile ) );
+    mpFile = NULL;
+    if( !ok )
+      throw std_runtime_error( "Could not write to " << mFilename );
+  }
+  return *this;
+}
+
+// **************************************************************************
+// Function:   SetStateValue
+// Purpose:    Sets a state's value in a range of samples. The bytes holding
+//             the state are read, changed through a mask, and written back.
+//             Small records are processed in blocks spanning the range from
+//             the first to the last state byte involved; large records are
+//             processed one at a time.
+//             Before the first write, the data file's column store is
+//             removed, as it holds the previous state values.
+// Parameters: state - name of the state
+//             first - first sample
+//             count - number of samples
+//             value - state value
+// Returns:    *this
+// **************************************************************************
+BCI2000FilePatcher&
+BCI2000FilePatcher::SetStateValue( const string& inState, long long inFirst, long long inCount,
+                                   State::ValueType inValue )
+{
+  if( !IsOpen() )
+    throw std_runtime_error( "No data file open for patching" );
+  if( !mReader.States()->Exists( inState ) )
+    throw std_runtime_error( "Requested state " << inState << " is not accessible" );
+  if( inCount <= 0 )
+    return *this;
+  if( inFirst < 0 || inFirst + inCount > mReader.NumSamples() )
+    throw std_range_error( "Sample range " << inFirst << ".." << inFirst + inCount
+                           << " exceeds file size of " << mReader.NumSamples() );
+
+  // state vectors holding the new value, and a mask of the state's bits
+  const State& state = ( *mReader.States() )[ inState ];
+  if( state.Length() < 1 )
+    throw std_range_error( "Requested state " << inState << " has zero length" );
+  const size_t stateVectorLength = mReader.StateVectorLength();
+  StateVectorSample value( stateVectorLength ),
+                    mask( stateVectorLength );
+  value.SetStateValue( state.Location(), state.Length(), inValue );
+  mask.SetStateValue( state.Location(), state.Length(),
+                      ~State::ValueType( 0 ) >> ( 8 * sizeof( State::ValueType ) - state.Length() ) );
+  const size_t spanBegin = state.Location() / 8,
+               spanLength = ( state.Location() + state.Length() + 7 ) / 8 - spanBegin;
+  const unsigned char* pValue = value.Data() + spanBegin,
+                     * pMask = mask.Data() + spanBegin;
+
+  const long long recordSize = mReader.Decoder()->RecordSize(),
+                  stateOffset = mReader.Decoder()->StateVectorOffset() + spanBegin;
+  const long long recordsPerBlock = recordSize >= cSparseRecordSize ? 1 :
+                  max<long long>( 1, ( static_cast<long long>( mBuffer.size() ) - spanLength ) / recordSize + 1 );
+  if( !mModified )
+  {
+    ::remove( BCI2000ColumnStore::FileName( mFilename ).c_str() );
+    mModified = true;
+  }
+  long long done = 0;
+  while( done < inCount )
+  {
+    long long count = min( recordsPerBlock, inCount - done ),
+              position = mReader.HeaderLength() + ( inFirst + done ) * recordSize + stateOffset;
+    size_t length = static_cast<size_t>( ( count - 1 ) * recordSize ) + spanLength;
+    if( mBuffer.size() < length )
+      mBuffer.resize( length );
+    if( PositionalIO::Read( mpFile, position, &mBuffer[ 0 ], length ) != length )
+      throw std_runtime_error( "Could not read state data at position " << position );
+    for( long long i = 0; i < count; ++i )
+    {
+      unsigned char* p = reinterpret_cast<unsigned char*>( &mBuffer[ 0 ] ) + i * recordSize;
+      StateVectorSample::CopyMasked( p, pValue, pMask, spanLength );
+    }
+    if( PositionalIO::Write( mpFile, position, &mBuffer[ 0 ], length ) != length )
+      throw std_runtime_error( "Could not write to " << mFilename );
+    done += count;
+  }
+  return *this;
+}
@@ -0,0 +1,96 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: Changes state values in an existing BCI2000 data file. Only
+//   the bytes holding a state are modified, and written back in place, so
+//   event markers can be recoded without rewriting the file.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#ifndef BCI2000_FILE_PATCHER_H
+#define BCI2000_FILE_PATCHER_H
+
+#include "BCI2000FileReader.h"
+#include "State.h"
+
+#include <vector>
+#include <string>
+#include <cstdio>
+
+class BCI2000FilePatcher
+{
+ public:
+  static const int cDefaultBufSize = 4 * 1024 * 1024;
+  // Records at least this large are patched one at a time, so only the
+  // pages holding state vectors are read and written.
+  static const int cSparseRecordSize = 4096;
+
+  enum
+  {
+    NoError = 0,
+    FileOpenError,
+    MalformedHeader,
+    CompressedFile,
+
+    NumErrors
+  };
+
+ public:
+  BCI2000FilePatcher();
+  ~BCI2000FilePatcher();
+
+ private:
+  BCI2000FilePatcher( const BCI2000FilePatcher& );
+  BCI2000FilePatcher& operator=( const BCI2000FilePatcher& );
+
+ public:
+  int   ErrorState() const
+        { return mErrorState; }
+  bool  IsOpen() const
+        { return mpFile != NULL; }
+
+  // Opens a data file for reading and writing. Its header is not changed.
+  BCI2000FilePatcher&
+        Open( const char* fileName, int bufferSize = cDefaultBufSize );
+  BCI2000FilePatcher&
+        Close();
+  // Header information of the open file.
+  const BCI2000FileReader&
+        Reader() const
+        { return mReader; }
+
+  // Sets a state to a value in count samples starting at sample first.
+  // Values are checked as in StateVectorSample::SetStateValue(), and the
+  // state's other bits in the state vector are left unchanged.
+  // The first change removes the data file's column store sidecar.
+  BCI2000FilePatcher&
+        SetStateValue( const std::string& state, long long first, long long count,
+                       State::ValueType value );
+
+ private:
+  BCI2000FileReader  mReader;
+  std::FILE*         mpFile;
+  std::string        mFilename;
+  std::vector<char>  mBuffer;
+  int                mErrorState;
+  bool               mModified;
+};
+
+#endif // BCI2000_FILE_PATCHER_H
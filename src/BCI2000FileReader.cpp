@@ -28,13 +28,33 @@
 #pragma hdrstop
 
 #include "BCI2000FileReader.h"
+#include "BCI2000ColumnStore.h"
+#include "BCI2000Archive.h"
+#include "BCI2000GzipFile.h"
 #include "BCIException.h"
+#include "Serialization.h"
+#include "AtomicFile.h"
+#include "PositionalIO.h"
 #include "defines.h"
 
-#include <fstream>
-#include <sstream>
+#include <algorithm>
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <sstream>
+#include <sys/stat.h>
+#include <cerrno>
+#include <chrono>
+#include <thread>
+#include <exception>
+
+#if _WIN32
+# include <windows.h>
+# include <io.h>
+#else // _WIN32
+# include <unistd.h>
+#endif // _WIN32
 
 #if _MSC_VER
 # define ftello64 _ftelli64
@@ -48,39 +68,6 @@
 
 using namespace std;
 
-// **************************************************************************
-// Function:   ReadValue<DataType>
-// Purpose:    Reads a value from the given memory location.
-// Parameters: Pointer into memory buffer.
-// Returns:    Data value.
-// **************************************************************************
-template<typename T>
-static
-GenericSignal::ValueType
-ReadValue( const char* p )
-{
-  return *reinterpret_cast<const T*>( p );
-}
-
-// **************************************************************************
-// Function:   ReadValue_SwapBytes<DataType>
-// Purpose:    Reads a value from the given memory location, and swaps bytes.
-// Parameters: Pointer into memory buffer.
-// Returns:    Data value.
-// **************************************************************************
-template<typename T>
-static
-GenericSignal::ValueType
-ReadValue_SwapBytes( const char* p )
-{
-  static uint8_t buf[ sizeof( T ) ];
-  uint8_t* b = buf + sizeof( T );
-  for( size_t i = 0; i < sizeof( T ); ++i )
-    *--b = *p++;
-  return *reinterpret_cast<const T*>( reinterpret_cast<char*>( b ) );
-}
-
-
 // **************************************************************************
 // Function:   BCI2000FileReader
 // Purpose:    The constructor for the BCI2000FileReader object
@@ -89,16 +76,26 @@ ReadValue_SwapBytes( const char* p )
 // **************************************************************************
 BCI2000FileReader::BCI2000FileReader()
 : mpStatevector( NULL ),
+  mpDecoder( NULL ),
   mpFile( NULL ),
-  mpBuffer( NULL ),
+  mUseHeaderCache( false ),
+  mpCursor( NULL ),
+  mpColumnStore( NULL ),
+  mpArchive( NULL ),
+  mpGzipFile( NULL ),
   mErrorState( NoError )
 {
 }
 
 BCI2000FileReader::BCI2000FileReader( const char* inFileName )
 : mpStatevector( NULL ),
+  mpDecoder( NULL ),
   mpFile( NULL ),
-  mpBuffer( NULL ),
+  mUseHeaderCache( false ),
+  mpCursor( NULL ),
+  mpColumnStore( NULL ),
+  mpArchive( NULL ),
+  mpGzipFile( NULL ),
   mErrorState( NoError )
 {
   Open( inFileName );
@@ -130,6 +127,8 @@ BCI2000FileReader::Reset()
   mStatelist.Clear();
   delete mpStatevector;
   mpStatevector = NULL;
+  delete mpDecoder;
+  mpDecoder = NULL;
 
   mFilename = "";
   if( mpFile )
@@ -137,11 +136,14 @@ BCI2000FileReader::Reset()
     ::fclose( mpFile );
     mpFile = NULL;
   }
-  delete[] mpBuffer;
-  mpBuffer = NULL;
-  mBufferSize = 0;
-  mBufferBegin = 0;
-  mBufferEnd = 0;
+  delete mpCursor;
+  mpCursor = NULL;
+  delete mpColumnStore;
+  mpColumnStore = NULL;
+  delete mpArchive;
+  mpArchive = NULL;
+  delete mpGzipFile;
+  mpGzipFile = NULL;
 
   mFileFormatVersion = "n/a";
   mChannels = 0;
@@ -155,6 +157,11 @@ BCI2000FileReader::Reset()
   mNumSamples = 0;
   mSignalProperties = ::SignalProperties( 0, 0, mSignalType );
 
+  mHeaderFromCache = false;
+  mHeaderHash = 0;
+  mFileSize = 0;
+  mFileTime = 0;
+
   mErrorState = NoError;
 }
 
@@ -177,17 +184,41 @@ BCI2000FileReader::Open( const char* inFilename, int inBufSize )
     mErrorState = FileOpenError;
   }
   if( ErrorState() == NoError )
-  {
     mFilename = inFilename;
+  if( ErrorState() == NoError && BCI2000Archive::IsArchive( mpFile ) )
+  {
+    mpArchive = new BCI2000Archive;
+    if( !mpArchive->Open( mpFile ) )
+      mErrorState = MalformedHeader;
+  }
+  // the size of gzip files is taken from their trailer, and their checkpoint
+  // index is kept in the header cache directory once data have been read
+  if( ErrorState() == NoError && BCI2000GzipFile::IsGzip( mpFile ) )
+  {
+    mpGzipFile = new BCI2000GzipFile;
+    if( !mpGzipFile->Open( mpFile, mUseHeaderCache ? CacheFile( ".bcigzi" ) : "" ) )
+      mErrorState = MalformedHeader;
+  }
+  if( ErrorState() == NoError )
+  {
     ReadHeader();
     if( ErrorState() == NoError )
     {
-      CalculateNumSamples();
-      mBufferSize = inBufSize;
-      mpBuffer = new char[ mBufferSize ];
-      mBufferBegin = 0;
-      mBufferEnd = 0;
+      if( !mHeaderFromCache )
+      {
+        CalculateNumSamples();
+        if( mUseHeaderCache )
+          WriteHeaderCache();
+      }
+      mpDecoder = RecordDecoder::Create( mSignalType, mChannels, mStatevectorLength, mStatelist );
+      mpCursor = new Cursor( *this, inBufSize );
       mInitialized = true;
+      mpColumnStore = new BCI2000ColumnStore;
+      if( !mpColumnStore->Open( *this ) )
+      {
+        delete mpColumnStore;
+        mpColumnStore = NULL;
+      }
     }
   }
   return *this;
@@ -232,46 +263,7 @@ BCI2000FileReader::State( const std::string& name ) const
 GenericSignal::ValueType
 BCI2000FileReader::RawValue( int inChannel, long long inSample )
 {
-  GenericSignal::ValueType value = 0;
-  const char* address = BufferSample( inSample ) + mDataSize * inChannel;
-
-  // When running on a big endian machine, we need to swap bytes.
-  static const bool isBigEndian = ( *reinterpret_cast<const uint16_t*>( "\0\1" ) == 0x0001 );
-  if( isBigEndian )
-  {
-    switch( mSignalType )
-    {
-      case SignalType::int16:
-        value = ReadValue_SwapBytes<int16_t>( address );
-        break;
-      case SignalType::int32:
-        value = ReadValue_SwapBytes<int32_t>( address );
-        break;
-      case SignalType::float32:
-        value = ReadValue_SwapBytes<float32_t>( address );
-        break;
-      default:
-        break;
-    }
-  }
-  else
-  { // Little endian machine
-    switch( mSignalType )
-    {
-      case SignalType::int16:
-        value = ReadValue<int16_t>( address );
-        break;
-      case SignalType::int32:
-        value = ReadValue<int32_t>( address );
-        break;
-      case SignalType::float32:
-        value = ReadValue<float32_t>( address );
-        break;
-      default:
-        break;
-    }
-  }
-  return value;
+  return mpCursor->RawValue( inChannel, inSample );
 }
 
 // **************************************************************************
@@ -300,66 +292,293 @@ BCI2000FileReader::CalibratedValue( int inChannel, long long inSample )
 BCI2000FileReader&
 BCI2000FileReader::ReadStateVector( long long inSample )
 {
-  ::memcpy( ( *mpStatevector )( 0 ).Data(),
-            BufferSample( inSample ) + mDataSize * SignalProperties().Channels(),
-            StateVectorLength() );
+  mpCursor->ReadStateVector( inSample, *mpStatevector );
+  return *this;
+}
+
+// **************************************************************************
+// Function:   ReadBlock
+// Purpose:    Decodes a range of samples into signal and state arrays,
+//             using the record decoder for the file's layout.
+// Parameters: sample - first sample number
+//             count - number of samples
+//             signal - output array for signal values, or NULL
+//             signalStride - distance between channels in the signal array
+//             calibrated - whether to apply offsets and gains
+//             states - output array for state values, or NULL
+//             stateStride - distance between states in the state array
+// Returns:    *this
+// **************************************************************************
+BCI2000FileReader&
+BCI2000FileReader::ReadBlock( long long inSample, long long inCount,
+                              GenericSignal::ValueType* outSignal, size_t inSignalStride, bool inCalibrated,
+                              double* outStates, size_t inStateStride )
+{
+  mpCursor->ReadBlock( inSample, inCount, outSignal, inSignalStride, inCalibrated, outStates, inStateStride );
   return *this;
 }
 
+// **************************************************************************
+// Function:   ReadColumns
+// Purpose:    Decodes selected channels and states for a range of samples.
+// Parameters: sample - first sample number
+//             count - number of samples
+//             channels - indices of channels to read
+//             signal - output array for signal values
+//             signalStride - distance between channels in the signal array
+//             calibrated - whether to apply offsets and gains
+//             states - indices of states to read
+//             stateValues - output array for state values
+//             stateStride - distance between states in the state array
+// Returns:    *this
+// **************************************************************************
+BCI2000FileReader&
+BCI2000FileReader::ReadColumns( long long inSample, long long inCount,
+                                const std::vector<int>& inChannels, GenericSignal::ValueType* outSignal,
+                                size_t inSignalStride, bool inCalibrated,
+                                const std::vector<int>& inStates, double* outStates, size_t inStateStride )
+{
+  mpCursor->ReadColumns( inSample, inCount, inChannels, outSignal, inSignalStride, inCalibrated,
+                         inStates, outStates, inStateStride );
+  return *this;
+}
+
+// **************************************************************************
+// Function:   Refresh
+// Purpose:    Updates the number of samples from the current file size.
+// Parameters: N/A
+// Returns:    Number of samples added since the last update.
+// **************************************************************************
+long long
+BCI2000FileReader::Refresh()
+{
+  long long previous = mNumSamples;
+  if( mpArchive || mpGzipFile )
+    return 0;
+  struct stat fileStat;
+  long long recordSize = mDataSize * mChannels + mStatevectorLength;
+  if( mpFile != NULL && recordSize > 0 && 0 == ::fstat( ::fileno( mpFile ), &fileStat ) )
+  {
+    long long dataSize = static_cast<long long>( fileStat.st_size ) - mHeaderLength;
+    mNumSamples = dataSize > 0 ? dataSize / recordSize : 0;
+  }
+  return static_cast<long long>( mNumSamples ) - previous;
+}
+
+// **************************************************************************
+// Function:   WaitForSamples
+// Purpose:    Waits until the file contains a given number of samples.
+//             The file size is polled at a fraction of the sample block
+//             duration, so new data is seen within one sample block.
+// Parameters: numSamples - number of samples to wait for
+//             timeoutMs - maximum time to wait, in milliseconds
+// Returns:    True if the samples are available.
+// **************************************************************************
+bool
+BCI2000FileReader::WaitForSamples( long long inNumSamples, int inTimeoutMs )
+{
+  Refresh();
+  if( NumSamples() >= inNumSamples || inTimeoutMs <= 0 )
+    return NumSamples() >= inNumSamples;
+
+  double blockMs = 1e3 * max( 1, mSignalProperties.Elements() ) / max( mSamplingRate, 1.0 );
+  int intervalMs = static_cast<int>( min( max( blockMs / 4, 1.0 ), 20.0 ) );
+  chrono::steady_clock::time_point deadline = chrono::steady_clock::now() + chrono::milliseconds( inTimeoutMs );
+  while( NumSamples() < inNumSamples && chrono::steady_clock::now() < deadline )
+  {
+    this_thread::sleep_for( chrono::milliseconds( intervalMs ) );
+    Refresh();
+  }
+  return NumSamples() >= inNumSamples;
+}
+
+// **************************************************************************
+// Function:   ReadAt
+// Purpose:    Reads data from an absolute file position. Unlike fseek()/fread(),
+//             this does not modify the file position, and may be called from
+//             multiple threads at once. Archives and gzip files are read
+//             as if they were uncompressed.
+// Parameters: position - file position
+//             data - destination buffer
+//             length - number of bytes to read
+// Returns:    Number of bytes read; less than length at the end of the file.
+// **************************************************************************
+size_t
+BCI2000FileReader::ReadAt( long long inPosition, char* outData, size_t inLength ) const
+{
+  if( mpArchive )
+    return mpArchive->ReadAt( inPosition, outData, inLength );
+  if( mpGzipFile )
+    return mpGzipFile->ReadAt( inPosition, outData, inLength );
+  return PositionalIO::Read( mpFile, inPosition, outData, inLength );
+}
+
+// **************************************************************************
+// Function:   HashBytes
+// Purpose:    Computes a 64 bit FNV-1a hash over a memory block.
+// Parameters: Pointer to data, data length.
+// Returns:    Hash value.
+// **************************************************************************
+static unsigned long long
+HashBytes( const char* inData, size_t inLength )
+{
+  unsigned long long hash = 14695981039346656037ULL;
+  for( size_t i = 0; i < inLength; ++i )
+  {
+    hash ^= static_cast<unsigned char>( inData[ i ] );
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+// **************************************************************************
+// Function:   NextToken
+// Purpose:    Extracts a whitespace delimited token from a memory range.
+// Parameters: Current position, which is advanced past the token; end of range.
+// Returns:    Token, or an empty string if the range is exhausted.
+// **************************************************************************
+static string
+NextToken( const char*& ioPos, const char* inEnd )
+{
+  while( ioPos < inEnd && ::isspace( static_cast<unsigned char>( *ioPos ) ) )
+    ++ioPos;
+  const char* begin = ioPos;
+  while( ioPos < inEnd && !::isspace( static_cast<unsigned char>( *ioPos ) ) )
+    ++ioPos;
+  return string( begin, ioPos );
+}
+
+// **************************************************************************
+// Function:   NextLine
+// Purpose:    Determines the extent of the next line in a memory range.
+// Parameters: Current position, which is advanced to the following line;
+//             end of range; output line end, excluding CR/LF.
+// Returns:    Beginning of the line, or NULL if the range is exhausted.
+// **************************************************************************
+static const char*
+NextLine( const char*& ioPos, const char* inEnd, const char*& outLineEnd )
+{
+  if( ioPos >= inEnd )
+    return NULL;
+  const char* begin = ioPos;
+  const char* eol = static_cast<const char*>( ::memchr( begin, '\n', inEnd - begin ) );
+  ioPos = eol ? eol + 1 : inEnd;
+  outLineEnd = eol ? eol : inEnd;
+  if( outLineEnd > begin && *( outLineEnd - 1 ) == '\r' )
+    --outLineEnd;
+  return begin;
+}
+
 // **************************************************************************
 // Function:   ReadHeader
 // Purpose:    This method reads the header of a BCI2000 data file
+//             The header is read from the open file as a single block of
+//             HeaderLen bytes, and parsed from memory.
 // Parameters: N/A
 // Returns:    N/A
 // **************************************************************************
 void
 BCI2000FileReader::ReadHeader()
 {
-  ifstream file( mFilename.c_str(), ios::in | ios::binary );
-
   mErrorState = MalformedHeader;
 
+  // read a first chunk which will normally contain the entire header
+  static const size_t cInitialReadSize = 16 * 1024;
+  vector<char> header( cInitialReadSize );
+  size_t headerRead = ReadAt( 0, &header[0], header.size() );
+
   // read the first line and do consistency checks
-  string line, element;
-  if( !getline( file, line, '\n' ) )
+  const char* pos = &header[0],
+            * lineEnd = NULL;
+  if( !::memchr( pos, '\n', headerRead ) || !NextLine( pos, pos + headerRead, lineEnd ) )
     return;
-  istringstream linestream( line );
-  linestream >> element;
+  const char* p = &header[0];
+  string element = NextToken( p, lineEnd );
   if( element == "BCI2000V=" )
-    linestream >> mFileFormatVersion >> element;
+  {
+    mFileFormatVersion = NextToken( p, lineEnd );
+    element = NextToken( p, lineEnd );
+  }
   else
     mFileFormatVersion = "1.0";
   if( element != "HeaderLen=" )
     return;
 
-  linestream >> mHeaderLength >> element >> mChannels;
+  mHeaderLength = ::atoi( NextToken( p, lineEnd ).c_str() );
+  element = NextToken( p, lineEnd );
+  mChannels = ::atoi( NextToken( p, lineEnd ).c_str() );
   if( element != "SourceCh=" )
     return;
 
-  linestream >> element >> mStatevectorLength;
+  element = NextToken( p, lineEnd );
+  mStatevectorLength = ::atoi( NextToken( p, lineEnd ).c_str() );
   if( element != "StatevectorLen=" )
     return;
 
   mSignalType = SignalType::int16;
-  if( linestream >> element )
+  element = NextToken( p, lineEnd );
+  if( !element.empty() )
   {
     if( element != "DataFormat=" )
       return;
-    if( !( linestream >> mSignalType ) )
+    string format = NextToken( p, lineEnd );
+    mSignalType = SignalType::none;
+    for( int i = 0; i < SignalType::numTypes; ++i )
+      if( format == SignalType( SignalType::Type( i ) ).Name() )
+        mSignalType = SignalType::Type( i );
+    if( mSignalType == SignalType::none )
       return;
   }
   mDataSize = mSignalType.Size();
 
+  // complete the header block
+  if( mHeaderLength <= 0 )
+    return;
+  size_t headerLength = static_cast<size_t>( mHeaderLength );
+  if( headerRead < headerLength )
+  {
+    size_t offset = pos - &header[0];
+    header.resize( headerLength );
+    headerRead += ReadAt( headerRead, &header[headerRead], headerLength - headerRead );
+    if( headerRead < headerLength )
+      return;
+    pos = &header[0] + offset;
+  }
+  const char* end = &header[0] + headerLength;
+
+  // use cached header information if available
+  PositionalIO::Stat( mpFile, mFileSize, mFileTime );
+  mHeaderHash = HashBytes( &header[0], headerLength );
+  if( mUseHeaderCache && ReadHeaderCache() )
+  {
+    mErrorState = NoError;
+    return;
+  }
+
   // now go through the header and read all parameters and states
-  getline( file >> ws, line, '\n' );
-  if( line.find( "[ State Vector Definition ]" ) != 0 )
+  while( pos < end && ::isspace( static_cast<unsigned char>( *pos ) ) )
+    ++pos;
+  const char* line = NextLine( pos, end, lineEnd );
+  static const char cStateSection[] = "[ State Vector Definition ]",
+                    cParamSection[] = "[ Parameter Definition ]";
+  if( !line || lineEnd - line < static_cast<ptrdiff_t>( sizeof( cStateSection ) - 1 )
+      || ::strncmp( line, cStateSection, sizeof( cStateSection ) - 1 ) )
     return;
-  while( getline( file, line, '\n' )
-         && line.find( "[ Parameter Definition ]" ) == line.npos )
-    mStatelist.Add( line.c_str() );
-  while( getline( file, line, '\n' )
-         && line != "" && line != "\r" )
-    mParamlist.Add( line );
+  string definition;
+  while( ( line = NextLine( pos, end, lineEnd ) ) != NULL )
+  {
+    definition.assign( line, lineEnd );
+    if( definition.find( cParamSection ) != definition.npos )
+      break;
+    mStatelist.Add( definition );
+  }
+  if( !line )
+    return;
+  while( ( line = NextLine( pos, end, lineEnd ) ) != NULL && line != lineEnd )
+  {
+    definition.assign( line, lineEnd );
+    mParamlist.Add( definition );
+  }
 
   // build statevector using specified positions
   mpStatevector = new ( class StateVector )( mStatelist );
@@ -376,14 +595,16 @@ BCI2000FileReader::ReadHeader()
   // Read information about signal dimensions.
   int sampleBlockSize = 1;
   if( mParamlist.Exists( "SampleBlockSize" ) )
-    sampleBlockSize = static_cast<int>( PhysicalUnit()
-                                       .SetGain( 1.0 )
-                                       .SetOffset( 0.0 )
-                                       .SetSymbol( "" )
-                                       .PhysicalToRaw( mParamlist[ "SampleBlockSize" ].Value().c_str() )
-                                      );
-  mSignalProperties = ::SignalProperties( mChannels, sampleBlockSize, mSignalType );
-  mSignalProperties.ElementUnit().SetGain( 1.0 / mSamplingRate ).SetOffset( 0.0 ).SetSymbol( "s" );
+  {
+    double value = PhysicalUnit()
+                   .SetGain( 1.0 )
+                   .SetOffset( 0.0 )
+                   .SetSymbol( "" )
+                   .PhysicalToRaw( mParamlist[ "SampleBlockSize" ].Value().c_str() );
+    if( !IsNaN( value ) )
+      sampleBlockSize = static_cast<int>( value );
+  }
+  SetupSignalProperties( sampleBlockSize );
 
   const float defaultOffset = 0.0;
   mSourceOffsets.clear();
@@ -405,8 +626,175 @@ BCI2000FileReader::ReadHeader()
   }
   mSourceGains.resize( mChannels, defaultGain );
 
-  if( file )
-    mErrorState = NoError;
+  mErrorState = NoError;
+}
+
+// **************************************************************************
+// Function:   SetupSignalProperties
+// Purpose:    Sets up signal properties from header information
+// Parameters: Number of samples in a data block
+// Returns:    N/A
+// **************************************************************************
+void
+BCI2000FileReader::SetupSignalProperties( int inSampleBlockSize )
+{
+  mSignalProperties = ::SignalProperties( mChannels, inSampleBlockSize, mSignalType );
+  mSignalProperties.ElementUnit().SetGain( 1.0 / mSamplingRate ).SetOffset( 0.0 ).SetSymbol( "s" );
+}
+
+// **************************************************************************
+// Function:   SetHeaderCache
+// Purpose:    Enables or disables the header cache for subsequent calls to
+//             Open()
+// Parameters: enable - whether to use the cache
+//             directory - cache directory, or empty for a cache file next
+//                         to the data file
+// Returns:    *this
+// **************************************************************************
+BCI2000FileReader&
+BCI2000FileReader::SetHeaderCache( bool inEnable, const std::string& inDirectory )
+{
+  mUseHeaderCache = inEnable;
+  mHeaderCacheDir = inDirectory;
+  return *this;
+}
+
+// **************************************************************************
+// Function:   CacheFile
+// Purpose:    Determines the name of a cache file for the current data
+//             file, in the header cache directory
+// Parameters: File name extension of the cache file
+// Returns:    Cache file name
+// **************************************************************************
+string
+BCI2000FileReader::CacheFile( const char* inExtension ) const
+{
+  if( mHeaderCacheDir.empty() )
+    return mFilename + inExtension;
+
+  ostringstream oss;
+  oss << mHeaderCacheDir;
+  if( mHeaderCacheDir.find_last_of( "/\\" ) != mHeaderCacheDir.length() - 1 )
+    oss << '/';
+  oss << hex << HashBytes( mFilename.data(), mFilename.length() ) << inExtension;
+  return oss.str();
+}
+
+static const char cHeaderCacheMagic[] = "BCI2000HeaderCache";
+static const uint32_t cHeaderCacheVersion = 2;
+
+// **************************************************************************
+// Function:   ReadHeaderCache
+// Purpose:    Reads header information from the cache file, if the cache
+//             entry matches the current data file
+// Parameters: N/A
+// Returns:    true if header information was read from the cache
+// **************************************************************************
+bool
+BCI2000FileReader::ReadHeaderCache()
+{
+  using namespace Serialization;
+
+  std::FILE* pFile = ::fopen( CacheFile( ".bcihdr" ).c_str(), "rb" );
+  if( !pFile )
+    return false;
+  vector<char> data;
+  struct stat cacheStat;
+  if( 0 == ::fstat( ::fileno( pFile ), &cacheStat ) && cacheStat.st_size > 0 )
+  {
+    data.resize( static_cast<size_t>( cacheStat.st_size ) );
+    data.resize( ::fread( &data[0], 1, data.size(), pFile ) );
+  }
+  ::fclose( pFile );
+  if( data.empty() )
+    return false;
+
+  MemoryBuffer buf( &data[0], data.size() );
+  istream is( &buf );
+  string magic, filename;
+  uint32_t version = 0;
+  long long fileSize = 0,
+            fileTime = 0;
+  unsigned long long headerHash = 0;
+  GetString( is, magic );
+  Get( is, version );
+  GetString( is, filename );
+  Get( is, fileSize );
+  Get( is, fileTime );
+  Get( is, headerHash );
+  if( !is || magic != cHeaderCacheMagic || version != cHeaderCacheVersion
+      || filename != mFilename || fileSize != mFileSize || fileTime != mFileTime
+      || headerHash != mHeaderHash )
+    return false;
+
+  // information from the first header line has been read already
+  double samplingRate = 0;
+  int sampleBlockSize = 0;
+  unsigned long long numSamples = 0;
+  Get( is, samplingRate );
+  Get( is, sampleBlockSize );
+  mStatelist.Unserialize( is );
+  mParamlist.Unserialize( is );
+  vector<GenericSignal::ValueType>* lists[] = { &mSourceOffsets, &mSourceGains };
+  for( size_t i = 0; i < sizeof( lists ) / sizeof( *lists ); ++i )
+  {
+    uint32_t count = 0;
+    Get( is, count );
+    lists[ i ]->resize( is ? count : 0 );
+    if( count > 0 )
+      is.read( reinterpret_cast<char*>( &( *lists[ i ] )[ 0 ] ), count * sizeof( GenericSignal::ValueType ) );
+  }
+  Get( is, numSamples );
+  if( !is || static_cast<int>( mSourceOffsets.size() ) != mChannels
+          || static_cast<int>( mSourceGains.size() ) != mChannels )
+  {
+    mParamlist.Clear();
+    mStatelist.Clear();
+    return false;
+  }
+
+  mSamplingRate = samplingRate;
+  mNumSamples = numSamples;
+  mpStatevector = new ( class StateVector )( mStatelist );
+  SetupSignalProperties( sampleBlockSize );
+  mHeaderFromCache = true;
+  return true;
+}
+
+// **************************************************************************
+// Function:   WriteHeaderCache
+// Purpose:    Writes header information into the cache file.
+//             Errors are ignored, as the cache is optional.
+// Parameters: N/A
+// Returns:    N/A
+// **************************************************************************
+void
+BCI2000FileReader::WriteHeaderCache() const
+{
+  using namespace Serialization;
+
+  ostringstream os;
+  PutString( os, cHeaderCacheMagic );
+  Put( os, cHeaderCacheVersion );
+  PutString( os, mFilename );
+  Put( os, mFileSize );
+  Put( os, mFileTime );
+  Put( os, mHeaderHash );
+
+  Put( os, mSamplingRate );
+  Put( os, mSignalProperties.Elements() );
+  mStatelist.Serialize( os );
+  mParamlist.Serialize( os );
+  const vector<GenericSignal::ValueType>* lists[] = { &mSourceOffsets, &mSourceGains };
+  for( size_t i = 0; i < sizeof( lists ) / sizeof( *lists ); ++i )
+  {
+    Put( os, static_cast<uint32_t>( lists[ i ]->size() ) );
+    if( !lists[ i ]->empty() )
+      os.write( reinterpret_cast<const char*>( &( *lists[ i ] )[ 0 ] ), lists[ i ]->size() * sizeof( GenericSignal::ValueType ) );
+  }
+  Put( os, mNumSamples );
+
+  AtomicFile::Write( CacheFile( ".bcihdr" ), os.str() );
 }
 
 // **************************************************************************
@@ -421,7 +809,11 @@ void
 BCI2000FileReader::CalculateNumSamples()
 {
   mNumSamples = 0;
-  if( mpFile )
+  if( mpArchive )
+    mNumSamples = mpArchive->NumSamples();
+  else if( mpGzipFile )
+    mNumSamples = max( 0LL, mpGzipFile->Size() - mHeaderLength ) / ( mDataSize * mChannels + mStatevectorLength );
+  else if( mpFile )
   {
     long long curPos = ::ftello64( mpFile );
     ::fseeko64( mpFile, 0, SEEK_END );
@@ -433,34 +825,224 @@ BCI2000FileReader::CalculateNumSamples()
 }
 
 // **************************************************************************
-// Function:   BufferSample
+// Function:   Cursor
+// Purpose:    Creates a cursor for an open reader.
+// Parameters: reader - the reader object
+//             bufferSize - size of the cursor's read buffer
+// **************************************************************************
+BCI2000FileReader::Cursor::Cursor( const BCI2000FileReader& inReader, int inBufferSize )
+: mpReader( &inReader ),
+  mBufferBegin( 0 ),
+  mBufferEnd( 0 )
+{
+  // the buffer must hold at least one record, and for archives a whole
+  // number of blocks, so blocks are decompressed straight into the buffer
+  int recordSize = inReader.mDataSize * inReader.mChannels + inReader.mStatevectorLength;
+  if( inReader.mpArchive )
+  {
+    long long blockSize = inReader.mpArchive->BlockSamples() * recordSize;
+    mBuffer.resize( static_cast<size_t>( max<long long>( 1, inBufferSize / max( blockSize, 1LL ) ) * blockSize ) );
+  }
+  else
+    mBuffer.resize( max( inBufferSize, recordSize ) );
+}
+
+// **************************************************************************
+// Function:   Record
 // Purpose:    Moves the data buffer such that it contains the given sample.
 // Parameters: Sample position in file
 // Returns:    The sample's buffer position
 // **************************************************************************
 const char*
-BCI2000FileReader::BufferSample( long long inSample )
+BCI2000FileReader::Cursor::Record( long long inSample )
+{
+  const BCI2000FileReader& r = *mpReader;
+  if( inSample < 0 || inSample >= r.NumSamples() )
+    throw std_range_error( "Sample position " << inSample << " exceeds file size of " << r.NumSamples() );
+  long long recordSize = r.mDataSize * r.mChannels + r.mStatevectorLength,
+            filepos = r.HeaderLength() + inSample * recordSize;
+  if( filepos < mBufferBegin || filepos + recordSize > mBufferEnd )
+  {
+    mBufferBegin = r.mpArchive ? r.mpArchive->BlockBegin( filepos ) : filepos;
+    mBufferEnd = mBufferBegin + r.ReadAt( mBufferBegin, &mBuffer[ 0 ], mBuffer.size() );
+    if( mBufferEnd < filepos + recordSize )
+      throw std_runtime_error( "Could not read sample " << inSample );
+  }
+  return &mBuffer[ 0 ] + ( filepos - mBufferBegin );
+}
+
+GenericSignal::ValueType
+BCI2000FileReader::Cursor::RawValue( int inChannel, long long inSample )
+{
+  if( mpReader->mpDecoder == NULL )
+    return 0;
+  return mpReader->mpDecoder->Value( Record( inSample ), inChannel );
+}
+
+GenericSignal::ValueType
+BCI2000FileReader::Cursor::CalibratedValue( int inChannel, long long inSample )
+{
+  return ( RawValue( inChannel, inSample ) - mpReader->mSourceOffsets[ inChannel ] )
+         * mpReader->mSourceGains[ inChannel ];
+}
+
+BCI2000FileReader::Cursor&
+BCI2000FileReader::Cursor::ReadStateVector( long long inSample, class StateVector& outStateVector )
+{
+  ::memcpy( outStateVector( 0 ).Data(),
+            Record( inSample ) + mpReader->mDataSize * mpReader->mChannels,
+            mpReader->StateVectorLength() );
+  return *this;
+}
+
+BCI2000FileReader::Cursor&
+BCI2000FileReader::Cursor::ReadBlock( long long inSample, long long inCount,
+                                      GenericSignal::ValueType* outSignal, size_t inSignalStride, bool inCalibrated,
+                                      double* outStates, size_t inStateStride )
 {
-  if( inSample >= NumSamples() )
-    throw std_range_error( "Sample position " << inSample << " exceeds file size of " << NumSamples() );
-  int numChannels = SignalProperties().Channels();
-  long long filepos = HeaderLength() + inSample * ( mDataSize * numChannels + StateVectorLength() );
-  if( filepos < mBufferBegin || filepos + mDataSize * numChannels + StateVectorLength() >= mBufferEnd )
+  const BCI2000FileReader& r = *mpReader;
+  if( inCount <= 0 )
+    return *this;
+  if( inSample < 0 || inSample + inCount > r.NumSamples() )
+    throw std_range_error( "Sample range " << inSample << ".." << inSample + inCount
+                           << " exceeds file size of " << r.NumSamples() );
+  if( r.mpDecoder == NULL )
+    throw std_runtime_error( "Unsupported data format: " << r.mSignalType.Name() );
+
+  RecordDecoder::Output output;
+  output.signal = outSignal;
+  output.signalStride = inSignalStride;
+  if( inCalibrated )
   {
-    if( 0 != ::fseeko64( mpFile, filepos, SEEK_SET ) )
-      throw std_runtime_error( "Could not seek to sample position" );
+    output.offsets = &r.mSourceOffsets[ 0 ];
+    output.gains = &r.mSourceGains[ 0 ];
+  }
+  output.states = outStates;
+  output.stateStride = inStateStride;
 
-    mBufferBegin = filepos;
-    mBufferEnd = mBufferBegin;
-    while( !::feof( mpFile ) && !::ferror( mpFile ) && ( mBufferEnd - mBufferBegin < StateVectorLength() ) )
+  // archive blocks are decompressed in parallel, by threads reading
+  // through cursors of their own, each taking a range of whole blocks
+  const long long blockSamples = r.mpArchive ? r.mpArchive->BlockSamples() : 0;
+  const long long numBlocks = blockSamples > 0 ? ( inSample + inCount - 1 ) / blockSamples - inSample / blockSamples + 1 : 1;
+  const int threads = static_cast<int>( min<long long>( numBlocks / 2, thread::hardware_concurrency() ) );
+  if( threads < 2 )
+    return Decode( inSample, inCount, output, 0 );
+
+  const long long firstBlock = inSample / blockSamples;
+  const size_t bufferSize = mBuffer.size();
+  vector<exception_ptr> errors( threads );
+  auto work = [&]( int i )
+  {
+    try
     {
-      size_t bytesRead = ::fread( mpBuffer + ( mBufferEnd - mBufferBegin ), 1,
-                                  mBufferSize - static_cast<size_t>( mBufferEnd - mBufferBegin ), mpFile );
-      mBufferEnd += bytesRead;
+      long long begin = max( inSample, ( firstBlock + numBlocks * i / threads ) * blockSamples ),
+                end = min( inSample + inCount, ( firstBlock + numBlocks * ( i + 1 ) / threads ) * blockSamples );
+      Cursor cursor( r, static_cast<int>( bufferSize ) );
+      cursor.Decode( begin, end - begin, output, begin - inSample );
     }
-    ::clearerr( mpFile );
+    catch( ... )
+    {
+      errors[ i ] = current_exception();
+    }
+  };
+  vector<thread> workers;
+  for( int i = 1; i < threads; ++i )
+    workers.push_back( thread( work, i ) );
+  work( 0 );
+  for( size_t i = 0; i < workers.size(); ++i )
+    workers[ i ].join();
+  for( size_t i = 0; i < errors.size(); ++i )
+    if( errors[ i ] )
+      rethrow_exception( errors[ i ] );
+  return *this;
+}
+
+// **************************************************************************
+// Function:   Decode
+// Purpose:    Decodes a range of samples through the cursor's buffer.
+// Parameters: sample - first sample number
+//             count - number of samples
+//             output - output arrays
+//             offset - index of the first sample in the output arrays
+// Returns:    *this
+// **************************************************************************
+BCI2000FileReader::Cursor&
+BCI2000FileReader::Cursor::Decode( long long inSample, long long inCount,
+                                   const RecordDecoder::Output& inOutput, long long inOffset )
+{
+  const BCI2000FileReader& r = *mpReader;
+  const long long recordSize = r.mpDecoder->RecordSize();
+  long long done = 0;
+  while( done < inCount )
+  {
+    const char* p = Record( inSample + done );
+    long long available = ( mBufferEnd - mBufferBegin - ( p - &mBuffer[ 0 ] ) ) / recordSize,
+              count = min( available, inCount - done );
+    r.mpDecoder->Decode( p, static_cast<size_t>( count ), inOutput, static_cast<size_t>( inOffset + done ) );
+    done += count;
   }
-  return mpBuffer + ( filepos - mBufferBegin );
+  return *this;
 }
 
+BCI2000FileReader::Cursor&
+BCI2000FileReader::Cursor::ReadColumns( long long inSample, long long inCount,
+                                        const std::vector<int>& inChannels, GenericSignal::ValueType* outSignal,
+                                        size_t inSignalStride, bool inCalibrated,
+                                        const std::vector<int>& inStates, double* outStates, size_t inStateStride )
+{
+  const BCI2000FileReader& r = *mpReader;
+  if( inCount <= 0 )
+    return *this;
+  if( inSample < 0 || inSample + inCount > r.NumSamples() )
+    throw std_range_error( "Sample range " << inSample << ".." << inSample + inCount
+                           << " exceeds file size of " << r.NumSamples() );
+  for( size_t i = 0; i < inChannels.size(); ++i )
+    if( inChannels[ i ] < 0 || inChannels[ i ] >= r.mChannels )
+      throw std_range_error( "Channel index " << inChannels[ i ] << " out of range" );
+  for( size_t i = 0; i < inStates.size(); ++i )
+    if( inStates[ i ] < 0 || inStates[ i ] >= r.mStatelist.Size() )
+      throw std_range_error( "State index " << inStates[ i ] << " out of range" );
 
+  const BCI2000ColumnStore* pStore = r.mpColumnStore;
+  if( pStore && inSample + inCount <= pStore->NumSamples() )
+  {
+    for( size_t i = 0; i < inChannels.size(); ++i )
+    {
+      GenericSignal::ValueType* p = outSignal + i * inSignalStride;
+      pStore->ReadChannel( inChannels[ i ], inSample, inCount, p );
+      if( inCalibrated )
+      {
+        const GenericSignal::ValueType offset = r.mSourceOffsets[ inChannels[ i ] ],
+                                       gain = r.mSourceGains[ inChannels[ i ] ];
+        for( long long j = 0; j < inCount; ++j )
+          p[ j ] = ( p[ j ] - offset ) * gain;
+      }
+    }
+    for( size_t i = 0; i < inStates.size(); ++i )
+      pStore->ReadState( inStates[ i ], inSample, inCount, outStates + i * inStateStride );
+    return *this;
+  }
+
+  // without a column store, records are decoded in blocks of the buffer
+  // size, and the requested columns are picked from each block
+  if( r.mpDecoder == NULL )
+    throw std_runtime_error( "Unsupported data format: " << r.mSignalType.Name() );
+  const long long block = max<long long>( 1, mBuffer.size() / r.mpDecoder->RecordSize() );
+  mSignalScratch.resize( static_cast<size_t>( block * r.mChannels ) );
+  mStateScratch.resize( static_cast<size_t>( block * r.mStatelist.Size() ) );
+  for( long long done = 0; done < inCount; )
+  {
+    long long count = min( block, inCount - done );
+    ReadBlock( inSample + done, count,
+               inChannels.empty() ? NULL : &mSignalScratch[ 0 ], static_cast<size_t>( count ), inCalibrated,
+               inStates.empty() ? NULL : &mStateScratch[ 0 ], static_cast<size_t>( count ) );
+    for( size_t i = 0; i < inChannels.size(); ++i )
+      ::memcpy( outSignal + i * inSignalStride + done, &mSignalScratch[ 0 ] + inChannels[ i ] * count,
+                count * sizeof( GenericSignal::ValueType ) );
+    for( size_t i = 0; i < inStates.size(); ++i )
+      ::memcpy( outStates + i * inStateStride + done, &mStateScratch[ 0 ] + inStates[ i ] * count,
+                count * sizeof( double ) );
+    done += count;
+  }
+  return *this;
+}
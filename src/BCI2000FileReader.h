@@ -35,15 +35,22 @@
 #include "StateVector.h"
 #include "StateRef.h"
 #include "GenericSignal.h"
+#include "RecordDecoder.h"
 
 #include <vector>
 #include <fstream>
 #include <string>
+#include <cstdio>
+
+class BCI2000ColumnStore;
+class BCI2000Archive;
+class BCI2000GzipFile;
 
 class BCI2000FileReader
 {
  public:
   static const int cDefaultBufSize = 50 * 1024;
+  class Cursor;
 
   enum
   {
@@ -73,10 +80,47 @@ class BCI2000FileReader
   // File access
   virtual BCI2000FileReader&
                 Open( const char* fileName, int bufferSize = cDefaultBufSize );
+  const std::string& FileName() const
+                { return mFilename; }
+  // Identity of the open data file: its size, modification time in
+  // nanoseconds, and a hash of its header. Files derived from the data file record its identity,
+  // and are ignored when it changes.
+  struct Identity
+  {
+    long long size,
+              time;
+    unsigned long long headerHash;
+  };
+  Identity FileIdentity() const
+                { Identity id = { mFileSize, mFileTime, mHeaderHash }; return id; }
+  // Header cache
+  //  When enabled, Open() stores the parsed header in a binary cache file,
+  //  and reads it from there as long as the data file's size, modification
+  //  time, and header content are unchanged.
+  //  With an empty directory, the cache file is put next to the data file.
+  BCI2000FileReader& SetHeaderCache( bool enable, const std::string& directory = "" );
+  bool  HeaderFromCache() const
+        { return mHeaderFromCache; }
   virtual long long NumSamples() const
                 { return mNumSamples; }
+  // Following a file that is still being written
+  //  Refresh() updates NumSamples() from the current file size, counting
+  //  complete records only, and returns the number of samples added.
+  //  WaitForSamples() polls until at least the given number of samples is
+  //  available, or the timeout expires. Neither re-reads the header.
+  //  These must not be called while other threads read through cursors.
+  long long Refresh();
+  bool  WaitForSamples( long long numSamples, int timeoutMs );
   double SamplingRate() const
         { return mSamplingRate; }
+  // Calibration: physical values are ( raw - offset ) * gain, with an
+  // offset and gain per channel.
+  const std::vector<GenericSignal::ValueType>&
+        SourceOffsets() const
+        { return mSourceOffsets; }
+  const std::vector<GenericSignal::ValueType>&
+        SourceGains() const
+        { return mSourceGains; }
   const class SignalProperties&
         SignalProperties() const
         { return mSignalProperties; }
@@ -101,25 +145,80 @@ class BCI2000FileReader
         { return mStatevectorLength; }
 
   // Data access
+  //  These functions use a cursor owned by the reader object, and must not be
+  //  called concurrently. For concurrent reads, use one Cursor per thread.
   virtual GenericSignal::ValueType
         RawValue( int channel, long long sample );
   GenericSignal::ValueType
         CalibratedValue( int channel, long long sample );
   virtual BCI2000FileReader&
         ReadStateVector( long long sample );
+  // Block access
+  //  Decodes count samples starting at sample into column-major arrays:
+  //  signal[ channel * signalStride + i ], states[ state * stateStride + i ].
+  //  States are in the order of the state list. Either array may be NULL.
+  BCI2000FileReader&
+        ReadBlock( long long sample, long long count,
+                   GenericSignal::ValueType* signal, size_t signalStride, bool calibrated,
+                   double* states = NULL, size_t stateStride = 0 );
+  // Subset access
+  //  Decodes the listed channels and states only, into column-major arrays
+  //  as with ReadBlock(): the i-th listed channel goes into
+  //  signal[ i * signalStride + j ], the i-th listed state into
+  //  states[ i * stateStride + j ]. When the file has a column store
+  //  covering the samples, only the columns involved are read.
+  BCI2000FileReader&
+        ReadColumns( long long sample, long long count,
+                     const std::vector<int>& channels, GenericSignal::ValueType* signal,
+                     size_t signalStride, bool calibrated,
+                     const std::vector<int>& states, double* stateValues, size_t stateStride );
+  // The column store that was found next to the data file, or NULL.
+  // Column stores are created with BCI2000ColumnStore::Create().
+  const BCI2000ColumnStore*
+        ColumnStore() const
+        { return mpColumnStore; }
+  // The archive object when the open file is a compressed archive, or NULL.
+  // Archives are created with BCI2000Archive::Create(), and read like data
+  // files.
+  const BCI2000Archive*
+        Archive() const
+        { return mpArchive; }
+  // Whether the open file is compressed, as an archive or with gzip.
+  //  Compressed files are read as if they were uncompressed, and cannot
+  //  be modified in place. Gzip files are read sequentially most
+  //  efficiently, as random access resumes decompression at the nearest
+  //  checkpoint. With the header cache enabled, checkpoints are kept in
+  //  the cache directory.
+  bool  IsCompressed() const
+        { return mpArchive != NULL || mpGzipFile != NULL; }
+  // Reads bytes at an absolute file position, without changing any file
+  // position shared between threads. Returns the number of bytes read.
+  // For compressed files, positions refer to the uncompressed data file.
+  size_t ReadAt( long long position, char* data, size_t length ) const;
+  // Descriptor of the open file, for transfers that bypass the reader's
+  // buffers, or -1 if no file is open, or the file is compressed.
+  int   FileDescriptor() const
+        { return mpFile && !IsCompressed() ? ::fileno( mpFile ) : -1; }
+  const RecordDecoder*
+        Decoder() const
+        { return mpDecoder; }
 
  protected:
   void               Reset();
 
  private:
   void               ReadHeader();
+  void               SetupSignalProperties( int sampleBlockSize );
+  std::string        CacheFile( const char* extension ) const;
+  bool               ReadHeaderCache();
+  void               WriteHeaderCache() const;
   void               CalculateNumSamples();
-  const char*        BufferSample( long long sample );
 
  private:
   ParamList          mParamlist;
   StateList          mStatelist;
   class StateVector* mpStatevector;
+  RecordDecoder*     mpDecoder;
   bool               mInitialized;
 
   std::FILE*         mpFile;
@@ -139,12 +238,60 @@ class BCI2000FileReader
 
   unsigned long long mNumSamples;
 
-  char*              mpBuffer;
-  int                mBufferSize;
-  long long          mBufferBegin,
-                     mBufferEnd;
+  bool               mUseHeaderCache,
+                     mHeaderFromCache;
+  std::string        mHeaderCacheDir;
+  unsigned long long mHeaderHash;
+  long long          mFileSize,
+                     mFileTime;
+
+  Cursor*            mpCursor;
+  BCI2000ColumnStore* mpColumnStore;
+  BCI2000Archive*    mpArchive;
+  BCI2000GzipFile*   mpGzipFile;
 
   int                mErrorState;
 };
 
+// A Cursor reads data from an open BCI2000FileReader through a buffer of its
+// own. The reader's header information is only read from, so any number of
+// threads may read from a single reader concurrently, each using its own
+// cursor. A cursor must not outlive the Open() call it was created after.
+class BCI2000FileReader::Cursor
+{
+ public:
+  explicit Cursor( const BCI2000FileReader&, int bufferSize = cDefaultBufSize );
+
+  const BCI2000FileReader& Reader() const
+    { return *mpReader; }
+  // Returns a pointer to the record (signal data and state vector) of the
+  // given sample, valid until the next call to a Cursor function.
+  const char* Record( long long sample );
+
+  GenericSignal::ValueType RawValue( int channel, long long sample );
+  GenericSignal::ValueType CalibratedValue( int channel, long long sample );
+  // Copies the sample's state vector into the first sample of a state vector.
+  Cursor& ReadStateVector( long long sample, class StateVector& );
+  // See BCI2000FileReader::ReadBlock().
+  Cursor& ReadBlock( long long sample, long long count,
+                     GenericSignal::ValueType* signal, size_t signalStride, bool calibrated,
+                     double* states = NULL, size_t stateStride = 0 );
+  // See BCI2000FileReader::ReadColumns().
+  Cursor& ReadColumns( long long sample, long long count,
+                       const std::vector<int>& channels, GenericSignal::ValueType* signal,
+                       size_t signalStride, bool calibrated,
+                       const std::vector<int>& states, double* stateValues, size_t stateStride );
+
+ private:
+  Cursor& Decode( long long sample, long long count, const RecordDecoder::Output&, long long offset );
+
+ private:
+  const BCI2000FileReader* mpReader;
+  std::vector<char> mBuffer;
+  std::vector<double> mSignalScratch,
+                      mStateScratch;
+  long long mBufferBegin,
+            mBufferEnd;
+};
+
 #endif // BCI2000_FILE_READER_H
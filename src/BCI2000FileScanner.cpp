@@ -0,0 +1,132 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: Decodes a range of samples from a BCI2000 data file in
+//   chunks, and passes the chunks to an accumulator object. Threads process
+//   contiguous parts of the range in parallel, each with an accumulator of
+//   its own, and partial results are merged in sample order.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#include "PCHIncludes.h"
+#pragma hdrstop
+
+#include "BCI2000FileScanner.h"
+#include "BCIException.h"
+
+#include <algorithm>
+
+using namespace std;
+
+BCI2000FileScanner::BCI2000FileScanner( const BCI2000FileReader& inReader )
+: mpReader( &inReader ),
+  mCalibrated( false ),
+  mChunkSamples( cDefaultChunkSamples ),
+  mThreads( 0 )
+{
+  for( int ch = 0; ch < inReader.SignalProperties().Channels(); ++ch )
+    mChannels.push_back( ch );
+}
+
+BCI2000FileScanner&
+BCI2000FileScanner::SetChannels( const vector<int>& inChannels )
+{
+  for( size_t i = 0; i < inChannels.size(); ++i )
+    if( inChannels[ i ] < 0 || inChannels[ i ] >= mpReader->SignalProperties().Channels() )
+      throw std_range_error( "Channel index " << inChannels[ i ] << " out of range" );
+  mChannels = inChannels;
+  return *this;
+}
+
+BCI2000FileScanner&
+BCI2000FileScanner::SetStates( const vector<int>& inStates )
+{
+  for( size_t i = 0; i < inStates.size(); ++i )
+    if( inStates[ i ] < 0 || inStates[ i ] >= mpReader->States()->Size() )
+      throw std_range_error( "State index " << inStates[ i ] << " out of range" );
+  mStates = inStates;
+  return *this;
+}
+
+BCI2000FileScanner&
+BCI2000FileScanner::SetChunkSamples( long long inSamples )
+{
+  if( inSamples < 1 )
+    throw std_range_error( "Chunk size must be at least one sample, is " << inSamples );
+  mChunkSamples = inSamples;
+  return *this;
+}
+
+BCI2000FileScanner&
+BCI2000FileScanner::SetThreads( int inThreads )
+{
+  if( inThreads < 0 )
+    throw std_range_error( "Negative number of threads: " << inThreads );
+  mThreads = inThreads;
+  return *this;
+}
+
+// **************************************************************************
+// Function:   Threads
+// Purpose:    Determines the number of threads for a scan. Each thread
+//             processes at least a few chunks, so the cost of starting
+//             threads, and of merging their results, stays small.
+// Parameters: count - number of samples to scan
+// Returns:    Number of threads
+// **************************************************************************
+int
+BCI2000FileScanner::Threads( long long inCount ) const
+{
+  if( mpReader->IsCompressed() && mpReader->Archive() == NULL )
+    return 1;
+  int threads = mThreads > 0 ? mThreads : static_cast<int>( thread::hardware_concurrency() );
+  long long chunks = ( inCount + mChunkSamples - 1 ) / mChunkSamples;
+  return static_cast<int>( max<long long>( 1, min<long long>( threads, chunks / 4 ) ) );
+}
+
+// **************************************************************************
+// Function:   Decode
+// Purpose:    Decodes a chunk through a cursor. When all channels and no
+//             or all states are selected, records are decoded as a whole;
+//             otherwise, only the selected columns are decoded.
+// Parameters: cursor - cursor of the calling thread
+//             sample - first sample number
+//             count - number of samples
+//             signal, states - output arrays, with a stride of the chunk
+//                              size
+// Returns:    N/A
+// **************************************************************************
+void
+BCI2000FileScanner::Decode( BCI2000FileReader::Cursor& ioCursor, long long inSample, long long inCount,
+                            GenericSignal::ValueType* outSignal, double* outStates ) const
+{
+  bool allChannels = static_cast<int>( mChannels.size() ) == mpReader->SignalProperties().Channels(),
+       allStates = static_cast<int>( mStates.size() ) == mpReader->States()->Size();
+  for( size_t i = 0; allChannels && i < mChannels.size(); ++i )
+    allChannels = mChannels[ i ] == static_cast<int>( i );
+  for( size_t i = 0; allStates && i < mStates.size(); ++i )
+    allStates = mStates[ i ] == static_cast<int>( i );
+  if( allChannels && ( mStates.empty() || allStates ) )
+    ioCursor.ReadBlock( inSample, inCount, outSignal, mChunkSamples, mCalibrated,
+                        mStates.empty() ? NULL : outStates, mChunkSamples );
+  else
+    ioCursor.ReadColumns( inSample, inCount, mChannels, outSignal, mChunkSamples, mCalibrated,
+                          mStates, outStates, mChunkSamples );
+}
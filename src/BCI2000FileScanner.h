@@ -0,0 +1,156 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: Decodes a range of samples from a BCI2000 data file in
+//   chunks, and passes the chunks to an accumulator object. Threads process
+//   contiguous parts of the range in parallel, each with an accumulator of
+//   its own, and partial results are merged in sample order.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#ifndef BCI2000_FILE_SCANNER_H
+#define BCI2000_FILE_SCANNER_H
+
+#include "BCI2000FileReader.h"
+
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <exception>
+
+// An accumulator is a copyable class with member functions
+//   void Add( const BCI2000FileScanner::Chunk& );
+//   void Merge( const Accumulator& );
+// Add() is called for consecutive chunks of a contiguous range of samples.
+// Merge() is called on the accumulator of a range with the accumulator of
+// the range that immediately follows it.
+class BCI2000FileScanner
+{
+ public:
+  static const long long cDefaultChunkSamples = 16384;
+
+  // Decoded samples, in column-major arrays as with
+  // BCI2000FileReader::ReadBlock(), with channels and states in the order
+  // selected.
+  struct Chunk
+  {
+    long long sample, // number of the first sample
+              count;  // number of samples
+    const GenericSignal::ValueType* signal;
+    size_t signalStride;
+    const double* states;
+    size_t stateStride;
+  };
+
+  explicit BCI2000FileScanner( const BCI2000FileReader& );
+
+  // Channels to decode; all channels by default.
+  BCI2000FileScanner& SetChannels( const std::vector<int>& );
+  const std::vector<int>& Channels() const
+    { return mChannels; }
+  // States to decode; none by default.
+  BCI2000FileScanner& SetStates( const std::vector<int>& );
+  const std::vector<int>& States() const
+    { return mStates; }
+  // Whether signal values are calibrated; raw by default.
+  BCI2000FileScanner& SetCalibrated( bool b )
+    { mCalibrated = b; return *this; }
+  BCI2000FileScanner& SetChunkSamples( long long );
+  long long ChunkSamples() const
+    { return mChunkSamples; }
+  // Maximum number of threads, or 0 for the number of processors.
+  BCI2000FileScanner& SetThreads( int );
+  // Number of threads used for a scan of count samples. Gzip files are
+  // scanned in a single thread, as they can only be decompressed
+  // sequentially.
+  int Threads( long long count ) const;
+
+  // Scans count samples starting at first, and returns the merged
+  // accumulator. Exceptions thrown by accumulators are passed on.
+  template<class Accumulator>
+    Accumulator Scan( long long first, long long count, const Accumulator& ) const;
+
+ private:
+  template<class Accumulator>
+    void ScanRange( long long begin, long long end, Accumulator& ) const;
+  void Decode( BCI2000FileReader::Cursor&, long long sample, long long count,
+               GenericSignal::ValueType* signal, double* states ) const;
+
+  const BCI2000FileReader* mpReader;
+  std::vector<int> mChannels,
+                   mStates;
+  bool mCalibrated;
+  long long mChunkSamples;
+  int mThreads;
+};
+
+template<class Accumulator>
+Accumulator
+BCI2000FileScanner::Scan( long long inFirst, long long inCount, const Accumulator& inAccumulator ) const
+{
+  const int threads = Threads( inCount );
+  std::vector<Accumulator> partial( threads, inAccumulator );
+  std::vector<std::exception_ptr> errors( threads );
+  auto work = [&]( int i )
+  {
+    try
+    {
+      ScanRange( inFirst + inCount * i / threads, inFirst + inCount * ( i + 1 ) / threads, partial[ i ] );
+    }
+    catch( ... )
+    {
+      errors[ i ] = std::current_exception();
+    }
+  };
+  std::vector<std::thread> workers;
+  for( int i = 1; i < threads; ++i )
+    workers.push_back( std::thread( work, i ) );
+  work( 0 );
+  for( size_t i = 0; i < workers.size(); ++i )
+    workers[ i ].join();
+  for( size_t i = 0; i < errors.size(); ++i )
+    if( errors[ i ] )
+      std::rethrow_exception( errors[ i ] );
+  for( int i = 1; i < threads; ++i )
+    partial[ 0 ].Merge( partial[ i ] );
+  return partial[ 0 ];
+}
+
+template<class Accumulator>
+void
+BCI2000FileScanner::ScanRange( long long inBegin, long long inEnd, Accumulator& ioAccumulator ) const
+{
+  BCI2000FileReader::Cursor cursor( *mpReader );
+  std::vector<GenericSignal::ValueType> signal( mChunkSamples * mChannels.size() + 1 );
+  std::vector<double> states( mChunkSamples * mStates.size() + 1 );
+  for( long long sample = inBegin; sample < inEnd; sample += mChunkSamples )
+  {
+    Chunk chunk =
+    {
+      sample, std::min( mChunkSamples, inEnd - sample ),
+      &signal[ 0 ], static_cast<size_t>( mChunkSamples ),
+      &states[ 0 ], static_cast<size_t>( mChunkSamples ),
+    };
+    Decode( cursor, chunk.sample, chunk.count, &signal[ 0 ], &states[ 0 ] );
+    ioAccumulator.Add( chunk );
+  }
+}
+
+#endif // BCI2000_FILE_SCANNER_H
@@ -0,0 +1,676 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: A class that writes BCI2000 data files. The header is
+//   written from a parameter and a state list, and signal blocks are
+//   encoded into records of any BCI2000 data format.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#include "PCHIncludes.h"
+#pragma hdrstop
+
+#include "BCI2000FileWriter.h"
+#include "BCI2000FileReader.h"
+#include "BCIException.h"
+#include "StateVector.h"
+#include "ByteOrder.h"
+
+#include <algorithm>
+#include <limits>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <sstream>
+
+#if __linux__
+# include <unistd.h>
+# include <sys/syscall.h>
+# include <sys/sendfile.h>
+#endif // __linux__
+
+using namespace std;
+
+namespace
+{
+
+// **************************************************************************
+// Function:   RoundSaturate<T>
+// Purpose:    Converts a value into an integer type, rounding to the nearest
+//             integer, and saturating at the type's limits. NaN becomes 0.
+//             There are no branches, so loops over this function vectorize.
+// Parameters: Value.
+// Returns:    Integer value.
+// **************************************************************************
+template<typename T>
+inline T
+RoundSaturate( double v )
+{
+  const double lo = numeric_limits<T>::min(),
+               hi = numeric_limits<T>::max();
+  v = v == v ? v : 0;
+  v = v < lo ? lo : v;
+  v = v > hi ? hi : v;
+  return static_cast<T>( v < 0 ? v - 0.5 : v + 0.5 );
+}
+
+// Data values are stored in little endian byte order.
+template<typename T, typename U>
+struct LittleEndianValue
+{
+  typedef T Type;
+  enum { Size = sizeof( T ) };
+  static T Convert( double v )
+  {
+    return RoundSaturate<T>( v );
+  }
+  static void Write( char* p, T t )
+  {
+    U u;
+    ::memcpy( &u, &t, sizeof( T ) );
+    StoreLittleEndian<U>( p, u );
+  }
+};
+
+template<>
+inline float32_t
+LittleEndianValue<float32_t, uint32_t>::Convert( double v )
+{
+  return static_cast<float32_t>( v );
+}
+
+// BCI2000's float24 format consists of a 16 bit signed mantissa, followed
+// by an 8 bit signed decimal exponent. The exponent is chosen as small as
+// possible, so the mantissa keeps as many digits as fit into 16 bits.
+struct Float24Value
+{
+  typedef double Type;
+  enum { Size = 3 };
+  static double Convert( double v )
+  {
+    return v;
+  }
+  static void Write( char* p, double v )
+  {
+    int mantissa = 0,
+        exponent = 0;
+    if( v == v && v != 0 )
+    {
+      const int maxMantissa = numeric_limits<int16_t>::max();
+      double magnitude = ::fabs( v );
+      exponent = magnitude > numeric_limits<double>::max() ? 127 : static_cast<int>( ::ceil( ::log10( magnitude / maxMantissa ) ) );
+      exponent = max( -128, min( 127, exponent ) );
+      double m = ::floor( magnitude * ::pow( 10.0, -exponent ) + 0.5 );
+      if( m > maxMantissa && exponent < 127 )
+        m = ::floor( magnitude * ::pow( 10.0, -++exponent ) + 0.5 );
+      mantissa = static_cast<int>( min<double>( m, maxMantissa ) );
+      if( v < 0 )
+        mantissa = -mantissa;
+    }
+    StoreLittleEndian<uint16_t>( p, static_cast<uint16_t>( static_cast<int16_t>( mantissa ) ) );
+    p[ 2 ] = static_cast<char>( static_cast<int8_t>( exponent ) );
+  }
+};
+
+// **************************************************************************
+// Function:   EncodeSignal<Format>
+// Purpose:    Encodes the signal values of consecutive records. Each channel
+//             is first converted into a contiguous column of the target type,
+//             and then stored into the records.
+// Parameters: Signal array and channel stride, number of records, number of
+//             channels, offsets and gains for calibrated input or NULL,
+//             record buffer and record size, scratch buffer.
+// Returns:    N/A
+// **************************************************************************
+template<class Format>
+void
+EncodeSignal( const GenericSignal::ValueType* inSignal, size_t inStride, size_t inCount, int inChannels,
+              const GenericSignal::ValueType* inOffsets, const GenericSignal::ValueType* inGains,
+              char* outRecords, size_t inRecordSize, vector<char>& ioScratch )
+{
+  typedef typename Format::Type T;
+  ioScratch.resize( inCount * sizeof( T ) );
+  T* column = reinterpret_cast<T*>( &ioScratch[ 0 ] );
+  for( int ch = 0; ch < inChannels; ++ch )
+  {
+    const GenericSignal::ValueType* in = inSignal + ch * inStride;
+    if( inGains )
+    {
+      const GenericSignal::ValueType offset = inOffsets[ ch ],
+                                     gain = inGains[ ch ];
+      for( size_t i = 0; i < inCount; ++i )
+        column[ i ] = Format::Convert( in[ i ] / gain + offset );
+    }
+    else
+    {
+      for( size_t i = 0; i < inCount; ++i )
+        column[ i ] = Format::Convert( in[ i ] );
+    }
+    char* p = outRecords + ch * Format::Size;
+    for( size_t i = 0; i < inCount; ++i, p += inRecordSize )
+      Format::Write( p, column[ i ] );
+  }
+}
+
+// **************************************************************************
+// Function:   CRLF
+// Purpose:    Converts line endings into the CR/LF line endings of BCI2000
+//             data file headers.
+// Parameters: Text with LF line endings.
+// Returns:    Text with CR/LF line endings.
+// **************************************************************************
+string
+CRLF( const string& inText )
+{
+  string result;
+  result.reserve( inText.size() + inText.size() / 16 );
+  for( string::const_iterator i = inText.begin(); i != inText.end(); ++i )
+  {
+    if( *i == '\n' )
+      result += '\r';
+    result += *i;
+  }
+  return result;
+}
+
+// **************************************************************************
+// Function:   TransferFileRange
+// Purpose:    Copies bytes from a position in one file to the current
+//             position of another file, inside the kernel. copy_file_range
+//             is called through syscall() so the C library need not know it;
+//             it fails across file systems on older kernels, where sendfile
+//             takes over.
+// Parameters: Input descriptor and position, output descriptor, length.
+// Returns:    Number of bytes copied, or 0 if neither call is available.
+// **************************************************************************
+long long
+TransferFileRange( int inFd, long long inPosition, int outFd, long long inLength )
+{
+#if __linux__
+  // limit single calls to well below the 2 GB transfer limit of sendfile
+  const size_t length = static_cast<size_t>( min<long long>( inLength, 1LL << 30 ) );
+  loff_t offset = inPosition;
+# ifdef SYS_copy_file_range
+  ssize_t n = ::syscall( SYS_copy_file_range, inFd, &offset, outFd, NULL, length, 0 );
+  if( n > 0 )
+    return n;
+# endif // SYS_copy_file_range
+  off_t sendOffset = inPosition;
+  ssize_t sent = ::sendfile( outFd, inFd, &sendOffset, length );
+  return sent > 0 ? sent : 0;
+#else // __linux__
+  return 0;
+#endif // __linux__
+}
+
+} // namespace
+
+// **************************************************************************
+// Function:   BCI2000FileWriter
+// Purpose:    The constructor for the BCI2000FileWriter object
+// Parameters: N/A
+// Returns:    N/A
+// **************************************************************************
+BCI2000FileWriter::BCI2000FileWriter()
+: mpFile( NULL ),
+  mBufferFill( 0 ),
+  mErrorState( NoError )
+{
+  Reset();
+}
+
+// **************************************************************************
+// Function:   ~BCI2000FileWriter
+// Purpose:    The destructor for the BCI2000FileWriter object
+// Parameters: N/A
+// Returns:    N/A
+// **************************************************************************
+BCI2000FileWriter::~BCI2000FileWriter()
+{
+  Reset();
+}
+
+// **************************************************************************
+// Function:   Reset
+// Purpose:    Resets file related data members to a defined state.
+//             An open file is closed after writing buffered data, but
+//             errors are not reported; use Close() to check for errors.
+// Parameters: N/A
+// Returns:    N/A
+// **************************************************************************
+void
+BCI2000FileWriter::Reset()
+{
+  mParamlist.Clear();
+  mStatelist.Clear();
+
+  mFilename = "";
+  if( mpFile )
+  {
+    if( mBufferFill > 0 )
+      ::fwrite( &mBuffer[ 0 ], 1, mBufferFill, mpFile );
+    ::fclose( mpFile );
+    mpFile = NULL;
+  }
+
+  mSignalType = SignalType::int16;
+  mChannels = 0;
+  mHeaderLength = 0;
+  mStatevectorLength = 0;
+  mRecordSize = 0;
+  mSourceOffsets.clear();
+  mSourceGains.clear();
+  mStateFields.clear();
+  mInitialStateVector.clear();
+  mBuffer.clear();
+  mBufferFill = 0;
+  mNumSamples = 0;
+
+  mErrorState = NoError;
+}
+
+// **************************************************************************
+// Function:   Open
+// Purpose:    Creates a data file, and writes its header.
+// Parameters: fileName - name of the file to create
+//             channels - number of signal channels
+//             type - data format of signal values
+//             params, states - parameters and states to write into the header
+//             bufferSize - size of the output buffer
+// Returns:    *this
+// **************************************************************************
+BCI2000FileWriter&
+BCI2000FileWriter::Open( const char* inFileName, int inChannels, SignalType inType,
+                         const ParamList& inParams, const StateList& inStates, int inBufferSize )
+{
+  Reset();
+
+  switch( inType )
+  {
+    case SignalType::int16:
+    case SignalType::float24:
+    case SignalType::int32:
+    case SignalType::float32:
+      break;
+    default:
+      mErrorState = UnsupportedFormat;
+      return *this;
+  }
+  mSignalType = inType;
+  mChannels = max( inChannels, 0 );
+  mParamlist = inParams;
+  mStatelist = inStates;
+  mStatevectorLength = mStatelist.ByteLength();
+  mRecordSize = mChannels * mSignalType.Size() + mStatevectorLength;
+
+  const double defaultOffset = 0.0;
+  if( mParamlist.Exists( "SourceChOffset" ) )
+  {
+    const Param& SourceChOffset = mParamlist[ "SourceChOffset" ];
+    for( int i = 0; i < SourceChOffset.NumValues(); ++i )
+      mSourceOffsets.push_back( ::atof( SourceChOffset.Value( i ).c_str() ) );
+  }
+  mSourceOffsets.resize( mChannels, defaultOffset );
+
+  const double defaultGain = 0.033;
+  if( mParamlist.Exists( "SourceChGain" ) )
+  {
+    const Param& SourceChGain = mParamlist[ "SourceChGain" ];
+    for( int i = 0; i < SourceChGain.NumValues(); ++i )
+      mSourceGains.push_back( ::atof( SourceChGain.Value( i ).c_str() ) );
+  }
+  mSourceGains.resize( mChannels, defaultGain );
+
+  // state vectors start out with the values from the state list
+  class StateVector initial( mStatelist, 1 );
+  mInitialStateVector.assign( initial( 0 ).Data(), initial( 0 ).Data() + mStatevectorLength );
+  for( int i = 0; i < mStatelist.Size(); ++i )
+  {
+    const State& s = mStatelist[ i ];
+    StateField f;
+    f.byteOffset = s.Location() / 8;
+    f.shift = s.Location() % 8;
+    f.mask = s.Length() < 64 ? ( uint64_t( 1 ) << s.Length() ) - 1 : ~uint64_t( 0 );
+    mStateFields.push_back( f );
+  }
+
+  if( inFileName != NULL )
+    mpFile = ::fopen( inFileName, "wb" );
+  if( mpFile == NULL )
+  {
+    mErrorState = FileOpenError;
+    return *this;
+  }
+  mFilename = inFileName;
+  // data is written in blocks of the buffer size, so stdio buffering would
+  // only add a copy
+  ::setvbuf( mpFile, NULL, _IONBF, 0 );
+  mBuffer.resize( max<size_t>( max( inBufferSize, 0 ), mRecordSize ) );
+  WriteHeader();
+  return *this;
+}
+
+// **************************************************************************
+// Function:   WriteHeader
+// Purpose:    Writes the header with the correct header length. As the
+//             length appears in the header's first line, the line is
+//             formatted until the number of digits no longer changes.
+// Parameters: N/A
+// Returns:    N/A
+// **************************************************************************
+void
+BCI2000FileWriter::WriteHeader()
+{
+  ostringstream states, params;
+  mStatelist.WriteToStream( states );
+  mParamlist.WriteToStream( params );
+  string definitions = "[ State Vector Definition ] \r\n"
+                       + CRLF( states.str() )
+                       + "[ Parameter Definition ] \r\n"
+                       + CRLF( params.str() )
+                       + "\r\n";
+  string firstLine;
+  size_t headerLength = definitions.size();
+  do
+  {
+    mHeaderLength = static_cast<int>( headerLength );
+    ostringstream oss;
+    oss << "BCI2000V= 1.1"
+        << " HeaderLen= " << mHeaderLength
+        << " SourceCh= " << mChannels
+        << " StatevectorLen= " << mStatevectorLength
+        << " DataFormat= " << mSignalType.Name()
+        << "\r\n";
+    firstLine = oss.str();
+    headerLength = firstLine.size() + definitions.size();
+  } while( headerLength != static_cast<size_t>( mHeaderLength ) );
+
+  string header = firstLine + definitions;
+  if( ::fwrite( header.data(), 1, header.size(), mpFile ) != header.size() )
+    mErrorState = FileWriteError;
+}
+
+// **************************************************************************
+// Function:   EncodeStates
+// Purpose:    Sets up the state vector for a single sample. States with a
+//             NaN value keep their value from the state list.
+// Parameters: states - state value array, or NULL
+//             stateStride - distance between states in the array
+//             index - index of the sample in the array
+//             stateVector - output state vector
+// Returns:    N/A
+// **************************************************************************
+void
+BCI2000FileWriter::EncodeStates( const double* inStates, size_t inStateStride, size_t inIndex, char* outStateVector ) const
+{
+  ::memcpy( outStateVector, &mInitialStateVector[ 0 ], mStatevectorLength );
+  if( inStates == NULL )
+    return;
+  unsigned char* data = reinterpret_cast<unsigned char*>( outStateVector );
+  const double* p = inStates + inIndex;
+  for( size_t i = 0; i < mStateFields.size(); ++i, p += inStateStride )
+  {
+    const StateField& f = mStateFields[ i ];
+    if( f.byteOffset >= static_cast<size_t>( mStatevectorLength ) )
+      continue;
+    double v = *p;
+    if( v != v )
+      continue;
+    uint64_t value = 0;
+    if( v >= static_cast<double>( f.mask ) )
+      value = f.mask;
+    else if( v > 0 )
+      value = static_cast<uint64_t>( v + 0.5 ) & f.mask;
+    size_t available = mStatevectorLength - f.byteOffset,
+           bytes = min<size_t>( available, 8 );
+    uint64_t word = LoadLittleEndian( data + f.byteOffset, bytes );
+    word = ( word & ~( f.mask << f.shift ) ) | ( value << f.shift );
+    StoreLittleEndian( data + f.byteOffset, bytes, word );
+    if( f.shift > 0 && available > 8 )
+    {
+      unsigned char high = static_cast<unsigned char>( f.mask >> ( 64 - f.shift ) );
+      data[ f.byteOffset + 8 ] = static_cast<unsigned char>( ( data[ f.byteOffset + 8 ] & ~high )
+                                                             | ( value >> ( 64 - f.shift ) ) );
+    }
+  }
+}
+
+// **************************************************************************
+// Function:   WriteBlock
+// Purpose:    Encodes a range of samples from signal and state arrays,
+//             and appends them to the file.
+// Parameters: count - number of samples
+//             signal - input array of signal values, or NULL for zeros
+//             signalStride - distance between channels in the signal array
+//             calibrated - whether values are calibrated
+//             states - input array of state values, or NULL
+//             stateStride - distance between states in the state array
+// Returns:    *this
+// **************************************************************************
+BCI2000FileWriter&
+BCI2000FileWriter::WriteBlock( long long inCount,
+                               const GenericSignal::ValueType* inSignal, size_t inSignalStride, bool inCalibrated,
+                               const double* inStates, size_t inStateStride )
+{
+  if( !IsOpen() )
+    throw std_runtime_error( "No data file open for writing" );
+
+  const GenericSignal::ValueType* offsets = inCalibrated ? &mSourceOffsets[ 0 ] : NULL,
+                                * gains = inCalibrated ? &mSourceGains[ 0 ] : NULL;
+  const size_t signalSize = mRecordSize - mStatevectorLength;
+  long long done = 0;
+  while( done < inCount )
+  {
+    if( mBuffer.size() - mBufferFill < mRecordSize )
+      Flush();
+    size_t count = static_cast<size_t>( min<long long>( ( mBuffer.size() - mBufferFill ) / mRecordSize, inCount - done ) );
+    char* records = &mBuffer[ mBufferFill ];
+    if( inSignal == NULL || mChannels == 0 )
+    {
+      for( size_t i = 0; i < count; ++i )
+        ::memset( records + i * mRecordSize, 0, signalSize );
+    }
+    else
+    {
+      const GenericSignal::ValueType* signal = inSignal + done;
+      switch( mSignalType )
+      {
+        case SignalType::int16:
+          EncodeSignal< LittleEndianValue<int16_t, uint16_t> >( signal, inSignalStride, count, mChannels, offsets, gains, records, mRecordSize, mScratch );
+          break;
+        case SignalType::float24:
+          EncodeSignal< Float24Value >( signal, inSignalStride, count, mChannels, offsets, gains, records, mRecordSize, mScratch );
+          break;
+        case SignalType::int32:
+          EncodeSignal< LittleEndianValue<int32_t, uint32_t> >( signal, inSignalStride, count, mChannels, offsets, gains, records, mRecordSize, mScratch );
+          break;
+        case SignalType::float32:
+          EncodeSignal< LittleEndianValue<float32_t, uint32_t> >( signal, inSignalStride, count, mChannels, offsets, gains, records, mRecordSize, mScratch );
+          break;
+        default:
+          throw std_runtime_error( "Unsupported data format: " << mSignalType.Name() );
+      }
+    }
+    for( size_t i = 0; i < count; ++i )
+      EncodeStates( inStates, inStateStride, static_cast<size_t>( done ) + i, records + i * mRecordSize + signalSize );
+    mBufferFill += count * mRecordSize;
+    mNumSamples += count;
+    done += count;
+  }
+  return *this;
+}
+
+// **************************************************************************
+// Function:   WriteRecords
+// Purpose:    Appends encoded records to the file. Large blocks bypass the
+//             output buffer.
+// Parameters: records - record data
+//             count - number of records
+// Returns:    *this
+// **************************************************************************
+BCI2000FileWriter&
+BCI2000FileWriter::WriteRecords( const char* inRecords, long long inCount )
+{
+  if( !IsOpen() )
+    throw std_runtime_error( "No data file open for writing" );
+  if( inCount <= 0 )
+    return *this;
+
+  size_t length = static_cast<size_t>( inCount ) * mRecordSize;
+  if( length >= mBuffer.size() )
+  {
+    Flush();
+    if( ::fwrite( inRecords, 1, length, mpFile ) != length )
+    {
+      mErrorState = FileWriteError;
+      throw std_runtime_error( "Could not write to " << mFilename );
+    }
+  }
+  else
+  {
+    if( mBuffer.size() - mBufferFill < length )
+      Flush();
+    ::memcpy( &mBuffer[ mBufferFill ], inRecords, length );
+    mBufferFill += length;
+  }
+  mNumSamples += inCount;
+  return *this;
+}
+
+// **************************************************************************
+// Function:   SameLayout
+// Purpose:    Checks whether a reader's records can be copied into the file
+//             as they are.
+// Parameters: reader - an open reader
+// Returns:    True if the record layouts match.
+// **************************************************************************
+bool
+BCI2000FileWriter::SameLayout( const BCI2000FileReader& inReader ) const
+{
+  if( !inReader.IsOpen()
+      || inReader.SignalProperties().Channels() != mChannels
+      || inReader.SignalProperties().Type() != mSignalType
+      || inReader.StateVectorLength() != mStatevectorLength )
+    return false;
+  for( int i = 0; i < mStatelist.Size(); ++i )
+  {
+    const State& s = mStatelist[ i ];
+    if( !inReader.States()->Exists( s.Name() ) )
+      return false;
+    const State& other = ( *inReader.States() )[ s.Name() ];
+    if( other.Location() != s.Location() || other.Length() != s.Length() )
+      return false;
+  }
+  return true;
+}
+
+// **************************************************************************
+// Function:   CopyRecords
+// Purpose:    Appends a range of records from another data file, without
+//             decoding them.
+// Parameters: reader - reader for the source file
+//             first - first record to copy
+//             count - number of records
+// Returns:    *this
+// **************************************************************************
+BCI2000FileWriter&
+BCI2000FileWriter::CopyRecords( const BCI2000FileReader& inReader, long long inFirst, long long inCount )
+{
+  if( !IsOpen() )
+    throw std_runtime_error( "No data file open for writing" );
+  if( inCount <= 0 )
+    return *this;
+  if( inFirst < 0 || inFirst + inCount > inReader.NumSamples() )
+    throw std_range_error( "Sample range " << inFirst << ".." << inFirst + inCount
+                           << " exceeds file size of " << inReader.NumSamples() );
+  if( !SameLayout( inReader ) )
+    throw std_runtime_error( "Records differ in layout from those of " << mFilename );
+
+  // buffered records go first, and the copy continues at the file position
+  Flush();
+  ::fflush( mpFile );
+  long long position = inReader.HeaderLength() + inFirst * static_cast<long long>( mRecordSize ),
+            remaining = inCount * static_cast<long long>( mRecordSize );
+  const int inFd = inReader.FileDescriptor(),
+            outFd = ::fileno( mpFile );
+  long long copied = 0;
+  while( inFd >= 0 && remaining > 0 && ( copied = TransferFileRange( inFd, position, outFd, remaining ) ) > 0 )
+  {
+    position += copied;
+    remaining -= copied;
+  }
+  while( remaining > 0 )
+  {
+    size_t length = static_cast<size_t>( min<long long>( remaining, mBuffer.size() ) ),
+           read = inReader.ReadAt( position, &mBuffer[ 0 ], length );
+    if( read == 0 )
+      throw std_runtime_error( "Could not read record data at position " << position );
+    if( ::fwrite( &mBuffer[ 0 ], 1, read, mpFile ) != read )
+    {
+      mErrorState = FileWriteError;
+      throw std_runtime_error( "Could not write to " << mFilename );
+    }
+    position += read;
+    remaining -= read;
+  }
+  mNumSamples += inCount;
+  return *this;
+}
+
+// **************************************************************************
+// Function:   Flush
+// Purpose:    Writes buffered records to the file.
+// Parameters: N/A
+// Returns:    *this
+// **************************************************************************
+BCI2000FileWriter&
+BCI2000FileWriter::Flush()
+{
+  if( !IsOpen() )
+    return *this;
+  size_t length = mBufferFill;
+  mBufferFill = 0;
+  if( length > 0 && ::fwrite( &mBuffer[ 0 ], 1, length, mpFile ) != length )
+  {
+    mErrorState = FileWriteError;
+    throw std_runtime_error( "Could not write to " << mFilename );
+  }
+  return *this;
+}
+
+// **************************************************************************
+// Function:   Close
+// Purpose:    Writes buffered records, and closes the file.
+// Parameters: N/A
+// Returns:    *this
+// **************************************************************************
+BCI2000FileWriter&
+BCI2000FileWriter::Close()
+{
+  if( !IsOpen() )
+    return *this;
+  Flush();
+  if( ::fclose( mpFile ) != 0 )
+    mErrorState = FileWriteError;
+  mpFile = NULL;
+  if( ErrorState() != NoError )
+    throw std_runtime_error( "Could not write to " << mFilename );
+  return *this;
+}
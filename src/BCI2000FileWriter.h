@@ -0,0 +1,159 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: A class that writes BCI2000 data files. The header is
+//   written from a parameter and a state list, and signal blocks are
+//   encoded into records of any BCI2000 data format.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#ifndef BCI2000_FILE_WRITER_H
+#define BCI2000_FILE_WRITER_H
+
+#include "ParamList.h"
+#include "StateList.h"
+#include "GenericSignal.h"
+#include "SignalType.h"
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <stdint.h>
+
+class BCI2000FileWriter
+{
+ public:
+  static const int cDefaultBufSize = 4 * 1024 * 1024;
+
+  enum
+  {
+    NoError = 0,
+    FileOpenError,
+    FileWriteError,
+    UnsupportedFormat,
+
+    NumErrors
+  };
+
+ public:
+  BCI2000FileWriter();
+  virtual ~BCI2000FileWriter();
+
+ private:
+  BCI2000FileWriter( const BCI2000FileWriter& );
+  BCI2000FileWriter& operator=( const BCI2000FileWriter& );
+
+ public:
+  // State
+  int   ErrorState() const
+        { return mErrorState; }
+  bool  IsOpen() const
+        { return mpFile != NULL; }
+
+  // File access
+  //  Open() creates the file, and writes its header. State positions are
+  //  taken from the state list as they are, so states created from scratch
+  //  need a call to StateList::AssignPositions() first.
+  //  Records are collected in a buffer of the given size, and written to the
+  //  file in large blocks. Close() writes remaining data, and closes the file.
+  BCI2000FileWriter&
+        Open( const char* fileName, int channels, SignalType,
+              const ParamList&, const StateList&, int bufferSize = cDefaultBufSize );
+  BCI2000FileWriter&
+        Close();
+  long long NumSamples() const
+        { return mNumSamples; }
+
+  // Header information
+  const ParamList*   Parameters() const
+                     { return &mParamlist; }
+  const StateList*   States() const
+                     { return &mStatelist; }
+  int   HeaderLength() const
+        { return mHeaderLength; }
+  int   StateVectorLength() const
+        { return mStatevectorLength; }
+  SignalType DataFormat() const
+        { return mSignalType; }
+
+  // Data output
+  //  Encodes count samples from column-major arrays, with the same layout as
+  //  in BCI2000FileReader::ReadBlock(): signal[ channel * signalStride + i ],
+  //  states[ state * stateStride + i ], states in the order of the state list.
+  //  Calibrated values are converted into raw values using the SourceChOffset
+  //  and SourceChGain parameters. Integer formats are rounded and saturated.
+  //  Without a state array, each sample's state vector holds the values
+  //  from the state list, as do states with a NaN value in the array.
+  BCI2000FileWriter&
+        WriteBlock( long long count,
+                    const GenericSignal::ValueType* signal, size_t signalStride, bool calibrated,
+                    const double* states = NULL, size_t stateStride = 0 );
+  // Appends records that are already encoded in the file's layout.
+  BCI2000FileWriter&
+        WriteRecords( const char* records, long long count );
+  // Appends count records of a file opened by a reader, starting at record
+  // first, without decoding them. Records are copied by the kernel where
+  // possible (copy_file_range, sendfile), and in large blocks otherwise.
+  // The reader's file must have the same record layout, i.e. channels,
+  // data format, state vector length, and state positions.
+  BCI2000FileWriter&
+        CopyRecords( const class BCI2000FileReader&, long long first, long long count );
+  bool  SameLayout( const class BCI2000FileReader& ) const;
+  BCI2000FileWriter&
+        Flush();
+
+ private:
+  void  Reset();
+  void  WriteHeader();
+  void  EncodeStates( const double* states, size_t stateStride, size_t index, char* stateVector ) const;
+
+ private:
+  ParamList          mParamlist;
+  StateList          mStatelist;
+
+  std::FILE*         mpFile;
+  std::string        mFilename;
+
+  SignalType         mSignalType;
+  int                mChannels,
+                     mHeaderLength,
+                     mStatevectorLength;
+  size_t             mRecordSize;
+  std::vector<GenericSignal::ValueType> mSourceOffsets,
+                                        mSourceGains;
+  struct StateField
+  {
+    size_t byteOffset;
+    int    shift;
+    uint64_t mask;
+  };
+  std::vector<StateField> mStateFields;
+  std::vector<char>  mInitialStateVector;
+
+  std::vector<char>  mBuffer;
+  size_t             mBufferFill;
+  std::vector<char>  mScratch;
+
+  long long          mNumSamples;
+
+  int                mErrorState;
+};
+
+#endif // BCI2000_FILE_WRITER_H
@@ -0,0 +1,602 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: Random access to the uncompressed content of a gzip file.
+//   A single pass over the file determines the uncompressed size, and
+//   records checkpoints from which decompression can be resumed.
+//   Sequential reads continue a decompression stream without seeking.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#include "PCHIncludes.h"
+#pragma hdrstop
+
+#include "BCI2000GzipFile.h"
+#include "BCIException.h"
+#include "Serialization.h"
+#include "AtomicFile.h"
+#include "PositionalIO.h"
+#include "ByteOrder.h"
+
+#include <zlib.h>
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+using namespace std;
+
+static const char cGzipIndexMagic[] = "BCI2000GzipIndex";
+static const uint32_t cGzipIndexVersion = 2;
+
+namespace
+{
+
+// deflate's maximum distance of back references
+const size_t cWindowSize = 32 * 1024;
+// sizes of the gzip header without optional fields, and of the trailer
+const long long cHeaderSize = 10,
+                cTrailerSize = 8;
+const size_t cInputSize = 64 * 1024;
+// Recent output is kept, so reads may step back by up to this many bytes
+// without restarting decompression, as cursors do when a record straddles
+// the end of their buffer.
+const size_t cHistorySize = 64 * 1024;
+// Checkpoints are set at deflate block boundaries, at least this far
+// apart initially. When there are more than cMaxPoints checkpoints, every
+// other one is dropped, and the distance doubled, so the index stays
+// bounded in size for files of any length.
+const long long cInitialSpan = 1024 * 1024;
+const size_t cMaxPoints = 1024;
+// window bits for zlib: 15 bits, gzip wrapper expected, or raw deflate data
+const int cGzipWindowBits = 15 + 16,
+          cRawWindowBits = -15;
+
+bool
+IsMemberStart( const unsigned char* p, size_t inLength )
+{
+  return inLength >= 2 && p[ 0 ] == 0x1f && p[ 1 ] == 0x8b;
+}
+
+} // namespace
+
+BCI2000GzipFile::BCI2000GzipFile()
+: mpFile( NULL ),
+  mpStream( NULL )
+{
+  Close();
+}
+
+BCI2000GzipFile::~BCI2000GzipFile()
+{
+  Close();
+}
+
+bool
+BCI2000GzipFile::IsGzip( std::FILE* inFile )
+{
+  unsigned char data[ 2 ];
+  return PositionalIO::Read( inFile, 0, reinterpret_cast<char*>( data ), sizeof( data ) ) == sizeof( data )
+         && IsMemberStart( data, sizeof( data ) );
+}
+
+// **************************************************************************
+// Function:   Open
+// Purpose:    Obtains the checkpoint index of a gzip file from an index
+//             file. Otherwise, the uncompressed size is taken from the gzip
+//             trailer, and checkpoints are recorded while data are read.
+//             Only if the trailer's size is implausible, the file is
+//             decompressed once to determine its size.
+// Parameters: file - an open gzip file
+//             indexFile - name of the index file, or empty
+// Returns:    True if the file could be decompressed.
+// **************************************************************************
+bool
+BCI2000GzipFile::Open( std::FILE* inFile, const string& inIndexFile )
+{
+  Close();
+  if( inFile == NULL || !IsGzip( inFile ) )
+    return false;
+  PositionalIO::Stat( inFile, mFileSize, mFileTime );
+  mpFile = inFile;
+  mIndexFile = inIndexFile;
+  mIndexFromFile = !inIndexFile.empty() && ReadIndex( inIndexFile );
+  if( mIndexFromFile )
+    mIndexComplete = true;
+  else if( SizeFromTrailer() )
+  {
+    Point start = { 0, 0, 0, vector<unsigned char>() };
+    mPoints.push_back( start );
+  }
+  else
+  {
+    if( !BuildIndex() )
+    {
+      Close();
+      return false;
+    }
+    mIndexComplete = true;
+    if( !inIndexFile.empty() )
+      WriteIndex( inIndexFile );
+  }
+  mpStream = new z_stream;
+  ::memset( mpStream, 0, sizeof( z_stream ) );
+  if( Z_OK != ::inflateInit2( mpStream, cGzipWindowBits ) )
+  {
+    Close();
+    return false;
+  }
+  mInput.resize( cInputSize );
+  return true;
+}
+
+void
+BCI2000GzipFile::Close()
+{
+  if( mpStream )
+  {
+    ::inflateEnd( mpStream );
+    delete mpStream;
+    mpStream = NULL;
+  }
+  mpFile = NULL;
+  mFileSize = 0;
+  mFileTime = 0;
+  mSize = 0;
+  mIndexFile.clear();
+  mIndexFromFile = false;
+  mIndexComplete = false;
+  mIndexEnd = 0;
+  mSpan = cInitialSpan;
+  mPoints.clear();
+  mInput.clear();
+  mInputPosition = 0;
+  mStreamPosition = -1;
+  mHistory.clear();
+  mStreamEnd = true;
+  mRawStream = false;
+}
+
+// **************************************************************************
+// Function:   SizeFromTrailer
+// Purpose:    Takes the uncompressed size from the gzip trailer, which
+//             holds the size of the last member modulo 2^32. This is the
+//             size of the file's content if the file consists of a single
+//             member of less than 4 GiB. The size is used unless it is less
+//             than the compressed data, as deflate expands data by no more
+//             than 5 bytes per block of 65535 bytes. It is checked when
+//             decompression reaches the end of data.
+// Parameters: N/A
+// Returns:    True if the size was taken from the trailer.
+// **************************************************************************
+bool
+BCI2000GzipFile::SizeFromTrailer()
+{
+  const long long compressed = mFileSize - cHeaderSize - cTrailerSize;
+  char data[ sizeof( uint32_t ) ];
+  if( compressed <= 0
+      || PositionalIO::Read( mpFile, mFileSize - sizeof( data ), data, sizeof( data ) ) != sizeof( data ) )
+    return false;
+  const long long size = LoadLittleEndian<uint32_t>( data );
+  if( size < compressed - 5 * ( compressed / 65535 + 1 ) )
+    return false;
+  mSize = size;
+  return true;
+}
+
+// **************************************************************************
+// Function:   AddPoint
+// Purpose:    Appends a checkpoint to the index. When there are more than
+//             cMaxPoints checkpoints, every other one is dropped, and the
+//             distance between checkpoints doubled.
+// Parameters: checkpoint
+// Returns:    N/A
+// **************************************************************************
+void
+BCI2000GzipFile::AddPoint( const Point& inPoint ) const
+{
+  if( !mPoints.empty() && inPoint.out <= mPoints.back().out )
+    return;
+  mPoints.push_back( inPoint );
+  if( mPoints.size() > cMaxPoints )
+  {
+    vector<Point> points;
+    for( size_t i = 0; i < mPoints.size(); ++i )
+      if( i % 2 == 0 || mPoints[ i ].window.empty() )
+        points.push_back( mPoints[ i ] );
+    mPoints.swap( points );
+    mSpan *= 2;
+  }
+}
+
+// **************************************************************************
+// Function:   BuildIndex
+// Purpose:    Decompresses the entire file, and records checkpoints at
+//             deflate block boundaries, together with the window of
+//             uncompressed data that later blocks may refer to.
+//             Concatenated gzip members are decompressed one after the
+//             other, and data following the last member is ignored.
+// Parameters: N/A
+// Returns:    True if the file could be decompressed.
+// **************************************************************************
+bool
+BCI2000GzipFile::BuildIndex()
+{
+  z_stream strm;
+  ::memset( &strm, 0, sizeof( strm ) );
+  if( Z_OK != ::inflateInit2( &strm, cGzipWindowBits ) )
+    return false;
+
+  vector<unsigned char> input( cInputSize ),
+                        window( cWindowSize );
+  long long inputPosition = 0,
+            totalIn = 0,
+            totalOut = 0;
+  // makes at least the given number of input bytes available, if possible
+  auto fill = [&]( size_t minimum )
+  {
+    if( strm.avail_in < minimum )
+    {
+      ::memmove( &input[ 0 ], strm.next_in, strm.avail_in );
+      size_t n = PositionalIO::Read( mpFile, inputPosition, reinterpret_cast<char*>( &input[ 0 ] ) + strm.avail_in,
+                                     input.size() - strm.avail_in );
+      inputPosition += n;
+      strm.next_in = &input[ 0 ];
+      strm.avail_in += static_cast<uInt>( n );
+    }
+    return strm.avail_in >= minimum;
+  };
+
+  Point start = { 0, 0, 0, vector<unsigned char>() };
+  mPoints.push_back( start );
+  strm.next_in = &input[ 0 ];
+  bool ok = true,
+       done = false;
+  while( ok && !done )
+  {
+    if( !fill( 1 ) )
+    { // truncated file
+      ok = false;
+      break;
+    }
+    if( strm.avail_out == 0 )
+    {
+      strm.next_out = &window[ 0 ];
+      strm.avail_out = static_cast<uInt>( window.size() );
+    }
+    totalIn += strm.avail_in;
+    totalOut += strm.avail_out;
+    int result = ::inflate( &strm, Z_BLOCK );
+    totalIn -= strm.avail_in;
+    totalOut -= strm.avail_out;
+    if( result == Z_STREAM_END )
+    {
+      fill( 2 );
+      if( IsMemberStart( strm.next_in, strm.avail_in ) )
+      {
+        ::inflateReset( &strm );
+        Point member = { totalIn, totalOut, 0, vector<unsigned char>() };
+        AddPoint( member );
+      }
+      else
+        done = true;
+    }
+    else if( result != Z_OK && result != Z_BUF_ERROR )
+      ok = false;
+    else if( ( strm.data_type & 128 ) && !( strm.data_type & 64 ) && totalOut - mPoints.back().out > mSpan )
+    { // at the end of a block that is not the last one
+      Point point = { totalIn, totalOut, strm.data_type & 7, vector<unsigned char>( cWindowSize ) };
+      const size_t filled = window.size() - strm.avail_out;
+      ::memcpy( &point.window[ 0 ], &window[ 0 ] + filled, window.size() - filled );
+      ::memcpy( &point.window[ 0 ] + window.size() - filled, &window[ 0 ], filled );
+      AddPoint( point );
+    }
+  }
+  ::inflateEnd( &strm );
+  mSize = totalOut;
+  if( !ok )
+    mPoints.clear();
+  return ok;
+}
+
+// **************************************************************************
+// Function:   ReadIndex
+// Purpose:    Reads the checkpoint index from a file.
+// Parameters: index file name
+// Returns:    True if the index file exists, and matches the gzip file.
+// **************************************************************************
+bool
+BCI2000GzipFile::ReadIndex( const string& inFileName )
+{
+  using namespace Serialization;
+
+  std::FILE* pFile = ::fopen( inFileName.c_str(), "rb" );
+  if( !pFile )
+    return false;
+  uint32_t magicLength = 0,
+           version = 0;
+  string magic;
+  bool ok = Get( pFile, magicLength ) && magicLength == sizeof( cGzipIndexMagic ) - 1;
+  if( ok )
+  {
+    magic.resize( magicLength );
+    ok = ( ::fread( &magic[ 0 ], 1, magicLength, pFile ) == magicLength );
+  }
+  long long fileSize = 0,
+            fileTime = 0;
+  uint64_t numPoints = 0;
+  ok = ok && magic == cGzipIndexMagic
+          && Get( pFile, version ) && version == cGzipIndexVersion
+          && Get( pFile, fileSize ) && fileSize == mFileSize
+          && Get( pFile, fileTime ) && fileTime == mFileTime
+          && Get( pFile, mSize )
+          && Get( pFile, numPoints ) && numPoints > 0;
+  for( uint64_t i = 0; ok && i < numPoints; ++i )
+  {
+    Point point = { 0, 0, 0, vector<unsigned char>() };
+    int32_t bits = 0;
+    uint8_t hasWindow = 0;
+    ok = Get( pFile, point.in ) && Get( pFile, point.out ) && Get( pFile, bits ) && Get( pFile, hasWindow )
+         && bits >= 0 && bits < 8;
+    point.bits = bits;
+    if( ok && hasWindow )
+    {
+      point.window.resize( cWindowSize );
+      ok = ( ::fread( &point.window[ 0 ], 1, cWindowSize, pFile ) == cWindowSize );
+    }
+    mPoints.push_back( point );
+  }
+  ::fclose( pFile );
+  if( !ok )
+    mPoints.clear();
+  return ok;
+}
+
+// **************************************************************************
+// Function:   WriteIndex
+// Purpose:    Writes the checkpoint index into a file.
+//             Errors are ignored, as the index file is optional.
+// Parameters: index file name
+// Returns:    N/A
+// **************************************************************************
+void
+BCI2000GzipFile::WriteIndex( const string& inFileName ) const
+{
+  using namespace Serialization;
+
+  ostringstream os;
+  PutString( os, cGzipIndexMagic );
+  Put( os, cGzipIndexVersion );
+  Put( os, mFileSize );
+  Put( os, mFileTime );
+  Put( os, mSize );
+  Put( os, static_cast<uint64_t>( mPoints.size() ) );
+  for( size_t i = 0; i < mPoints.size(); ++i )
+  {
+    const Point& point = mPoints[ i ];
+    Put( os, point.in );
+    Put( os, point.out );
+    Put( os, static_cast<int32_t>( point.bits ) );
+    Put( os, static_cast<uint8_t>( !point.window.empty() ) );
+    if( !point.window.empty() )
+      os.write( reinterpret_cast<const char*>( &point.window[ 0 ] ), point.window.size() );
+  }
+
+  AtomicFile::Write( inFileName, os.str() );
+}
+
+// **************************************************************************
+// Function:   ReadAt
+// Purpose:    Reads uncompressed content.
+// Parameters: position - position in the uncompressed content
+//             data - destination buffer
+//             length - number of bytes to read
+// Returns:    Number of bytes read.
+// **************************************************************************
+size_t
+BCI2000GzipFile::ReadAt( long long inPosition, char* outData, size_t inLength ) const
+{
+  lock_guard<mutex> lock( mMutex );
+  if( !IsOpen() || inPosition < 0 || inPosition >= mSize )
+    return 0;
+  inLength = static_cast<size_t>( min<long long>( inLength, mSize - inPosition ) );
+
+  // data shortly before the current position is taken from the history
+  size_t done = 0;
+  const long long historyBegin = mStreamPosition - static_cast<long long>( mHistory.size() );
+  if( mStreamPosition >= 0 && inPosition >= historyBegin && inPosition < mStreamPosition )
+  {
+    done = static_cast<size_t>( min<long long>( inLength, mStreamPosition - inPosition ) );
+    ::memcpy( outData, &mHistory[ 0 ] + ( inPosition - historyBegin ), done );
+  }
+  const long long position = inPosition + done;
+  // restart at a checkpoint when going backwards, or when a checkpoint is
+  // closer than the current position
+  size_t k = 0;
+  while( k + 1 < mPoints.size() && mPoints[ k + 1 ].out <= position )
+    ++k;
+  if( mStreamPosition < 0 || position < mStreamPosition || mPoints[ k ].out > mStreamPosition )
+    StartAt( mPoints[ k ] );
+  vector<char> discard;
+  while( mStreamPosition < position )
+  {
+    discard.resize( static_cast<size_t>( min<long long>( position - mStreamPosition, cInputSize ) ) );
+    if( Inflate( &discard[ 0 ], discard.size() ) == 0 )
+      return 0;
+  }
+  size_t count = 0;
+  while( done < inLength && ( count = Inflate( outData + done, inLength - done ) ) > 0 )
+    done += count;
+  // with the size from the trailer, no data may follow
+  char c = 0;
+  if( !mIndexComplete && mStreamPosition == mSize && Inflate( &c, 1 ) > 0 )
+    throw std_runtime_error( "Gzip file holds more data than its trailer indicates; "
+                             "it may consist of multiple members, or exceed 4 GiB" );
+  return done;
+}
+
+// **************************************************************************
+// Function:   StartAt
+// Purpose:    Prepares the decompression stream to continue from a
+//             checkpoint.
+// Parameters: checkpoint
+// Returns:    N/A
+// **************************************************************************
+void
+BCI2000GzipFile::StartAt( const Point& inPoint ) const
+{
+  z_stream& strm = *mpStream;
+  mInputPosition = inPoint.in;
+  if( inPoint.window.empty() )
+    ::inflateReset2( &strm, cGzipWindowBits );
+  else
+  {
+    ::inflateReset2( &strm, cRawWindowBits );
+    if( inPoint.bits > 0 )
+    {
+      unsigned char c = 0;
+      if( PositionalIO::Read( mpFile, inPoint.in - 1, reinterpret_cast<char*>( &c ), 1 ) != 1 )
+        throw std_runtime_error( "Could not read compressed data at position " << inPoint.in - 1 );
+      ::inflatePrime( &strm, inPoint.bits, c >> ( 8 - inPoint.bits ) );
+    }
+    ::inflateSetDictionary( &strm, &inPoint.window[ 0 ], static_cast<uInt>( inPoint.window.size() ) );
+  }
+  strm.next_in = &mInput[ 0 ];
+  strm.avail_in = 0;
+  mStreamPosition = inPoint.out;
+  // the window is the data preceding the checkpoint
+  mHistory.assign( inPoint.window.begin(), inPoint.window.end() );
+  mStreamEnd = false;
+  mRawStream = !inPoint.window.empty();
+}
+
+// **************************************************************************
+// Function:   Inflate
+// Purpose:    Continues decompression from the current stream position.
+//             Streams started at a checkpoint within a gzip member read raw
+//             deflate data, and skip the member's trailer at its end.
+//             Until the index is complete, decompression stops at block
+//             boundaries, and checkpoints are recorded beyond the end of
+//             the index. At the end of data, the index is complete, and
+//             written to the index file if there is one.
+// Parameters: data - destination buffer
+//             length - number of bytes to decompress
+// Returns:    Number of bytes decompressed; 0 at the end of data.
+// **************************************************************************
+size_t
+BCI2000GzipFile::Inflate( char* outData, size_t inLength ) const
+{
+  z_stream& strm = *mpStream;
+  auto fill = [&]( size_t minimum )
+  {
+    if( strm.avail_in < minimum )
+    {
+      ::memmove( &mInput[ 0 ], strm.next_in, strm.avail_in );
+      size_t n = PositionalIO::Read( mpFile, mInputPosition, reinterpret_cast<char*>( &mInput[ 0 ] ) + strm.avail_in,
+                                     mInput.size() - strm.avail_in );
+      mInputPosition += n;
+      strm.next_in = &mInput[ 0 ];
+      strm.avail_in += static_cast<uInt>( n );
+    }
+    return strm.avail_in >= minimum;
+  };
+
+  strm.next_out = reinterpret_cast<Bytef*>( outData );
+  strm.avail_out = static_cast<uInt>( inLength );
+  while( strm.avail_out > 0 && !mStreamEnd )
+  {
+    if( !fill( 1 ) )
+      throw std_runtime_error( "Compressed data ends unexpectedly at position " << mInputPosition );
+    int result = ::inflate( &strm, mIndexComplete ? Z_NO_FLUSH : Z_BLOCK );
+    const size_t produced = inLength - strm.avail_out;
+    const long long out = mStreamPosition + produced;
+    const bool indexing = !mIndexComplete && out >= mIndexEnd;
+    if( indexing )
+      mIndexEnd = out;
+    if( result == Z_STREAM_END )
+    {
+      // the raw stream is unaware of the gzip trailer
+      if( mRawStream )
+      {
+        fill( 8 );
+        size_t skip = min<size_t>( 8, strm.avail_in );
+        strm.next_in += skip;
+        strm.avail_in -= static_cast<uInt>( skip );
+      }
+      fill( 2 );
+      if( IsMemberStart( strm.next_in, strm.avail_in ) )
+      {
+        ::inflateReset2( &strm, cGzipWindowBits );
+        mRawStream = false;
+        if( indexing )
+        {
+          Point member = { mInputPosition - strm.avail_in, out, 0, vector<unsigned char>() };
+          AddPoint( member );
+        }
+      }
+      else
+      {
+        mStreamEnd = true;
+        if( indexing )
+          CompleteIndex( out );
+      }
+    }
+    else if( result != Z_OK && result != Z_BUF_ERROR )
+      throw std_runtime_error( "Compressed data is corrupt near position " << mInputPosition );
+    else if( indexing && ( strm.data_type & 128 ) && !( strm.data_type & 64 )
+             && out - mPoints.back().out > mSpan )
+    { // at the end of a block that is not the last one
+      Point point = { mInputPosition - strm.avail_in, out, strm.data_type & 7, vector<unsigned char>( cWindowSize ) };
+      const size_t fromOutput = min( produced, cWindowSize ),
+                   fromHistory = min( cWindowSize - fromOutput, mHistory.size() );
+      ::memcpy( &point.window[ 0 ] + cWindowSize - fromOutput - fromHistory,
+                &mHistory[ 0 ] + mHistory.size() - fromHistory, fromHistory );
+      ::memcpy( &point.window[ 0 ] + cWindowSize - fromOutput, outData + produced - fromOutput, fromOutput );
+      AddPoint( point );
+    }
+  }
+  size_t count = inLength - strm.avail_out;
+  mStreamPosition += count;
+  if( count >= cHistorySize )
+    mHistory.assign( outData + count - cHistorySize, outData + count );
+  else
+  {
+    mHistory.insert( mHistory.end(), outData, outData + count );
+    if( mHistory.size() > cHistorySize )
+      mHistory.erase( mHistory.begin(), mHistory.end() - cHistorySize );
+  }
+  return count;
+}
+
+// **************************************************************************
+// Function:   CompleteIndex
+// Purpose:    Checks the size taken from the gzip trailer against the end
+//             of data, and writes the index file if there is one.
+// Parameters: end - position of the end of data
+// Returns:    N/A
+// **************************************************************************
+void
+BCI2000GzipFile::CompleteIndex( long long inEnd ) const
+{
+  if( inEnd != mSize )
+    throw std_runtime_error( "Gzip file holds " << inEnd << " bytes of data, but its trailer indicates " << mSize );
+  mIndexComplete = true;
+  if( !mIndexFile.empty() )
+    WriteIndex( mIndexFile );
+}
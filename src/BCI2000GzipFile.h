@@ -0,0 +1,128 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: Random access to the uncompressed content of a gzip file.
+//   A single pass over the file determines the uncompressed size, and
+//   records checkpoints from which decompression can be resumed.
+//   Sequential reads continue a decompression stream without seeking.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#ifndef BCI2000_GZIP_FILE_H
+#define BCI2000_GZIP_FILE_H
+
+#include <vector>
+#include <string>
+#include <mutex>
+#include <cstdio>
+
+struct z_stream_s;
+
+class BCI2000GzipFile
+{
+ public:
+  BCI2000GzipFile();
+  ~BCI2000GzipFile();
+
+ private:
+  BCI2000GzipFile( const BCI2000GzipFile& );
+  BCI2000GzipFile& operator=( const BCI2000GzipFile& );
+
+ public:
+  // Whether a file starts with the signature of a gzip member.
+  static bool IsGzip( std::FILE* );
+
+  // Prepares an open gzip file for reading. The checkpoint index is read
+  // from the index file if it matches the gzip file's size and
+  // modification time. Otherwise, the uncompressed size is taken from the
+  // gzip trailer, which is exact for single-member files under 4 GiB, and
+  // checkpoints are recorded as data are first decompressed; the index is
+  // written to the index file once decompression reaches the end of data.
+  // With an empty index file name, the index is kept in memory only.
+  // The file remains owned by the caller, and must stay open while the
+  // object is in use.
+  bool  Open( std::FILE*, const std::string& indexFile = "" );
+  void  Close();
+  bool  IsOpen() const
+        { return mpFile != NULL; }
+  // Whether the checkpoint index was read from the index file.
+  bool  IndexFromFile() const
+        { return mIndexFromFile; }
+  // Size of the uncompressed content.
+  long long Size() const
+        { return mSize; }
+
+  // Reads uncompressed content. Reads that continue at or shortly before
+  // the end of the previous read resume decompression where it stopped;
+  // other reads start at the nearest checkpoint before the requested
+  // position. Calls from multiple threads are serialized.
+  // Returns the number of bytes read; less than length at the end of data.
+  // Throws if data turn out to differ in size from the gzip trailer.
+  size_t ReadAt( long long position, char* data, size_t length ) const;
+
+ private:
+  // A position from which decompression can be resumed: the compressed
+  // and uncompressed positions, the number of bits of the byte before
+  // the compressed position that belong to the next deflate block, and the
+  // preceding 32k of uncompressed data. Points at the beginning of a gzip
+  // member have no window.
+  struct Point
+  {
+    long long in,
+              out;
+    int bits;
+    std::vector<unsigned char> window;
+  };
+  bool  SizeFromTrailer();
+  bool  BuildIndex();
+  void  AddPoint( const Point& ) const;
+  void  CompleteIndex( long long end ) const;
+  bool  ReadIndex( const std::string& );
+  void  WriteIndex( const std::string& ) const;
+  void  StartAt( const Point& ) const;
+  size_t Inflate( char* data, size_t length ) const;
+
+ private:
+  std::FILE*         mpFile;
+  long long          mFileSize,
+                     mFileTime,
+                     mSize;
+  std::string        mIndexFile;
+  bool               mIndexFromFile;
+
+  // the checkpoint index, which is extended while data are read, up to the
+  // uncompressed position mIndexEnd, until the end of data is reached
+  mutable std::vector<Point> mPoints;
+  mutable long long  mIndexEnd,
+                     mSpan;
+  mutable bool       mIndexComplete;
+
+  // the decompression stream that is continued by sequential reads
+  mutable std::mutex mMutex;
+  mutable z_stream_s* mpStream;
+  mutable std::vector<unsigned char> mInput;
+  mutable std::vector<char> mHistory;
+  mutable long long  mInputPosition,
+                     mStreamPosition;
+  mutable bool       mStreamEnd,
+                     mRawStream;
+};
+
+#endif // BCI2000_GZIP_FILE_H
@@ -0,0 +1,416 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: Receives a BCI2000 binary message stream from a local socket
+//   or pipe, and publishes signal blocks with their state vectors into a
+//   lock-free ring buffer, for online analysis of a running system.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#include "PCHIncludes.h"
+#pragma hdrstop
+
+#include "BCI2000Receiver.h"
+#include "RecordDecoder.h"
+#include "LengthField.h"
+#include "Serialization.h"
+
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <algorithm>
+
+#if !_WIN32
+# include <fcntl.h>
+# include <netdb.h>
+# include <poll.h>
+# include <unistd.h>
+# include <sys/socket.h>
+# include <sys/stat.h>
+# include <sys/un.h>
+#endif // _WIN32
+
+using namespace std;
+
+#if !_WIN32
+namespace
+{
+
+// A stream buffer reading from a file descriptor. Waiting for data is done
+// in short intervals, so the reading thread notices when it is asked to stop.
+class FdBuffer : public streambuf
+{
+ public:
+  FdBuffer( int inFd, const atomic<bool>& inStop )
+  : mFd( inFd ),
+    mStop( inStop ),
+    mBuffer( 64 * 1024 )
+  {
+  }
+
+ protected:
+  int_type underflow()
+  {
+    while( !mStop )
+    {
+      pollfd p = { mFd, POLLIN, 0 };
+      int r = ::poll( &p, 1, 100 );
+      if( r < 0 && errno != EINTR )
+        break;
+      if( r > 0 )
+      {
+        ssize_t count = ::read( mFd, &mBuffer[ 0 ], mBuffer.size() );
+        if( count < 0 && errno == EINTR )
+          continue;
+        if( count <= 0 )
+          break;
+        setg( &mBuffer[ 0 ], &mBuffer[ 0 ], &mBuffer[ 0 ] + count );
+        return traits_type::to_int_type( mBuffer[ 0 ] );
+      }
+    }
+    return traits_type::eof();
+  }
+
+ private:
+  int mFd;
+  const atomic<bool>& mStop;
+  vector<char> mBuffer;
+};
+
+int
+ConnectTCP( const string& inHost, const string& inPort )
+{
+  addrinfo hints, *pInfo = NULL;
+  ::memset( &hints, 0, sizeof( hints ) );
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  if( 0 != ::getaddrinfo( inHost.c_str(), inPort.c_str(), &hints, &pInfo ) )
+    return -1;
+  int fd = -1;
+  for( addrinfo* p = pInfo; p != NULL && fd < 0; p = p->ai_next )
+  {
+    fd = ::socket( p->ai_family, p->ai_socktype, p->ai_protocol );
+    if( fd >= 0 && 0 != ::connect( fd, p->ai_addr, p->ai_addrlen ) )
+    {
+      ::close( fd );
+      fd = -1;
+    }
+  }
+  ::freeaddrinfo( pInfo );
+  return fd;
+}
+
+int
+ConnectUnix( const string& inPath )
+{
+  sockaddr_un address;
+  if( inPath.length() >= sizeof( address.sun_path ) )
+    return -1;
+  ::memset( &address, 0, sizeof( address ) );
+  address.sun_family = AF_UNIX;
+  ::strcpy( address.sun_path, inPath.c_str() );
+  int fd = ::socket( AF_UNIX, SOCK_STREAM, 0 );
+  if( fd >= 0 && 0 != ::connect( fd, reinterpret_cast<sockaddr*>( &address ), sizeof( address ) ) )
+  {
+    ::close( fd );
+    fd = -1;
+  }
+  return fd;
+}
+
+} // namespace
+#endif // _WIN32
+
+// **************************************************************************
+// Function:   ReadSignalHeader
+// Purpose:    Reads the type and dimensions of a signal in binary format,
+//             and checks whether they are consistent with the data length.
+// Parameters: Pointer to data, data length, output arguments.
+// Returns:    True if the data is a complete signal.
+// **************************************************************************
+static bool
+ReadSignalHeader( const char* inData, size_t inLength,
+                  SignalType& outType, size_t& outChannels, size_t& outElements, size_t& outHeaderLength )
+{
+  Serialization::MemoryBuffer buffer( inData, inLength );
+  istream is( &buffer );
+  LengthField<2> channels, elements;
+  outType.ReadBinary( is );
+  channels.ReadBinary( is );
+  elements.ReadBinary( is );
+  if( !is )
+    return false;
+  outChannels = channels;
+  outElements = elements;
+  outHeaderLength = inLength - static_cast<size_t>( buffer.in_avail() );
+  return outHeaderLength + outChannels * outElements * outType.Size() == inLength;
+}
+
+BCI2000Receiver::BCI2000Receiver( size_t inCapacity )
+: mBlocks( inCapacity ),
+  mOverruns( 0 ),
+  mMessages( 0 ),
+  mHaveStateVector( false ),
+  mFd( -1 ),
+  mRunning( false ),
+  mStop( false )
+{
+}
+
+BCI2000Receiver::~BCI2000Receiver()
+{
+  Close();
+}
+
+// **************************************************************************
+// Function:   Open
+// Purpose:    Connects to a message source, and starts receiving.
+// Parameters: Address: "host:port" for TCP, "fd:n" for an open file
+//             descriptor, or the path to a named pipe or Unix socket.
+// Returns:    True if successful.
+// **************************************************************************
+bool
+BCI2000Receiver::Open( const string& inAddress )
+{
+  Close();
+#if _WIN32
+  lock_guard<mutex> lock( mMetaMutex );
+  mError = "Receiving messages is not supported on this platform";
+  return false;
+#else // _WIN32
+  int fd = -1;
+  struct stat fileStat;
+  size_t colon = inAddress.rfind( ':' );
+  if( inAddress.substr( 0, 3 ) == "fd:" )
+    fd = ::dup( ::atoi( inAddress.c_str() + 3 ) );
+  else if( 0 == ::stat( inAddress.c_str(), &fileStat ) )
+    fd = S_ISSOCK( fileStat.st_mode ) ? ConnectUnix( inAddress ) : ::open( inAddress.c_str(), O_RDONLY );
+  else if( colon != string::npos )
+    fd = ConnectTCP( inAddress.substr( 0, colon ), inAddress.substr( colon + 1 ) );
+  if( fd < 0 )
+  {
+    lock_guard<mutex> lock( mMetaMutex );
+    mError = "Could not connect to " + inAddress;
+    return false;
+  }
+  return Attach( fd );
+#endif // _WIN32
+}
+
+// **************************************************************************
+// Function:   Attach
+// Purpose:    Starts receiving from an open file descriptor.
+// Parameters: File descriptor, owned by the receiver from now on.
+// Returns:    True if successful.
+// **************************************************************************
+bool
+BCI2000Receiver::Attach( int inFd )
+{
+  Close();
+#if _WIN32
+  return false;
+#else // _WIN32
+  {
+    lock_guard<mutex> lock( mMetaMutex );
+    mError.clear();
+  }
+  mFd = inFd;
+  mStop = false;
+  mRunning = true;
+  mThread = thread( &BCI2000Receiver::Run, this );
+  return true;
+#endif // _WIN32
+}
+
+// **************************************************************************
+// Function:   Close
+// Purpose:    Stops the receiving thread, and closes the connection.
+//             Blocks received so far remain available to the consumer.
+// Parameters: N/A
+// Returns:    N/A
+// **************************************************************************
+void
+BCI2000Receiver::Close()
+{
+  mStop = true;
+  if( mThread.joinable() )
+    mThread.join();
+#if !_WIN32
+  if( mFd >= 0 )
+    ::close( mFd );
+#endif // _WIN32
+  mFd = -1;
+  mRunning = false;
+}
+
+string
+BCI2000Receiver::Error() const
+{
+  lock_guard<mutex> lock( mMetaMutex );
+  return mError;
+}
+
+ParamList
+BCI2000Receiver::Parameters() const
+{
+  lock_guard<mutex> lock( mMetaMutex );
+  return mParams;
+}
+
+StateList
+BCI2000Receiver::States() const
+{
+  lock_guard<mutex> lock( mMetaMutex );
+  return mStates;
+}
+
+void
+BCI2000Receiver::Run()
+{
+#if !_WIN32
+  FdBuffer buffer( mFd, mStop );
+  istream is( &buffer );
+  while( !mStop && ProcessMessage( is ) )
+    ;
+  if( !mStop )
+  {
+    lock_guard<mutex> lock( mMetaMutex );
+    mError = is.eof() ? "Connection closed" : "Malformed message";
+  }
+#endif // _WIN32
+  mRunning = false;
+}
+
+// **************************************************************************
+// Function:   ProcessMessage
+// Purpose:    Reads a message, and updates parameters, states, or the block
+//             buffer depending on its type. Messages of other types are
+//             skipped.
+// Parameters: Input stream.
+// Returns:    False if no complete message could be read.
+// **************************************************************************
+bool
+BCI2000Receiver::ProcessMessage( istream& is )
+{
+  int descriptor = is.get(),
+      supplement = is.get();
+  LengthField<2> lengthField;
+  if( !lengthField.ReadBinary( is ) )
+    return false;
+  size_t length = lengthField;
+  mContent.resize( length + 1 );
+  if( length > 0 && !is.read( &mContent[ 0 ], length ) )
+    return false;
+
+  Serialization::MemoryBuffer buffer( &mContent[ 0 ], length );
+  istream content( &buffer );
+  switch( descriptor )
+  {
+    case ParamMessage:
+    {
+      Param p;
+      if( p.ReadBinary( content ) )
+      {
+        lock_guard<mutex> lock( mMetaMutex );
+        mParams.Add( p );
+      }
+    } break;
+    case StateMessage:
+    {
+      class State s;
+      if( s.ReadBinary( content ) )
+      {
+        lock_guard<mutex> lock( mMetaMutex );
+        mStates.Add( s );
+      }
+    } break;
+    case StateVectorMessage:
+      mHaveStateVector = !!mStateVector.ReadBinary( content );
+      break;
+    case DataMessage:
+      if( supplement == SignalData )
+        HandleSignal( length );
+      break;
+    default:
+      break;
+  }
+  ++mMessages;
+  return true;
+}
+
+// **************************************************************************
+// Function:   HandleSignal
+// Purpose:    Decodes a signal message into the next free block, together
+//             with the most recent state vector.
+// Parameters: Message content stream, content length.
+// Returns:    True if a block was published.
+// **************************************************************************
+bool
+BCI2000Receiver::HandleSignal( size_t inLength )
+{
+  // Visualization messages prefix the signal with a null-terminated source
+  // identifier, data messages don't. A bare signal is recognized by its
+  // dimensions matching the message length.
+  const char* data = &mContent[ 0 ];
+  SignalType type;
+  size_t channels = 0, elements = 0, headerLength = 0, offset = 0;
+  if( !ReadSignalHeader( data, inLength, type, channels, elements, headerLength ) )
+  {
+    const char* p = static_cast<const char*>( ::memchr( data, '\0', inLength ) );
+    offset = p ? p - data + 1 : inLength;
+    if( !ReadSignalHeader( data + offset, inLength - offset, type, channels, elements, headerLength ) )
+      return false;
+  }
+
+  Block* pBlock = mBlocks.WriteSlot();
+  if( pBlock == NULL )
+  {
+    ++mOverruns;
+    mHaveStateVector = false;
+    return false;
+  }
+  Block& b = *pBlock;
+  b.sourceID.assign( data, offset > 0 ? offset - 1 : 0 );
+  b.channels = static_cast<int>( channels );
+  b.elements = static_cast<int>( elements );
+  b.signal.resize( channels * elements );
+  if( !b.signal.empty()
+      && !RecordDecoder::DecodeValues( type, data + offset + headerLength, b.signal.size(), &b.signal[ 0 ] ) )
+    return false;
+
+  // A state vector carries one sample more than the signal block; copy one
+  // state vector per element, repeating the last one if there are fewer.
+  b.stateVectorLength = 0;
+  b.states.clear();
+  if( mHaveStateVector && mStateVector.Samples() > 0 && mStateVector.Length() > 0 )
+  {
+    size_t svLength = mStateVector.Length();
+    b.stateVectorLength = static_cast<int>( svLength );
+    b.states.resize( elements * svLength );
+    for( size_t i = 0; i < elements; ++i )
+    {
+      int sample = min<int>( static_cast<int>( i ), mStateVector.Samples() - 1 );
+      ::memcpy( &b.states[ i * svLength ], mStateVector( sample ).Data(), svLength );
+    }
+  }
+  mHaveStateVector = false;
+  mBlocks.Publish();
+  return true;
+}
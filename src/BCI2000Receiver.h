@@ -0,0 +1,140 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: Receives a BCI2000 binary message stream from a local socket
+//   or pipe, and publishes signal blocks with their state vectors into a
+//   lock-free ring buffer, for online analysis of a running system.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#ifndef BCI2000_RECEIVER_H
+#define BCI2000_RECEIVER_H
+
+#include "ParamList.h"
+#include "StateList.h"
+#include "StateVector.h"
+#include "GenericSignal.h"
+#include "SPSCRingBuffer.h"
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+class BCI2000Receiver
+{
+ public:
+  static const size_t cDefaultCapacity = 256;
+
+  // Message descriptors of the BCI2000 protocol.
+  enum
+  {
+    ProtocolVersionMessage = 0,
+    StatusMessage = 1,
+    ParamMessage = 2,
+    StateMessage = 3,
+    DataMessage = 4,
+    StateVectorMessage = 5,
+    SysCommandMessage = 6,
+  };
+  // Supplements of data messages.
+  enum
+  {
+    SignalData = 1,
+    SignalPropertiesData = 3,
+  };
+
+  // A signal block, and the state vectors for its samples.
+  struct Block
+  {
+    std::string sourceID;
+    int channels,
+        elements;
+    // signal[ channel * elements + element ]
+    std::vector<GenericSignal::ValueType> signal;
+    // one state vector of stateVectorLength bytes per element, or empty if
+    // no state vector preceded the signal
+    int stateVectorLength;
+    std::vector<unsigned char> states;
+  };
+
+ public:
+  explicit BCI2000Receiver( size_t capacity = cDefaultCapacity );
+  ~BCI2000Receiver();
+
+ private:
+  BCI2000Receiver( const BCI2000Receiver& );
+  BCI2000Receiver& operator=( const BCI2000Receiver& );
+
+ public:
+  // Connects to an address, and starts receiving in a background thread.
+  //  "host:port" connects to a TCP port, "fd:n" reads from an open file
+  //  descriptor; anything else is a path to a named pipe or Unix socket.
+  bool  Open( const std::string& address );
+  // Starts receiving from an open file descriptor. The receiver takes
+  // ownership of the descriptor.
+  bool  Attach( int fd );
+  void  Close();
+  bool  IsRunning() const
+        { return mRunning; }
+  std::string Error() const;
+
+  // Consumer side. Blocks must be drained by a single thread.
+  SPSCRingBuffer<Block>& Blocks()
+        { return mBlocks; }
+  // Number of blocks dropped because the consumer fell behind.
+  long long Overruns() const
+        { return mOverruns; }
+  long long Messages() const
+        { return mMessages; }
+  // Copies of the parameters and states received so far.
+  ParamList Parameters() const;
+  StateList States() const;
+
+  // Reads and handles a single message. Used by the receiving thread, and
+  // for processing a message stream synchronously.
+  bool  ProcessMessage( std::istream& );
+
+ private:
+  void  Run();
+  bool  HandleSignal( size_t contentLength );
+
+  SPSCRingBuffer<Block> mBlocks;
+  std::atomic<long long> mOverruns,
+                         mMessages;
+
+  mutable std::mutex mMetaMutex;
+  ParamList mParams;
+  StateList mStates;
+  std::string mError;
+
+  std::vector<char> mContent;
+  StateVector mStateVector;
+  bool mHaveStateVector;
+
+  int mFd;
+  std::thread mThread;
+  std::atomic<bool> mRunning,
+                    mStop;
+};
+
+#endif // BCI2000_RECEIVER_H
@@ -0,0 +1,126 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: Loading and storing little endian values, as used in BCI2000
+//   data files and messages. The host byte order is known at compile time,
+//   so conversions compile into plain loads and stores on little endian
+//   machines, and into byte swap instructions otherwise.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#ifndef BYTE_ORDER_H
+#define BYTE_ORDER_H
+
+#include "defines.h"
+#include <cstring>
+#include <cstddef>
+#include <stdint.h>
+#if _MSC_VER
+# include <stdlib.h>
+#endif // _MSC_VER
+
+// **************************************************************************
+// Function:   SwapBytes
+// Purpose:    Reverses the byte order of an unsigned integer.
+// Parameters: Value.
+// Returns:    Byte-swapped value.
+// **************************************************************************
+#if defined( __GNUC__ ) || defined( __clang__ )
+inline uint16_t SwapBytes( uint16_t x ) { return __builtin_bswap16( x ); }
+inline uint32_t SwapBytes( uint32_t x ) { return __builtin_bswap32( x ); }
+inline uint64_t SwapBytes( uint64_t x ) { return __builtin_bswap64( x ); }
+#elif defined( _MSC_VER )
+inline uint16_t SwapBytes( uint16_t x ) { return _byteswap_ushort( x ); }
+inline uint32_t SwapBytes( uint32_t x ) { return _byteswap_ulong( x ); }
+inline uint64_t SwapBytes( uint64_t x ) { return _byteswap_uint64( x ); }
+#else
+inline uint16_t SwapBytes( uint16_t x ) { return uint16_t( x << 8 | x >> 8 ); }
+inline uint32_t SwapBytes( uint32_t x )
+{ return x << 24 | ( ( x & 0xff00 ) << 8 ) | ( ( x >> 8 ) & 0xff00 ) | x >> 24; }
+inline uint64_t SwapBytes( uint64_t x )
+{ return uint64_t( SwapBytes( uint32_t( x ) ) ) << 32 | SwapBytes( uint32_t( x >> 32 ) ); }
+#endif
+
+// **************************************************************************
+// Function:   LoadLittleEndian<T>
+// Purpose:    Reads an unsigned integer stored in little endian byte order.
+//             The byte order test is a compile-time constant, so only one
+//             of the branches is compiled.
+// Parameters: Pointer into memory buffer.
+// Returns:    Data value.
+// **************************************************************************
+template<typename T>
+inline T
+LoadLittleEndian( const char* p )
+{
+  T t;
+  ::memcpy( &t, p, sizeof( T ) );
+  return HostOrder == LittleEndian ? t : SwapBytes( t );
+}
+
+// **************************************************************************
+// Function:   StoreLittleEndian<T>
+// Purpose:    Writes an unsigned integer in little endian byte order.
+// Parameters: Pointer into memory buffer, data value.
+// Returns:    N/A
+// **************************************************************************
+template<typename T>
+inline void
+StoreLittleEndian( char* p, T t )
+{
+  if( HostOrder != LittleEndian )
+    t = SwapBytes( t );
+  ::memcpy( p, &t, sizeof( T ) );
+}
+
+// **************************************************************************
+// Function:   LoadLittleEndian
+// Purpose:    Reads up to 8 bytes as a little endian unsigned integer.
+// Parameters: Pointer into memory buffer, number of bytes.
+// Returns:    Data value.
+// **************************************************************************
+inline uint64_t
+LoadLittleEndian( const unsigned char* p, size_t inBytes )
+{
+  if( inBytes == sizeof( uint64_t ) )
+    return LoadLittleEndian<uint64_t>( reinterpret_cast<const char*>( p ) );
+  uint64_t result = 0;
+  for( size_t i = 0; i < inBytes; ++i )
+    result |= uint64_t( p[ i ] ) << ( 8 * i );
+  return result;
+}
+
+// **************************************************************************
+// Function:   StoreLittleEndian
+// Purpose:    Writes the lower bytes of an unsigned integer in little endian
+//             byte order.
+// Parameters: Pointer into memory buffer, number of bytes, data value.
+// Returns:    N/A
+// **************************************************************************
+inline void
+StoreLittleEndian( unsigned char* p, size_t inBytes, uint64_t inValue )
+{
+  if( inBytes == sizeof( uint64_t ) )
+    return StoreLittleEndian<uint64_t>( reinterpret_cast<char*>( p ), inValue );
+  for( size_t i = 0; i < inBytes; ++i )
+    p[ i ] = static_cast<unsigned char>( inValue >> ( 8 * i ) );
+}
+
+#endif // BYTE_ORDER_H
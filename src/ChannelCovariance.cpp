@@ -0,0 +1,230 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: Channel means and covariances, accumulated over chunks of
+//   samples in a single pass, optionally per condition, e.g. per value of a
+//   state. Accumulators of adjacent sample ranges can be merged.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#include "PCHIncludes.h"
+#pragma hdrstop
+
+#include "ChannelCovariance.h"
+#include "BCIException.h"
+
+#include <algorithm>
+
+using namespace std;
+
+double
+ChannelCovariance::Condition::Covariance( int inA, int inB ) const
+{
+  const size_t C = mean.size();
+  if( inA > inB )
+    swap( inA, inB );
+  return count > 1 ? m2[ inA * C + inB ] / ( count - 1 ) : 0;
+}
+
+ChannelCovariance::ChannelCovariance( int inChannels, bool inConditions )
+: mChannels( inChannels ),
+  mUseConditions( inConditions )
+{
+  if( inChannels < 0 )
+    throw std_range_error( "Negative number of channels: " << inChannels );
+}
+
+void
+ChannelCovariance::Add( const BCI2000FileScanner::Chunk& inChunk )
+{
+  Add( inChunk.count, inChunk.signal, inChunk.signalStride, mUseConditions ? inChunk.states : NULL );
+}
+
+// **************************************************************************
+// Function:   Add
+// Purpose:    Splits samples into runs of equal condition, and the runs into
+//             tiles, which are added to their condition.
+// Parameters: count - number of samples
+//             signal - column-major signal array
+//             signalStride - distance between channels in the signal array
+//             conditions - condition values, or NULL
+// Returns:    N/A
+// **************************************************************************
+void
+ChannelCovariance::Add( long long inCount, const double* inSignal, size_t inSignalStride,
+                        const double* inConditions )
+{
+  const size_t C = mChannels;
+  mTile.resize( cTileSamples * C + 1 );
+  for( long long begin = 0, end = 0; begin < inCount; begin = end )
+  {
+    const double condition = inConditions ? inConditions[ begin ] : 0;
+    end = begin + 1;
+    while( end < inCount && inConditions && inConditions[ end ] == condition )
+      ++end;
+    if( !inConditions )
+      end = inCount;
+    Condition& c = mConditions[ condition ];
+    if( c.mean.empty() )
+    {
+      c.count = 0;
+      c.mean.resize( C );
+      c.m2.resize( C * C );
+    }
+    for( long long first = begin; first < end; first += cTileSamples )
+    {
+      const int count = static_cast<int>( min<long long>( cTileSamples, end - first ) );
+      for( int t = 0; t < count; ++t )
+        for( size_t ch = 0; ch < C; ++ch )
+          mTile[ t * C + ch ] = inSignal[ ch * inSignalStride + first + t ];
+      AddTile( c, count );
+    }
+  }
+}
+
+// **************************************************************************
+// Function:   AddTile
+// Purpose:    Centers the tile on its mean, and adds its cross products for
+//             pairs of channel blocks on and above the diagonal. Four
+//             samples are added per pass over a block, so each matrix
+//             element is loaded and stored once per four samples, and the
+//             innermost loop runs over consecutive channels.
+// Parameters: condition - condition to add to
+//             count - number of samples in the tile
+// Returns:    N/A
+// **************************************************************************
+void
+ChannelCovariance::AddTile( Condition& ioCondition, int inCount )
+{
+  const int C = mChannels;
+  Condition& tile = mTileSums;
+  tile.count = inCount;
+  tile.mean.assign( C, 0.0 );
+  tile.m2.assign( static_cast<size_t>( C ) * C, 0.0 );
+  double* mean = &tile.mean[ 0 ];
+  for( int t = 0; t < inCount; ++t )
+    for( int ch = 0; ch < C; ++ch )
+      mean[ ch ] += mTile[ t * C + ch ];
+  for( int ch = 0; ch < C; ++ch )
+    mean[ ch ] /= inCount;
+  for( int t = 0; t < inCount; ++t )
+    for( int ch = 0; ch < C; ++ch )
+      mTile[ t * C + ch ] -= mean[ ch ];
+
+  double* m2 = &tile.m2[ 0 ];
+  for( int a0 = 0; a0 < C; a0 += cBlockChannels )
+    for( int b0 = a0; b0 < C; b0 += cBlockChannels )
+    {
+      const int a1 = min( a0 + cBlockChannels, C ),
+                b1 = min( b0 + cBlockChannels, C );
+      int t = 0;
+      for( ; t + 4 <= inCount; t += 4 )
+      {
+        const double* x0 = &mTile[ t * C ],
+                    * x1 = x0 + C,
+                    * x2 = x1 + C,
+                    * x3 = x2 + C;
+        for( int a = a0; a < a1; ++a )
+        {
+          const double y0 = x0[ a ], y1 = x1[ a ], y2 = x2[ a ], y3 = x3[ a ];
+          double* row = m2 + a * C;
+          for( int b = max( a, b0 ); b < b1; ++b )
+            row[ b ] += ( y0 * x0[ b ] + y1 * x1[ b ] ) + ( y2 * x2[ b ] + y3 * x3[ b ] );
+        }
+      }
+      for( ; t < inCount; ++t )
+      {
+        const double* x = &mTile[ t * C ];
+        for( int a = a0; a < a1; ++a )
+        {
+          double* row = m2 + a * C;
+          for( int b = max( a, b0 ); b < b1; ++b )
+            row[ b ] += x[ a ] * x[ b ];
+        }
+      }
+    }
+  Merge( ioCondition, tile );
+}
+
+void
+ChannelCovariance::Merge( const ChannelCovariance& inOther )
+{
+  for( ConditionMap::const_iterator i = inOther.mConditions.begin(); i != inOther.mConditions.end(); ++i )
+  {
+    ConditionMap::iterator j = mConditions.find( i->first );
+    if( j == mConditions.end() )
+      mConditions[ i->first ] = i->second;
+    else
+      Merge( j->second, i->second );
+  }
+}
+
+// **************************************************************************
+// Function:   Merge
+// Purpose:    Combines means and sums of products with the pairwise update
+//             of Chan et al.:
+//             M2 = M2a + M2b + d d^T na nb / n, with d = mean_b - mean_a.
+// Parameters: a - sums of the first set of samples, updated
+//             b - sums of the second set of samples
+// Returns:    N/A
+// **************************************************************************
+void
+ChannelCovariance::Merge( Condition& ioA, const Condition& inB ) const
+{
+  if( inB.count == 0 )
+    return;
+  if( ioA.count == 0 )
+  {
+    ioA = inB;
+    return;
+  }
+  const int C = mChannels;
+  const double n = static_cast<double>( ioA.count + inB.count ),
+               weight = static_cast<double>( ioA.count ) * inB.count / n;
+  vector<double> delta( C );
+  for( int ch = 0; ch < C; ++ch )
+    delta[ ch ] = inB.mean[ ch ] - ioA.mean[ ch ];
+  for( int a = 0; a < C; ++a )
+  {
+    double* row = &ioA.m2[ a * C ];
+    const double* other = &inB.m2[ a * C ];
+    const double d = delta[ a ] * weight;
+    for( int b = a; b < C; ++b )
+      row[ b ] += other[ b ] + d * delta[ b ];
+  }
+  for( int ch = 0; ch < C; ++ch )
+    ioA.mean[ ch ] += delta[ ch ] * inB.count / n;
+  ioA.count += inB.count;
+}
+
+ChannelCovariance::Condition
+ChannelCovariance::Calibrate( const Condition& inRaw, const vector<double>& inOffsets,
+                              const vector<double>& inGains )
+{
+  Condition c = inRaw;
+  const size_t C = inRaw.mean.size();
+  for( size_t a = 0; a < C; ++a )
+  {
+    c.mean[ a ] = ( inRaw.mean[ a ] - inOffsets[ a ] ) * inGains[ a ];
+    for( size_t b = a; b < C; ++b )
+      c.m2[ a * C + b ] = inRaw.m2[ a * C + b ] * inGains[ a ] * inGains[ b ];
+  }
+  return c;
+}
@@ -0,0 +1,91 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: Channel means and covariances, accumulated over chunks of
+//   samples in a single pass, optionally per condition, e.g. per value of a
+//   state. Accumulators of adjacent sample ranges can be merged.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#ifndef CHANNEL_COVARIANCE_H
+#define CHANNEL_COVARIANCE_H
+
+#include "BCI2000FileScanner.h"
+
+#include <vector>
+#include <map>
+
+// Samples are collected into tiles of cTileSamples samples, with channels
+// innermost. Each tile is centered on its own mean, and its cross products
+// are added in blocks of cBlockChannels channels, so the part of the
+// matrix being updated stays in cache while the tile is traversed. Tile
+// sums are combined with the pairwise update of Chan et al., which keeps
+// covariances accurate when means are large compared to deviations.
+// As an accumulator for BCI2000FileScanner::Scan(), conditions are taken
+// from the first state of chunks when conditions are enabled.
+class ChannelCovariance
+{
+ public:
+  static const int cTileSamples = 256,
+                   cBlockChannels = 64;
+
+  struct Condition
+  {
+    long long count;
+    std::vector<double> mean,
+                        m2; // sums of products of deviations, upper triangle
+                            // of a row-major matrix
+
+    // Covariance of channels a and b.
+    double Covariance( int a, int b ) const;
+  };
+  typedef std::map<double, Condition> ConditionMap;
+
+  ChannelCovariance( int channels, bool conditions );
+
+  int Channels() const
+    { return mChannels; }
+  const ConditionMap& Conditions() const
+    { return mConditions; }
+
+  void Add( const BCI2000FileScanner::Chunk& );
+  void Merge( const ChannelCovariance& );
+  // Adds count samples, with values of channel ch at
+  // signal[ ch * signalStride + i ], and a condition value per sample, or
+  // NULL for a single condition 0.
+  void Add( long long count, const double* signal, size_t signalStride, const double* conditions );
+
+  // Means and sums of products of calibrated values, computed from those
+  // of raw values.
+  static Condition Calibrate( const Condition&, const std::vector<double>& offsets,
+                              const std::vector<double>& gains );
+
+ private:
+  void AddTile( Condition&, int count );
+  void Merge( Condition&, const Condition& ) const;
+
+  int mChannels;
+  bool mUseConditions;
+  std::vector<double> mTile;
+  Condition mTileSums;
+  ConditionMap mConditions;
+};
+
+#endif // CHANNEL_COVARIANCE_H
@@ -0,0 +1,216 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: Per-channel summary statistics, accumulated over chunks of
+//   samples in a single pass: extrema, mean, variance, counts of values at
+//   the limits of the data type, and runs of constant values. Statistics of
+//   adjacent sample ranges can be merged.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#include "PCHIncludes.h"
+#pragma hdrstop
+
+#include "ChannelStatistics.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+ChannelStatistics::ChannelStatistics( int inChannels, double inClipLow, double inClipHigh )
+: mClipLow( inClipLow ),
+  mClipHigh( inClipHigh ),
+  mChannels( inChannels )
+{
+  Channel empty = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+  for( size_t ch = 0; ch < mChannels.size(); ++ch )
+    mChannels[ ch ] = empty;
+}
+
+ChannelStatistics&
+ChannelStatistics::EnableQuantiles( double inCompression )
+{
+  mSketches.assign( mChannels.size(), QuantileSketch( inCompression ) );
+  return *this;
+}
+
+void
+ChannelStatistics::Add( const BCI2000FileScanner::Chunk& inChunk )
+{
+  for( size_t ch = 0; ch < mChannels.size(); ++ch )
+    Add( static_cast<int>( ch ), inChunk.signal + ch * inChunk.signalStride, inChunk.count );
+}
+
+// **************************************************************************
+// Function:   Add
+// Purpose:    Computes statistics of a block of values, and merges them
+//             into the channel's statistics. Sums are accumulated in four
+//             independent partial sums, so the loops vectorize without
+//             reordering floating point operations; the sum of squares is
+//             taken about the block mean in a second pass over the block,
+//             which is in cache.
+// Parameters: channel - channel index
+//             values - array of values
+//             count - number of values
+// Returns:    N/A
+// **************************************************************************
+void
+ChannelStatistics::Add( int inChannel, const double* inValues, long long inCount )
+{
+  if( inCount <= 0 )
+    return;
+  const double* x = inValues;
+  double mn = x[ 0 ], mx = x[ 0 ],
+         s[ 4 ] = { 0, 0, 0, 0 };
+  long long low = 0, high = 0;
+  long long i = 0;
+  for( ; i + 4 <= inCount; i += 4 )
+    for( int k = 0; k < 4; ++k )
+    {
+      const double v = x[ i + k ];
+      s[ k ] += v;
+      mn = v < mn ? v : mn;
+      mx = v > mx ? v : mx;
+      low += v <= mClipLow;
+      high += v >= mClipHigh;
+    }
+  for( ; i < inCount; ++i )
+  {
+    const double v = x[ i ];
+    s[ 0 ] += v;
+    mn = v < mn ? v : mn;
+    mx = v > mx ? v : mx;
+    low += v <= mClipLow;
+    high += v >= mClipHigh;
+  }
+  const double mean = ( ( s[ 0 ] + s[ 1 ] ) + ( s[ 2 ] + s[ 3 ] ) ) / inCount;
+  double q[ 4 ] = { 0, 0, 0, 0 };
+  for( i = 0; i + 4 <= inCount; i += 4 )
+    for( int k = 0; k < 4; ++k )
+    {
+      const double d = x[ i + k ] - mean;
+      q[ k ] += d * d;
+    }
+  for( ; i < inCount; ++i )
+  {
+    const double d = x[ i ] - mean;
+    q[ 0 ] += d * d;
+  }
+
+  Channel c;
+  c.count = inCount;
+  c.min = mn;
+  c.max = mx;
+  c.mean = mean;
+  c.m2 = ( q[ 0 ] + q[ 1 ] ) + ( q[ 2 ] + q[ 3 ] );
+  c.clippedLow = low;
+  c.clippedHigh = high;
+  c.first = x[ 0 ];
+  c.last = x[ inCount - 1 ];
+  long long run = 1;
+  c.leadingRun = 0;
+  c.longestRun = 1;
+  for( i = 1; i < inCount; ++i )
+  {
+    if( x[ i ] == x[ i - 1 ] )
+      ++run;
+    else
+    {
+      if( c.leadingRun == 0 )
+        c.leadingRun = run;
+      run = 1;
+    }
+    c.longestRun = max( c.longestRun, run );
+  }
+  if( c.leadingRun == 0 )
+    c.leadingRun = run;
+  c.trailingRun = run;
+  Merge( mChannels[ inChannel ], c );
+  if( !mSketches.empty() )
+    mSketches[ inChannel ].Add( inValues, inCount );
+}
+
+void
+ChannelStatistics::Merge( const ChannelStatistics& inOther )
+{
+  for( size_t ch = 0; ch < mChannels.size(); ++ch )
+    Merge( mChannels[ ch ], inOther.mChannels[ ch ] );
+  for( size_t ch = 0; ch < mSketches.size() && ch < inOther.mSketches.size(); ++ch )
+    mSketches[ ch ].Merge( inOther.mSketches[ ch ] );
+}
+
+// **************************************************************************
+// Function:   Merge
+// Purpose:    Merges statistics of the range that immediately follows.
+//             Means and sums of squared deviations are combined with the
+//             pairwise update of Chan et al.; runs of constant values
+//             continue across the boundary when the values at both sides
+//             are equal.
+// Parameters: a - statistics of the first range, updated
+//             b - statistics of the second range
+// Returns:    N/A
+// **************************************************************************
+void
+ChannelStatistics::Merge( Channel& ioA, const Channel& inB )
+{
+  if( inB.count == 0 )
+    return;
+  if( ioA.count == 0 )
+  {
+    ioA = inB;
+    return;
+  }
+  const double n = static_cast<double>( ioA.count + inB.count ),
+               delta = inB.mean - ioA.mean;
+  ioA.m2 += inB.m2 + delta * delta * ioA.count * inB.count / n;
+  ioA.mean += delta * inB.count / n;
+  ioA.min = min( ioA.min, inB.min );
+  ioA.max = max( ioA.max, inB.max );
+  ioA.clippedLow += inB.clippedLow;
+  ioA.clippedHigh += inB.clippedHigh;
+
+  const bool joined = ioA.last == inB.first;
+  long long longest = max( ioA.longestRun, inB.longestRun );
+  if( joined )
+    longest = max( longest, ioA.trailingRun + inB.leadingRun );
+  if( joined && ioA.leadingRun == ioA.count )
+    ioA.leadingRun += inB.leadingRun;
+  if( joined && inB.trailingRun == inB.count )
+    ioA.trailingRun += inB.trailingRun;
+  else
+    ioA.trailingRun = inB.trailingRun;
+  ioA.longestRun = longest;
+  ioA.last = inB.last;
+  ioA.count += inB.count;
+}
+
+ChannelStatistics::Channel
+ChannelStatistics::Calibrate( const Channel& inRaw, double inOffset, double inGain )
+{
+  Channel c = inRaw;
+  c.min = ( ( inGain < 0 ? inRaw.max : inRaw.min ) - inOffset ) * inGain;
+  c.max = ( ( inGain < 0 ? inRaw.min : inRaw.max ) - inOffset ) * inGain;
+  c.mean = ( inRaw.mean - inOffset ) * inGain;
+  c.m2 = inRaw.m2 * inGain * inGain;
+  c.first = ( inRaw.first - inOffset ) * inGain;
+  c.last = ( inRaw.last - inOffset ) * inGain;
+  return c;
+}
@@ -0,0 +1,96 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: Per-channel summary statistics, accumulated over chunks of
+//   samples in a single pass: extrema, mean, variance, counts of values at
+//   the limits of the data type, runs of constant values, and optionally
+//   quantile sketches. Statistics of adjacent sample ranges can be merged.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#ifndef CHANNEL_STATISTICS_H
+#define CHANNEL_STATISTICS_H
+
+#include "BCI2000FileScanner.h"
+#include "QuantileSketch.h"
+
+#include <vector>
+
+class ChannelStatistics
+{
+ public:
+  struct Channel
+  {
+    long long count;
+    double min,
+           max,
+           mean,
+           m2; // sum of squared deviations from the mean
+    // number of values at or beyond the clipping limits
+    long long clippedLow,
+              clippedHigh;
+    // runs of identical consecutive values: at the beginning and end of
+    // the range, and the longest one
+    double first,
+           last;
+    long long leadingRun,
+              trailingRun,
+              longestRun;
+
+    double Variance() const
+      { return count > 1 ? m2 / ( count - 1 ) : 0; }
+    double MeanSquare() const
+      { return count > 0 ? mean * mean + m2 / count : 0; }
+  };
+
+  // Values at or below clipLow, or at or above clipHigh, count as clipped.
+  ChannelStatistics( int channels, double clipLow, double clipHigh );
+
+  int Channels() const
+    { return static_cast<int>( mChannels.size() ); }
+  const Channel& operator[]( int ch ) const
+    { return mChannels[ ch ]; }
+  // Maintains a quantile sketch per channel; disabled by default, as
+  // sketches cost more than the other statistics together.
+  ChannelStatistics& EnableQuantiles( double compression = QuantileSketch::cDefaultCompression );
+  bool QuantilesEnabled() const
+    { return !mSketches.empty(); }
+  const QuantileSketch& Quantiles( int ch ) const
+    { return mSketches[ ch ]; }
+
+  void Add( const BCI2000FileScanner::Chunk& );
+  void Merge( const ChannelStatistics& );
+  // Adds count values of a single channel.
+  void Add( int channel, const double* values, long long count );
+
+  // Statistics of calibrated values, computed from statistics of raw
+  // values.
+  static Channel Calibrate( const Channel&, double offset, double gain );
+
+ private:
+  static void Merge( Channel&, const Channel& );
+
+  double mClipLow,
+         mClipHigh;
+  std::vector<Channel> mChannels;
+  std::vector<QuantileSketch> mSketches;
+};
+
+#endif // CHANNEL_STATISTICS_H
@@ -0,0 +1,264 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: Downsampling of multichannel signals by an integer factor.
+//   Signals are low-pass filtered before downsampling, so frequencies above
+//   the new Nyquist frequency do not alias. States are downsampled without
+//   filtering. Both process signals in blocks of any size, keeping their
+//   state from one block to the next.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#include "PCHIncludes.h"
+#pragma hdrstop
+
+#include "Decimator.h"
+#include "BCIException.h"
+#include "NumericConstants.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+// **************************************************************************
+// Function:   Decimator
+// Purpose:    Designs the anti-aliasing filter as a Hamming windowed sinc
+//             function. The cutoff is at 80% of the new Nyquist frequency,
+//             so the transition band ends near the new Nyquist frequency.
+//             Coefficients are normalized to unit gain at zero frequency.
+// Parameters: factor - decimation factor
+//             channels - number of channels
+// **************************************************************************
+Decimator::Decimator( int inFactor, int inChannels )
+: mFactor( inFactor ),
+  mChannels( inChannels ),
+  mCenter( inFactor > 1 ? cHalfLength * inFactor : 0 )
+{
+  if( inFactor < 1 )
+    throw std_range_error( "Decimation factor must be at least 1, is " << inFactor );
+  if( inChannels < 0 )
+    throw std_range_error( "Negative number of channels: " << inChannels );
+
+  const int length = 2 * mCenter + 1;
+  const double cutoff = 0.4 / inFactor; // in cycles per input sample
+  mCoefficients.resize( length );
+  double sum = 0;
+  for( int k = 0; k < length; ++k )
+  {
+    const double t = k - mCenter,
+                 sinc = t == 0 ? 2 * cutoff : ::sin( 2 * Pi() * cutoff * t ) / ( Pi() * t ),
+                 window = 0.54 - 0.46 * ::cos( 2 * Pi() * k / ( length - 1 ) );
+    mCoefficients[ k ] = length > 1 ? sinc * window : 1;
+    sum += mCoefficients[ k ];
+  }
+  for( int k = 0; k < length; ++k )
+    mCoefficients[ k ] /= sum;
+  mSums.resize( mChannels );
+  Reset();
+}
+
+void
+Decimator::Reset()
+{
+  mBuffer.clear();
+  mBufferBegin = 0;
+  mReceived = 0;
+  mNextOutput = 0;
+}
+
+// **************************************************************************
+// Function:   Process
+// Purpose:    Appends input samples to the buffer, and computes output
+//             samples whose filter window is complete. Before the first
+//             input sample, the signal is extended with its first value.
+// Parameters: input - input array
+//             inputStride - distance between channels in the input array
+//             count - number of input samples
+//             output - output array
+//             outputStride - distance between channels in the output array
+// Returns:    Number of output samples written.
+// **************************************************************************
+long long
+Decimator::Process( const double* inInput, size_t inInputStride, long long inCount,
+                    double* outOutput, size_t inOutputStride )
+{
+  if( inCount <= 0 || mChannels == 0 )
+    return 0;
+  const size_t C = mChannels;
+  if( mReceived == 0 )
+  {
+    mBufferBegin = -mCenter;
+    mBuffer.resize( mCenter * C );
+    for( int i = 0; i < mCenter; ++i )
+      for( size_t ch = 0; ch < C; ++ch )
+        mBuffer[ i * C + ch ] = inInput[ ch * inInputStride ];
+  }
+  // channels are interleaved, so the filter loop runs across channels
+  const size_t previous = mBuffer.size();
+  mBuffer.resize( previous + inCount * C );
+  double* p = &mBuffer[ previous ];
+  for( long long i = 0; i < inCount; ++i )
+    for( size_t ch = 0; ch < C; ++ch )
+      *p++ = inInput[ ch * inInputStride + i ];
+  mReceived += inCount;
+  return Emit( outOutput, inOutputStride );
+}
+
+// **************************************************************************
+// Function:   Flush
+// Purpose:    Extends the signal with its last value, and computes the
+//             remaining output samples.
+// Parameters: output - output array
+//             outputStride - distance between channels in the output array
+// Returns:    Number of output samples written.
+// **************************************************************************
+long long
+Decimator::Flush( double* outOutput, size_t inOutputStride )
+{
+  if( mReceived == 0 || mChannels == 0 )
+    return 0;
+  const size_t C = mChannels,
+               previous = mBuffer.size();
+  mBuffer.resize( previous + mCenter * C );
+  for( int i = 0; i < mCenter; ++i )
+    for( size_t ch = 0; ch < C; ++ch )
+      mBuffer[ previous + i * C + ch ] = mBuffer[ previous - C + ch ];
+  long long count = Emit( outOutput, inOutputStride );
+  Reset();
+  return count;
+}
+
+// **************************************************************************
+// Function:   Emit
+// Purpose:    Computes output samples for which the buffer holds the
+//             filter window, and removes input that is no longer needed.
+//             Outputs are restricted to input samples received, so the
+//             samples appended by Flush() only serve as filter input.
+// Parameters: output - output array
+//             outputStride - distance between channels in the output array
+// Returns:    Number of output samples written.
+// **************************************************************************
+long long
+Decimator::Emit( double* outOutput, size_t inOutputStride )
+{
+  const size_t C = mChannels,
+               length = mCoefficients.size();
+  const long long bufferEnd = mBufferBegin + static_cast<long long>( mBuffer.size() / C );
+  long long count = 0;
+  for( long long center = mNextOutput * mFactor;
+       center + mCenter < bufferEnd && center < mReceived;
+       center = ++mNextOutput * mFactor )
+  {
+    const double* window = &mBuffer[ ( center - mCenter - mBufferBegin ) * C ];
+    double* sums = &mSums[ 0 ];
+    for( size_t ch = 0; ch < C; ++ch )
+      sums[ ch ] = 0;
+    for( size_t k = 0; k < length; ++k )
+    {
+      const double h = mCoefficients[ k ];
+      const double* x = window + k * C;
+      for( size_t ch = 0; ch < C; ++ch )
+        sums[ ch ] += h * x[ ch ];
+    }
+    for( size_t ch = 0; ch < C; ++ch )
+      outOutput[ ch * inOutputStride + count ] = sums[ ch ];
+    ++count;
+  }
+  // keep the window of the next output sample
+  long long keep = min( mNextOutput * mFactor - mCenter, bufferEnd ) - mBufferBegin;
+  if( keep > 0 )
+  {
+    mBuffer.erase( mBuffer.begin(), mBuffer.begin() + keep * C );
+    mBufferBegin += keep;
+  }
+  return count;
+}
+
+StateDecimator::StateDecimator( int inFactor, int inStates, Mode inMode )
+: mFactor( inFactor ),
+  mMode( inMode ),
+  mPrevious( inStates )
+{
+  if( inFactor < 1 )
+    throw std_range_error( "Decimation factor must be at least 1, is " << inFactor );
+  Reset();
+}
+
+void
+StateDecimator::Reset()
+{
+  mReceived = 0;
+}
+
+// **************************************************************************
+// Function:   Process
+// Purpose:    Downsamples states. An output sample represents the input
+//             samples from its own up to the next output sample's.
+//             In AnyChange mode, each block must begin an interval.
+// Parameters: input - input array
+//             inputStride - distance between states in the input array
+//             count - number of input samples
+//             output - output array
+//             outputStride - distance between states in the output array
+// Returns:    Number of output samples written.
+// **************************************************************************
+long long
+StateDecimator::Process( const double* inInput, size_t inInputStride, long long inCount,
+                         double* outOutput, size_t inOutputStride )
+{
+  // input index of the first output sample within this block
+  const long long first = ( mFactor - mReceived % mFactor ) % mFactor,
+                  count = first < inCount ? ( inCount - first + mFactor - 1 ) / mFactor : 0;
+  if( mMode == AnyChange && first != 0 )
+    throw std_logic_error( "State decimation blocks must hold a multiple of " << mFactor << " samples" );
+  for( size_t s = 0; s < mPrevious.size(); ++s )
+  {
+    const double* in = inInput + s * inInputStride;
+    double* out = outOutput + s * inOutputStride;
+    if( mMode == Hold )
+    {
+      for( long long m = 0; m < count; ++m )
+        out[ m ] = in[ first + m * mFactor ];
+      continue;
+    }
+    // the first interval is compared against its own first value
+    double& previous = mPrevious[ s ];
+    if( mReceived == 0 && inCount > 0 )
+      previous = in[ 0 ];
+    for( long long m = 0; m < count; ++m )
+    {
+      const long long begin = m * mFactor,
+                      end = min( begin + mFactor, inCount );
+      double value = in[ begin ];
+      if( value == previous )
+        for( long long i = begin + 1; i < end; ++i )
+          if( in[ i ] != previous )
+          {
+            value = in[ i ];
+            break;
+          }
+      out[ m ] = value;
+      previous = value;
+    }
+  }
+  mReceived += inCount;
+  return count;
+}
@@ -0,0 +1,117 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: Downsampling of multichannel signals by an integer factor.
+//   Signals are low-pass filtered before downsampling, so frequencies above
+//   the new Nyquist frequency do not alias. States are downsampled without
+//   filtering. Both process signals in blocks of any size, keeping their
+//   state from one block to the next.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#ifndef DECIMATOR_H
+#define DECIMATOR_H
+
+#include <vector>
+#include <cstddef>
+
+// Arrays are column-major as with RecordDecoder::Output, i.e. value i of
+// channel ch is at data[ ch * stride + i ].
+// The output sample with index m corresponds to input sample m * factor,
+// so a signal of n samples results in ( n + factor - 1 ) / factor samples.
+class Decimator
+{
+ public:
+  // The anti-aliasing filter is a linear phase FIR filter with
+  // 2 * cHalfLength * factor + 1 coefficients, centered on the output
+  // sample, so the output is not delayed against the input. With a factor
+  // of 1, the signal is passed through unchanged.
+  static const int cHalfLength = 8;
+
+  Decimator( int factor, int channels );
+
+  int Factor() const
+    { return mFactor; }
+  int Channels() const
+    { return mChannels; }
+  const std::vector<double>& Coefficients() const
+    { return mCoefficients; }
+  static long long OutputSamples( long long inputSamples, int factor )
+    { return ( inputSamples + factor - 1 ) / factor; }
+
+  // Processes count input samples, and writes the output samples that are
+  // complete, i.e. whose filter window is covered by input received so
+  // far. Returns the number of output samples written, which is at most
+  // count / factor + 1.
+  long long Process( const double* input, size_t inputStride, long long count,
+                     double* output, size_t outputStride );
+  // At the end of the signal, writes the remaining output samples,
+  // extending the signal with its last value. Returns the number of output
+  // samples written, which is at most cHalfLength + 1.
+  long long Flush( double* output, size_t outputStride );
+  // Discards all input, for processing an unrelated signal.
+  void Reset();
+
+ private:
+  long long Emit( double* output, size_t outputStride );
+
+  int mFactor,
+      mChannels,
+      mCenter;
+  std::vector<double> mCoefficients;
+  // Input samples not consumed yet, with channels interleaved, and the
+  // input index of the first of them.
+  std::vector<double> mBuffer;
+  long long mBufferBegin,
+            mReceived,
+            mNextOutput;
+  std::vector<double> mSums;
+};
+
+// Downsamples states, taking either the value at each output sample
+// (Hold), or a value that differs from the previous output value if there
+// is one in the interval represented by the output sample (AnyChange), so
+// brief state changes are not lost. The first output sample represents a
+// change if its interval contains one.
+class StateDecimator
+{
+ public:
+  enum Mode
+  {
+    Hold,
+    AnyChange,
+  };
+
+  StateDecimator( int factor, int states, Mode );
+
+  // In AnyChange mode, all blocks but the last must hold a multiple of
+  // factor samples, so intervals do not straddle blocks.
+  long long Process( const double* input, size_t inputStride, long long count,
+                     double* output, size_t outputStride );
+  void Reset();
+
+ private:
+  int mFactor;
+  Mode mMode;
+  long long mReceived;
+  std::vector<double> mPrevious;
+};
+
+#endif // DECIMATOR_H
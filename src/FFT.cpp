@@ -0,0 +1,215 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: Fast Fourier transform of any length, for batches of signals.
+//   Lengths are factored into radices 4, 2, 3, 5, and remaining primes, and
+//   transformed with a Stockham algorithm, which needs no bit reversal.
+//   Signals of a batch are interleaved, so butterflies run across the batch.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#include "PCHIncludes.h"
+#pragma hdrstop
+
+#include "FFT.h"
+#include "BCIException.h"
+#include "NumericConstants.h"
+
+#include <cmath>
+
+using namespace std;
+
+// **************************************************************************
+// Function:   FFT
+// Purpose:    Factors the length, and computes twiddle factors. Stage s
+//             with radix r transforms n = r * m values at stride s, the
+//             product of previous radices, and multiplies output k of
+//             butterfly p with exp( -2 pi i p k / n ).
+// Parameters: length - transform length
+// **************************************************************************
+FFT::FFT( int inLength )
+: mLength( inLength )
+{
+  if( inLength < 1 )
+    throw std_range_error( "FFT length must be at least 1, is " << inLength );
+  int n = inLength;
+  while( n % 4 == 0 )
+    mRadices.push_back( 4 ), n /= 4;
+  while( n % 2 == 0 )
+    mRadices.push_back( 2 ), n /= 2;
+  for( int p = 3; n > 1; p += 2 )
+    while( n % p == 0 )
+      mRadices.push_back( p ), n /= p;
+
+  n = inLength;
+  for( size_t stage = 0; stage < mRadices.size(); ++stage )
+  {
+    const int r = mRadices[ stage ],
+              m = n / r;
+    vector<double> re( n ), im( n ), rootRe( r ), rootIm( r );
+    for( int p = 0; p < m; ++p )
+      for( int k = 0; k < r; ++k )
+      {
+        const double phi = -2 * Pi() * p * k / n;
+        re[ p * r + k ] = ::cos( phi );
+        im[ p * r + k ] = ::sin( phi );
+      }
+    for( int k = 0; k < r; ++k )
+    {
+      rootRe[ k ] = ::cos( -2 * Pi() * k / r );
+      rootIm[ k ] = ::sin( -2 * Pi() * k / r );
+    }
+    mTwiddleRe.push_back( re );
+    mTwiddleIm.push_back( im );
+    mRootRe.push_back( rootRe );
+    mRootIm.push_back( rootIm );
+    n = m;
+  }
+}
+
+void
+FFT::Transform( double* ioRe, double* ioIm, int inBatch )
+{
+  const size_t size = static_cast<size_t>( mLength ) * inBatch;
+  mScratchRe.resize( size );
+  mScratchIm.resize( size );
+  double* re[] = { ioRe, &mScratchRe[ 0 ] },
+        * im[] = { ioIm, &mScratchIm[ 0 ] };
+  int current = 0;
+  for( size_t stage = 0; stage < mRadices.size(); ++stage, current = 1 - current )
+    Stage( static_cast<int>( stage ), re[ current ], im[ current ], re[ 1 - current ], im[ 1 - current ], inBatch );
+  if( current != 0 )
+    for( size_t i = 0; i < size; ++i )
+    {
+      ioRe[ i ] = re[ 1 ][ i ];
+      ioIm[ i ] = im[ 1 ][ i ];
+    }
+}
+
+// **************************************************************************
+// Function:   Stage
+// Purpose:    Computes a decimation in frequency stage. Input j of
+//             butterfly p is at ( q + s * ( p + j * m ) ), output k at
+//             ( q + s * ( r * p + k ) ), for q < s. With the batch index
+//             innermost, indices q and b form a contiguous block of
+//             s * batch values, which is the inner loop.
+// Parameters: stage - stage index
+//             inRe, inIm - input arrays
+//             outRe, outIm - output arrays
+//             batch - number of signals
+// Returns:    N/A
+// **************************************************************************
+void
+FFT::Stage( int inStage, const double* inRe, const double* inIm,
+            double* outRe, double* outIm, int inBatch ) const
+{
+  int s = 1;
+  for( int i = 0; i < inStage; ++i )
+    s *= mRadices[ i ];
+  const int r = mRadices[ inStage ],
+            n = mLength / s,
+            m = n / r;
+  const size_t block = static_cast<size_t>( s ) * inBatch;
+  const double* twRe = &mTwiddleRe[ inStage ][ 0 ],
+              * twIm = &mTwiddleIm[ inStage ][ 0 ];
+  for( int p = 0; p < m; ++p )
+  {
+    const double* wRe = twRe + p * r,
+                * wIm = twIm + p * r;
+    const double* aRe = inRe + p * block,
+                * aIm = inIm + p * block;
+    double* yRe = outRe + r * p * block,
+          * yIm = outIm + r * p * block;
+    const size_t in = m * block; // distance between butterfly inputs
+    switch( r )
+    {
+      case 2:
+        for( size_t u = 0; u < block; ++u )
+        {
+          const double r0 = aRe[ u ], i0 = aIm[ u ],
+                       r1 = aRe[ u + in ], i1 = aIm[ u + in ],
+                       dr = r0 - r1, di = i0 - i1;
+          yRe[ u ] = r0 + r1;
+          yIm[ u ] = i0 + i1;
+          yRe[ u + block ] = dr * wRe[ 1 ] - di * wIm[ 1 ];
+          yIm[ u + block ] = dr * wIm[ 1 ] + di * wRe[ 1 ];
+        }
+        break;
+      case 4:
+        for( size_t u = 0; u < block; ++u )
+        {
+          const double r0 = aRe[ u ], i0 = aIm[ u ],
+                       r1 = aRe[ u + in ], i1 = aIm[ u + in ],
+                       r2 = aRe[ u + 2 * in ], i2 = aIm[ u + 2 * in ],
+                       r3 = aRe[ u + 3 * in ], i3 = aIm[ u + 3 * in ],
+                       t0r = r0 + r2, t0i = i0 + i2,
+                       t1r = r0 - r2, t1i = i0 - i2,
+                       t2r = r1 + r3, t2i = i1 + i3,
+                       t3r = r1 - r3, t3i = i1 - i3,
+                       y1r = t1r + t3i, y1i = t1i - t3r,
+                       y2r = t0r - t2r, y2i = t0i - t2i,
+                       y3r = t1r - t3i, y3i = t1i + t3r;
+          yRe[ u ] = t0r + t2r;
+          yIm[ u ] = t0i + t2i;
+          yRe[ u + block ] = y1r * wRe[ 1 ] - y1i * wIm[ 1 ];
+          yIm[ u + block ] = y1r * wIm[ 1 ] + y1i * wRe[ 1 ];
+          yRe[ u + 2 * block ] = y2r * wRe[ 2 ] - y2i * wIm[ 2 ];
+          yIm[ u + 2 * block ] = y2r * wIm[ 2 ] + y2i * wRe[ 2 ];
+          yRe[ u + 3 * block ] = y3r * wRe[ 3 ] - y3i * wIm[ 3 ];
+          yIm[ u + 3 * block ] = y3r * wIm[ 3 ] + y3i * wRe[ 3 ];
+        }
+        break;
+      default:
+      {
+        // direct DFT of r inputs, with roots of unity taken modulo r
+        const double* rootRe = &mRootRe[ inStage ][ 0 ],
+                    * rootIm = &mRootIm[ inStage ][ 0 ];
+        for( int k = 0; k < r; ++k )
+        {
+          double* sRe = yRe + k * block,
+                * sIm = yIm + k * block;
+          for( size_t u = 0; u < block; ++u )
+          {
+            sRe[ u ] = aRe[ u ];
+            sIm[ u ] = aIm[ u ];
+          }
+          for( int j = 1; j < r; ++j )
+          {
+            const double cr = rootRe[ j * k % r ], ci = rootIm[ j * k % r ];
+            const double* xRe = aRe + j * in,
+                        * xIm = aIm + j * in;
+            for( size_t u = 0; u < block; ++u )
+            {
+              sRe[ u ] += xRe[ u ] * cr - xIm[ u ] * ci;
+              sIm[ u ] += xRe[ u ] * ci + xIm[ u ] * cr;
+            }
+          }
+          if( k > 0 )
+            for( size_t u = 0; u < block; ++u )
+            {
+              const double xr = sRe[ u ], xi = sIm[ u ];
+              sRe[ u ] = xr * wRe[ k ] - xi * wIm[ k ];
+              sIm[ u ] = xr * wIm[ k ] + xi * wRe[ k ];
+            }
+        }
+      }
+    }
+  }
+}
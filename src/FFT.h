@@ -0,0 +1,66 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: Fast Fourier transform of any length, for batches of signals.
+//   Lengths are factored into radices 4, 2, 3, 5, and remaining primes, and
+//   transformed with a Stockham algorithm, which needs no bit reversal.
+//   Signals of a batch are interleaved, so butterflies run across the batch.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#ifndef FFT_H
+#define FFT_H
+
+#include <vector>
+
+// Data are in split complex format, with the batch index innermost: value
+// t of signal b is re[ t * batch + b ] + i im[ t * batch + b ].
+// The forward transform is X[ k ] = sum_t x[ t ] exp( -2 pi i t k / n ),
+// unnormalized.
+class FFT
+{
+ public:
+  explicit FFT( int length );
+
+  int Length() const
+    { return mLength; }
+  const std::vector<int>& Radices() const
+    { return mRadices; }
+
+  // Transforms batch signals in place, using scratch memory of the object,
+  // so an object must not be used by multiple threads at once.
+  void Transform( double* re, double* im, int batch );
+
+ private:
+  void Stage( int stage, const double* inRe, const double* inIm,
+              double* outRe, double* outIm, int batch ) const;
+
+  int mLength;
+  std::vector<int> mRadices;
+  // twiddle factors of each stage, and roots of unity of each radix
+  std::vector< std::vector<double> > mTwiddleRe,
+                                     mTwiddleIm,
+                                     mRootRe,
+                                     mRootIm;
+  std::vector<double> mScratchRe,
+                      mScratchIm;
+};
+
+#endif // FFT_H
@@ -0,0 +1,326 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: Cascaded second order IIR filter sections applied to
+//   multichannel signals, with designs for Butterworth low-pass and high-pass
+//   filters, and notch filters. Filter state is kept between calls, so a
+//   signal may be filtered in consecutive blocks of any size.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#include "PCHIncludes.h"
+#pragma hdrstop
+
+#include "IIRFilter.h"
+#include "BCIException.h"
+#include "NumericConstants.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+static void CheckFrequency( double f )
+{
+  if( !( f > 0 && f < 0.5 ) )
+    throw std_range_error( "Filter frequency must be between 0 and the Nyquist frequency, is "
+                           << f << " times the sampling rate" );
+}
+
+IIRFilter::IIRFilter( int inChannels )
+: mChannels( 0 ),
+  mInitialized( false )
+{
+  SetChannels( inChannels );
+}
+
+IIRFilter&
+IIRFilter::AddSection( const Section& inSection )
+{
+  mSections.push_back( inSection );
+  mState.resize( 2 * mSections.size() * mChannels );
+  return Reset();
+}
+
+// **************************************************************************
+// Function:   AddLowpass
+// Purpose:    Adds a Butterworth low-pass filter as a cascade of second
+//             order sections, and a first order section for odd orders.
+//             Section quality factors follow from the analog prototype's
+//             pole angles, and the cutoff is prewarped for the bilinear
+//             transform.
+// Parameters: order - filter order
+//             cutoff - -3dB frequency
+// Returns:    *this
+// **************************************************************************
+IIRFilter&
+IIRFilter::AddLowpass( int inOrder, double inCutoff )
+{
+  CheckFrequency( inCutoff );
+  if( inOrder < 1 )
+    throw std_range_error( "Filter order must be at least 1, is " << inOrder );
+  const double w = 2 * Pi() * inCutoff,
+               cosw = ::cos( w );
+  for( int k = 0; k < inOrder / 2; ++k )
+  {
+    const double q = 1 / ( 2 * ::cos( Pi() * ( inOrder - 1 - 2 * k ) / ( 2 * inOrder ) ) ),
+                 alpha = ::sin( w ) / ( 2 * q ),
+                 a0 = 1 + alpha;
+    Section s = { ( 1 - cosw ) / 2 / a0, ( 1 - cosw ) / a0, ( 1 - cosw ) / 2 / a0,
+                  -2 * cosw / a0, ( 1 - alpha ) / a0 };
+    AddSection( s );
+  }
+  if( inOrder % 2 )
+  {
+    const double K = ::tan( Pi() * inCutoff );
+    Section s = { K / ( 1 + K ), K / ( 1 + K ), 0, ( K - 1 ) / ( K + 1 ), 0 };
+    AddSection( s );
+  }
+  return *this;
+}
+
+// **************************************************************************
+// Function:   AddHighpass
+// Purpose:    Adds a Butterworth high-pass filter, designed as the
+//             low-pass filter above.
+// Parameters: order - filter order
+//             cutoff - -3dB frequency
+// Returns:    *this
+// **************************************************************************
+IIRFilter&
+IIRFilter::AddHighpass( int inOrder, double inCutoff )
+{
+  CheckFrequency( inCutoff );
+  if( inOrder < 1 )
+    throw std_range_error( "Filter order must be at least 1, is " << inOrder );
+  const double w = 2 * Pi() * inCutoff,
+               cosw = ::cos( w );
+  for( int k = 0; k < inOrder / 2; ++k )
+  {
+    const double q = 1 / ( 2 * ::cos( Pi() * ( inOrder - 1 - 2 * k ) / ( 2 * inOrder ) ) ),
+                 alpha = ::sin( w ) / ( 2 * q ),
+                 a0 = 1 + alpha;
+    Section s = { ( 1 + cosw ) / 2 / a0, -( 1 + cosw ) / a0, ( 1 + cosw ) / 2 / a0,
+                  -2 * cosw / a0, ( 1 - alpha ) / a0 };
+    AddSection( s );
+  }
+  if( inOrder % 2 )
+  {
+    const double K = ::tan( Pi() * inCutoff );
+    Section s = { 1 / ( 1 + K ), -1 / ( 1 + K ), 0, ( K - 1 ) / ( K + 1 ), 0 };
+    AddSection( s );
+  }
+  return *this;
+}
+
+IIRFilter&
+IIRFilter::AddNotch( double inFrequency, double inBandwidth )
+{
+  CheckFrequency( inFrequency );
+  if( !( inBandwidth > 0 ) )
+    throw std_range_error( "Notch bandwidth must be positive, is " << inBandwidth );
+  const double w = 2 * Pi() * inFrequency,
+               cosw = ::cos( w ),
+               alpha = ::sin( w ) * inBandwidth / inFrequency / 2,
+               a0 = 1 + alpha;
+  Section s = { 1 / a0, -2 * cosw / a0, 1 / a0, -2 * cosw / a0, ( 1 - alpha ) / a0 };
+  return AddSection( s );
+}
+
+IIRFilter&
+IIRFilter::SetChannels( int inChannels )
+{
+  if( inChannels < 0 )
+    throw std_range_error( "Negative number of channels: " << inChannels );
+  if( inChannels != mChannels )
+  {
+    mChannels = inChannels;
+    mState.resize( 2 * mSections.size() * mChannels );
+    Reset();
+  }
+  return *this;
+}
+
+IIRFilter&
+IIRFilter::Reset()
+{
+  mInitialized = false;
+  return *this;
+}
+
+// **************************************************************************
+// Function:   Process
+// Purpose:    Filters a block of samples. Samples are copied into a tile
+//             with channels interleaved, so the inner loop of the filter
+//             recursion runs across channels, and vectorizes.
+// Parameters: input - input array
+//             inputStride - distance between channels in the input array
+//             count - number of samples
+//             output - output array
+//             outputStride - distance between channels in the output array
+// Returns:    N/A
+// **************************************************************************
+void
+IIRFilter::Process( const double* inInput, size_t inInputStride, long long inCount,
+                    double* outOutput, size_t inOutputStride )
+{
+  if( inCount <= 0 || mChannels == 0 )
+    return;
+  const size_t C = mChannels;
+  const long long tileSamples = max<long long>( 16, 8192 / mChannels );
+  mTile.resize( tileSamples * C );
+  for( long long begin = 0; begin < inCount; begin += tileSamples )
+  {
+    const long long n = min( tileSamples, inCount - begin );
+    for( size_t ch = 0; ch < C; ++ch )
+    {
+      const double* in = inInput + ch * inInputStride + begin;
+      for( long long i = 0; i < n; ++i )
+        mTile[ i * C + ch ] = in[ i ];
+    }
+    if( !mInitialized )
+    {
+      SteadyState( &mTile[ 0 ], mChannels, mState.empty() ? NULL : &mState[ 0 ] );
+      mInitialized = true;
+    }
+    if( !mState.empty() )
+      Run( &mTile[ 0 ], n, mChannels, &mState[ 0 ] );
+    for( size_t ch = 0; ch < C; ++ch )
+    {
+      double* out = outOutput + ch * inOutputStride + begin;
+      for( long long i = 0; i < n; ++i )
+        out[ i ] = mTile[ i * C + ch ];
+    }
+  }
+}
+
+// **************************************************************************
+// Function:   ProcessZeroPhase
+// Purpose:    Filters forward and backward. Channels are processed in
+//             groups, so the padded copy of the signal is limited to a few
+//             channels at a time.
+// Parameters: data - array, filtered in place
+//             stride - distance between channels
+//             count - number of samples
+// Returns:    N/A
+// **************************************************************************
+void
+IIRFilter::ProcessZeroPhase( double* ioData, size_t inStride, long long inCount ) const
+{
+  if( inCount <= 0 || mChannels == 0 || mSections.empty() )
+    return;
+  const int cGroup = 8;
+  const long long pad = min<long long>( inCount - 1, 3 * ( 2 * mSections.size() + 1 ) ),
+                  total = inCount + 2 * pad;
+  vector<double> buffer( total * cGroup ),
+                 state( 2 * mSections.size() * cGroup );
+  for( int group = 0; group < mChannels; group += cGroup )
+  {
+    const int G = min( cGroup, mChannels - group );
+    for( int g = 0; g < G; ++g )
+    {
+      const double* x = ioData + ( group + g ) * inStride;
+      for( long long i = 0; i < inCount; ++i )
+        buffer[ ( pad + i ) * G + g ] = x[ i ];
+      for( long long j = 1; j <= pad; ++j )
+      {
+        buffer[ ( pad - j ) * G + g ] = 2 * x[ 0 ] - x[ j ];
+        buffer[ ( pad + inCount - 1 + j ) * G + g ] = 2 * x[ inCount - 1 ] - x[ inCount - 1 - j ];
+      }
+    }
+    for( int pass = 0; pass < 2; ++pass )
+    {
+      SteadyState( &buffer[ 0 ], G, &state[ 0 ] );
+      Run( &buffer[ 0 ], total, G, &state[ 0 ] );
+      for( long long i = 0, j = total - 1; i < j; ++i, --j )
+        swap_ranges( &buffer[ i * G ], &buffer[ i * G ] + G, &buffer[ j * G ] );
+    }
+    for( int g = 0; g < G; ++g )
+    {
+      double* x = ioData + ( group + g ) * inStride;
+      for( long long i = 0; i < inCount; ++i )
+        x[ i ] = buffer[ ( pad + i ) * G + g ];
+    }
+  }
+}
+
+// **************************************************************************
+// Function:   Run
+// Purpose:    Applies all sections to interleaved data in place, in
+//             transposed direct form II.
+// Parameters: data - interleaved samples
+//             samples - number of samples
+//             channels - number of channels
+//             state - two values per section and channel
+// Returns:    N/A
+// **************************************************************************
+void
+IIRFilter::Run( double* ioData, long long inSamples, int inChannels, double* ioState ) const
+{
+  const size_t C = inChannels;
+  for( size_t s = 0; s < mSections.size(); ++s )
+  {
+    const Section& k = mSections[ s ];
+    const double b0 = k.b0, b1 = k.b1, b2 = k.b2, a1 = k.a1, a2 = k.a2;
+    double* z1 = ioState + 2 * s * C,
+          * z2 = z1 + C;
+    for( long long i = 0; i < inSamples; ++i )
+    {
+      double* x = ioData + i * C;
+      for( size_t ch = 0; ch < C; ++ch )
+      {
+        const double in = x[ ch ],
+                     out = b0 * in + z1[ ch ];
+        z1[ ch ] = b1 * in - a1 * out + z2[ ch ];
+        z2[ ch ] = b2 * in - a2 * out;
+        x[ ch ] = out;
+      }
+    }
+  }
+}
+
+// **************************************************************************
+// Function:   SteadyState
+// Purpose:    Sets the state to what it would be after a constant input
+//             of infinite duration.
+// Parameters: input - one value per channel
+//             channels - number of channels
+//             state - two values per section and channel
+// Returns:    N/A
+// **************************************************************************
+void
+IIRFilter::SteadyState( const double* inInput, int inChannels, double* outState ) const
+{
+  const size_t C = inChannels;
+  for( size_t ch = 0; ch < C; ++ch )
+  {
+    double x = inInput[ ch ];
+    for( size_t s = 0; s < mSections.size(); ++s )
+    {
+      const Section& k = mSections[ s ];
+      const double denominator = 1 + k.a1 + k.a2,
+                   y = ::fabs( denominator ) > Eps( denominator ) ? x * ( k.b0 + k.b1 + k.b2 ) / denominator : 0,
+                   z2 = k.b2 * x - k.a2 * y;
+      outState[ 2 * s * C + ch ] = k.b1 * x - k.a1 * y + z2;
+      outState[ ( 2 * s + 1 ) * C + ch ] = z2;
+      x = y;
+    }
+  }
+}
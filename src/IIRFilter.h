@@ -0,0 +1,93 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: Cascaded second order IIR filter sections applied to
+//   multichannel signals, with designs for Butterworth low-pass and high-pass
+//   filters, and notch filters. Filter state is kept between calls, so a
+//   signal may be filtered in consecutive blocks of any size.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#ifndef IIR_FILTER_H
+#define IIR_FILTER_H
+
+#include <vector>
+#include <cstddef>
+
+// Arrays are column-major as with RecordDecoder::Output, i.e. value i of
+// channel ch is at data[ ch * stride + i ]. Frequencies are given in units
+// of the sampling rate.
+class IIRFilter
+{
+ public:
+  // A second order section with coefficients normalized to a0 = 1.
+  // First order sections have b2 = a2 = 0.
+  struct Section
+  {
+    double b0, b1, b2,
+           a1, a2;
+  };
+
+  IIRFilter( int channels = 0 );
+
+  IIRFilter& AddSection( const Section& );
+  // Butterworth filters of the given order, designed with the bilinear
+  // transform.
+  IIRFilter& AddLowpass( int order, double cutoff );
+  IIRFilter& AddHighpass( int order, double cutoff );
+  // A notch at the given frequency, with the given -3dB bandwidth.
+  IIRFilter& AddNotch( double frequency, double bandwidth );
+
+  const std::vector<Section>& Sections() const
+    { return mSections; }
+  bool Empty() const
+    { return mSections.empty(); }
+  // Setting a different number of channels resets the filter state.
+  IIRFilter& SetChannels( int );
+  int Channels() const
+    { return mChannels; }
+  // Forgets the filter state. Filtering then starts in the steady state
+  // for the first input sample, so a constant offset does not cause a
+  // transient response.
+  IIRFilter& Reset();
+
+  // Filters count samples, continuing from the state the previous call
+  // left. Input and output may be the same array.
+  void Process( const double* input, size_t inputStride, long long count,
+                double* output, size_t outputStride );
+  // Filters forward and backward in place, which results in zero phase
+  // shift and squared magnitude response. Ends are extended by odd
+  // reflection to reduce transients. Does not use or change the filter
+  // state, so each call treats its data as a signal of its own.
+  void ProcessZeroPhase( double* data, size_t stride, long long count ) const;
+
+ private:
+  void Run( double* data, long long samples, int channels, double* state ) const;
+  void SteadyState( const double* input, int channels, double* state ) const;
+
+  std::vector<Section> mSections;
+  int mChannels;
+  bool mInitialized;
+  // two values per section and channel, with channels varying fastest
+  std::vector<double> mState;
+  std::vector<double> mTile;
+};
+
+#endif // IIR_FILTER_H
@@ -31,6 +31,7 @@
 #include "Brackets.h"
 #include "PhysicalUnit.h"
 #include <cmath>
+#include <cstdio>
 #include <sstream>
 
 using namespace std;
@@ -185,9 +186,11 @@ LabelIndex::TrivialLabel( size_t index )
   const int trivialBase = 1; // Channels are counted from 1,
                              // so trivial labels should start with 1 to avoid
                              // user confusion.
-  ostringstream oss;
-  oss << index + trivialBase;
-  return oss.str();
+  // Avoid stream construction, this is called for every label of every
+  // parameter.
+  char buf[ 32 ];
+  ::sprintf( buf, "%lu", static_cast<unsigned long>( index + trivialBase ) );
+  return buf;
 }
 
 // **************************************************************************
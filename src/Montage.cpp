@@ -0,0 +1,306 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: A linear combination of input channels into output channels,
+//   such as a re-referencing montage or a BCI2000 spatial filter. Weights are
+//   kept as a sparse matrix, and a common reference, the mean of a set of
+//   input channels, may be subtracted from all outputs.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#include "PCHIncludes.h"
+#pragma hdrstop
+
+#include "Montage.h"
+#include "ParamList.h"
+#include "BCIException.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+using namespace std;
+
+Montage::Montage( int inInputs )
+: mInputs( inInputs )
+{
+  if( inInputs < 0 )
+    throw std_range_error( "Negative number of channels: " << inInputs );
+}
+
+Montage
+Montage::Identity( int inChannels )
+{
+  Montage m( inChannels );
+  for( int ch = 0; ch < inChannels; ++ch )
+    m.Add( ch, ch, 1 );
+  return m;
+}
+
+Montage
+Montage::CommonAverage( int inChannels )
+{
+  vector<int> all( inChannels );
+  for( int ch = 0; ch < inChannels; ++ch )
+    all[ ch ] = ch;
+  return LinkedReference( inChannels, all );
+}
+
+Montage
+Montage::LinkedReference( int inChannels, const vector<int>& inReference )
+{
+  Montage m = Identity( inChannels );
+  m.SetReference( inReference );
+  return m;
+}
+
+int
+Montage::FindChannel( const ParamList& inParams, int inChannels, const string& inChannel )
+{
+  if( inParams.Exists( "ChannelNames" ) )
+  {
+    const Param& names = inParams[ "ChannelNames" ];
+    for( int i = 0; i < names.NumValues() && i < inChannels; ++i )
+      if( names.Value( i ).ToString() == inChannel )
+        return i;
+  }
+  const char* begin = inChannel.c_str();
+  char* end = NULL;
+  long index = ::strtol( begin, &end, 10 );
+  if( end == begin || *end != '\0' || index < 1 || index > inChannels )
+    throw std_runtime_error( "Unknown channel: " << inChannel );
+  return static_cast<int>( index - 1 );
+}
+
+// **************************************************************************
+// Function:   FromParameters
+// Purpose:    Creates a montage from BCI2000 SpatialFilter parameters.
+//             SpatialFilterType is 0 for none, 1 for a full matrix, 2 for a
+//             sparse matrix, and 3 for a common average reference. Without
+//             SpatialFilterType, a SpatialFilter matrix is taken as full.
+// Parameters: params - parameter list
+//             channels - number of input channels
+// Returns:    Montage
+// **************************************************************************
+Montage
+Montage::FromParameters( const ParamList& inParams, int inChannels )
+{
+  const bool hasMatrix = inParams.Exists( "SpatialFilter" );
+  int type = hasMatrix ? 1 : 0;
+  if( inParams.Exists( "SpatialFilterType" ) )
+    type = ::atoi( inParams[ "SpatialFilterType" ].Value().c_str() );
+
+  Montage m( inChannels );
+  switch( type )
+  {
+    case 0:
+      return Identity( inChannels );
+
+    case 1:
+    {
+      if( !hasMatrix )
+        throw std_runtime_error( "Missing SpatialFilter parameter" );
+      const Param& matrix = inParams[ "SpatialFilter" ];
+      if( matrix.NumColumns() != inChannels )
+        throw std_runtime_error( "SpatialFilter has " << matrix.NumColumns()
+                                 << " columns, expected one per channel (" << inChannels << ")" );
+      for( int row = 0; row < matrix.NumRows(); ++row )
+      {
+        m.Add( row, 0, 0 );
+        for( int col = 0; col < matrix.NumColumns(); ++col )
+        {
+          double weight = ::atof( matrix.Value( row, col ).c_str() );
+          if( weight != 0 )
+            m.Add( row, col, weight );
+        }
+      }
+    } break;
+
+    case 2:
+    {
+      if( !hasMatrix )
+        throw std_runtime_error( "Missing SpatialFilter parameter" );
+      const Param& matrix = inParams[ "SpatialFilter" ];
+      if( matrix.NumRows() > 0 && matrix.NumColumns() != 3 )
+        throw std_runtime_error( "Sparse SpatialFilter must have 3 columns, has " << matrix.NumColumns() );
+      // outputs are numbered in the order of their first occurrence
+      vector<string> outputs;
+      for( int row = 0; row < matrix.NumRows(); ++row )
+      {
+        string output = matrix.Value( row, 1 ).ToString();
+        size_t index = find( outputs.begin(), outputs.end(), output ) - outputs.begin();
+        if( index == outputs.size() )
+          outputs.push_back( output );
+        m.Add( static_cast<int>( index ),
+               FindChannel( inParams, inChannels, matrix.Value( row, 0 ).ToString() ),
+               ::atof( matrix.Value( row, 2 ).c_str() ) );
+      }
+    } break;
+
+    case 3:
+    {
+      vector<int> outputs;
+      if( inParams.Exists( "SpatialFilterCAROutput" ) )
+      {
+        const Param& carOutput = inParams[ "SpatialFilterCAROutput" ];
+        for( int i = 0; i < carOutput.NumValues(); ++i )
+          outputs.push_back( FindChannel( inParams, inChannels, carOutput.Value( i ).ToString() ) );
+      }
+      m = CommonAverage( inChannels );
+      if( !outputs.empty() )
+        m = m.Select( outputs );
+    } break;
+
+    default:
+      throw std_runtime_error( "Unknown SpatialFilterType: " << type );
+  }
+  return m;
+}
+
+Montage&
+Montage::Add( int inOutput, int inInput, double inWeight )
+{
+  if( inOutput < 0 )
+    throw std_range_error( "Negative output channel index: " << inOutput );
+  if( inInput < 0 || inInput >= mInputs )
+    throw std_range_error( "Input channel index " << inInput << " out of range" );
+  if( inOutput >= Outputs() )
+    mOutputs.resize( inOutput + 1 );
+  if( inWeight != 0 )
+  {
+    Term t = { inInput, inWeight };
+    mOutputs[ inOutput ].push_back( t );
+  }
+  return *this;
+}
+
+Montage&
+Montage::SetReference( const vector<int>& inInputs )
+{
+  for( size_t i = 0; i < inInputs.size(); ++i )
+    if( inInputs[ i ] < 0 || inInputs[ i ] >= mInputs )
+      throw std_range_error( "Reference channel index " << inInputs[ i ] << " out of range" );
+  mReference = inInputs;
+  return *this;
+}
+
+Montage
+Montage::Select( const vector<int>& inOutputs ) const
+{
+  Montage m( mInputs );
+  m.mReference = mReference;
+  for( size_t i = 0; i < inOutputs.size(); ++i )
+  {
+    if( inOutputs[ i ] < 0 || inOutputs[ i ] >= Outputs() )
+      throw std_range_error( "Output channel index " << inOutputs[ i ] << " out of range" );
+    m.mOutputs.push_back( mOutputs[ inOutputs[ i ] ] );
+  }
+  return m;
+}
+
+Montage
+Montage::Compact( vector<int>& outInputs ) const
+{
+  vector<int> map( mInputs, -1 );
+  for( size_t o = 0; o < mOutputs.size(); ++o )
+    for( size_t t = 0; t < mOutputs[ o ].size(); ++t )
+      map[ mOutputs[ o ][ t ].input ] = 0;
+  for( size_t i = 0; i < mReference.size(); ++i )
+    map[ mReference[ i ] ] = 0;
+  outInputs.clear();
+  for( int i = 0; i < mInputs; ++i )
+    if( map[ i ] == 0 )
+    {
+      map[ i ] = static_cast<int>( outInputs.size() );
+      outInputs.push_back( i );
+    }
+
+  Montage m( static_cast<int>( outInputs.size() ) );
+  m.mOutputs = mOutputs;
+  for( size_t o = 0; o < m.mOutputs.size(); ++o )
+    for( size_t t = 0; t < m.mOutputs[ o ].size(); ++t )
+      m.mOutputs[ o ][ t ].input = map[ m.mOutputs[ o ][ t ].input ];
+  for( size_t i = 0; i < mReference.size(); ++i )
+    m.mReference.push_back( map[ mReference[ i ] ] );
+  return m;
+}
+
+// **************************************************************************
+// Function:   Apply
+// Purpose:    Computes outputs in tiles of samples that stay in cache. Each
+//             output is accumulated from its inputs' samples, which are
+//             contiguous, so the inner loops vectorize.
+// Parameters: input - input array
+//             inputStride - distance between channels in the input array
+//             count - number of samples
+//             output - output array
+//             outputStride - distance between channels in the output array
+// Returns:    N/A
+// **************************************************************************
+void
+Montage::Apply( const double* inInput, size_t inInputStride, long long inCount,
+                double* outOutput, size_t inOutputStride ) const
+{
+  const long long cTile = 2048;
+  vector<double> reference( mReference.empty() ? 0 : cTile );
+  const double norm = mReference.empty() ? 0 : 1.0 / mReference.size();
+  for( long long begin = 0; begin < inCount; begin += cTile )
+  {
+    const long long n = min( cTile, inCount - begin );
+    if( !mReference.empty() )
+    {
+      double* r = &reference[ 0 ];
+      for( long long i = 0; i < n; ++i )
+        r[ i ] = 0;
+      for( size_t j = 0; j < mReference.size(); ++j )
+      {
+        const double* x = inInput + mReference[ j ] * inInputStride + begin;
+        for( long long i = 0; i < n; ++i )
+          r[ i ] += x[ i ];
+      }
+      for( long long i = 0; i < n; ++i )
+        r[ i ] *= norm;
+    }
+    for( size_t o = 0; o < mOutputs.size(); ++o )
+    {
+      const vector<Term>& terms = mOutputs[ o ];
+      double* y = outOutput + o * inOutputStride + begin;
+      if( terms.empty() )
+        for( long long i = 0; i < n; ++i )
+          y[ i ] = 0;
+      for( size_t t = 0; t < terms.size(); ++t )
+      {
+        const double* x = inInput + terms[ t ].input * inInputStride + begin;
+        const double w = terms[ t ].weight;
+        if( t == 0 )
+          for( long long i = 0; i < n; ++i )
+            y[ i ] = w * x[ i ];
+        else
+          for( long long i = 0; i < n; ++i )
+            y[ i ] += w * x[ i ];
+      }
+      if( !mReference.empty() )
+      {
+        const double* r = &reference[ 0 ];
+        for( long long i = 0; i < n; ++i )
+          y[ i ] -= r[ i ];
+      }
+    }
+  }
+}
@@ -0,0 +1,93 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: A linear combination of input channels into output channels,
+//   such as a re-referencing montage or a BCI2000 spatial filter. Weights are
+//   kept as a sparse matrix, and a common reference, the mean of a set of
+//   input channels, may be subtracted from all outputs.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#ifndef MONTAGE_H
+#define MONTAGE_H
+
+#include <vector>
+#include <string>
+#include <cstddef>
+
+class ParamList;
+
+// Arrays are column-major as with RecordDecoder::Output, i.e. value i of
+// channel ch is at data[ ch * stride + i ]. Channel indices are zero-based.
+class Montage
+{
+ public:
+  explicit Montage( int inputs = 0 );
+
+  // Outputs equal inputs.
+  static Montage Identity( int channels );
+  // Each channel minus the mean of all channels.
+  static Montage CommonAverage( int channels );
+  // Each channel minus the mean of the reference channels.
+  static Montage LinkedReference( int channels, const std::vector<int>& reference );
+  // The spatial filter defined by the SpatialFilterType, SpatialFilter, and
+  // SpatialFilterCAROutput parameters of a BCI2000 file: a full matrix with
+  // an output channel per row and an input channel per column, a sparse
+  // matrix with rows of input channel, output channel, and weight, or a
+  // common average reference. Results in an identity montage if there is
+  // no spatial filter.
+  static Montage FromParameters( const ParamList&, int channels );
+  // Resolves a channel given by a name from the ChannelNames parameter, or
+  // by a one-based index.
+  static int FindChannel( const ParamList&, int channels, const std::string& );
+
+  int Inputs() const
+    { return mInputs; }
+  int Outputs() const
+    { return static_cast<int>( mOutputs.size() ); }
+
+  // Adds an input with a weight to an output, creating outputs as needed.
+  Montage& Add( int output, int input, double weight );
+  // Subtracts the mean of the given inputs from all outputs.
+  Montage& SetReference( const std::vector<int>& inputs );
+
+  // A montage with the listed outputs only, in the order listed.
+  Montage Select( const std::vector<int>& outputs ) const;
+  // An equivalent montage that takes only the inputs actually used, with
+  // the original indices of these inputs returned in the list.
+  Montage Compact( std::vector<int>& inputs ) const;
+
+  // Computes count samples of all outputs. Input and output must not
+  // overlap.
+  void Apply( const double* input, size_t inputStride, long long count,
+              double* output, size_t outputStride ) const;
+
+ private:
+  struct Term
+  {
+    int input;
+    double weight;
+  };
+  int mInputs;
+  std::vector< std::vector<Term> > mOutputs;
+  std::vector<int> mReference;
+};
+
+#endif // MONTAGE_H
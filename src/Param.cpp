@@ -29,6 +29,7 @@
 #include "Param.h"
 #include "Brackets.h"
 #include "BCIAssert.h"
+#include "Serialization.h"
 
 #include <sstream>
 #include <cstdio>
@@ -454,6 +455,83 @@ Param::WriteBinary( ostream& os ) const
   return WriteToStream( os ).write( "\r\n", 2 );
 }
 
+// **************************************************************************
+// Function:   Serialize
+// Purpose:    Member function for output of a single parameter in a compact
+//             binary representation, as used for header caching.
+// Parameters: Output stream to write into.
+// Returns:    Output stream written into.
+// **************************************************************************
+ostream&
+Param::Serialize( ostream& os ) const
+{
+  using namespace Serialization;
+  Put( os, static_cast<uint32_t>( mSections.size() ) );
+  for( size_t i = 0; i < mSections.size(); ++i )
+    PutString( os, mSections[ i ] );
+  PutString( os, mName );
+  PutString( os, mType );
+  PutString( os, mDefaultValue );
+  PutString( os, mLowRange );
+  PutString( os, mHighRange );
+  PutString( os, mComment );
+  const LabelIndex* indices[] = { &mDim1Index, &mDim2Index };
+  for( size_t i = 0; i < sizeof( indices ) / sizeof( *indices ); ++i )
+  {
+    Put( os, static_cast<uint32_t>( indices[ i ]->Size() ) );
+    for( int j = 0; j < indices[ i ]->Size(); ++j )
+      PutString( os, ( *indices[ i ] )[ j ] );
+  }
+  Put( os, static_cast<uint32_t>( mValues.size() ) );
+  for( size_t i = 0; i < mValues.size(); ++i )
+    mValues[ i ].Serialize( os );
+  return os;
+}
+
+// **************************************************************************
+// Function:   Unserialize
+// Purpose:    Member function for input of a single parameter from its
+//             compact binary representation.
+// Parameters: Input stream to read from.
+// Returns:    Input stream read from.
+// **************************************************************************
+istream&
+Param::Unserialize( istream& is )
+{
+  using namespace Serialization;
+  mChanged = true;
+  uint32_t count = 0;
+  Get( is, count );
+  mSections.resize( is ? count : 0 );
+  for( size_t i = 0; i < mSections.size(); ++i )
+    GetString( is, mSections[ i ] );
+  GetString( is, mName );
+  GetString( is, mType );
+  GetString( is, mDefaultValue );
+  GetString( is, mLowRange );
+  GetString( is, mHighRange );
+  string comment;
+  GetString( is, comment );
+  SetComment( comment );
+  LabelIndex* indices[] = { &mDim1Index, &mDim2Index };
+  string label;
+  for( size_t i = 0; is && i < sizeof( indices ) / sizeof( *indices ); ++i )
+  {
+    count = 0;
+    Get( is, count );
+    indices[ i ]->Resize( is ? count : 0 );
+    for( uint32_t j = 0; is && j < count; ++j )
+      if( GetString( is, label ) )
+        ( *indices[ i ] )[ j ] = label;
+  }
+  count = 0;
+  Get( is, count );
+  mValues.resize( is ? count : 0 );
+  for( size_t i = 0; is && i < mValues.size(); ++i )
+    mValues[ i ].Unserialize( is );
+  return is;
+}
+
 // **************************************************************************
 // Function:   operator=
 // Purpose:    Assignment from one parameter instance to another.
@@ -711,6 +789,58 @@ Param::ParamValue::ReadFromStream( istream& is )
   return is;
 }
 
+// **************************************************************************
+// Function:   Serialize
+// Purpose:    Member function for output of a single parameter value in
+//             compact binary representation.
+// Parameters: Output stream to write into.
+// Returns:    Output stream written into.
+// **************************************************************************
+ostream&
+Param::ParamValue::Serialize( ostream& os ) const
+{
+  bciassert( !( mpString && mpParam ) );
+  if( mpParam )
+    mpParam->Serialize( Serialization::Put( os, uint8_t( Matrix ) ) );
+  else if( mpString )
+    Serialization::PutString( Serialization::Put( os, uint8_t( Single ) ), *mpString );
+  else
+    Serialization::Put( os, uint8_t( Null ) );
+  return os;
+}
+
+// **************************************************************************
+// Function:   Unserialize
+// Purpose:    Member function for input of a single parameter value from
+//             its compact binary representation.
+// Parameters: Input stream to read from.
+// Returns:    Input stream read from.
+// **************************************************************************
+istream&
+Param::ParamValue::Unserialize( istream& is )
+{
+  delete mpString;
+  mpString = NULL;
+  delete mpParam;
+  mpParam = NULL;
+  uint8_t kind = Null;
+  Serialization::Get( is, kind );
+  switch( kind )
+  {
+    case Matrix:
+      mpParam = new Param;
+      mpParam->Unserialize( is );
+      break;
+    case Single:
+      mpString = new EncodedString;
+      Serialization::GetString( is, *mpString );
+      break;
+    default:
+      ;
+  }
+  return is;
+}
+
 // **************************************************************************
 // Function:   ConstructParamBuf
 // Purpose:    Constructs a Param from a single or NULL value in a
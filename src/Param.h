@@ -105,6 +105,8 @@ class Param
 
      std::ostream& WriteToStream( std::ostream& os ) const;
      std::istream& ReadFromStream( std::istream& is );
+     std::ostream& Serialize( std::ostream& os ) const;
+     std::istream& Unserialize( std::istream& is );
 
     private:
      void ConstructParamBuf() const;
@@ -251,6 +253,9 @@ class Param
   std::istream&       ReadFromStream( std::istream& );
   std::ostream&       WriteBinary( std::ostream& ) const;
   std::istream&       ReadBinary( std::istream& );
+  // Compact binary representation for local caching.
+  std::ostream&       Serialize( std::ostream& ) const;
+  std::istream&       Unserialize( std::istream& );
 
  private:
   HierarchicalLabel   mSections;
@@ -30,6 +30,7 @@
 #include "ParamList.h"
 #include "ParamRef.h"
 #include "BCIAssert.h"
+#include "Serialization.h"
 
 #include <sstream>
 #include <fstream>
@@ -228,6 +229,55 @@ ParamList::ReadBinary( istream& is )
   return ReadFromStream( is );
 }
 
+// **************************************************************************
+// Function:   Serialize
+// Purpose:    Member function for output of the entire parameter list in a
+//             compact binary representation, as used for header caching.
+// Parameters: Output stream to write into.
+// Returns:    Output stream written into.
+// **************************************************************************
+ostream&
+ParamList::Serialize( ostream& os ) const
+{
+  Serialization::Put( os, static_cast<uint32_t>( Size() ) );
+  for( int i = 0; i < Size(); ++i )
+  {
+    Serialization::PutString( os, ByIndex( i ).Name() );
+    Serialization::Put( os, mIndex[ i ]->SortingHint );
+    ByIndex( i ).Serialize( os );
+  }
+  return os;
+}
+
+// **************************************************************************
+// Function:   Unserialize
+// Purpose:    Member function for input of the entire parameter list from
+//             its compact binary representation. The list is cleared before
+//             reading.
+// Parameters: Input stream to read from.
+// Returns:    Input stream read from.
+// **************************************************************************
+istream&
+ParamList::Unserialize( istream& is )
+{
+  Clear();
+  uint32_t count = 0;
+  Serialization::Get( is, count );
+  string name;
+  for( uint32_t i = 0; is && i < count; ++i )
+  {
+    // Parameters are unserialized in place, avoiding a copy.
+    Serialization::GetString( is, name );
+    size_t size = mParams.size();
+    ParamEntry& entry = mParams[ name ];
+    if( mParams.size() != size )
+      mIndex.push_back( &entry );
+    Serialization::Get( is, entry.SortingHint );
+    entry.Param.Unserialize( is );
+  }
+  return is;
+}
+
 // **************************************************************************
 // Function:   Save
 // Purpose:    Saves the current list of paramters in a parameter file
@@ -87,6 +87,10 @@ class ParamList
         std::ostream& WriteBinary( std::ostream& ) const;
         std::istream& ReadBinary( std::istream& );
 
+  // Compact binary representation for local caching.
+        std::ostream& Serialize( std::ostream& ) const;
+        std::istream& Unserialize( std::istream& );
+
  private:
   struct ParamEntry
   {
@@ -38,6 +38,7 @@
 #include "BCIException.h"
 #include <limits>
 #include <cmath>
+#include <cstdlib>
 #include <sstream>
 #include <iomanip>
 
@@ -92,10 +93,12 @@ PhysicalUnit::SexagesimalAllowed() const
 bool
 PhysicalUnit::ParseNumber( const string& inNumber, PhysicalUnit::ValueType& outValue ) const
 {
+  // Arithmetic expressions are not available here, so each sexagesimal
+  // component must be a plain number.
   outValue = 0;
   bool valid = true;
-  /*int count = 0;
-  for( size_t beginPos = 0; beginPos < inNumber.length(); )
+  int count = 0;
+  for( size_t beginPos = 0; beginPos <= inNumber.length(); )
   {
     ++count;
     size_t endPos = inNumber.find( ':', beginPos );
@@ -103,18 +106,23 @@ PhysicalUnit::ParseNumber( const string& inNumber, PhysicalUnit::ValueType& outV
       endPos = inNumber.length();
     else if( !SexagesimalAllowed() )
       return false;
-    size_t length = endPos - beginPos;
-    valid &= ( length > 0 );
-    ValueType value = ArithmeticExpression( inNumber.substr( beginPos, length ) ).Evaluate();
+    string component = inNumber.substr( beginPos, endPos - beginPos );
+    const char* p = component.c_str();
+    char* end = NULL;
+    ValueType value = ::strtod( p, &end );
+    valid &= ( end != p );
+    while( end && *end == ' ' )
+      ++end;
+    valid &= ( end && *end == '\0' );
     if( beginPos != 0 )
     {
       valid &= ( value >= 0 && value < 60 );
       outValue *= 60;
     }
     outValue += value;
-    beginPos = endPos;
+    beginPos = endPos + 1;
   }
-  valid &= ( count > 0 && count <= 3 );*/
+  valid &= ( count > 0 && count <= 3 );
   return valid;
 }
 
@@ -177,8 +185,8 @@ PhysicalUnit::SetGainWithSymbol( const std::string& inGain )
   size_t pos = 0, ignored = 0;
   TokenizePhysical( inGain, pos, ignored );
   ValueType gain = 0;
-  /*if( !ParseNumber( inGain.substr( 0, pos ), gain ) )
-    throw bciexception( "Invalid number format: " << inGain );*/
+  if( !ParseNumber( inGain.substr( 0, pos ), gain ) )
+    gain = NaN( gain ); // conversions with an invalid gain result in NaN
   string prefix = inGain.substr( pos );
   while( !prefix.empty() && !ApplyPrefix( prefix, gain ) )
     prefix.erase( prefix.length() - 1 );
@@ -233,13 +241,13 @@ PhysicalUnit::PhysicalToRaw( const string& s ) const
          symbolPos = 0;
   bool unitOK = TokenizePhysical( s, prefixPos, symbolPos );
   string number = s.substr( beginPos, prefixPos );
-  /*if( !ParseNumber( number, value ) )
-    throw bciexception( "Invalid number format \"" << number << "\" in " << s );*/
+  if( !ParseNumber( number, value ) )
+    return NaN( value );
   if( value != 0 ) // zero times whatever is identical to zero
   {
     string prefix = s.substr( prefixPos, symbolPos - prefixPos );
-    /*if( !ApplyPrefix( prefix, value ) )
-      throw bciexception( "Invalid unit prefix \"" << prefix << "\" in " << s );*/
+    if( !ApplyPrefix( prefix, value ) )
+      return NaN( value );
     if( !unitOK )
     {
       string symbol = s.substr( symbolPos ),
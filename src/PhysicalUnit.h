@@ -87,6 +87,7 @@ class PhysicalUnit
   ValueType     RawToPhysicalValue( ValueType ) const;
 
   bool          IsPhysical( const std::string& ) const;
+  // Returns NaN if the number or unit prefix is invalid.
   ValueType     PhysicalToRaw( const std::string& ) const;
   Pair RawToPhysical( ValueType, ValueType range = NaN<ValueType>() ) const;
 
@@ -0,0 +1,159 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: Reading and writing at absolute file positions, without
+//   changing a file position that is shared between threads.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#include "PCHIncludes.h"
+#pragma hdrstop
+
+#include "PositionalIO.h"
+
+#include <cerrno>
+
+#if _WIN32
+# include <windows.h>
+# include <io.h>
+#else // _WIN32
+# include <unistd.h>
+# include <sys/stat.h>
+#endif // _WIN32
+
+// **************************************************************************
+// Function:   Read
+// Purpose:    Reads data from an absolute file position. Unlike fseek()/fread(),
+//             this does not modify the file position, and may be called from
+//             multiple threads at once.
+// Parameters: file - open file
+//             position - file position
+//             data - destination buffer
+//             length - number of bytes to read
+// Returns:    Number of bytes read; less than length at the end of the file.
+// **************************************************************************
+size_t
+PositionalIO::Read( std::FILE* inFile, long long inPosition, char* outData, size_t inLength )
+{
+  if( inFile == NULL )
+    return 0;
+  int fd = ::fileno( inFile );
+  size_t total = 0;
+  while( total < inLength )
+  {
+    long long pos = inPosition + total;
+#if _WIN32
+    HANDLE handle = reinterpret_cast<HANDLE>( ::_get_osfhandle( fd ) );
+    OVERLAPPED overlapped = { 0 };
+    overlapped.Offset = static_cast<DWORD>( pos );
+    overlapped.OffsetHigh = static_cast<DWORD>( pos >> 32 );
+    DWORD count = 0;
+    if( !::ReadFile( handle, outData + total, static_cast<DWORD>( inLength - total ), &count, &overlapped ) )
+      count = 0;
+#else // _WIN32
+    ssize_t count = ::pread( fd, outData + total, inLength - total, static_cast<off_t>( pos ) );
+    if( count < 0 && errno == EINTR )
+      continue;
+#endif // _WIN32
+    if( count <= 0 )
+      break;
+    total += count;
+  }
+  return total;
+}
+
+// **************************************************************************
+// Function:   Write
+// Purpose:    Writes data at an absolute file position, without modifying
+//             the file position.
+// Parameters: file - open file
+//             position - file position
+//             data - source buffer
+//             length - number of bytes to write
+// Returns:    Number of bytes written.
+// **************************************************************************
+size_t
+PositionalIO::Write( std::FILE* inFile, long long inPosition, const char* inData, size_t inLength )
+{
+  if( inFile == NULL )
+    return 0;
+  int fd = ::fileno( inFile );
+  size_t total = 0;
+  while( total < inLength )
+  {
+    long long pos = inPosition + total;
+#if _WIN32
+    HANDLE handle = reinterpret_cast<HANDLE>( ::_get_osfhandle( fd ) );
+    OVERLAPPED overlapped = { 0 };
+    overlapped.Offset = static_cast<DWORD>( pos );
+    overlapped.OffsetHigh = static_cast<DWORD>( pos >> 32 );
+    DWORD count = 0;
+    if( !::WriteFile( handle, inData + total, static_cast<DWORD>( inLength - total ), &count, &overlapped ) )
+      count = 0;
+#else // _WIN32
+    ssize_t count = ::pwrite( fd, inData + total, inLength - total, static_cast<off_t>( pos ) );
+    if( count < 0 && errno == EINTR )
+      continue;
+#endif // _WIN32
+    if( count <= 0 )
+      break;
+    total += count;
+  }
+  return total;
+}
+
+// **************************************************************************
+// Function:   Stat
+// Purpose:    Obtains a file's size and modification time. The time is
+//             given in nanoseconds, to the resolution of the file system.
+// Parameters: file - open file
+//             size - receives the file size
+//             time - receives the modification time
+// Returns:    True on success.
+// **************************************************************************
+bool
+PositionalIO::Stat( std::FILE* inFile, long long& outSize, long long& outTime )
+{
+  if( inFile == NULL )
+    return false;
+  int fd = ::fileno( inFile );
+#if _WIN32
+  HANDLE handle = reinterpret_cast<HANDLE>( ::_get_osfhandle( fd ) );
+  BY_HANDLE_FILE_INFORMATION info;
+  if( !::GetFileInformationByHandle( handle, &info ) )
+    return false;
+  outSize = static_cast<long long>( info.nFileSizeHigh ) << 32 | info.nFileSizeLow;
+  // FILETIME counts intervals of 100 ns
+  outTime = ( static_cast<long long>( info.ftLastWriteTime.dwHighDateTime ) << 32
+              | info.ftLastWriteTime.dwLowDateTime ) * 100;
+#else // _WIN32
+  struct stat fileStat;
+  if( 0 != ::fstat( fd, &fileStat ) )
+    return false;
+  outSize = fileStat.st_size;
+# if __APPLE__
+  const struct timespec& mtime = fileStat.st_mtimespec;
+# else // __APPLE__
+  const struct timespec& mtime = fileStat.st_mtim;
+# endif // __APPLE__
+  outTime = static_cast<long long>( mtime.tv_sec ) * 1000000000LL + mtime.tv_nsec;
+#endif // _WIN32
+  return true;
+}
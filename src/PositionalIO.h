@@ -0,0 +1,44 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: Reading and writing at absolute file positions, without
+//   changing a file position that is shared between threads.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#ifndef POSITIONAL_IO_H
+#define POSITIONAL_IO_H
+
+#include <cstdio>
+#include <cstddef>
+
+namespace PositionalIO
+{
+  // Both functions return the number of bytes transferred, which is less
+  // than length at the end of the file, or after an error.
+  size_t Read( std::FILE*, long long position, char* data, size_t length );
+  size_t Write( std::FILE*, long long position, const char* data, size_t length );
+  // Obtains a file's size, and its modification time in nanoseconds, so
+  // that changes within the same second are noticed.
+  // Returns false if the file's status is unavailable.
+  bool Stat( std::FILE*, long long& size, long long& time );
+} // namespace PositionalIO
+
+#endif // POSITIONAL_IO_H
@@ -0,0 +1,204 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: Approximate quantiles of a stream of values, in memory that
+//   does not depend on the number of values. Sketches of parts of a stream
+//   can be merged.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#include "PCHIncludes.h"
+#pragma hdrstop
+
+#include "QuantileSketch.h"
+#include "BCIException.h"
+#include "NumericConstants.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+using namespace std;
+
+QuantileSketch::QuantileSketch( double inCompression )
+: mCompression( inCompression ),
+  mBufferLimit( static_cast<size_t>( 5 * inCompression ) + 1 ),
+  mCount( 0 ),
+  mMin( numeric_limits<double>::infinity() ),
+  mMax( -numeric_limits<double>::infinity() )
+{
+  if( !( inCompression >= 10 ) )
+    throw std_range_error( "Quantile sketch compression must be at least 10, is " << inCompression );
+}
+
+void
+QuantileSketch::Add( const double* inValues, long long inCount )
+{
+  while( inCount > 0 )
+  {
+    const size_t n = min<size_t>( inCount, mBufferLimit - mBuffer.size() );
+    mBuffer.insert( mBuffer.end(), inValues, inValues + n );
+    inValues += n;
+    inCount -= n;
+    if( mBuffer.size() >= mBufferLimit )
+      Compress();
+  }
+}
+
+void
+QuantileSketch::Merge( const QuantileSketch& inOther )
+{
+  inOther.Compress();
+  Compress();
+  if( inOther.mCount == 0 )
+    return;
+  // the other sketch's centroids are merged like buffered values, with
+  // their weights
+  vector<pair<double, double> > centroids;
+  for( size_t i = 0; i < mMeans.size(); ++i )
+    centroids.push_back( make_pair( mMeans[ i ], mWeights[ i ] ) );
+  for( size_t i = 0; i < inOther.mMeans.size(); ++i )
+    centroids.push_back( make_pair( inOther.mMeans[ i ], inOther.mWeights[ i ] ) );
+  inplace_merge( centroids.begin(), centroids.begin() + mMeans.size(), centroids.end() );
+  mMeans.clear();
+  mWeights.clear();
+  for( size_t i = 0; i < centroids.size(); ++i )
+  {
+    mMeans.push_back( centroids[ i ].first );
+    mWeights.push_back( centroids[ i ].second );
+  }
+  mCount += inOther.mCount;
+  mMin = min( mMin, inOther.mMin );
+  mMax = max( mMax, inOther.mMax );
+  // an empty buffer makes Compress() re-merge the centroids
+  Compress();
+}
+
+double
+QuantileSketch::Scale( double inQ, double inCompression )
+{
+  return inCompression / ( 2 * Pi() ) * ::asin( 2 * inQ - 1 );
+}
+
+double
+QuantileSketch::InverseScale( double inK, double inCompression )
+{
+  const double k = min( max( inK, -inCompression / 4 ), inCompression / 4 );
+  return ( ::sin( 2 * Pi() * k / inCompression ) + 1 ) / 2;
+}
+
+// **************************************************************************
+// Function:   Compress
+// Purpose:    Merges buffered values into the centroids. Values and
+//             centroids are traversed in order, and added to the current
+//             centroid while its quantile range spans at most one unit of
+//             the scale function; otherwise, a new centroid is begun.
+// Parameters: N/A
+// Returns:    N/A
+// **************************************************************************
+void
+QuantileSketch::Compress() const
+{
+  if( mBuffer.empty() && mMeans.size() <= 1 )
+    return;
+  sort( mBuffer.begin(), mBuffer.end() );
+  if( !mBuffer.empty() )
+  {
+    mMin = min( mMin, mBuffer.front() );
+    mMax = max( mMax, mBuffer.back() );
+  }
+  const double total = static_cast<double>( mCount + mBuffer.size() );
+  vector<double> means, weights;
+  means.reserve( mMeans.size() + 1 );
+  weights.reserve( mMeans.size() + 1 );
+  size_t i = 0, j = 0;
+  double before = 0, // weight of centroids completed
+         limit = total * InverseScale( Scale( 0, mCompression ) + 1, mCompression );
+  while( i < mMeans.size() || j < mBuffer.size() )
+  {
+    double mean, weight;
+    if( j >= mBuffer.size() || ( i < mMeans.size() && mMeans[ i ] < mBuffer[ j ] ) )
+      mean = mMeans[ i ], weight = mWeights[ i++ ];
+    else
+      mean = mBuffer[ j++ ], weight = 1;
+    if( !weights.empty() && before + weights.back() + weight <= limit )
+    {
+      double& w = weights.back();
+      means.back() += ( mean - means.back() ) * weight / ( w + weight );
+      w += weight;
+    }
+    else
+    {
+      if( !weights.empty() )
+      {
+        before += weights.back();
+        limit = total * InverseScale( Scale( before / total, mCompression ) + 1, mCompression );
+      }
+      means.push_back( mean );
+      weights.push_back( weight );
+    }
+  }
+  mMeans.swap( means );
+  mWeights.swap( weights );
+  mCount += mBuffer.size();
+  mBuffer.clear();
+}
+
+// **************************************************************************
+// Function:   Quantile
+// Purpose:    Interpolates the quantile function. Centroid means are taken
+//             to lie at the middle of the cumulative weight of their
+//             centroids, the minimum at 0, and the maximum at the total
+//             weight. Centroids of a single value are exact.
+// Parameters: p - probability
+// Returns:    Estimated quantile.
+// **************************************************************************
+double
+QuantileSketch::Quantile( double inP ) const
+{
+  Compress();
+  if( mCount == 0 || inP != inP )
+    return numeric_limits<double>::quiet_NaN();
+  if( inP <= 0 )
+    return mMin;
+  if( inP >= 1 )
+    return mMax;
+  const double index = inP * mCount;
+  double position = 0, // cumulative weight at the previous point
+         value = mMin, // value at the previous point
+         cumulative = 0;
+  for( size_t i = 0; i < mMeans.size(); ++i )
+  {
+    const double center = cumulative + mWeights[ i ] / 2;
+    if( index < center )
+    {
+      if( mWeights[ i ] == 1 && index >= cumulative )
+        return mMeans[ i ];
+      return value + ( mMeans[ i ] - value ) * ( index - position ) / ( center - position );
+    }
+    position = center;
+    value = mMeans[ i ];
+    cumulative += mWeights[ i ];
+  }
+  if( position >= mCount )
+    return mMax;
+  return value + ( mMax - value ) * ( index - position ) / ( mCount - position );
+}
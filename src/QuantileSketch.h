@@ -0,0 +1,76 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: Approximate quantiles of a stream of values, in memory that
+//   does not depend on the number of values. Sketches of parts of a stream
+//   can be merged.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#ifndef QUANTILE_SKETCH_H
+#define QUANTILE_SKETCH_H
+
+#include <vector>
+#include <cstddef>
+
+// A merging t-digest (Dunning & Ertl, 2019): values are summarized by
+// centroids, i.e. means and weights of adjacent values, whose weights are
+// limited by the scale function k( q ) = compression / 2pi * asin( 2q - 1 ).
+// Centroids are small near the ends of the distribution, so errors of
+// quantiles near 0 or 1 are small relative to their distance from the end.
+// There are at most about compression centroids; added values are buffered,
+// and merged into the centroids when the buffer is full, or when results
+// are requested, so a sketch must not be used by multiple threads at once.
+class QuantileSketch
+{
+ public:
+  static const int cDefaultCompression = 200;
+
+  explicit QuantileSketch( double compression = cDefaultCompression );
+
+  void Add( const double* values, long long count );
+  void Merge( const QuantileSketch& );
+
+  long long Count() const
+    { return mCount + static_cast<long long>( mBuffer.size() ); }
+  size_t Centroids() const
+    { Compress(); return mMeans.size(); }
+  // The value below which a fraction p of values lies, interpolated
+  // linearly between centroids, and between the extreme centroids and the
+  // minimum and maximum. NaN for an empty sketch.
+  double Quantile( double p ) const;
+
+ private:
+  void Compress() const;
+  static double Scale( double q, double compression );
+  static double InverseScale( double k, double compression );
+
+  double mCompression;
+  size_t mBufferLimit;
+  // centroids, sorted by mean, and values not merged yet
+  mutable std::vector<double> mMeans,
+                              mWeights,
+                              mBuffer;
+  mutable long long mCount;
+  mutable double mMin,
+                 mMax;
+};
+
+#endif // QUANTILE_SKETCH_H
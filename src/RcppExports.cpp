@@ -5,21 +5,342 @@
 
 using namespace Rcpp;
 
+// open_bcidat
+SEXP open_bcidat(std::string file, bool numeric_params, bool param_units, SEXP header_cache, SEXP filter, SEXP montage);
+RcppExport SEXP _bcidat_open_bcidat(SEXP fileSEXP, SEXP numeric_paramsSEXP, SEXP param_unitsSEXP, SEXP header_cacheSEXP, SEXP filterSEXP, SEXP montageSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type file(fileSEXP);
+    Rcpp::traits::input_parameter< bool >::type numeric_params(numeric_paramsSEXP);
+    Rcpp::traits::input_parameter< bool >::type param_units(param_unitsSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type header_cache(header_cacheSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type filter(filterSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type montage(montageSEXP);
+    rcpp_result_gen = Rcpp::wrap(open_bcidat(file, numeric_params, param_units, header_cache, filter, montage));
+    return rcpp_result_gen;
+END_RCPP
+}
+// read_bcidat
+Rcpp::List read_bcidat(SEXP handle, SEXP from, SEXP count, bool raw, SEXP channels, SEXP states);
+RcppExport SEXP _bcidat_read_bcidat(SEXP handleSEXP, SEXP fromSEXP, SEXP countSEXP, SEXP rawSEXP, SEXP channelsSEXP, SEXP statesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type handle(handleSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type from(fromSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type count(countSEXP);
+    Rcpp::traits::input_parameter< bool >::type raw(rawSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type channels(channelsSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type states(statesSEXP);
+    rcpp_result_gen = Rcpp::wrap(read_bcidat(handle, from, count, raw, channels, states));
+    return rcpp_result_gen;
+END_RCPP
+}
+// poll_bcidat
+double poll_bcidat(SEXP handle, double timeout);
+RcppExport SEXP _bcidat_poll_bcidat(SEXP handleSEXP, SEXP timeoutSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type handle(handleSEXP);
+    Rcpp::traits::input_parameter< double >::type timeout(timeoutSEXP);
+    rcpp_result_gen = Rcpp::wrap(poll_bcidat(handle, timeout));
+    return rcpp_result_gen;
+END_RCPP
+}
+// open_bcidat_sampler
+SEXP open_bcidat_sampler(Rcpp::CharacterVector files, int window, SEXP channels, SEXP state, bool stratify, bool raw, SEXP seed, int threads, int max_open, SEXP header_cache);
+RcppExport SEXP _bcidat_open_bcidat_sampler(SEXP filesSEXP, SEXP windowSEXP, SEXP channelsSEXP, SEXP stateSEXP, SEXP stratifySEXP, SEXP rawSEXP, SEXP seedSEXP, SEXP threadsSEXP, SEXP max_openSEXP, SEXP header_cacheSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type files(filesSEXP);
+    Rcpp::traits::input_parameter< int >::type window(windowSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type channels(channelsSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type state(stateSEXP);
+    Rcpp::traits::input_parameter< bool >::type stratify(stratifySEXP);
+    Rcpp::traits::input_parameter< bool >::type raw(rawSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< int >::type max_open(max_openSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type header_cache(header_cacheSEXP);
+    rcpp_result_gen = Rcpp::wrap(open_bcidat_sampler(files, window, channels, state, stratify, raw, seed, threads, max_open, header_cache));
+    return rcpp_result_gen;
+END_RCPP
+}
+// sample_bcidat
+Rcpp::List sample_bcidat(SEXP sampler, int n, bool float32);
+RcppExport SEXP _bcidat_sample_bcidat(SEXP samplerSEXP, SEXP nSEXP, SEXP float32SEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type sampler(samplerSEXP);
+    Rcpp::traits::input_parameter< int >::type n(nSEXP);
+    Rcpp::traits::input_parameter< bool >::type float32(float32SEXP);
+    rcpp_result_gen = Rcpp::wrap(sample_bcidat(sampler, n, float32));
+    return rcpp_result_gen;
+END_RCPP
+}
+// scan_bcidat
+Rcpp::DataFrame scan_bcidat(std::string file, SEXP channels, bool raw, double flat_duration, int threads, SEXP quantiles, SEXP header_cache);
+RcppExport SEXP _bcidat_scan_bcidat(SEXP fileSEXP, SEXP channelsSEXP, SEXP rawSEXP, SEXP flat_durationSEXP, SEXP threadsSEXP, SEXP quantilesSEXP, SEXP header_cacheSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type file(fileSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type channels(channelsSEXP);
+    Rcpp::traits::input_parameter< bool >::type raw(rawSEXP);
+    Rcpp::traits::input_parameter< double >::type flat_duration(flat_durationSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type quantiles(quantilesSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type header_cache(header_cacheSEXP);
+    rcpp_result_gen = Rcpp::wrap(scan_bcidat(file, channels, raw, flat_duration, threads, quantiles, header_cache));
+    return rcpp_result_gen;
+END_RCPP
+}
+// envelope_bcidat
+Rcpp::List envelope_bcidat(std::string file, double from, SEXP to, int width, SEXP channels, bool raw, SEXP header_cache);
+RcppExport SEXP _bcidat_envelope_bcidat(SEXP fileSEXP, SEXP fromSEXP, SEXP toSEXP, SEXP widthSEXP, SEXP channelsSEXP, SEXP rawSEXP, SEXP header_cacheSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type file(fileSEXP);
+    Rcpp::traits::input_parameter< double >::type from(fromSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type to(toSEXP);
+    Rcpp::traits::input_parameter< int >::type width(widthSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type channels(channelsSEXP);
+    Rcpp::traits::input_parameter< bool >::type raw(rawSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type header_cache(header_cacheSEXP);
+    rcpp_result_gen = Rcpp::wrap(envelope_bcidat(file, from, to, width, channels, raw, header_cache));
+    return rcpp_result_gen;
+END_RCPP
+}
+// psd_bcidat
+Rcpp::List psd_bcidat(std::string file, int window, double overlap, SEXP channels, SEXP state, bool raw, int threads, SEXP header_cache);
+RcppExport SEXP _bcidat_psd_bcidat(SEXP fileSEXP, SEXP windowSEXP, SEXP overlapSEXP, SEXP channelsSEXP, SEXP stateSEXP, SEXP rawSEXP, SEXP threadsSEXP, SEXP header_cacheSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type file(fileSEXP);
+    Rcpp::traits::input_parameter< int >::type window(windowSEXP);
+    Rcpp::traits::input_parameter< double >::type overlap(overlapSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type channels(channelsSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type state(stateSEXP);
+    Rcpp::traits::input_parameter< bool >::type raw(rawSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type header_cache(header_cacheSEXP);
+    rcpp_result_gen = Rcpp::wrap(psd_bcidat(file, window, overlap, channels, state, raw, threads, header_cache));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cov_bcidat
+Rcpp::List cov_bcidat(std::string file, SEXP channels, SEXP state, bool raw, int threads, SEXP header_cache);
+RcppExport SEXP _bcidat_cov_bcidat(SEXP fileSEXP, SEXP channelsSEXP, SEXP stateSEXP, SEXP rawSEXP, SEXP threadsSEXP, SEXP header_cacheSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type file(fileSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type channels(channelsSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type state(stateSEXP);
+    Rcpp::traits::input_parameter< bool >::type raw(rawSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type header_cache(header_cacheSEXP);
+    rcpp_result_gen = Rcpp::wrap(cov_bcidat(file, channels, state, raw, threads, header_cache));
+    return rcpp_result_gen;
+END_RCPP
+}
+// artifacts_bcidat
+Rcpp::List artifacts_bcidat(std::string file, int window, SEXP step, SEXP amplitude, SEXP peak_to_peak, SEXP flat, SEXP channels, SEXP state, bool raw, int threads, SEXP header_cache);
+RcppExport SEXP _bcidat_artifacts_bcidat(SEXP fileSEXP, SEXP windowSEXP, SEXP stepSEXP, SEXP amplitudeSEXP, SEXP peak_to_peakSEXP, SEXP flatSEXP, SEXP channelsSEXP, SEXP stateSEXP, SEXP rawSEXP, SEXP threadsSEXP, SEXP header_cacheSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type file(fileSEXP);
+    Rcpp::traits::input_parameter< int >::type window(windowSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type step(stepSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type amplitude(amplitudeSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type peak_to_peak(peak_to_peakSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type flat(flatSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type channels(channelsSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type state(stateSEXP);
+    Rcpp::traits::input_parameter< bool >::type raw(rawSEXP);
+    Rcpp::traits::input_parameter< int >::type threads(threadsSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type header_cache(header_cacheSEXP);
+    rcpp_result_gen = Rcpp::wrap(artifacts_bcidat(file, window, step, amplitude, peak_to_peak, flat, channels, state, raw, threads, header_cache));
+    return rcpp_result_gen;
+END_RCPP
+}
+// open_bcistream
+SEXP open_bcistream(std::string address, int capacity);
+RcppExport SEXP _bcidat_open_bcistream(SEXP addressSEXP, SEXP capacitySEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type address(addressSEXP);
+    Rcpp::traits::input_parameter< int >::type capacity(capacitySEXP);
+    rcpp_result_gen = Rcpp::wrap(open_bcistream(address, capacity));
+    return rcpp_result_gen;
+END_RCPP
+}
+// read_bcistream
+Rcpp::List read_bcistream(SEXP handle, int max_blocks, bool parameters, bool numeric_params);
+RcppExport SEXP _bcidat_read_bcistream(SEXP handleSEXP, SEXP max_blocksSEXP, SEXP parametersSEXP, SEXP numeric_paramsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type handle(handleSEXP);
+    Rcpp::traits::input_parameter< int >::type max_blocks(max_blocksSEXP);
+    Rcpp::traits::input_parameter< bool >::type parameters(parametersSEXP);
+    Rcpp::traits::input_parameter< bool >::type numeric_params(numeric_paramsSEXP);
+    rcpp_result_gen = Rcpp::wrap(read_bcistream(handle, max_blocks, parameters, numeric_params));
+    return rcpp_result_gen;
+END_RCPP
+}
+// close_bcistream
+void close_bcistream(SEXP handle);
+RcppExport SEXP _bcidat_close_bcistream(SEXP handleSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type handle(handleSEXP);
+    close_bcistream(handle);
+    return R_NilValue;
+END_RCPP
+}
+// write_bcidat
+void write_bcidat(std::string file, Rcpp::NumericMatrix signal, SEXP states, SEXP template_file, SEXP parameters, std::string format, bool raw);
+RcppExport SEXP _bcidat_write_bcidat(SEXP fileSEXP, SEXP signalSEXP, SEXP statesSEXP, SEXP template_fileSEXP, SEXP parametersSEXP, SEXP formatSEXP, SEXP rawSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type file(fileSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericMatrix >::type signal(signalSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type states(statesSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type template_file(template_fileSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type parameters(parametersSEXP);
+    Rcpp::traits::input_parameter< std::string >::type format(formatSEXP);
+    Rcpp::traits::input_parameter< bool >::type raw(rawSEXP);
+    write_bcidat(file, signal, states, template_file, parameters, format, raw);
+    return R_NilValue;
+END_RCPP
+}
+// crop_bcidat
+void crop_bcidat(std::string file, std::string output, double from, SEXP to, SEXP parameters);
+RcppExport SEXP _bcidat_crop_bcidat(SEXP fileSEXP, SEXP outputSEXP, SEXP fromSEXP, SEXP toSEXP, SEXP parametersSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type file(fileSEXP);
+    Rcpp::traits::input_parameter< std::string >::type output(outputSEXP);
+    Rcpp::traits::input_parameter< double >::type from(fromSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type to(toSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type parameters(parametersSEXP);
+    crop_bcidat(file, output, from, to, parameters);
+    return R_NilValue;
+END_RCPP
+}
+// concat_bcidat
+void concat_bcidat(std::vector<std::string> files, std::string output, SEXP parameters);
+RcppExport SEXP _bcidat_concat_bcidat(SEXP filesSEXP, SEXP outputSEXP, SEXP parametersSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::vector<std::string> >::type files(filesSEXP);
+    Rcpp::traits::input_parameter< std::string >::type output(outputSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type parameters(parametersSEXP);
+    concat_bcidat(files, output, parameters);
+    return R_NilValue;
+END_RCPP
+}
+// set_bcidat_state
+void set_bcidat_state(std::string file, std::string state, Rcpp::NumericVector value, Rcpp::NumericVector from, SEXP to);
+RcppExport SEXP _bcidat_set_bcidat_state(SEXP fileSEXP, SEXP stateSEXP, SEXP valueSEXP, SEXP fromSEXP, SEXP toSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type file(fileSEXP);
+    Rcpp::traits::input_parameter< std::string >::type state(stateSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type value(valueSEXP);
+    Rcpp::traits::input_parameter< Rcpp::NumericVector >::type from(fromSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type to(toSEXP);
+    set_bcidat_state(file, state, value, from, to);
+    return R_NilValue;
+END_RCPP
+}
+// write_bcidat_columns
+void write_bcidat_columns(std::string file, int chunk_samples);
+RcppExport SEXP _bcidat_write_bcidat_columns(SEXP fileSEXP, SEXP chunk_samplesSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type file(fileSEXP);
+    Rcpp::traits::input_parameter< int >::type chunk_samples(chunk_samplesSEXP);
+    write_bcidat_columns(file, chunk_samples);
+    return R_NilValue;
+END_RCPP
+}
+// write_bcidat_envelope
+void write_bcidat_envelope(std::string file, int bin_samples);
+RcppExport SEXP _bcidat_write_bcidat_envelope(SEXP fileSEXP, SEXP bin_samplesSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type file(fileSEXP);
+    Rcpp::traits::input_parameter< int >::type bin_samples(bin_samplesSEXP);
+    write_bcidat_envelope(file, bin_samples);
+    return R_NilValue;
+END_RCPP
+}
+// compress_bcidat
+void compress_bcidat(std::string file, SEXP output, int block_samples);
+RcppExport SEXP _bcidat_compress_bcidat(SEXP fileSEXP, SEXP outputSEXP, SEXP block_samplesSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< std::string >::type file(fileSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type output(outputSEXP);
+    Rcpp::traits::input_parameter< int >::type block_samples(block_samplesSEXP);
+    compress_bcidat(file, output, block_samples);
+    return R_NilValue;
+END_RCPP
+}
 // load_bcidat
-Rcpp::List load_bcidat(std::string file, bool raw);
-RcppExport SEXP _bcidat_load_bcidat(SEXP fileSEXP, SEXP rawSEXP) {
+Rcpp::List load_bcidat(std::string file, bool raw, bool numeric_params, bool param_units, SEXP header_cache, SEXP channels, SEXP states, int decimate, std::string state_decimation, SEXP filter, SEXP montage);
+RcppExport SEXP _bcidat_load_bcidat(SEXP fileSEXP, SEXP rawSEXP, SEXP numeric_paramsSEXP, SEXP param_unitsSEXP, SEXP header_cacheSEXP, SEXP channelsSEXP, SEXP statesSEXP, SEXP decimateSEXP, SEXP state_decimationSEXP, SEXP filterSEXP, SEXP montageSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< std::string >::type file(fileSEXP);
     Rcpp::traits::input_parameter< bool >::type raw(rawSEXP);
-    rcpp_result_gen = Rcpp::wrap(load_bcidat(file, raw));
+    Rcpp::traits::input_parameter< bool >::type numeric_params(numeric_paramsSEXP);
+    Rcpp::traits::input_parameter< bool >::type param_units(param_unitsSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type header_cache(header_cacheSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type channels(channelsSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type states(statesSEXP);
+    Rcpp::traits::input_parameter< int >::type decimate(decimateSEXP);
+    Rcpp::traits::input_parameter< std::string >::type state_decimation(state_decimationSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type filter(filterSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type montage(montageSEXP);
+    rcpp_result_gen = Rcpp::wrap(load_bcidat(file, raw, numeric_params, param_units, header_cache, channels, states, decimate, state_decimation, filter, montage));
     return rcpp_result_gen;
 END_RCPP
 }
 
 static const R_CallMethodDef CallEntries[] = {
-    {"_bcidat_load_bcidat", (DL_FUNC) &_bcidat_load_bcidat, 2},
+    {"_bcidat_open_bcidat", (DL_FUNC) &_bcidat_open_bcidat, 6},
+    {"_bcidat_read_bcidat", (DL_FUNC) &_bcidat_read_bcidat, 6},
+    {"_bcidat_poll_bcidat", (DL_FUNC) &_bcidat_poll_bcidat, 2},
+    {"_bcidat_open_bcidat_sampler", (DL_FUNC) &_bcidat_open_bcidat_sampler, 10},
+    {"_bcidat_sample_bcidat", (DL_FUNC) &_bcidat_sample_bcidat, 3},
+    {"_bcidat_scan_bcidat", (DL_FUNC) &_bcidat_scan_bcidat, 7},
+    {"_bcidat_envelope_bcidat", (DL_FUNC) &_bcidat_envelope_bcidat, 7},
+    {"_bcidat_psd_bcidat", (DL_FUNC) &_bcidat_psd_bcidat, 8},
+    {"_bcidat_cov_bcidat", (DL_FUNC) &_bcidat_cov_bcidat, 6},
+    {"_bcidat_artifacts_bcidat", (DL_FUNC) &_bcidat_artifacts_bcidat, 11},
+    {"_bcidat_open_bcistream", (DL_FUNC) &_bcidat_open_bcistream, 2},
+    {"_bcidat_read_bcistream", (DL_FUNC) &_bcidat_read_bcistream, 4},
+    {"_bcidat_close_bcistream", (DL_FUNC) &_bcidat_close_bcistream, 1},
+    {"_bcidat_write_bcidat", (DL_FUNC) &_bcidat_write_bcidat, 7},
+    {"_bcidat_crop_bcidat", (DL_FUNC) &_bcidat_crop_bcidat, 5},
+    {"_bcidat_concat_bcidat", (DL_FUNC) &_bcidat_concat_bcidat, 3},
+    {"_bcidat_set_bcidat_state", (DL_FUNC) &_bcidat_set_bcidat_state, 5},
+    {"_bcidat_write_bcidat_columns", (DL_FUNC) &_bcidat_write_bcidat_columns, 2},
+    {"_bcidat_write_bcidat_envelope", (DL_FUNC) &_bcidat_write_bcidat_envelope, 2},
+    {"_bcidat_compress_bcidat", (DL_FUNC) &_bcidat_compress_bcidat, 3},
+    {"_bcidat_load_bcidat", (DL_FUNC) &_bcidat_load_bcidat, 11},
     {NULL, NULL, 0}
 };
 
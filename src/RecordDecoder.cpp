@@ -0,0 +1,262 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: Decoders for the records of a BCI2000 data file, i.e. the
+//   signal values and state vector of a single sample.
+//   A decoder is selected once per file layout (data format, channel count,
+//   state vector length), and converts blocks of records into channel and
+//   state arrays in a single pass per record.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#include "PCHIncludes.h"
+#pragma hdrstop
+
+#include "RecordDecoder.h"
+#include "StateList.h"
+#include "ByteOrder.h"
+
+#include <cstring>
+#include <cmath>
+
+using namespace std;
+
+namespace
+{
+
+// Data values are stored in little endian byte order.
+template<typename T, typename U>
+struct LittleEndianValue
+{
+  enum { Size = sizeof( T ) };
+  static GenericSignal::ValueType Read( const char* p )
+  {
+    U u = LoadLittleEndian<U>( p );
+    T t;
+    ::memcpy( &t, &u, sizeof( T ) );
+    return t;
+  }
+};
+
+// BCI2000's float24 format consists of a 16 bit signed mantissa, followed
+// by an 8 bit signed decimal exponent. Powers of ten are taken from a table.
+class Float24Value
+{
+ public:
+  enum { Size = 3 };
+  static GenericSignal::ValueType Read( const char* p )
+  {
+    int16_t mantissa = static_cast<int16_t>( LoadLittleEndian<uint16_t>( p ) );
+    int8_t exponent = static_cast<int8_t>( p[ 2 ] );
+    return exponent == 0 ? mantissa : mantissa * sPowersOfTen.values[ exponent + 128 ];
+  }
+
+ private:
+  static const struct PowersOfTen
+  {
+    PowersOfTen()
+    {
+      for( int i = 0; i < 256; ++i )
+        values[ i ] = ::pow( 10.0, i - 128 );
+    }
+    double values[ 256 ];
+  } sPowersOfTen;
+};
+const Float24Value::PowersOfTen Float24Value::sPowersOfTen;
+
+// A decoder specialized for a data format, and for a channel count.
+// With Channels == 0, the channel count is taken from the layout at run time.
+template<class Format, int Channels_>
+class RecordDecoderT : public RecordDecoder
+{
+ public:
+  RecordDecoderT( SignalType inType, int inChannels, int inStateVectorLength, const StateList& inStates )
+  : RecordDecoder( inType, inChannels, inStateVectorLength, inStates )
+  {
+  }
+
+  GenericSignal::ValueType Value( const char* inRecord, int inChannel ) const
+  {
+    return Format::Read( inRecord + inChannel * Format::Size );
+  }
+
+  void Decode( const char* inRecords, size_t inCount, const Output& inOutput, size_t inOffset ) const
+  {
+    if( inOutput.gains )
+      DecodeT<true>( inRecords, inCount, inOutput, inOffset );
+    else
+      DecodeT<false>( inRecords, inCount, inOutput, inOffset );
+  }
+
+ private:
+  template<bool Calibrate>
+  void DecodeT( const char* inRecords, size_t inCount, const Output& inOutput, size_t inOffset ) const
+  {
+    const int channels = Channels_ > 0 ? Channels_ : Channels();
+    const size_t recordSize = RecordSize(),
+                 signalSize = channels * Format::Size;
+    const char* record = inRecords;
+    for( size_t i = 0; i < inCount; ++i, record += recordSize )
+    {
+      size_t idx = i + inOffset;
+      if( inOutput.signal )
+      {
+        GenericSignal::ValueType* p = inOutput.signal + idx;
+        for( int ch = 0; ch < channels; ++ch, p += inOutput.signalStride )
+        {
+          GenericSignal::ValueType value = Format::Read( record + ch * Format::Size );
+          *p = Calibrate ? ( value - inOutput.offsets[ ch ] ) * inOutput.gains[ ch ] : value;
+        }
+      }
+      if( inOutput.states )
+        DecodeStates( record + signalSize, inOutput, idx );
+    }
+  }
+};
+
+template<class Format>
+RecordDecoder*
+CreateDecoder( SignalType inType, int inChannels, int inStateVectorLength, const StateList& inStates )
+{
+  switch( inChannels )
+  {
+#define CHANNELS( n ) \
+    case n: return new RecordDecoderT<Format, n>( inType, inChannels, inStateVectorLength, inStates );
+    CHANNELS( 8 )
+    CHANNELS( 16 )
+    CHANNELS( 32 )
+    CHANNELS( 64 )
+    CHANNELS( 128 )
+    CHANNELS( 256 )
+#undef CHANNELS
+    default:
+      return new RecordDecoderT<Format, 0>( inType, inChannels, inStateVectorLength, inStates );
+  }
+}
+
+template<class Format>
+void
+DecodeValuesT( const char* inData, size_t inCount, GenericSignal::ValueType* outValues )
+{
+  for( size_t i = 0; i < inCount; ++i )
+    outValues[ i ] = Format::Read( inData + i * Format::Size );
+}
+
+} // namespace
+
+// **************************************************************************
+// Function:   DecodeValues
+// Purpose:    Decodes a run of values in a given data format.
+// Parameters: Data format, pointer to data, number of values, output array.
+// Returns:    False if the data format is not supported.
+// **************************************************************************
+bool
+RecordDecoder::DecodeValues( SignalType inType, const char* inData, size_t inCount, GenericSignal::ValueType* outValues )
+{
+  switch( inType )
+  {
+    case SignalType::int16:
+      DecodeValuesT< LittleEndianValue<int16_t, uint16_t> >( inData, inCount, outValues );
+      return true;
+    case SignalType::float24:
+      DecodeValuesT< Float24Value >( inData, inCount, outValues );
+      return true;
+    case SignalType::int32:
+      DecodeValuesT< LittleEndianValue<int32_t, uint32_t> >( inData, inCount, outValues );
+      return true;
+    case SignalType::float32:
+      DecodeValuesT< LittleEndianValue<float32_t, uint32_t> >( inData, inCount, outValues );
+      return true;
+    default:
+      return false;
+  }
+}
+
+// **************************************************************************
+// Function:   Create
+// Purpose:    Selects a decoder for the given record layout.
+// Parameters: Data format, number of channels, state vector length in bytes,
+//             state list.
+// Returns:    A new decoder object, owned by the caller, or NULL if the
+//             data format is not supported.
+// **************************************************************************
+RecordDecoder*
+RecordDecoder::Create( SignalType inType, int inChannels, int inStateVectorLength, const StateList& inStates )
+{
+  switch( inType )
+  {
+    case SignalType::int16:
+      return CreateDecoder< LittleEndianValue<int16_t, uint16_t> >( inType, inChannels, inStateVectorLength, inStates );
+    case SignalType::float24:
+      return CreateDecoder< Float24Value >( inType, inChannels, inStateVectorLength, inStates );
+    case SignalType::int32:
+      return CreateDecoder< LittleEndianValue<int32_t, uint32_t> >( inType, inChannels, inStateVectorLength, inStates );
+    case SignalType::float32:
+      return CreateDecoder< LittleEndianValue<float32_t, uint32_t> >( inType, inChannels, inStateVectorLength, inStates );
+    default:
+      return NULL;
+  }
+}
+
+RecordDecoder::RecordDecoder( SignalType inType, int inChannels, int inStateVectorLength, const StateList& inStates )
+: mType( inType ),
+  mChannels( inChannels ),
+  mStateVectorLength( inStateVectorLength ),
+  mRecordSize( inChannels * inType.Size() + inStateVectorLength )
+{
+  mStateFields.reserve( inStates.Size() );
+  for( int i = 0; i < inStates.Size(); ++i )
+  {
+    StateField f;
+    f.byteOffset = inStates[ i ].Location() / 8;
+    f.shift = inStates[ i ].Location() % 8;
+    f.length = inStates[ i ].Length();
+    f.mask = f.length < 64 ? ( uint64_t( 1 ) << f.length ) - 1 : ~uint64_t( 0 );
+    mStateFields.push_back( f );
+  }
+}
+
+// **************************************************************************
+// Function:   DecodeStates
+// Purpose:    Extracts all state values from a state vector, reading each
+//             state's bits with a single word load where possible.
+// Parameters: Pointer to state vector data, output arrays, output index.
+// Returns:    N/A
+// **************************************************************************
+void
+RecordDecoder::DecodeStates( const char* inStateVector, const Output& inOutput, size_t inIndex ) const
+{
+  const unsigned char* data = reinterpret_cast<const unsigned char*>( inStateVector );
+  double* p = inOutput.states + inIndex;
+  for( size_t i = 0; i < mStateFields.size(); ++i, p += inOutput.stateStride )
+  {
+    const StateField& f = mStateFields[ i ];
+    if( f.byteOffset >= static_cast<size_t>( mStateVectorLength ) )
+    {
+      *p = 0;
+      continue;
+    }
+    size_t available = mStateVectorLength - f.byteOffset;
+    uint64_t value = LoadLittleEndian( data + f.byteOffset, available < 8 ? available : 8 ) >> f.shift;
+    if( f.shift + f.length > 64 && available > 8 )
+      value |= uint64_t( data[ f.byteOffset + 8 ] ) << ( 64 - f.shift );
+    *p = static_cast<double>( value & f.mask );
+  }
+}
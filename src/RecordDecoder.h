@@ -0,0 +1,105 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: Decoders for the records of a BCI2000 data file, i.e. the
+//   signal values and state vector of a single sample.
+//   A decoder is selected once per file layout (data format, channel count,
+//   state vector length), and converts blocks of records into channel and
+//   state arrays in a single pass per record.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#ifndef RECORD_DECODER_H
+#define RECORD_DECODER_H
+
+#include "SignalType.h"
+#include "GenericSignal.h"
+#include <vector>
+#include <stdint.h>
+
+class StateList;
+
+class RecordDecoder
+{
+ public:
+  // Output arrays are column-major, i.e. the value of channel ch for the
+  // i-th decoded record goes into signal[ ch * signalStride + i ], and the
+  // value of state s into states[ s * stateStride + i ].
+  struct Output
+  {
+    Output()
+    : signal( 0 ), signalStride( 0 ), offsets( 0 ), gains( 0 ),
+      states( 0 ), stateStride( 0 ) {}
+    GenericSignal::ValueType* signal;
+    size_t signalStride;
+    // When gains are given, values are calibrated as ( raw - offset ) * gain.
+    const GenericSignal::ValueType* offsets,
+                                  * gains;
+    double* states;
+    size_t stateStride;
+  };
+
+  // Returns a decoder for the given layout, or NULL if the data format is
+  // not supported. States are decoded in the order of the state list.
+  static RecordDecoder* Create( SignalType, int channels, int stateVectorLength, const StateList& );
+  // Decodes count consecutive values of the given data format, as found in
+  // data files and in signal messages. Returns false if the format is not
+  // supported.
+  static bool DecodeValues( SignalType, const char* data, size_t count, GenericSignal::ValueType* );
+  virtual ~RecordDecoder() {}
+
+  SignalType Type() const
+    { return mType; }
+  int Channels() const
+    { return mChannels; }
+  int StateVectorLength() const
+    { return mStateVectorLength; }
+  size_t RecordSize() const
+    { return mRecordSize; }
+  // Byte offset of the state vector within a record.
+  size_t StateVectorOffset() const
+    { return mRecordSize - mStateVectorLength; }
+
+  // Raw value of a single channel from a record.
+  virtual GenericSignal::ValueType Value( const char* record, int channel ) const = 0;
+  // Decodes count consecutive records, writing the i-th record to output
+  // position i + outputOffset. Arrays that are NULL in the output are skipped.
+  virtual void Decode( const char* records, size_t count, const Output&, size_t outputOffset = 0 ) const = 0;
+
+ protected:
+  RecordDecoder( SignalType, int channels, int stateVectorLength, const StateList& );
+  void DecodeStates( const char* stateVector, const Output&, size_t index ) const;
+
+ private:
+  struct StateField
+  {
+    size_t byteOffset;
+    int    shift,
+           length;
+    uint64_t mask;
+  };
+  SignalType mType;
+  int mChannels,
+      mStateVectorLength;
+  size_t mRecordSize;
+  std::vector<StateField> mStateFields;
+};
+
+#endif // RECORD_DECODER_H
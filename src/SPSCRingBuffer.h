@@ -0,0 +1,107 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: A lock-free ring buffer for a single producer thread and a
+//   single consumer thread. Slots are allocated once, and are filled and
+//   read in place, so objects holding buffers of their own keep their
+//   allocations when slots are reused.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#ifndef SPSC_RING_BUFFER_H
+#define SPSC_RING_BUFFER_H
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+template<class T>
+class SPSCRingBuffer
+{
+ public:
+  // The capacity is rounded up to a power of two.
+  explicit SPSCRingBuffer( size_t capacity )
+  : mMask( RoundUp( capacity ) - 1 ),
+    mSlots( mMask + 1 ),
+    mWrite( 0 ),
+    mRead( 0 )
+  {
+  }
+
+ private:
+  SPSCRingBuffer( const SPSCRingBuffer& );
+  SPSCRingBuffer& operator=( const SPSCRingBuffer& );
+
+ public:
+  size_t Capacity() const
+    { return mSlots.size(); }
+  // Number of published slots not yet released. Exact only when called from
+  // the producer or consumer thread.
+  size_t Size() const
+    { return mWrite.load( std::memory_order_acquire ) - mRead.load( std::memory_order_acquire ); }
+  bool Empty() const
+    { return Size() == 0; }
+
+  // Producer side: WriteSlot() returns the next slot to fill, or NULL if the
+  // buffer is full. Publish() makes the filled slot visible to the consumer.
+  T* WriteSlot()
+  {
+    size_t write = mWrite.load( std::memory_order_relaxed );
+    if( write - mRead.load( std::memory_order_acquire ) > mMask )
+      return NULL;
+    return &mSlots[ write & mMask ];
+  }
+  void Publish()
+    { mWrite.store( mWrite.load( std::memory_order_relaxed ) + 1, std::memory_order_release ); }
+
+  // Consumer side: ReadSlot() returns the oldest published slot, or the
+  // index-th slot after it, or NULL if there is no such slot.
+  // Release() hands the given number of oldest slots back to the producer.
+  T* ReadSlot( size_t index = 0 )
+  {
+    size_t read = mRead.load( std::memory_order_relaxed );
+    if( mWrite.load( std::memory_order_acquire ) - read <= index )
+      return NULL;
+    return &mSlots[ ( read + index ) & mMask ];
+  }
+  void Release( size_t count = 1 )
+    { mRead.store( mRead.load( std::memory_order_relaxed ) + count, std::memory_order_release ); }
+
+ private:
+  static size_t RoundUp( size_t n )
+  {
+    size_t result = 1;
+    while( result < n )
+      result <<= 1;
+    return result;
+  }
+
+  const size_t mMask;
+  std::vector<T> mSlots;
+  // Keep the indices on separate cache lines, so producer and consumer
+  // do not invalidate each other's caches on every update.
+  char mPad0[ 64 ];
+  std::atomic<size_t> mWrite;
+  char mPad1[ 64 ];
+  std::atomic<size_t> mRead;
+  char mPad2[ 64 ];
+};
+
+#endif // SPSC_RING_BUFFER_H
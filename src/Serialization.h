@@ -0,0 +1,115 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: Helpers for the compact binary representation of BCI2000
+//   types, as used by the Serialize()/Unserialize() member functions.
+//   The representation is in host byte order, and is meant for local caches
+//   rather than for data exchange.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#ifndef SERIALIZATION_H
+#define SERIALIZATION_H
+
+#include "ByteOrder.h"
+
+#include <iostream>
+#include <string>
+#include <algorithm>
+#include <cstdio>
+#include <stdint.h>
+
+namespace Serialization
+{
+  // Fixed-size values are written as their memory representation.
+  template<typename T>
+  std::ostream& Put( std::ostream& os, const T& t )
+  { return os.write( reinterpret_cast<const char*>( &t ), sizeof( T ) ); }
+
+  template<typename T>
+  std::istream& Get( std::istream& is, T& t )
+  { return is.read( reinterpret_cast<char*>( &t ), sizeof( T ) ); }
+
+  template<typename T>
+  bool Get( std::FILE* f, T& t )
+  { return ::fread( &t, sizeof( T ), 1, f ) == 1; }
+
+  // Integers written in little endian byte order, for files that are read
+  // on other machines.
+  template<typename T>
+  std::ostream& PutLittleEndian( std::ostream& os, T t )
+  {
+    unsigned char data[sizeof( T )];
+    StoreLittleEndian( data, sizeof( T ), static_cast<uint64_t>( t ) );
+    return os.write( reinterpret_cast<const char*>( data ), sizeof( T ) );
+  }
+
+  template<typename T>
+  bool GetLittleEndian( std::FILE* f, T& t )
+  {
+    unsigned char data[sizeof( T )];
+    if( ::fread( data, sizeof( T ), 1, f ) != 1 )
+      return false;
+    t = static_cast<T>( LoadLittleEndian( data, sizeof( T ) ) );
+    return true;
+  }
+
+  // Strings are written as a 32 bit length field, followed by their content.
+  inline
+  std::ostream& PutString( std::ostream& os, const std::string& s )
+  {
+    uint32_t length = static_cast<uint32_t>( s.length() );
+    return Put( os, length ).write( s.data(), length );
+  }
+
+  inline
+  std::istream& GetString( std::istream& is, std::string& s )
+  {
+    uint32_t length = 0;
+    if( Get( is, length ) )
+    { // Grow the string in bounded steps, so a corrupt length field fails
+      // at the end of input rather than allocating a huge buffer first.
+      const uint32_t cChunk = 1 << 16;
+      s.clear();
+      while( is && s.length() < length )
+      {
+        size_t pos = s.length(),
+               count = std::min<size_t>( cChunk, length - pos );
+        s.resize( pos + count );
+        if( !is.read( &s[pos], count ) )
+          s.resize( pos + is.gcount() );
+      }
+    }
+    return is;
+  }
+
+  // A stream buffer reading from a memory block without copying it.
+  class MemoryBuffer : public std::streambuf
+  {
+   public:
+    MemoryBuffer( const char* inData, size_t inLength )
+    {
+      char* p = const_cast<char*>( inData );
+      setg( p, p, p + inLength );
+    }
+  };
+} // namespace Serialization
+
+#endif // SERIALIZATION_H
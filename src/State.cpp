@@ -30,6 +30,7 @@
 #include "StateVector.h"
 #include "BCIException.h"
 #include "BCIAssert.h"
+#include "Serialization.h"
 
 #include <sstream>
 #include <map>
@@ -173,6 +174,55 @@ State::WriteBinary( ostream& os ) const
   return os.write( "\r\n", 2 );
 }
 
+// **************************************************************************
+// Function:   Serialize
+// Purpose:    Member function for output of a single state in a compact
+//             binary representation, as used for header caching.
+// Parameters: Output stream to write into.
+// Returns:    Output stream written into.
+// **************************************************************************
+ostream&
+State::Serialize( ostream& os ) const
+{
+  using namespace Serialization;
+  PutString( os, mName );
+  Put( os, static_cast<uint64_t>( mValue ) );
+  Put( os, static_cast<uint32_t>( mLocation ) );
+  Put( os, static_cast<uint32_t>( mLength ) );
+  return Put( os, static_cast<int32_t>( mKind ) );
+}
+
+// **************************************************************************
+// Function:   Unserialize
+// Purpose:    Member function for input of a single state from its compact
+//             binary representation.
+// Parameters: Input stream to read from.
+// Returns:    Input stream read from.
+// **************************************************************************
+istream&
+State::Unserialize( istream& is )
+{
+  using namespace Serialization;
+  *this = State();
+  mModified = true;
+  uint64_t value = 0;
+  uint32_t location = 0,
+           length = 0;
+  int32_t kind = StateKind;
+  GetString( is, mName );
+  Get( is, value );
+  Get( is, location );
+  Get( is, length );
+  Get( is, kind );
+  mValue = static_cast<ValueType>( value );
+  mLocation = location;
+  mLength = length;
+  mKind = kind;
+  if( mLength > 8 * sizeof( ValueType ) )
+    is.setstate( ios::failbit );
+  return is;
+}
+
 // **************************************************************************
 // Function:   SetValue
 // Purpose:    Sets this state's value
@@ -80,6 +80,8 @@ class State
   std::istream& ReadFromStream( std::istream& );
   std::ostream& WriteBinary( std::ostream& ) const;
   std::istream& ReadBinary( std::istream& );
+  std::ostream& Serialize( std::ostream& ) const;
+  std::istream& Unserialize( std::istream& );
 
   class NameCmp
   {
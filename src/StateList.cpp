@@ -29,6 +29,7 @@
 #include "StateList.h"
 
 #include "BCIException.h"
+#include "Serialization.h"
 
 #include <sstream>
 #include <algorithm>
@@ -266,6 +267,43 @@ StateList::ReadBinary( istream& is )
   return ReadFromStream( is );
 }
 
+// **************************************************************************
+// Function:   Serialize
+// Purpose:    Member function for output of the entire state list in a
+//             compact binary representation, including state locations.
+// Parameters: Output stream to write into.
+// Returns:    Output stream written into.
+// **************************************************************************
+ostream&
+StateList::Serialize( ostream& os ) const
+{
+  Serialization::Put( os, static_cast<uint32_t>( Size() ) );
+  for( int i = 0; i < Size(); ++i )
+    ( *this )[ i ].Serialize( os );
+  return os;
+}
+
+// **************************************************************************
+// Function:   Unserialize
+// Purpose:    Member function for input of the entire state list from its
+//             compact binary representation. The list is cleared before
+//             reading.
+// Parameters: Input stream to read from.
+// Returns:    Input stream read from.
+// **************************************************************************
+istream&
+StateList::Unserialize( istream& is )
+{
+  Clear();
+  uint32_t count = 0;
+  Serialization::Get( is, count );
+  State state;
+  for( uint32_t i = 0; is && i < count; ++i )
+    if( state.Unserialize( is ) )
+      Add( state );
+  return is;
+}
+
 // **************************************************************************
 // Function:   AssignPositions
 // Purpose:    assigns positions to states contained in the list
@@ -73,6 +73,8 @@ class StateList : private StateContainer
   std::istream& ReadFromStream( std::istream& );
   std::ostream& WriteBinary( std::ostream& ) const;
   std::istream& ReadBinary( std::istream& );
+  std::ostream& Serialize( std::ostream& ) const;
+  std::istream& Unserialize( std::istream& );
 
  private:
   void RebuildIndex();
@@ -34,32 +34,131 @@
 
 #include <sstream>
 #include <iomanip>
+#include <cstring>
+#include <utility>
 
 using namespace std;
 
 StateVector::StateVector()
-: mpStateList( NULL )
+: mpStateList( NULL ),
+  mByteLength( 0 )
 {
 }
 
 StateVector::StateVector( class StateList& inList, size_t inSamples )
-: mpStateList( &inList )
+: mpStateList( &inList ),
+  mByteLength( 0 )
 {
-  mSamples.resize( inSamples, StateVectorSample( mpStateList->ByteLength() ) );
-  // initialize the content in the state vector, according to the content
-  // of the current states in the state list
-  for( int i = 0; i < mpStateList->Size(); ++i )
-    SetStateValue( ( *mpStateList )[ i ].Name(), ( *mpStateList )[ i ].Value() );
+  Allocate( mpStateList->ByteLength(), inSamples );
+  if( inSamples > 0 )
+  {
+    // initialize the content in the state vector, according to the content
+    // of the current states in the state list
+    for( int i = 0; i < mpStateList->Size(); ++i )
+    {
+      const State& s = ( *mpStateList )[ i ];
+      mSamples[ 0 ].SetStateValue( s.Location(), s.Length(), s.Value() );
+    }
+    for( size_t i = 1; i < inSamples; ++i )
+      ::memcpy( mSamples[ i ].Data(), mSamples[ 0 ].Data(), mByteLength );
+  }
+}
+
+StateVector::StateVector( const StateVector& inOther )
+: mpStateList( inOther.mpStateList ),
+  mByteLength( 0 )
+{
+  *this = inOther;
+}
+
+StateVector::StateVector( StateVector&& inOther ) noexcept
+: mpStateList( inOther.mpStateList ),
+  mByteLength( inOther.mByteLength ),
+  mBuffer( std::move( inOther.mBuffer ) ),
+  mSamples( std::move( inOther.mSamples ) )
+{ // Moving the buffer leaves its address unchanged, so views remain valid.
+  inOther.mByteLength = 0;
+  inOther.mBuffer.clear();
+  inOther.mSamples.clear();
+}
+
+StateVector&
+StateVector::operator=( const StateVector& inOther )
+{
+  if( &inOther != this )
+  {
+    mpStateList = inOther.mpStateList;
+    Allocate( inOther.mByteLength, inOther.mSamples.size() );
+    ::memcpy( Data(), inOther.Data(), mByteLength * mSamples.size() );
+  }
+  return *this;
+}
+
+StateVector&
+StateVector::operator=( StateVector&& inOther ) noexcept
+{
+  if( &inOther != this )
+  {
+    mpStateList = inOther.mpStateList;
+    mByteLength = inOther.mByteLength;
+    mBuffer.swap( inOther.mBuffer );
+    mSamples.swap( inOther.mSamples );
+  }
+  return *this;
+}
+
+// **************************************************************************
+// Function:   Allocate
+// Purpose:    Allocates a single buffer for all samples, and creates the
+//             samples as views into it. Existing data are kept only if the
+//             dimensions are unchanged.
+// Parameters: byteLength ... length of a sample in bytes
+//             samples    ... number of samples
+// Returns:    N/A
+// **************************************************************************
+void
+StateVector::Allocate( size_t inByteLength, size_t inSamples )
+{
+  size_t bytes = inByteLength * inSamples;
+  if( inByteLength == mByteLength && inSamples == mSamples.size() )
+    return;
+  mByteLength = inByteLength;
+  mBuffer.assign( ( bytes + sizeof( uint64_t ) - 1 ) / sizeof( uint64_t ), 0 );
+  mSamples.clear();
+  mSamples.reserve( inSamples );
+  unsigned char* p = Data();
+  for( size_t i = 0; i < inSamples; ++i, p += inByteLength )
+    mSamples.push_back( StateVectorSample( p, inByteLength ) );
 }
 
+// **************************************************************************
+// Function:   CopyFromMasked
+// Purpose:    copies state values from another state vector, sample by
+//             sample, copying only bits that are set in a mask. Without a
+//             mask, the contiguous buffer is copied at once.
+// Parameters: vector ... state vector to copy from, with the same number of
+//                        samples
+//             mask   ... StateVectorSample holding the bits to copy, or an
+//                        empty sample to copy all bits
+// Returns:    the calling instance
+// **************************************************************************
 const StateVector&
 StateVector::CopyFromMasked( const StateVector& inVector, const StateVectorSample& inMask )
 {
   if( &inVector == this )
     return *this;
   bciassert( this->Samples() == inVector.Samples() );
-  for( int i = 0; i < this->Samples(); ++i )
-    ( *this )( i ).CopyFromMasked( inVector( i ), inMask );
+  if( inMask.Length() == 0 )
+  {
+    bciassert( this->Length() == inVector.Length() );
+    ::memcpy( Data(), inVector.Data(), mByteLength * mSamples.size() );
+  }
+  else
+  {
+    bciassert( this->Length() == inMask.Length() && inVector.Length() == inMask.Length() );
+    for( int i = 0; i < this->Samples(); ++i )
+      StateVectorSample::CopyMasked( mSamples[ i ].Data(), inVector.mSamples[ i ].Data(), inMask.Data(), mByteLength );
+  }
   return *this;
 }
 
@@ -67,6 +166,7 @@ StateVector::CopyFromMasked( const StateVector& inVector, const StateVectorSampl
 // Function:   StateValue
 // Purpose:    returns a state's value from the state vector block
 // Parameters: statename - the name of a state
+//             sample - sample position for which to return the state's value
 // Returns:    the value of the state
 //             0 on error (e.g., state not found)
 // **************************************************************************
@@ -218,12 +318,14 @@ StateVector::ReadBinary( istream& is )
   int length, samples;
   ( is >> length ).get();
   ( is >> samples ).get();
-  if( length != Length() )
-    mSamples.clear();
-  if( samples != Samples() )
-    mSamples.resize( samples, StateVectorSample( length ) );
-  for( size_t i = 0; i < mSamples.size(); ++i )
-    mSamples[ i ].ReadBinary( is );
+  if( length < 0 || samples < 0 )
+    is.setstate( ios::failbit );
+  else
+  {
+    Allocate( length, samples );
+    for( size_t i = 0; i < mSamples.size(); ++i )
+      mSamples[ i ].ReadBinary( is );
+  }
   return is;
 }
 
@@ -29,6 +29,7 @@
 
 #include <iostream>
 #include <vector>
+#include <stdint.h>
 #include "StateVectorSample.h"
 
 class StateVector
@@ -36,6 +37,10 @@ class StateVector
  public:
   StateVector();
   explicit StateVector( class StateList& list, size_t numSamples = 1 );
+  StateVector( const StateVector& );
+  StateVector( StateVector&& ) noexcept;
+  StateVector& operator=( const StateVector& );
+  StateVector& operator=( StateVector&& ) noexcept;
 
  public:
   const StateVector& CopyFromMasked( const StateVector&, const StateVectorSample& mask );
@@ -43,13 +48,19 @@ class StateVector
   int            Samples() const
                  { return static_cast<int>( mSamples.size() ); }
   int            Length() const
-                 { return mSamples.empty() ? 0 : mSamples[0].Length(); }
+                 { return static_cast<int>( mByteLength ); }
   StateVectorSample& operator()( size_t inIdx )
                  { return mSamples[ inIdx ]; }
   const StateVectorSample& operator()( size_t inIdx ) const
                  { return mSamples[ inIdx ]; }
   const class StateList& StateList() const
                  { return *mpStateList; }
+  // All samples are stored back to back in a single buffer of
+  // Samples() * Length() bytes.
+  unsigned char* Data()
+                 { return reinterpret_cast<unsigned char*>( mBuffer.data() ); }
+  const unsigned char* Data() const
+                 { return reinterpret_cast<const unsigned char*>( mBuffer.data() ); }
 
   State::ValueType StateValue( const std::string& name, size_t sample = 0 ) const;
   State::ValueType StateValue( size_t location, size_t length, size_t sample = 0 ) const;
@@ -66,8 +77,12 @@ class StateVector
   std::istream&  ReadBinary( std::istream& );
 
  private:
+  void           Allocate( size_t byteLength, size_t samples );
+
   class StateList*               mpStateList;
-  std::vector<StateVectorSample> mSamples;
+  size_t                         mByteLength;
+  std::vector<uint64_t>          mBuffer;  // word-aligned storage for all samples
+  std::vector<StateVectorSample> mSamples; // views into mBuffer
 };
 
 
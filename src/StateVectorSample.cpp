@@ -34,34 +34,57 @@
 #include <sstream>
 #include <iomanip>
 #include <climits>
+#include <cstring>
+#include <utility>
+#include <stdint.h>
 
 using namespace std;
 
 StateVectorSample::StateVectorSample( const StateVectorSample& s )
-: mByteLength( 0 ),
-  mpData( NULL )
+: mByteLength( s.mByteLength ),
+  mpData( new unsigned char[ s.mByteLength ] ),
+  mOwnsData( true )
 {
-  this->operator=( s );
+  ::memcpy( mpData, s.mpData, mByteLength );
 }
 
 StateVectorSample::StateVectorSample( size_t inByteLength )
 : mByteLength( inByteLength ),
-  mpData( NULL )
+  mpData( new unsigned char[ inByteLength ] ),
+  mOwnsData( true )
 {
-  mpData = new unsigned char[ mByteLength ];
   // at the very beginning, initialize the state vector to all 0 bytes
-  for( size_t i = 0; i < mByteLength; ++i )
-    mpData[ i ] = 0;
+  ::memset( mpData, 0, mByteLength );
+}
+
+StateVectorSample::StateVectorSample( unsigned char* inData, size_t inByteLength )
+: mByteLength( inByteLength ),
+  mpData( inData ),
+  mOwnsData( false )
+{
+}
+
+StateVectorSample::StateVectorSample( StateVectorSample&& s ) noexcept
+: mByteLength( s.mByteLength ),
+  mpData( s.mpData ),
+  mOwnsData( s.mOwnsData )
+{ // Moving a view yields a view of the same data.
+  s.mByteLength = 0;
+  s.mpData = NULL;
+  s.mOwnsData = false;
 }
 
 StateVectorSample::~StateVectorSample()
 {
-  delete[] mpData;
+  if( mOwnsData )
+    delete[] mpData;
 }
 
 // **************************************************************************
 // Function:   operator=
-// Purpose:    Make a deep copy of a StateVectorSample object.
+// Purpose:    Make a deep copy of a StateVectorSample object. A sample that
+//             is a view into a StateVector's buffer keeps its storage, and
+//             only accepts samples of its own length.
 // Parameters: StateVectorSample to copy from.
 // Returns:    Calling instance.
 // **************************************************************************
@@ -70,20 +93,48 @@ StateVectorSample::operator=( const StateVectorSample& s )
 {
   if( &s != this )
   {
-    mByteLength = s.mByteLength;
-    delete[] mpData;
-    mpData = new unsigned char[ mByteLength ];
+    if( s.mByteLength != mByteLength )
+    {
+      if( !mOwnsData )
+        throw std_length_error(
+          "Cannot assign a state vector sample of length " << s.mByteLength
+          << " to a view of length " << mByteLength
+        );
+      delete[] mpData;
+      mpData = new unsigned char[ s.mByteLength ];
+      mByteLength = s.mByteLength;
+    }
     ::memcpy( mpData, s.mpData, mByteLength );
   }
   return *this;
 }
 
+// **************************************************************************
+// Function:   operator=
+// Purpose:    Move a StateVectorSample object. Storage is exchanged when
+//             both samples own their data; otherwise, data are copied.
+// Parameters: StateVectorSample to move from.
+// Returns:    Calling instance.
+// **************************************************************************
+StateVectorSample&
+StateVectorSample::operator=( StateVectorSample&& s )
+{
+  if( mOwnsData && s.mOwnsData )
+  {
+    std::swap( mByteLength, s.mByteLength );
+    std::swap( mpData, s.mpData );
+  }
+  else
+    operator=( static_cast<const StateVectorSample&>( s ) );
+  return *this;
+}
+
 // **************************************************************************
 // Function:   CopyFromMasked
 // Purpose:    Make a deep copy of a StateVectorSample object, copying only
 //             bits that are set in a mask.
 // Parameters: StateVectorSample to copy from,
-//             mask as a std::string.
+//             mask as a StateVectorSample; an empty mask copies all bits.
 // Returns:    Calling instance.
 // **************************************************************************
 const StateVectorSample&
@@ -97,14 +148,39 @@ StateVectorSample::CopyFromMasked( const StateVectorSample& inSample, const Stat
   bciassert( inSample.Length() == inMask.Length() );
   bciassert( inSample.Length() == this->Length() );
 
-  for( size_t i = 0; i < mByteLength; ++i )
-  {
-    mpData[i] &= ~inMask.mpData[i];
-    mpData[i] |= inSample.mpData[i] & inMask.mpData[i];
-  }
+  CopyMasked( mpData, inSample.mpData, inMask.mpData, mByteLength );
   return *this;
 }
 
+// **************************************************************************
+// Function:   CopyMasked
+// Purpose:    Copies the bits that are set in a mask from one block of
+//             state vector data into another, a 64-bit word at a time.
+// Parameters: dest ... data to copy into
+//             src  ... data to copy from
+//             mask ... bits to copy
+//             byteLength ... length of each of the blocks
+// Returns:    N/A
+// **************************************************************************
+void
+StateVectorSample::CopyMasked( unsigned char* ioDest, const unsigned char* inSrc,
+                               const unsigned char* inMask, size_t inByteLength )
+{
+  typedef uint64_t Word;
+  size_t i = 0;
+  for( ; i + sizeof( Word ) <= inByteLength; i += sizeof( Word ) )
+  { // memcpy() compiles into plain loads and stores, without alignment requirements
+    Word d, s, m;
+    ::memcpy( &d, ioDest + i, sizeof( Word ) );
+    ::memcpy( &s, inSrc + i, sizeof( Word ) );
+    ::memcpy( &m, inMask + i, sizeof( Word ) );
+    d = ( d & ~m ) | ( s & m );
+    ::memcpy( ioDest + i, &d, sizeof( Word ) );
+  }
+  for( ; i < inByteLength; ++i )
+    ioDest[ i ] = ( ioDest[ i ] & ~inMask[ i ] ) | ( inSrc[ i ] & inMask[ i ] );
+}
+
 // **************************************************************************
 // Function:   StateValue
 // Purpose:    returns a state's value, based upon the state's location and size
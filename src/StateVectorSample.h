@@ -32,11 +32,17 @@
 
 class StateVectorSample
 {
+  friend class StateVector; // creates views into its sample buffer
+
  public:
   StateVectorSample( const StateVectorSample& );
   explicit StateVectorSample( size_t byteLength );
   ~StateVectorSample();
+  // Assignment copies data into the existing buffer, which may be a view
+  // into a StateVector's buffer.
   const StateVectorSample& operator=( const StateVectorSample& );
+  StateVectorSample( StateVectorSample&& ) noexcept;
+  StateVectorSample& operator=( StateVectorSample&& );
   // CopyFromMasked() copies bits that are set to 1 in the mask.
   const StateVectorSample& CopyFromMasked( const StateVectorSample&, const StateVectorSample& mask );
 
@@ -54,10 +60,17 @@ class StateVectorSample
   std::ostream&  WriteBinary( std::ostream& ) const;
   std::istream&  ReadBinary( std::istream& );
 
+  // Masked copy of a raw buffer of byteLength bytes, one machine word at a time.
+  static void    CopyMasked( unsigned char* dest, const unsigned char* src,
+                             const unsigned char* mask, size_t byteLength );
+
  private:
+  // A view refers to data owned by someone else.
+  StateVectorSample( unsigned char* data, size_t byteLength );
   void           SetStateValue_( size_t, size_t, State::ValueType );
   size_t         mByteLength; // the length of the binary representation
   unsigned char* mpData;      // binary state data
+  bool           mOwnsData;
 };
 
 #endif // STATE_VECTOR_SAMPLE_H
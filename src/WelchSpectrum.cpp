@@ -0,0 +1,163 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: Welch estimate of the power spectral density of each channel,
+//   accumulated over chunks of samples in a single pass. Windows overlap,
+//   and are kept apart by the value of a condition, e.g. a state, so
+//   spectra of conditions are estimated separately.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#include "PCHIncludes.h"
+#pragma hdrstop
+
+#include "WelchSpectrum.h"
+#include "BCIException.h"
+#include "NumericConstants.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+WelchSpectrum::WelchSpectrum( int inChannels, int inLength, int inStep, long long inOrigin, bool inConditions )
+: WindowedAccumulator( inChannels, inLength, inStep, inOrigin, inConditions, true ),
+  mFFT( max( inLength, 1 ) )
+{
+  if( inLength < 2 )
+    throw std_range_error( "Window length must be at least 2, is " << inLength );
+  mWindow.resize( inLength );
+  for( int t = 0; t < inLength; ++t )
+    mWindow[ t ] = 0.5 - 0.5 * ::cos( 2 * Pi() * t / inLength );
+  const size_t pairs = ( inChannels + 1 ) / 2;
+  mRe.resize( inLength * pairs + 1 );
+  mIm.resize( inLength * pairs + 1 );
+}
+
+void
+WelchSpectrum::Merge( const WelchSpectrum& inOther )
+{
+  MergeWindows( inOther );
+  for( ConditionMap::const_iterator i = inOther.mConditions.begin(); i != inOther.mConditions.end(); ++i )
+  {
+    Condition& c = mConditions[ i->first ];
+    c.power.resize( i->second.power.size() );
+    c.windows += i->second.windows;
+    for( size_t j = 0; j < c.power.size(); ++j )
+      c.power[ j ] += i->second.power[ j ];
+  }
+}
+
+// **************************************************************************
+// Function:   Window
+// Purpose:    Adds a window's squared magnitudes to its condition. Pairs of
+//             channels are transformed together as the real and imaginary
+//             part of a complex signal, and separated using the symmetry of
+//             real signal transforms: with Z = FFT( x + i y ),
+//             X[ k ] = ( Z[ k ] + Z*[ n - k ] ) / 2 and
+//             Y[ k ] = ( Z[ k ] - Z*[ n - k ] ) / 2i.
+// Parameters: start - first sample of the window
+//             data - Length() samples, with channels innermost
+//             condition - the window's condition value
+// Returns:    N/A
+// **************************************************************************
+void
+WelchSpectrum::Window( long long, const double* inData, double inCondition )
+{
+  const int C = Channels(),
+            pairs = ( C + 1 ) / 2,
+            n = Length();
+  vector<double> mean( C + 1, 0.0 );
+  for( int t = 0; t < n; ++t )
+    for( int ch = 0; ch < C; ++ch )
+      mean[ ch ] += inData[ t * C + ch ];
+  for( int ch = 0; ch < C; ++ch )
+    mean[ ch ] /= n;
+  for( int t = 0; t < n; ++t )
+  {
+    const double* x = inData + t * C;
+    const double w = mWindow[ t ];
+    double* re = &mRe[ t * pairs ],
+          * im = &mIm[ t * pairs ];
+    for( int b = 0; b < C / 2; ++b )
+    {
+      re[ b ] = ( x[ 2 * b ] - mean[ 2 * b ] ) * w;
+      im[ b ] = ( x[ 2 * b + 1 ] - mean[ 2 * b + 1 ] ) * w;
+    }
+    if( C % 2 )
+    {
+      re[ pairs - 1 ] = ( x[ C - 1 ] - mean[ C - 1 ] ) * w;
+      im[ pairs - 1 ] = 0;
+    }
+  }
+  mFFT.Transform( &mRe[ 0 ], &mIm[ 0 ], pairs );
+
+  Condition& c = mConditions[ inCondition ];
+  c.power.resize( Bins() * C );
+  ++c.windows;
+  for( int k = 0; k < Bins(); ++k )
+  {
+    const double* zRe = &mRe[ k * pairs ],
+                * zIm = &mIm[ k * pairs ],
+                * nRe = &mRe[ ( n - k ) % n * pairs ],
+                * nIm = &mIm[ ( n - k ) % n * pairs ];
+    double* power = &c.power[ k * C ];
+    for( int b = 0; b < C / 2; ++b )
+    {
+      const double xr = zRe[ b ] + nRe[ b ], xi = zIm[ b ] - nIm[ b ],
+                   yr = zRe[ b ] - nRe[ b ], yi = zIm[ b ] + nIm[ b ];
+      power[ 2 * b ] += 0.25 * ( xr * xr + xi * xi );
+      power[ 2 * b + 1 ] += 0.25 * ( yr * yr + yi * yi );
+    }
+    if( C % 2 )
+      power[ C - 1 ] += zRe[ pairs - 1 ] * zRe[ pairs - 1 ] + zIm[ pairs - 1 ] * zIm[ pairs - 1 ];
+  }
+}
+
+// **************************************************************************
+// Function:   Density
+// Purpose:    Scales the average of squared magnitudes into a one-sided
+//             power spectral density. Power at frequencies other than 0 and
+//             the Nyquist frequency is doubled, to include the negative
+//             frequencies.
+// Parameters: condition - condition
+//             samplingRate - sampling rate in Hz
+// Returns:    Densities, with frequencies innermost.
+// **************************************************************************
+vector<double>
+WelchSpectrum::Density( const Condition& inCondition, double inSamplingRate ) const
+{
+  const int bins = Bins();
+  const int C = Channels();
+  vector<double> density( static_cast<size_t>( bins ) * C, 0.0 );
+  if( inCondition.windows == 0 || inCondition.power.empty() )
+    return density;
+  double sumSquares = 0;
+  for( size_t t = 0; t < mWindow.size(); ++t )
+    sumSquares += mWindow[ t ] * mWindow[ t ];
+  const double scale = 1.0 / ( inSamplingRate * sumSquares * inCondition.windows );
+  for( int k = 0; k < bins; ++k )
+  {
+    const double factor = ( k == 0 || 2 * k == Length() ) ? scale : 2 * scale;
+    for( int ch = 0; ch < C; ++ch )
+      density[ ch * bins + k ] = inCondition.power[ k * C + ch ] * factor;
+  }
+  return density;
+}
@@ -0,0 +1,76 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: Welch estimate of the power spectral density of each channel,
+//   accumulated over chunks of samples in a single pass. Windows overlap,
+//   and are kept apart by the value of a condition, e.g. a state, so
+//   spectra of conditions are estimated separately.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#ifndef WELCH_SPECTRUM_H
+#define WELCH_SPECTRUM_H
+
+#include "WindowedAccumulator.h"
+#include "FFT.h"
+
+#include <vector>
+#include <map>
+
+// Windows that span a change of condition are skipped. Each window has its
+// mean removed, and is multiplied with a periodic Hann window before its
+// transform. Windows that span the boundary between ranges are computed
+// when merging, so results do not depend on how the scanned range is split.
+class WelchSpectrum : public WindowedAccumulator
+{
+ public:
+  struct Condition
+  {
+    long long windows;
+    // sums of squared magnitudes, with channels innermost
+    std::vector<double> power;
+  };
+  typedef std::map<double, Condition> ConditionMap;
+
+  WelchSpectrum( int channels, int length, int step, long long origin, bool conditions );
+
+  // Number of frequency bins, from 0 to the Nyquist frequency.
+  int Bins() const
+    { return Length() / 2 + 1; }
+
+  void Merge( const WelchSpectrum& );
+
+  const ConditionMap& Conditions() const
+    { return mConditions; }
+  // Power spectral density, one-sided, in squared units per Hz, as
+  // density[ ch * Bins() + k ] for frequency k * samplingRate / Length().
+  std::vector<double> Density( const Condition&, double samplingRate ) const;
+
+ private:
+  void Window( long long start, const double* data, double condition );
+
+  std::vector<double> mWindow;
+  FFT mFFT;
+  std::vector<double> mRe,
+                      mIm;
+  ConditionMap mConditions;
+};
+
+#endif // WELCH_SPECTRUM_H
@@ -0,0 +1,514 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: Draws random windows of fixed length from a set of data
+//   files, optionally stratified by the value of a state, and decodes
+//   batches of windows into a float array. Reads are sorted and coalesced
+//   per file, so random windows are read near-sequentially.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#include "PCHIncludes.h"
+#pragma hdrstop
+
+#include "WindowSampler.h"
+#include "BCI2000FileReader.h"
+#include "BCI2000FileScanner.h"
+#include "BCIException.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <limits>
+#include <map>
+#include <thread>
+
+using namespace std;
+
+// Collects runs of a constant state value while scanning a file.
+class WindowSampler::RunScan
+{
+ public:
+  void Add( const BCI2000FileScanner::Chunk& );
+  void Merge( const RunScan& );
+
+  vector<Run> runs;
+
+ private:
+  void Append( long long start, long long length, double value );
+};
+
+void
+WindowSampler::RunScan::Add( const BCI2000FileScanner::Chunk& inChunk )
+{
+  for( long long i = 0; i < inChunk.count; ++i )
+    Append( inChunk.sample + i, 1, inChunk.states[ i ] );
+}
+
+void
+WindowSampler::RunScan::Merge( const RunScan& inOther )
+{
+  for( size_t i = 0; i < inOther.runs.size(); ++i )
+    Append( inOther.runs[ i ].start, inOther.runs[ i ].length, inOther.runs[ i ].value );
+}
+
+void
+WindowSampler::RunScan::Append( long long inStart, long long inLength, double inValue )
+{
+  if( !runs.empty() && runs.back().value == inValue
+      && runs.back().start + runs.back().length == inStart )
+    runs.back().length += inLength;
+  else
+  {
+    Run run = { inStart, inLength, inValue };
+    runs.push_back( run );
+  }
+}
+
+WindowSampler::WindowSampler( int inLength )
+: mLength( inLength ),
+  mAllChannels( true ),
+  mCalibrated( true ),
+  mLabels( false ),
+  mUseHeaderCache( false ),
+  mThreads( 0 ),
+  mMaxOpenFiles( cDefaultMaxOpenFiles ),
+  mOpenFiles( 0 ),
+  mSamplingRate( 0 ),
+  mClock( 0 )
+{
+  if( inLength < 1 )
+    throw std_range_error( "Window length must be at least one sample, is " << inLength );
+}
+
+WindowSampler::~WindowSampler()
+{
+  for( size_t i = 0; i < mFiles.size(); ++i )
+    delete mFiles[ i ].pReader;
+}
+
+WindowSampler&
+WindowSampler::SetHeaderCache( bool inEnable, const string& inDirectory )
+{
+  mUseHeaderCache = inEnable;
+  mHeaderCacheDir = inDirectory;
+  return *this;
+}
+
+WindowSampler&
+WindowSampler::SetChannels( const vector<int>& inChannels )
+{
+  if( !mFiles.empty() )
+    throw std_runtime_error( "Channels must be selected before files are added" );
+  for( size_t i = 0; i < inChannels.size(); ++i )
+    if( inChannels[ i ] < 0 )
+      throw std_range_error( "Channel index " << inChannels[ i ] << " out of range" );
+  mChannels = inChannels;
+  mAllChannels = false;
+  return *this;
+}
+
+WindowSampler&
+WindowSampler::SetThreads( int inThreads )
+{
+  if( inThreads < 0 )
+    throw std_range_error( "Negative number of threads: " << inThreads );
+  mThreads = inThreads;
+  return *this;
+}
+
+WindowSampler&
+WindowSampler::SetMaxOpenFiles( int inFiles )
+{
+  if( inFiles < 1 )
+    throw std_range_error( "At least one file must be kept open, not " << inFiles );
+  mMaxOpenFiles = inFiles;
+  Evict( mClock );
+  return *this;
+}
+
+// **************************************************************************
+// Function:   AddFile
+// Purpose:    Reads a file's header, and checks that the file's sampling
+//             rate and channels match those of the files added before.
+//             The file stays open unless too many files are open.
+// Parameters: name - file name
+// Returns:    Index of the file
+// **************************************************************************
+int
+WindowSampler::AddFile( const string& inName )
+{
+  if( mLabels )
+    throw std_runtime_error( "Files must be added before labels are set" );
+  File file;
+  file.name = inName;
+  file.samples = 0;
+  file.recordBytes = 0;
+  file.pReader = NULL;
+  file.lastUse = 0;
+  mFiles.push_back( file );
+  BCI2000FileReader* pReader = NULL;
+  try
+  {
+    pReader = &Acquire( static_cast<int>( mFiles.size() ) - 1 );
+    const int channels = pReader->SignalProperties().Channels();
+    if( mFiles.size() == 1 )
+    {
+      mSamplingRate = pReader->SamplingRate();
+      if( mAllChannels )
+        for( int ch = 0; ch < channels; ++ch )
+          mChannels.push_back( ch );
+    }
+    else if( pReader->SamplingRate() != mSamplingRate )
+      throw std_runtime_error( inName << ": sampling rate of " << pReader->SamplingRate()
+                               << " differs from " << mSamplingRate );
+    if( mAllChannels && channels != Channels() )
+      throw std_runtime_error( inName << ": " << channels << " channels instead of " << Channels() );
+    for( size_t i = 0; i < mChannels.size(); ++i )
+      if( mChannels[ i ] >= channels )
+        throw std_range_error( inName << ": channel index " << mChannels[ i ] << " out of range" );
+  }
+  catch( ... )
+  {
+    if( mFiles.back().pReader )
+    {
+      delete mFiles.back().pReader;
+      --mOpenFiles;
+    }
+    mFiles.pop_back();
+    throw;
+  }
+  File& added = mFiles.back();
+  added.samples = pReader->NumSamples();
+  added.recordBytes = pReader->SignalProperties().Channels() * pReader->SignalProperties().Type().Size()
+                      + pReader->StateVectorLength();
+  mStarts.push_back( ( mStarts.empty() ? 0 : mStarts.back() ) + max( 0LL, added.samples - mLength + 1 ) );
+  Evict( mClock );
+  return static_cast<int>( mFiles.size() ) - 1;
+}
+
+// **************************************************************************
+// Function:   SetLabels
+// Purpose:    Scans a state in all files, recording runs of constant value.
+//             For stratified sampling, runs that hold at least one window
+//             are grouped by their value.
+// Parameters: state - name of the state
+//             stratified - whether windows are stratified by state value
+// Returns:    N/A
+// **************************************************************************
+void
+WindowSampler::SetLabels( const string& inState, bool inStratified )
+{
+  for( size_t f = 0; f < mFiles.size(); ++f )
+  {
+    BCI2000FileReader& reader = Acquire( static_cast<int>( f ) );
+    Evict( mClock );
+    if( !reader.States()->Exists( inState ) )
+      throw std_runtime_error( mFiles[ f ].name << ": no state named " << inState );
+    vector<int> states( 1, reader.States()->Index( inState ) );
+    BCI2000FileScanner scanner( reader );
+    scanner.SetChannels( vector<int>() ).SetStates( states ).SetThreads( mThreads );
+    mFiles[ f ].runs = scanner.Scan( 0, reader.NumSamples(), RunScan() ).runs;
+  }
+  mLabels = true;
+  mStrata.clear();
+  if( !inStratified )
+    return;
+
+  map<double, vector<Segment> > strata;
+  for( size_t f = 0; f < mFiles.size(); ++f )
+    for( size_t i = 0; i < mFiles[ f ].runs.size(); ++i )
+    {
+      const Run& run = mFiles[ f ].runs[ i ];
+      if( run.length < mLength )
+        continue;
+      vector<Segment>& segments = strata[ run.value ];
+      Segment segment =
+      {
+        static_cast<int>( f ), run.start,
+        ( segments.empty() ? 0 : segments.back().end ) + run.length - mLength + 1
+      };
+      segments.push_back( segment );
+    }
+  if( strata.empty() )
+    throw std_runtime_error( "No run of constant " << inState << " holds a window of "
+                             << mLength << " samples" );
+  for( map<double, vector<Segment> >::iterator i = strata.begin(); i != strata.end(); ++i )
+  {
+    mStrata.push_back( Stratum() );
+    mStrata.back().value = i->first;
+    mStrata.back().segments.swap( i->second );
+  }
+}
+
+vector<double>
+WindowSampler::Strata() const
+{
+  vector<double> values;
+  for( size_t i = 0; i < mStrata.size(); ++i )
+    values.push_back( mStrata[ i ].value );
+  return values;
+}
+
+// **************************************************************************
+// Function:   Draw
+// Purpose:    Draws windows. Without stratification, each window that fits
+//             into a file is equally likely. With stratification, a state
+//             value is drawn first, then a window within that value's runs.
+// Parameters: count - number of windows
+// Returns:    Windows in the order drawn
+// **************************************************************************
+WindowSampler::Windows
+WindowSampler::Draw( int inCount )
+{
+  if( inCount < 0 )
+    throw std_range_error( "Negative number of windows: " << inCount );
+  Windows windows( inCount );
+  if( !mStrata.empty() )
+  {
+    uniform_int_distribution<size_t> stratum( 0, mStrata.size() - 1 );
+    for( int w = 0; w < inCount; ++w )
+    {
+      const Stratum& s = mStrata[ stratum( mRandom ) ];
+      long long u = uniform_int_distribution<long long>( 0, s.segments.back().end - 1 )( mRandom );
+      // first segment whose end exceeds u
+      vector<Segment>::const_iterator i = upper_bound( s.segments.begin(), s.segments.end(), u,
+        []( long long v, const Segment& segment ) { return v < segment.end; } );
+      const long long before = i == s.segments.begin() ? 0 : ( i - 1 )->end;
+      windows[ w ].file = i->file;
+      windows[ w ].start = i->start + u - before;
+      windows[ w ].label = s.value;
+    }
+    return windows;
+  }
+  const long long total = mStarts.empty() ? 0 : mStarts.back();
+  if( inCount > 0 && total == 0 )
+    throw std_runtime_error( "No file holds a window of " << mLength << " samples" );
+  uniform_int_distribution<long long> start( 0, max( total, 1LL ) - 1 );
+  for( int w = 0; w < inCount; ++w )
+  {
+    long long u = start( mRandom );
+    const int f = static_cast<int>( upper_bound( mStarts.begin(), mStarts.end(), u ) - mStarts.begin() );
+    windows[ w ].file = f;
+    windows[ w ].start = u - ( f > 0 ? mStarts[ f - 1 ] : 0 );
+    windows[ w ].label = mLabels ? Label( mFiles[ f ], windows[ w ].start )
+                                 : numeric_limits<double>::quiet_NaN();
+  }
+  return windows;
+}
+
+double
+WindowSampler::Label( const File& inFile, long long inSample ) const
+{
+  // the run before the first one starting after the sample
+  vector<Run>::const_iterator i = upper_bound( inFile.runs.begin(), inFile.runs.end(), inSample,
+    []( long long v, const Run& run ) { return v < run.start; } );
+  return i == inFile.runs.begin() ? numeric_limits<double>::quiet_NaN() : ( i - 1 )->value;
+}
+
+// **************************************************************************
+// Function:   Read
+// Purpose:    Sorts windows by file and position, and coalesces windows
+//             that overlap or lie close to each other into spans, which
+//             are read with a single sequential read each. Spans are read
+//             in parallel, in groups of files that may be open at once.
+// Parameters: windows - windows to read
+//             out - output array of windows.size() * Channels() * Length()
+//                   values
+// Returns:    N/A
+// **************************************************************************
+void
+WindowSampler::Read( const Windows& inWindows, float* outData )
+{
+  for( size_t w = 0; w < inWindows.size(); ++w )
+  {
+    const Window& window = inWindows[ w ];
+    if( window.file < 0 || window.file >= Files() )
+      throw std_range_error( "File index " << window.file << " out of range" );
+    if( window.start < 0 || window.start + mLength > mFiles[ window.file ].samples )
+      throw std_range_error( "Window at " << window.start << " exceeds "
+                             << mFiles[ window.file ].name );
+  }
+  vector<size_t> order( inWindows.size() );
+  for( size_t w = 0; w < order.size(); ++w )
+    order[ w ] = w;
+  sort( order.begin(), order.end(), [&]( size_t a, size_t b )
+  {
+    const Window& x = inWindows[ a ], &y = inWindows[ b ];
+    return x.file < y.file || ( x.file == y.file && ( x.start < y.start || ( x.start == y.start && a < b ) ) );
+  } );
+
+  vector<Span> spans;
+  for( size_t k = 0; k < order.size(); ++k )
+  {
+    const Window& w = inWindows[ order[ k ] ];
+    const long long end = w.start + mLength,
+                    bytes = mFiles[ w.file ].recordBytes;
+    if( !spans.empty() )
+    {
+      Span& s = spans.back();
+      if( s.file == w.file && ( w.start - s.end ) * bytes <= cCoalesceBytes
+          && ( max( s.end, end ) - s.begin ) * bytes <= cMaxReadBytes )
+      {
+        s.end = max( s.end, end );
+        s.last = k + 1;
+        continue;
+      }
+    }
+    Span s = { w.file, w.start, end, k, k + 1 };
+    spans.push_back( s );
+  }
+
+  const int maxThreads = mThreads > 0 ? mThreads : max( 1, static_cast<int>( thread::hardware_concurrency() ) );
+  for( size_t group = 0; group < spans.size(); )
+  {
+    // spans of at most mMaxOpenFiles files, opened before threads start
+    const unsigned long long tick = mClock + 1;
+    size_t end = group;
+    for( int files = 0; end < spans.size(); ++end )
+    {
+      if( end == group || spans[ end ].file != spans[ end - 1 ].file )
+      {
+        if( files == mMaxOpenFiles )
+          break;
+        ++files;
+        Acquire( spans[ end ].file );
+      }
+    }
+    Evict( tick );
+
+    const int threads = static_cast<int>( min<size_t>( maxThreads, end - group ) );
+    atomic<size_t> next( group );
+    vector<exception_ptr> errors( threads );
+    auto work = [&]( int i )
+    {
+      try
+      {
+        vector<double> buffer;
+        for( size_t s = next++; s < end; s = next++ )
+          ReadSpan( spans[ s ], inWindows, order, buffer, outData );
+      }
+      catch( ... )
+      {
+        errors[ i ] = current_exception();
+      }
+    };
+    vector<thread> workers;
+    for( int i = 1; i < threads; ++i )
+      workers.push_back( thread( work, i ) );
+    work( 0 );
+    for( size_t i = 0; i < workers.size(); ++i )
+      workers[ i ].join();
+    for( size_t i = 0; i < errors.size(); ++i )
+      if( errors[ i ] )
+        rethrow_exception( errors[ i ] );
+    group = end;
+  }
+}
+
+// **************************************************************************
+// Function:   ReadSpan
+// Purpose:    Reads a span through a cursor with a buffer of the span's
+//             size, and copies its windows into the output array.
+// Parameters: span - span to read
+//             windows - windows to read
+//             order - window indices in read order
+//             buffer - the calling thread's decoding buffer
+//             out - output array
+// Returns:    N/A
+// **************************************************************************
+void
+WindowSampler::ReadSpan( const Span& inSpan, const Windows& inWindows, const vector<size_t>& inOrder,
+                         vector<double>& ioBuffer, float* outData ) const
+{
+  const File& file = mFiles[ inSpan.file ];
+  const long long count = inSpan.end - inSpan.begin;
+  const size_t C = mChannels.size(),
+               L = mLength;
+  ioBuffer.resize( count * C + 1 );
+  const long long bufferSize = min( max<long long>( BCI2000FileReader::cDefaultBufSize, count * file.recordBytes ),
+                                    cMaxReadBytes );
+  BCI2000FileReader::Cursor cursor( *file.pReader, static_cast<int>( bufferSize ) );
+  cursor.ReadColumns( inSpan.begin, count, mChannels, &ioBuffer[ 0 ], count, mCalibrated,
+                      vector<int>(), NULL, 0 );
+  for( size_t k = inSpan.first; k < inSpan.last; ++k )
+  {
+    const size_t w = inOrder[ k ];
+    const double* in = &ioBuffer[ 0 ] + ( inWindows[ w ].start - inSpan.begin );
+    float* out = outData + w * C * L;
+    for( size_t ch = 0; ch < C; ++ch )
+      for( size_t i = 0; i < L; ++i )
+        out[ ch * L + i ] = static_cast<float>( in[ ch * count + i ] );
+  }
+}
+
+// **************************************************************************
+// Function:   Acquire
+// Purpose:    Opens a file if it is not open, and marks it as used.
+//             Callers close files beyond the limit with Evict().
+// Parameters: file - index of the file
+// Returns:    The file's reader
+// **************************************************************************
+BCI2000FileReader&
+WindowSampler::Acquire( int inFile )
+{
+  File& file = mFiles[ inFile ];
+  if( file.pReader == NULL )
+  {
+    BCI2000FileReader* pReader = new BCI2000FileReader;
+    pReader->SetHeaderCache( mUseHeaderCache, mHeaderCacheDir );
+    pReader->Open( file.name.c_str() );
+    if( !pReader->IsOpen() )
+    {
+      delete pReader;
+      throw std_runtime_error( "Could not open " << file.name );
+    }
+    file.pReader = pReader;
+    ++mOpenFiles;
+  }
+  file.lastUse = ++mClock;
+  return *file.pReader;
+}
+
+// **************************************************************************
+// Function:   Evict
+// Purpose:    Closes the least recently used files until no more than the
+//             maximum number of files are open. Files used at or after the
+//             given time are kept open.
+// Parameters: before - files used before this time may be closed
+// Returns:    N/A
+// **************************************************************************
+void
+WindowSampler::Evict( unsigned long long inBefore )
+{
+  while( mOpenFiles > mMaxOpenFiles )
+  {
+    File* pOldest = NULL;
+    for( size_t i = 0; i < mFiles.size(); ++i )
+      if( mFiles[ i ].pReader && mFiles[ i ].lastUse < inBefore
+          && ( pOldest == NULL || mFiles[ i ].lastUse < pOldest->lastUse ) )
+        pOldest = &mFiles[ i ];
+    if( pOldest == NULL )
+      return;
+    delete pOldest->pReader;
+    pOldest->pReader = NULL;
+    --mOpenFiles;
+  }
+}
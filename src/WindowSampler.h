@@ -0,0 +1,181 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: Draws random windows of fixed length from a set of data
+//   files, optionally stratified by the value of a state, and decodes
+//   batches of windows into a float array. Reads are sorted and coalesced
+//   per file, so random windows are read near-sequentially.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#ifndef WINDOW_SAMPLER_H
+#define WINDOW_SAMPLER_H
+
+#include <vector>
+#include <string>
+#include <random>
+#include <cstddef>
+
+class BCI2000FileReader;
+
+// Files are added with their headers only, and opened for reading when
+// windows are read from them. At most SetMaxOpenFiles() files are kept
+// open, closing the least recently used first.
+// Files must have the same sampling rate, and the same number of channels
+// unless channels are selected.
+// Without labels, windows are drawn uniformly from all windows that fit
+// into the files. With labels, each window is labeled with the value of a
+// state at its first sample. Stratified windows lie within runs of a
+// constant state value, and each value occurring in a run long enough for
+// a window is drawn with equal probability.
+class WindowSampler
+{
+ public:
+  static const int cDefaultMaxOpenFiles = 64;
+  // Windows of a file less than this far apart are read in one go, as
+  // reading the gap is faster than seeking over it.
+  static const long long cCoalesceBytes = 1024 * 1024;
+  // Upper limit on the size of a single read, unless a window is larger.
+  static const long long cMaxReadBytes = 4 * 1024 * 1024;
+
+  struct Window
+  {
+    int file;
+    long long start; // first sample
+    double label;    // NaN without labels
+  };
+  typedef std::vector<Window> Windows;
+
+  explicit WindowSampler( int length );
+  ~WindowSampler();
+
+ private:
+  WindowSampler( const WindowSampler& );
+  WindowSampler& operator=( const WindowSampler& );
+
+ public:
+  // Settings that apply to files added afterwards.
+  //  See BCI2000FileReader::SetHeaderCache().
+  WindowSampler& SetHeaderCache( bool enable, const std::string& directory = "" );
+  //  Channels to decode; all channels by default.
+  WindowSampler& SetChannels( const std::vector<int>& );
+  // Settings that apply to reads.
+  //  Whether signal values are calibrated; true by default.
+  WindowSampler& SetCalibrated( bool b )
+    { mCalibrated = b; return *this; }
+  //  Maximum number of threads, or 0 for the number of processors.
+  WindowSampler& SetThreads( int );
+  WindowSampler& SetMaxOpenFiles( int );
+  WindowSampler& SetSeed( unsigned long long seed )
+    { mRandom.seed( seed ); return *this; }
+
+  // Reads a file's header, and returns the file's index.
+  int AddFile( const std::string& );
+  // Reads a state from all files, and labels windows with its value.
+  // This reads the state column of each file once, so it should be called
+  // after all files are added.
+  void SetLabels( const std::string& state, bool stratified );
+
+  int Length() const
+    { return mLength; }
+  int Channels() const
+    { return static_cast<int>( mChannels.size() ); }
+  int Files() const
+    { return static_cast<int>( mFiles.size() ); }
+  const std::string& FileName( int file ) const
+    { return mFiles[ file ].name; }
+  long long Samples( int file ) const
+    { return mFiles[ file ].samples; }
+  double SamplingRate() const
+    { return mSamplingRate; }
+  // Label values drawn from when stratified, in ascending order.
+  std::vector<double> Strata() const;
+
+  // Draws windows independently, with replacement.
+  Windows Draw( int count );
+  // Decodes windows into out[ ( w * Channels() + ch ) * Length() + i ],
+  // where w is the index of a window in the list.
+  void Read( const Windows&, float* out );
+
+ private:
+  struct Run
+  {
+    long long start,
+              length;
+    double value;
+  };
+  struct File
+  {
+    std::string name;
+    long long samples,
+              recordBytes;
+    std::vector<Run> runs;
+    BCI2000FileReader* pReader;
+    unsigned long long lastUse;
+  };
+  // Runs long enough for a window, with cumulative numbers of window
+  // starts for drawing a run with probability proportional to its starts.
+  struct Segment
+  {
+    int file;
+    long long start,
+              end; // cumulative number of starts up to the segment's end
+  };
+  struct Stratum
+  {
+    double value;
+    std::vector<Segment> segments;
+  };
+  struct Span
+  {
+    int file;
+    long long begin,
+              end;
+    size_t first, // range of windows in read order
+           last;
+  };
+  class RunScan;
+
+  BCI2000FileReader& Acquire( int file );
+  void Evict( unsigned long long before );
+  double Label( const File&, long long sample ) const;
+  void ReadSpan( const Span&, const Windows&, const std::vector<size_t>& order,
+                 std::vector<double>& buffer, float* out ) const;
+
+  int mLength;
+  std::vector<int> mChannels;
+  bool mAllChannels,
+       mCalibrated,
+       mLabels,
+       mUseHeaderCache;
+  std::string mHeaderCacheDir;
+  int mThreads,
+      mMaxOpenFiles,
+      mOpenFiles;
+  double mSamplingRate;
+  unsigned long long mClock;
+  std::vector<File> mFiles;
+  // cumulative number of window starts up to each file's end
+  std::vector<long long> mStarts;
+  std::vector<Stratum> mStrata;
+  std::mt19937_64 mRandom;
+};
+
+#endif // WINDOW_SAMPLER_H
@@ -0,0 +1,202 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: Base class of accumulators that process a signal in windows
+//   of fixed length, starting at a fixed step, while chunks of samples are
+//   added in a single pass. Windows that span the boundary between ranges
+//   of samples added to different accumulators are processed when the
+//   accumulators are merged.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#include "PCHIncludes.h"
+#pragma hdrstop
+
+#include "WindowedAccumulator.h"
+#include "BCIException.h"
+
+#include <algorithm>
+
+using namespace std;
+
+WindowedAccumulator::WindowedAccumulator( int inChannels, int inLength, int inStep, long long inOrigin,
+                                          bool inConditions, bool inConstantConditions )
+: mChannels( inChannels ),
+  mLength( inLength ),
+  mStep( inStep ),
+  mOrigin( inOrigin ),
+  mUseConditions( inConditions ),
+  mConstantConditions( inConstantConditions ),
+  mBegin( -1 ),
+  mEnd( -1 )
+{
+  if( inChannels < 0 )
+    throw std_range_error( "Negative number of channels: " << inChannels );
+  if( inLength < 1 )
+    throw std_range_error( "Window length must be at least 1, is " << inLength );
+  if( inStep < 1 )
+    throw std_range_error( "Window step must be at least 1, is " << inStep );
+}
+
+void
+WindowedAccumulator::Add( const BCI2000FileScanner::Chunk& inChunk )
+{
+  Add( inChunk.sample, inChunk.count, inChunk.signal, inChunk.signalStride,
+       mUseConditions ? inChunk.states : NULL );
+}
+
+// **************************************************************************
+// Function:   Add
+// Purpose:    Appends samples to the samples kept from previous calls, and
+//             computes the windows that are complete. Afterwards, only the
+//             last Length() - 1 samples are kept, as all windows that
+//             begin earlier have been computed.
+// Parameters: sample - number of the first sample
+//             count - number of samples
+//             signal - column-major signal array
+//             signalStride - distance between channels in the signal array
+//             conditions - condition values, or NULL
+// Returns:    N/A
+// **************************************************************************
+void
+WindowedAccumulator::Add( long long inSample, long long inCount, const double* inSignal, size_t inSignalStride,
+                          const double* inConditions )
+{
+  if( inCount <= 0 )
+    return;
+  if( mEnd < 0 )
+  {
+    mBegin = mEnd = inSample;
+    mHead.begin = mTail.begin = inSample;
+  }
+  if( inSample != mEnd )
+    throw std_runtime_error( "Samples added out of order: expected sample " << mEnd
+                             << ", got " << inSample );
+  const size_t C = mChannels,
+               previous = mTail.conditions.size();
+  mTail.data.resize( ( previous + inCount ) * C );
+  mTail.conditions.resize( previous + inCount );
+  double* p = &mTail.data[ previous * C ];
+  for( long long i = 0; i < inCount; ++i )
+    for( size_t ch = 0; ch < C; ++ch )
+      *p++ = inSignal[ ch * inSignalStride + i ];
+  for( long long i = 0; i < inCount; ++i )
+    mTail.conditions[ previous + i ] = inConditions ? inConditions[ i ] : 0;
+  mEnd += inCount;
+  if( static_cast<int>( mHead.conditions.size() ) < mLength - 1 )
+  {
+    Samples added;
+    added.begin = inSample;
+    added.data.assign( mTail.data.begin() + previous * C, mTail.data.end() );
+    added.conditions.assign( mTail.conditions.begin() + previous, mTail.conditions.end() );
+    Append( mHead, added, mLength - 1 - static_cast<long long>( mHead.conditions.size() ) );
+  }
+  Windows( mTail, mTail.begin, mEnd - mLength );
+  Trim( mTail );
+}
+
+// **************************************************************************
+// Function:   MergeWindows
+// Purpose:    Processes the windows that span the boundary from the last
+//             samples of this range and the first samples of the following
+//             one, and keeps the samples needed for later merges.
+// Parameters: other - accumulator of the range that follows
+// Returns:    N/A
+// **************************************************************************
+void
+WindowedAccumulator::MergeWindows( const WindowedAccumulator& inOther )
+{
+  if( inOther.mEnd < 0 )
+    return;
+  if( mEnd < 0 )
+  {
+    mBegin = inOther.mBegin;
+    mEnd = inOther.mEnd;
+    mHead = inOther.mHead;
+    mTail = inOther.mTail;
+    return;
+  }
+  if( inOther.mBegin != mEnd )
+    throw std_runtime_error( "Merged accumulators of non-adjacent ranges" );
+
+  Samples boundary = mTail;
+  Append( boundary, inOther.mHead, inOther.mHead.conditions.size() );
+  Windows( boundary, boundary.begin, mEnd - 1 );
+
+  if( static_cast<int>( mHead.conditions.size() ) < mLength - 1 )
+    Append( mHead, inOther.mHead, mLength - 1 - static_cast<long long>( mHead.conditions.size() ) );
+  if( inOther.mTail.begin == mEnd )
+  {
+    Append( mTail, inOther.mTail, inOther.mTail.conditions.size() );
+    Trim( mTail );
+  }
+  else
+    mTail = inOther.mTail;
+  mEnd = inOther.mEnd;
+}
+
+void
+WindowedAccumulator::Append( Samples& ioSamples, const Samples& inSamples, long long inCount ) const
+{
+  const size_t count = min<size_t>( inCount, inSamples.conditions.size() );
+  ioSamples.data.insert( ioSamples.data.end(), inSamples.data.begin(), inSamples.data.begin() + count * mChannels );
+  ioSamples.conditions.insert( ioSamples.conditions.end(), inSamples.conditions.begin(), inSamples.conditions.begin() + count );
+}
+
+// Keeps the last Length() - 1 samples.
+void
+WindowedAccumulator::Trim( Samples& ioSamples ) const
+{
+  const long long excess = static_cast<long long>( ioSamples.conditions.size() ) - ( mLength - 1 );
+  if( excess > 0 )
+  {
+    ioSamples.data.erase( ioSamples.data.begin(), ioSamples.data.begin() + excess * mChannels );
+    ioSamples.conditions.erase( ioSamples.conditions.begin(), ioSamples.conditions.begin() + excess );
+    ioSamples.begin += excess;
+  }
+}
+
+// **************************************************************************
+// Function:   Windows
+// Purpose:    Computes the windows that start between first and last, and
+//             whose samples are all contained in the samples given, and
+//             have the same condition if required.
+// Parameters: samples - samples
+//             first, last - range of window starts
+// Returns:    N/A
+// **************************************************************************
+void
+WindowedAccumulator::Windows( const Samples& inSamples, long long inFirst, long long inLast )
+{
+  long long start = mOrigin;
+  if( inFirst > mOrigin )
+    start += ( inFirst - mOrigin + mStep - 1 ) / mStep * mStep;
+  for( ; start <= inLast && start + mLength <= inSamples.End(); start += mStep )
+  {
+    if( start < inSamples.begin )
+      continue;
+    const double* conditions = &inSamples.conditions[ start - inSamples.begin ];
+    bool constant = true;
+    for( int t = 1; mConstantConditions && constant && t < mLength; ++t )
+      constant = ( conditions[ t ] == conditions[ 0 ] );
+    if( constant )
+      Window( start, &inSamples.data[ ( start - inSamples.begin ) * mChannels ], conditions[ 0 ] );
+  }
+}
@@ -0,0 +1,103 @@
+////////////////////////////////////////////////////////////////////////////////
+// $Id$
+// Description: Base class of accumulators that process a signal in windows
+//   of fixed length, starting at a fixed step, while chunks of samples are
+//   added in a single pass. Windows that span the boundary between ranges
+//   of samples added to different accumulators are processed when the
+//   accumulators are merged.
+//
+// $BEGIN_BCI2000_LICENSE$
+//
+// This file is part of BCI2000, a platform for real-time bio-signal research.
+// [ Copyright (C) 2000-2012: BCI2000 team and many external contributors ]
+//
+// BCI2000 is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or (at your option) any later
+// version.
+//
+// BCI2000 is distributed in the hope that it will be useful, but
+//                         WITHOUT ANY WARRANTY
+// - without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+// A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with
+// this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// $END_BCI2000_LICENSE$
+////////////////////////////////////////////////////////////////////////////////
+#ifndef WINDOWED_ACCUMULATOR_H
+#define WINDOWED_ACCUMULATOR_H
+
+#include "BCI2000FileScanner.h"
+
+#include <vector>
+
+// Windows start at origin + k * step. Each sample has a condition value,
+// taken from the first state of chunks when conditions are enabled, and 0
+// otherwise; when constant conditions are required, windows that span a
+// change of condition are skipped.
+// Only the samples of incomplete windows, and the first Length() - 1
+// samples of the range added, are kept, so memory is bounded by the window
+// length times the number of channels.
+// Derived classes implement Window(), and call MergeWindows() from their
+// Merge() function before merging their own results, so windows are
+// processed in the order of their starts.
+class WindowedAccumulator
+{
+ public:
+  WindowedAccumulator( int channels, int length, int step, long long origin,
+                       bool conditions, bool constantConditions );
+  virtual ~WindowedAccumulator()
+    {}
+
+  int Channels() const
+    { return mChannels; }
+  int Length() const
+    { return mLength; }
+  int Step() const
+    { return mStep; }
+
+  void Add( const BCI2000FileScanner::Chunk& );
+  // Adds count consecutive samples, with values of channel ch at
+  // signal[ ch * signalStride + i ], and a condition value per sample, or
+  // NULL for a single condition 0.
+  void Add( long long sample, long long count, const double* signal, size_t signalStride,
+            const double* conditions );
+
+ protected:
+  // Takes over the samples kept by the accumulator of the range that
+  // follows, and processes the windows that span the boundary.
+  void MergeWindows( const WindowedAccumulator& );
+  // Processes the window starting at sample start, with Length() samples
+  // at data[ t * Channels() + ch ], and the condition of its first sample.
+  virtual void Window( long long start, const double* data, double condition ) = 0;
+
+ private:
+  // Samples with channels innermost, and their conditions.
+  struct Samples
+  {
+    long long begin;
+    std::vector<double> data,
+                        conditions;
+    long long End() const
+      { return begin + static_cast<long long>( conditions.size() ); }
+  };
+  void Append( Samples&, const Samples&, long long count ) const;
+  void Trim( Samples& ) const;
+  void Windows( const Samples&, long long first, long long last );
+
+  int mChannels,
+      mLength,
+      mStep;
+  long long mOrigin;
+  bool mUseConditions,
+       mConstantConditions;
+  // The range of samples added, its first and last Length() - 1 samples.
+  long long mBegin,
+            mEnd;
+  Samples mHead,
+          mTail;
+};
+
+#endif // WINDOWED_ACCUMULATOR_H
@@ -0,0 +1,24 @@
+// Helpers shared between the R interface files. They are defined in
+// load_bcidat.cpp, and documented there.
+#ifndef BCIDAT_GLUE_H
+#define BCIDAT_GLUE_H
+
+#include <Rcpp.h>
+
+#include "BCI2000FileReader.h"
+#include "IIRFilter.h"
+#include "Montage.h"
+
+#include <string>
+#include <vector>
+
+bool openReader(BCI2000FileReader &reader, const std::string &file, SEXP header_cache);
+std::vector<int> selectChannels(SEXP channels, int available);
+bool parseFilter(SEXP spec, double samplingRate, IIRFilter &filter, bool &zeroPhase);
+bool parseMontage(SEXP spec, BCI2000FileReader &reader, Montage &montage);
+Rcpp::List readSamples(BCI2000FileReader &reader, long long first, int count, bool raw,
+                       SEXP channels, SEXP states, const Montage *montage,
+                       IIRFilter *filter, bool zeroPhase);
+SEXP paramListToSEXP(const ParamList &list, bool numeric, bool units);
+
+#endif // BCIDAT_GLUE_H
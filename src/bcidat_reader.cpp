@@ -0,0 +1,98 @@
+#include <Rcpp.h>
+using namespace Rcpp;
+
+#include "bcidat_glue.h"
+
+#include <algorithm>
+#include <vector>
+
+// A reader kept open between calls, together with the position up to which
+// samples have been returned. Used for files that are still being recorded.
+// An optional montage is applied to each read. An optional filter keeps its
+// state between reads that continue where the previous read ended, with the
+// same channels and calibration.
+struct ReaderHandle
+{
+  BCI2000FileReader reader;
+  long long next;
+  Montage montage;
+  IIRFilter filter;
+  bool referenced, filtered, zeroPhase, filterRaw;
+  std::vector<int> filterChannels;
+  long long filterNext;
+};
+
+typedef Rcpp::XPtr<ReaderHandle> ReaderPtr;
+
+static ReaderHandle &getHandle(SEXP handle)
+{
+  ReaderPtr ptr(handle);
+  if(ptr.get() == NULL)
+    Rcpp::stop("invalid or closed bcidat handle");
+  return *ptr;
+}
+
+// [[Rcpp::export]]
+SEXP open_bcidat(std::string file, bool numeric_params=false, bool param_units=false, SEXP header_cache=R_NilValue, SEXP filter=R_NilValue, SEXP montage=R_NilValue)
+{
+  ReaderPtr ptr(new ReaderHandle, true);
+  ptr->next = 0;
+  ptr->filterNext = -1;
+  ptr->filterRaw = false;
+  if(!openReader(ptr->reader, file, header_cache))
+    Rcpp::stop("could not open " + file);
+  ptr->referenced = parseMontage(montage, ptr->reader, ptr->montage);
+  ptr->filtered = parseFilter(filter, ptr->reader.SamplingRate(), ptr->filter, ptr->zeroPhase);
+  ptr.attr("class") = "bcidat_reader";
+  ptr.attr("parameters") = paramListToSEXP(*ptr->reader.Parameters(), numeric_params, param_units);
+  ptr.attr("sampling_rate") = ptr->reader.SamplingRate();
+  return ptr;
+}
+
+// [[Rcpp::export]]
+Rcpp::List read_bcidat(SEXP handle, SEXP from=R_NilValue, SEXP count=R_NilValue, bool raw=false, SEXP channels=R_NilValue, SEXP states=R_NilValue)
+{
+  ReaderHandle &h = getHandle(handle);
+  h.reader.Refresh();
+  long long available = h.reader.NumSamples();
+  //from is 1-based; by default, continue where the previous read ended
+  long long first = Rf_isNull(from) ? h.next : static_cast<long long>(Rcpp::as<double>(from)) - 1;
+  if(first < 0 || first > available)
+    Rcpp::stop("'from' is outside the available samples");
+  long long n = Rf_isNull(count) ? available - first : static_cast<long long>(Rcpp::as<double>(count));
+  if(n < 0 || first + n > available)
+    Rcpp::stop("requested samples are not available yet");
+  if(h.filtered && !h.zeroPhase)
+  {
+    std::vector<int> selected;
+    if(!Rf_isNull(channels))
+      selected = Rcpp::as<std::vector<int> >(channels);
+    if(first != h.filterNext || raw != h.filterRaw || selected != h.filterChannels)
+      h.filter.Reset();
+    h.filterNext = first + n;
+    h.filterRaw = raw;
+    h.filterChannels = selected;
+  }
+  Rcpp::List data = readSamples(h.reader, first, static_cast<int>(n), raw, channels, states,
+                                h.referenced ? &h.montage : NULL,
+                                h.filtered ? &h.filter : NULL, h.zeroPhase);
+  h.next = first + n;
+  data["from"] = static_cast<double>(first + 1);
+  return data;
+}
+
+// [[Rcpp::export]]
+double poll_bcidat(SEXP handle, double timeout=0)
+{
+  ReaderHandle &h = getHandle(handle);
+  //wait in short slices, so the wait can be interrupted from R
+  const int slice = 100;
+  long long target = h.next + 1;
+  int remaining = static_cast<int>(timeout * 1000);
+  while(!h.reader.WaitForSamples(target, std::min(remaining, slice)) && remaining > slice)
+  {
+    remaining -= slice;
+    Rcpp::checkUserInterrupt();
+  }
+  return static_cast<double>(h.reader.NumSamples() - h.next);
+}
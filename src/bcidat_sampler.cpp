@@ -0,0 +1,132 @@
+#include <Rcpp.h>
+using namespace Rcpp;
+
+#include "bcidat_glue.h"
+#include "WindowSampler.h"
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+// A window sampler over a set of files, together with the names of the
+// selected channels, which are taken from the first file.
+struct SamplerHandle
+{
+  explicit SamplerHandle(int window) : sampler(window) {}
+  WindowSampler sampler;
+  std::vector<std::string> channels;
+};
+
+typedef Rcpp::XPtr<SamplerHandle> SamplerPtr;
+
+static SamplerHandle &getSampler(SEXP handle)
+{
+  SamplerPtr ptr(handle);
+  if(ptr.get() == NULL)
+    Rcpp::stop("invalid or closed bcidat sampler");
+  return *ptr;
+}
+
+// [[Rcpp::export]]
+SEXP open_bcidat_sampler(Rcpp::CharacterVector files, int window, SEXP channels=R_NilValue, SEXP state=R_NilValue, bool stratify=true, bool raw=false, SEXP seed=R_NilValue, int threads=0, int max_open=64, SEXP header_cache=R_NilValue)
+{
+  if(files.size() == 0)
+    Rcpp::stop("no files given");
+  //channels are selected, and named, from the first file
+  BCI2000FileReader reader;
+  std::string first = Rcpp::as<std::string>(files[0]);
+  if(!openReader(reader, first, header_cache))
+    Rcpp::stop("could not open " + first);
+  std::vector<int> channelIndex = selectChannels(channels, reader.SignalProperties().Channels());
+
+  SamplerPtr ptr(new SamplerHandle(window), true);
+  const ParamList &params = *reader.Parameters();
+  for(size_t i = 0; i < channelIndex.size(); ++i)
+  {
+    if(params.Exists("ChannelNames") && channelIndex[i] < params["ChannelNames"].NumValues())
+      ptr->channels.push_back(params["ChannelNames"].Value(channelIndex[i]).ToString());
+    else
+      ptr->channels.push_back(std::to_string(channelIndex[i] + 1));
+  }
+  WindowSampler &sampler = ptr->sampler;
+  if(Rf_isString(header_cache))
+    sampler.SetHeaderCache(true, Rcpp::as<std::string>(header_cache));
+  else if(Rf_isLogical(header_cache))
+    sampler.SetHeaderCache(Rcpp::as<bool>(header_cache));
+  if(!Rf_isNull(channels))
+    sampler.SetChannels(channelIndex);
+  sampler.SetCalibrated(!raw).SetThreads(threads).SetMaxOpenFiles(max_open);
+  //by default, the seed is drawn from R's generator, so set.seed() applies
+  double seedValue;
+  if(Rf_isNull(seed))
+  {
+    Rcpp::RNGScope scope;
+    seedValue = std::floor(R::runif(0, 4294967296.0));
+  }
+  else
+    seedValue = Rcpp::as<double>(seed);
+  sampler.SetSeed(static_cast<unsigned long long>(seedValue));
+  for(int i = 0; i < files.size(); ++i)
+    sampler.AddFile(Rcpp::as<std::string>(files[i]));
+  if(!Rf_isNull(state))
+    sampler.SetLabels(Rcpp::as<std::string>(state), stratify);
+
+  Rcpp::NumericVector samples(sampler.Files());
+  for(int i = 0; i < sampler.Files(); ++i)
+    samples[i] = static_cast<double>(sampler.Samples(i));
+  ptr.attr("class") = "bcidat_sampler";
+  ptr.attr("files") = files;
+  ptr.attr("samples") = samples;
+  ptr.attr("window") = window;
+  ptr.attr("sampling_rate") = sampler.SamplingRate();
+  if(!Rf_isNull(state) && stratify)
+    ptr.attr("strata") = Rcpp::wrap(sampler.Strata());
+  return ptr;
+}
+
+// [[Rcpp::export]]
+Rcpp::List sample_bcidat(SEXP sampler, int n, bool float32=false)
+{
+  SamplerHandle &h = getSampler(sampler);
+  WindowSampler &s = h.sampler;
+  WindowSampler::Windows windows = s.Draw(n);
+  const size_t length = s.Length(),
+               channels = s.Channels(),
+               values = windows.size() * channels * length;
+  Rcpp::IntegerVector file(n);
+  Rcpp::NumericVector start(n), label(n);
+  for(int w = 0; w < n; ++w)
+  {
+    file[w] = windows[w].file + 1;
+    start[w] = static_cast<double>(windows[w].start + 1);
+    label[w] = std::isnan(windows[w].label) ? NA_REAL : windows[w].label;
+  }
+  //float32 batches are decoded into the returned raw vector directly
+  SEXP signal;
+  if(float32)
+  {
+    Rcpp::RawVector bytes(values * sizeof(float));
+    if(values > 0)
+      s.Read(windows, reinterpret_cast<float*>(&bytes[0]));
+    signal = bytes;
+  }
+  else
+  {
+    std::vector<float> buffer(values + 1);
+    s.Read(windows, &buffer[0]);
+    Rcpp::NumericVector data(values);
+    for(size_t i = 0; i < values; ++i)
+      data[i] = buffer[i];
+    Rcpp::CharacterVector names(channels);
+    for(size_t ch = 0; ch < channels; ++ch)
+      names[ch] = h.channels[ch];
+    data.attr("dim") = Rcpp::IntegerVector::create(static_cast<int>(length), static_cast<int>(channels), n);
+    data.attr("dimnames") = Rcpp::List::create(R_NilValue, names, R_NilValue);
+    signal = data;
+  }
+  return Rcpp::List::create(
+    Rcpp::Named("signal") = signal,
+    Rcpp::Named("file") = file,
+    Rcpp::Named("start") = start,
+    Rcpp::Named("label") = label);
+}
@@ -0,0 +1,393 @@
+#include <Rcpp.h>
+using namespace Rcpp;
+
+#include "bcidat_glue.h"
+#include "BCI2000FileScanner.h"
+#include "BCI2000Envelope.h"
+#include "ChannelStatistics.h"
+#include "ChannelCovariance.h"
+#include "ArtifactDetector.h"
+#include "WelchSpectrum.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+// Names of the selected channels from the ChannelNames parameter, or their
+// one-based indices.
+static Rcpp::CharacterVector channelNames(BCI2000FileReader &reader, const std::vector<int> &channels)
+{
+  const ParamList &params = *reader.Parameters();
+  Rcpp::CharacterVector names(channels.size());
+  for(size_t i = 0; i < channels.size(); ++i)
+  {
+    if(params.Exists("ChannelNames") && channels[i] < params["ChannelNames"].NumValues())
+      names[i] = params["ChannelNames"].Value(channels[i]).ToString();
+    else
+      names[i] = std::to_string(channels[i] + 1);
+  }
+  return names;
+}
+
+// Index of the state that defines conditions, or -1 for NULL.
+static int conditionState(BCI2000FileReader &reader, SEXP state)
+{
+  if(Rf_isNull(state))
+    return -1;
+  std::string name = Rcpp::as<std::string>(state);
+  if(!reader.States()->Exists(name))
+    Rcpp::stop("no state named " + name);
+  return reader.States()->Index(name);
+}
+
+// Converts intervals of zero-based samples into a data frame of one-based
+// first and last samples, and the criteria met. With withChannel, the
+// frame starts with a column of channel numbers, even if it has no rows.
+static Rcpp::DataFrame intervalFrame(const ArtifactDetector::Intervals &intervals, bool withChannel,
+                                     Rcpp::IntegerVector channel)
+{
+  const int n = static_cast<int>(intervals.size());
+  Rcpp::NumericVector start(n), end(n);
+  Rcpp::LogicalVector amplitude(n), peakToPeak(n), flat(n);
+  for(int i = 0; i < n; ++i)
+  {
+    start[i] = static_cast<double>(intervals[i].begin + 1);
+    end[i] = static_cast<double>(intervals[i].end);
+    amplitude[i] = (intervals[i].criteria & ArtifactDetector::Amplitude) != 0;
+    peakToPeak[i] = (intervals[i].criteria & ArtifactDetector::PeakToPeak) != 0;
+    flat[i] = (intervals[i].criteria & ArtifactDetector::Flat) != 0;
+  }
+  if(!withChannel)
+    return Rcpp::DataFrame::create(
+      Rcpp::Named("start") = start,
+      Rcpp::Named("end") = end,
+      Rcpp::Named("amplitude") = amplitude,
+      Rcpp::Named("peak_to_peak") = peakToPeak,
+      Rcpp::Named("flat") = flat);
+  return Rcpp::DataFrame::create(
+    Rcpp::Named("channel") = channel,
+    Rcpp::Named("start") = start,
+    Rcpp::Named("end") = end,
+    Rcpp::Named("amplitude") = amplitude,
+    Rcpp::Named("peak_to_peak") = peakToPeak,
+    Rcpp::Named("flat") = flat);
+}
+
+// Formats a condition value as a list name.
+static std::string conditionName(double value)
+{
+  std::ostringstream oss;
+  oss << value;
+  return oss.str();
+}
+
+// [[Rcpp::export]]
+Rcpp::DataFrame scan_bcidat(std::string file, SEXP channels=R_NilValue, bool raw=false, double flat_duration=1, int threads=0, SEXP quantiles=R_NilValue, SEXP header_cache=R_NilValue)
+{
+  BCI2000FileReader reader;
+  if(!openReader(reader, file, header_cache))
+    Rcpp::stop("could not open " + file);
+  std::vector<int> channelIndex = selectChannels(channels, reader.SignalProperties().Channels());
+
+  //statistics are accumulated from raw values, so clipping is detected at
+  //the limits of the data type, and converted into calibrated values after
+  BCI2000FileScanner scanner(reader);
+  scanner.SetChannels(channelIndex).SetThreads(threads);
+  const SignalType &type = reader.SignalProperties().Type();
+  ChannelStatistics accumulator(static_cast<int>(channelIndex.size()), type.Min(), type.Max());
+  std::vector<double> probabilities;
+  if(!Rf_isNull(quantiles))
+  {
+    probabilities = Rcpp::as<std::vector<double> >(quantiles);
+    for(size_t j = 0; j < probabilities.size(); ++j)
+      if(!(probabilities[j] >= 0 && probabilities[j] <= 1))
+        Rcpp::stop("quantile probabilities must be between 0 and 1");
+    accumulator.EnableQuantiles();
+  }
+  ChannelStatistics stats = scanner.Scan(0, reader.NumSamples(), accumulator);
+
+  const int n = static_cast<int>(channelIndex.size());
+  Rcpp::NumericVector min(n), max(n), mean(n), var(n), rms(n), flatRun(n);
+  Rcpp::IntegerVector index(n);
+  Rcpp::NumericVector clippedLow(n), clippedHigh(n);
+  Rcpp::LogicalVector flat(n);
+  for(int i = 0; i < n; ++i)
+  {
+    const int ch = channelIndex[i];
+    ChannelStatistics::Channel c = raw ? stats[i]
+      : ChannelStatistics::Calibrate(stats[i], reader.SourceOffsets()[ch], reader.SourceGains()[ch]);
+    index[i] = ch + 1;
+    min[i] = c.min;
+    max[i] = c.max;
+    mean[i] = c.mean;
+    var[i] = c.Variance();
+    rms[i] = ::sqrt(c.MeanSquare());
+    clippedLow[i] = static_cast<double>(c.clippedLow);
+    clippedHigh[i] = static_cast<double>(c.clippedHigh);
+    flatRun[i] = c.longestRun / reader.SamplingRate();
+    flat[i] = c.count > 0 && flatRun[i] >= flat_duration;
+  }
+  Rcpp::DataFrame result = Rcpp::DataFrame::create(
+    Rcpp::Named("channel") = index,
+    Rcpp::Named("name") = channelNames(reader, channelIndex),
+    Rcpp::Named("min") = min,
+    Rcpp::Named("max") = max,
+    Rcpp::Named("mean") = mean,
+    Rcpp::Named("var") = var,
+    Rcpp::Named("rms") = rms,
+    Rcpp::Named("clipped_low") = clippedLow,
+    Rcpp::Named("clipped_high") = clippedHigh,
+    Rcpp::Named("flat_run") = flatRun,
+    Rcpp::Named("flat") = flat,
+    Rcpp::Named("stringsAsFactors") = false);
+  result.attr("samples") = static_cast<double>(reader.NumSamples());
+  if(stats.QuantilesEnabled())
+  {
+    //calibration is monotonic, so quantiles of calibrated values are
+    //calibrated quantiles, taken from the other end for negative gains
+    const int m = static_cast<int>(probabilities.size());
+    Rcpp::NumericMatrix q(n, m);
+    Rcpp::CharacterVector names(m);
+    for(int j = 0; j < m; ++j)
+    {
+      for(int i = 0; i < n; ++i)
+      {
+        const int ch = channelIndex[i];
+        const double offset = raw ? 0 : reader.SourceOffsets()[ch],
+                     gain = raw ? 1 : reader.SourceGains()[ch];
+        q(i, j) = (stats.Quantiles(i).Quantile(gain < 0 ? 1 - probabilities[j] : probabilities[j]) - offset) * gain;
+      }
+      std::ostringstream oss;
+      oss << std::setprecision(7) << 100 * probabilities[j] << "%";
+      names[j] = oss.str();
+    }
+    q.attr("dimnames") = Rcpp::List::create(channelNames(reader, channelIndex), names);
+    result.attr("quantiles") = q;
+  }
+  return result;
+}
+
+// [[Rcpp::export]]
+Rcpp::List envelope_bcidat(std::string file, double from=1, SEXP to=R_NilValue, int width=1000, SEXP channels=R_NilValue, bool raw=false, SEXP header_cache=R_NilValue)
+{
+  BCI2000FileReader reader;
+  if(!openReader(reader, file, header_cache))
+    Rcpp::stop("could not open " + file);
+  std::vector<int> channelIndex = selectChannels(channels, reader.SignalProperties().Channels());
+
+  //without a sidecar file, or one that does not match the data file, the
+  //envelope is computed from the data
+  BCI2000Envelope envelope;
+  envelope.Open(reader);
+  const long long available = envelope.IsOpen() ? envelope.NumSamples() : reader.NumSamples(),
+                  first = static_cast<long long>(from) - 1,
+                  last = Rf_isNull(to) ? available : static_cast<long long>(Rcpp::as<double>(to));
+  if(first < 0 || last > available || first >= last)
+    Rcpp::stop("invalid sample range");
+  if(width < 1)
+    Rcpp::stop("width must be at least 1");
+  width = static_cast<int>(std::min<long long>(width, last - first));
+
+  const int n = static_cast<int>(channelIndex.size());
+  Rcpp::NumericMatrix min(width, n), max(width, n), mean(width, n);
+  int level = envelope.Query(reader, first, last, width, channelIndex, !raw,
+                             min.begin(), max.begin(), mean.begin(), width);
+  Rcpp::List dimnames = Rcpp::List::create(R_NilValue, channelNames(reader, channelIndex));
+  min.attr("dimnames") = dimnames;
+  max.attr("dimnames") = dimnames;
+  mean.attr("dimnames") = dimnames;
+  Rcpp::NumericVector start(width);
+  for(int p = 0; p < width; ++p)
+    start[p] = static_cast<double>(first + (last - first) * p / width + 1);
+  return Rcpp::List::create(
+    Rcpp::Named("min") = min,
+    Rcpp::Named("max") = max,
+    Rcpp::Named("mean") = mean,
+    Rcpp::Named("start") = start,
+    Rcpp::Named("level") = level,
+    Rcpp::Named("bin_samples") = level < 0 ? 1.0 : static_cast<double>(envelope.BinSamples(level)));
+}
+
+// [[Rcpp::export]]
+Rcpp::List psd_bcidat(std::string file, int window=256, double overlap=0.5, SEXP channels=R_NilValue, SEXP state=R_NilValue, bool raw=false, int threads=0, SEXP header_cache=R_NilValue)
+{
+  BCI2000FileReader reader;
+  if(!openReader(reader, file, header_cache))
+    Rcpp::stop("could not open " + file);
+  std::vector<int> channelIndex = selectChannels(channels, reader.SignalProperties().Channels());
+  const int stateIndex = conditionState(reader, state);
+  if(window < 2)
+    Rcpp::stop("window must be at least 2 samples");
+  if(overlap < 0 || overlap >= 1)
+    Rcpp::stop("overlap must be at least 0, and less than 1");
+  const int step = std::max(1, static_cast<int>(::floor(window * (1 - overlap) + 0.5)));
+
+  BCI2000FileScanner scanner(reader);
+  scanner.SetChannels(channelIndex).SetCalibrated(!raw).SetThreads(threads);
+  if(stateIndex >= 0)
+    scanner.SetStates(std::vector<int>(1, stateIndex));
+  const int n = static_cast<int>(channelIndex.size());
+  WelchSpectrum spectrum = scanner.Scan(0, reader.NumSamples(),
+                             WelchSpectrum(n, window, step, 0, stateIndex >= 0));
+
+  const double rate = reader.SamplingRate();
+  const int bins = spectrum.Bins();
+  Rcpp::NumericVector frequency(bins);
+  for(int k = 0; k < bins; ++k)
+    frequency[k] = k * rate / window;
+  Rcpp::List dimnames = Rcpp::List::create(R_NilValue, channelNames(reader, channelIndex));
+  const WelchSpectrum::ConditionMap &conditions = spectrum.Conditions();
+  Rcpp::List psd(conditions.size());
+  Rcpp::NumericVector windows(conditions.size());
+  Rcpp::CharacterVector names(conditions.size());
+  int j = 0;
+  for(WelchSpectrum::ConditionMap::const_iterator i = conditions.begin(); i != conditions.end(); ++i, ++j)
+  {
+    std::vector<double> density = spectrum.Density(i->second, rate);
+    Rcpp::NumericMatrix m(bins, n);
+    std::copy(density.begin(), density.end(), m.begin());
+    m.attr("dimnames") = dimnames;
+    psd[j] = m;
+    windows[j] = static_cast<double>(i->second.windows);
+    names[j] = conditionName(i->first);
+  }
+  if(stateIndex < 0)
+  {
+    Rcpp::NumericMatrix m(bins, n);
+    m.attr("dimnames") = dimnames;
+    return Rcpp::List::create(
+      Rcpp::Named("frequency") = frequency,
+      Rcpp::Named("psd") = psd.size() > 0 ? SEXP(psd[0]) : SEXP(m),
+      Rcpp::Named("windows") = windows.size() > 0 ? windows[0] : 0.0);
+  }
+  psd.attr("names") = names;
+  windows.attr("names") = names;
+  return Rcpp::List::create(
+    Rcpp::Named("frequency") = frequency,
+    Rcpp::Named("psd") = psd,
+    Rcpp::Named("windows") = windows);
+}
+
+// [[Rcpp::export]]
+Rcpp::List cov_bcidat(std::string file, SEXP channels=R_NilValue, SEXP state=R_NilValue, bool raw=false, int threads=0, SEXP header_cache=R_NilValue)
+{
+  BCI2000FileReader reader;
+  if(!openReader(reader, file, header_cache))
+    Rcpp::stop("could not open " + file);
+  std::vector<int> channelIndex = selectChannels(channels, reader.SignalProperties().Channels());
+  const int stateIndex = conditionState(reader, state);
+
+  //products are accumulated from raw values, and scaled by gains after
+  BCI2000FileScanner scanner(reader);
+  scanner.SetChannels(channelIndex).SetThreads(threads);
+  if(stateIndex >= 0)
+    scanner.SetStates(std::vector<int>(1, stateIndex));
+  const int n = static_cast<int>(channelIndex.size());
+  ChannelCovariance covariance = scanner.Scan(0, reader.NumSamples(), ChannelCovariance(n, stateIndex >= 0));
+  std::vector<double> offsets(n), gains(n);
+  for(int i = 0; i < n; ++i)
+  {
+    offsets[i] = raw ? 0 : reader.SourceOffsets()[channelIndex[i]];
+    gains[i] = raw ? 1 : reader.SourceGains()[channelIndex[i]];
+  }
+
+  Rcpp::CharacterVector channelName = channelNames(reader, channelIndex);
+  Rcpp::List dimnames = Rcpp::List::create(channelName, channelName);
+  const ChannelCovariance::ConditionMap &conditions = covariance.Conditions();
+  Rcpp::List cov(conditions.size()), mean(conditions.size());
+  Rcpp::NumericVector samples(conditions.size());
+  Rcpp::CharacterVector names(conditions.size());
+  int j = 0;
+  for(ChannelCovariance::ConditionMap::const_iterator i = conditions.begin(); i != conditions.end(); ++i, ++j)
+  {
+    ChannelCovariance::Condition c = ChannelCovariance::Calibrate(i->second, offsets, gains);
+    Rcpp::NumericMatrix m(n, n);
+    for(int a = 0; a < n; ++a)
+      for(int b = 0; b < n; ++b)
+        m(a, b) = c.Covariance(a, b);
+    m.attr("dimnames") = dimnames;
+    Rcpp::NumericVector mu(c.mean.begin(), c.mean.end());
+    mu.attr("names") = channelName;
+    cov[j] = m;
+    mean[j] = mu;
+    samples[j] = static_cast<double>(c.count);
+    names[j] = conditionName(i->first);
+  }
+  if(stateIndex < 0)
+  {
+    if(conditions.empty())
+      Rcpp::stop("no samples in " + file);
+    return Rcpp::List::create(
+      Rcpp::Named("cov") = cov[0],
+      Rcpp::Named("mean") = mean[0],
+      Rcpp::Named("samples") = samples[0]);
+  }
+  cov.attr("names") = names;
+  mean.attr("names") = names;
+  samples.attr("names") = names;
+  return Rcpp::List::create(
+    Rcpp::Named("cov") = cov,
+    Rcpp::Named("mean") = mean,
+    Rcpp::Named("samples") = samples);
+}
+
+// [[Rcpp::export]]
+Rcpp::List artifacts_bcidat(std::string file, int window=256, SEXP step=R_NilValue, SEXP amplitude=R_NilValue, SEXP peak_to_peak=R_NilValue, SEXP flat=R_NilValue, SEXP channels=R_NilValue, SEXP state=R_NilValue, bool raw=false, int threads=0, SEXP header_cache=R_NilValue)
+{
+  BCI2000FileReader reader;
+  if(!openReader(reader, file, header_cache))
+    Rcpp::stop("could not open " + file);
+  std::vector<int> channelIndex = selectChannels(channels, reader.SignalProperties().Channels());
+  const int stateIndex = conditionState(reader, state);
+  const int windowStep = Rf_isNull(step) ? window : Rcpp::as<int>(step);
+  if(window < 1 || windowStep < 1)
+    Rcpp::stop("window and step must be at least 1 sample");
+
+  const int n = static_cast<int>(channelIndex.size());
+  ArtifactDetector detector(n, window, windowStep, 0, stateIndex >= 0);
+  if(!Rf_isNull(amplitude))
+    detector.SetAmplitude(Rcpp::as<double>(amplitude));
+  if(!Rf_isNull(peak_to_peak))
+    detector.SetPeakToPeak(Rcpp::as<double>(peak_to_peak));
+  if(!Rf_isNull(flat))
+    detector.SetFlat(Rcpp::as<double>(flat));
+  BCI2000FileScanner scanner(reader);
+  scanner.SetChannels(channelIndex).SetCalibrated(!raw).SetThreads(threads);
+  if(stateIndex >= 0)
+    scanner.SetStates(std::vector<int>(1, stateIndex));
+  ArtifactDetector result = scanner.Scan(0, reader.NumSamples(), detector);
+
+  ArtifactDetector::Intervals channelIntervals;
+  std::vector<int> intervalChannel;
+  for(int i = 0; i < n; ++i)
+  {
+    const ArtifactDetector::Intervals &intervals = result.ChannelIntervals(i);
+    channelIntervals.insert(channelIntervals.end(), intervals.begin(), intervals.end());
+    intervalChannel.insert(intervalChannel.end(), intervals.size(), channelIndex[i] + 1);
+  }
+  Rcpp::IntegerVector channelColumn(intervalChannel.begin(), intervalChannel.end());
+
+  const ArtifactDetector::ConditionMap &conditions = result.Conditions();
+  Rcpp::NumericVector value(conditions.size()), windows(conditions.size()), bad(conditions.size());
+  double totalWindows = 0, totalBad = 0;
+  int j = 0;
+  for(ArtifactDetector::ConditionMap::const_iterator i = conditions.begin(); i != conditions.end(); ++i, ++j)
+  {
+    value[j] = i->first;
+    windows[j] = static_cast<double>(i->second.windows);
+    bad[j] = static_cast<double>(i->second.bad);
+    totalWindows += windows[j];
+    totalBad += bad[j];
+  }
+  return Rcpp::List::create(
+    Rcpp::Named("channels") = intervalFrame(channelIntervals, true, channelColumn),
+    Rcpp::Named("global") = intervalFrame(result.GlobalIntervals(), false, Rcpp::IntegerVector()),
+    Rcpp::Named("conditions") = stateIndex < 0 ? R_NilValue : SEXP(Rcpp::DataFrame::create(
+      Rcpp::Named("value") = value,
+      Rcpp::Named("windows") = windows,
+      Rcpp::Named("bad") = bad)),
+    Rcpp::Named("windows") = totalWindows,
+    Rcpp::Named("bad") = totalBad);
+}
@@ -0,0 +1,104 @@
+#include <Rcpp.h>
+using namespace Rcpp;
+
+#include "bcidat_glue.h"
+#include "BCI2000Receiver.h"
+#include "RecordDecoder.h"
+
+#include <memory>
+#include <vector>
+
+typedef Rcpp::XPtr<BCI2000Receiver> ReceiverPtr;
+
+//upper bound of the number of buffered blocks, which is rounded up to a
+//power of two by the ring buffer
+static const int cMaxCapacity = 1 << 20;
+
+static BCI2000Receiver &getReceiver(SEXP handle)
+{
+  ReceiverPtr ptr(handle);
+  if(ptr.get() == NULL)
+    Rcpp::stop("invalid bcistream handle");
+  return *ptr;
+}
+
+// [[Rcpp::export]]
+SEXP open_bcistream(std::string address, int capacity=256)
+{
+  if(capacity < 1 || capacity > cMaxCapacity)
+    Rcpp::stop("capacity must be between 1 and " + std::to_string(cMaxCapacity));
+  ReceiverPtr ptr(new BCI2000Receiver(capacity), true);
+  if(!ptr->Open(address))
+    Rcpp::stop(ptr->Error());
+  ptr.attr("class") = "bcistream";
+  return ptr;
+}
+
+// [[Rcpp::export]]
+Rcpp::List read_bcistream(SEXP handle, int max_blocks=-1, bool parameters=false, bool numeric_params=false)
+{
+  BCI2000Receiver &receiver = getReceiver(handle);
+  SPSCRingBuffer<BCI2000Receiver::Block> &blocks = receiver.Blocks();
+
+  //collect blocks with the same number of channels as the first one,
+  //a change in dimensions is returned by the next call
+  //slots are read in place, and only released after copying
+  std::vector<BCI2000Receiver::Block*> taken;
+  int channels = 0, samples = 0;
+  BCI2000Receiver::Block *next = NULL;
+  while((max_blocks < 0 || static_cast<int>(taken.size()) < max_blocks)
+        && (next = blocks.ReadSlot(taken.size())) != NULL)
+  {
+    if(taken.empty())
+      channels = next->channels;
+    else if(next->channels != channels)
+      break;
+    taken.push_back(next);
+    samples += next->elements;
+  }
+
+  StateList states = receiver.States();
+  Rcpp::NumericMatrix signal(samples, channels);
+  Rcpp::NumericMatrix stateValues(samples, states.Size());
+  std::unique_ptr<RecordDecoder> decoder;
+  int row = 0;
+  for(size_t i = 0; i < taken.size(); ++i)
+  {
+    const BCI2000Receiver::Block &b = *taken[i];
+    for(int ch = 0; ch < channels; ++ch)
+      std::copy(b.signal.begin() + ch * b.elements, b.signal.begin() + (ch + 1) * b.elements,
+                signal.begin() + ch * samples + row);
+    if(!b.states.empty() && states.Size() > 0)
+    {
+      if(!decoder || decoder->StateVectorLength() != b.stateVectorLength)
+        decoder.reset(RecordDecoder::Create(SignalType::int16, 0, b.stateVectorLength, states));
+      RecordDecoder::Output output;
+      output.states = stateValues.begin();
+      output.stateStride = samples;
+      decoder->Decode(reinterpret_cast<const char*>(&b.states[0]), b.elements, output, row);
+    }
+    row += b.elements;
+  }
+  blocks.Release(taken.size());
+
+  Rcpp::CharacterVector stateNames(states.Size());
+  for(int j = 0; j < states.Size(); ++j)
+    stateNames[j] = states[j].Name();
+  stateValues.attr("dimnames") = Rcpp::List::create(R_NilValue, stateNames);
+
+  Rcpp::List result = Rcpp::List::create(Rcpp::Named("signal") = signal,
+                                         Rcpp::Named("states") = stateValues,
+                                         Rcpp::Named("blocks") = static_cast<int>(taken.size()),
+                                         Rcpp::Named("running") = receiver.IsRunning(),
+                                         Rcpp::Named("overruns") = static_cast<double>(receiver.Overruns()),
+                                         Rcpp::Named("error") = receiver.Error());
+  if(parameters)
+    result["parameters"] = paramListToSEXP(receiver.Parameters(), numeric_params, false);
+  return result;
+}
+
+// [[Rcpp::export]]
+void close_bcistream(SEXP handle)
+{
+  getReceiver(handle).Close();
+}
@@ -0,0 +1,362 @@
+#include <Rcpp.h>
+using namespace Rcpp;
+
+#include "bcidat_glue.h"
+#include "BCI2000FileWriter.h"
+#include "BCI2000FilePatcher.h"
+#include "BCI2000ColumnStore.h"
+#include "BCI2000Envelope.h"
+#include "BCI2000Archive.h"
+#include "AtomicFile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <vector>
+
+// Converts an R value into parameter value strings, in column-major order.
+static std::vector<std::string> paramValues(SEXP value)
+{
+  std::vector<std::string> values;
+  if(Rf_isString(value))
+  {
+    Rcpp::CharacterVector strings(value);
+    for(int i = 0; i < strings.size(); ++i)
+      values.push_back(Rcpp::as<std::string>(strings[i]));
+  }
+  else
+  {
+    Rcpp::NumericVector numbers(value);
+    for(int i = 0; i < numbers.size(); ++i)
+    {
+      std::ostringstream oss;
+      oss.precision(15);
+      oss << numbers[i];
+      values.push_back(oss.str());
+    }
+  }
+  return values;
+}
+
+// Sets a parameter's values from an R value. Parameters that do not exist
+// yet are created with a type matching the value's shape.
+static void setParam(ParamList &list, const std::string &name, SEXP value)
+{
+  Rcpp::RObject obj(value);
+  std::vector<std::string> values = paramValues(value);
+  const bool isMatrix = obj.hasAttribute("dim");
+  int rows = static_cast<int>(values.size()), cols = 1;
+  if(isMatrix)
+  {
+    Rcpp::IntegerVector dim = obj.attr("dim");
+    rows = dim[0];
+    cols = dim[1];
+  }
+  if(!list.Exists(name))
+  {
+    std::string type = Rf_isString(value) ? "string" : "float";
+    if(isMatrix)
+      type = "matrix";
+    else if(values.size() != 1)
+      type = Rf_isString(value) ? "list" : "floatlist";
+    list.Add(Param(name, "Derived", type));
+  }
+  Param &param = list[name];
+  if(isMatrix)
+    param.SetDimensions(rows, cols);
+  else
+    param.SetNumValues(values.size());
+  for(int col = 0; col < cols; ++col)
+    for(int row = 0; row < rows; ++row)
+      param.Value(row, col) = values[col * rows + row];
+}
+
+// Sets parameters from a named list of values.
+static void setParams(ParamList &list, SEXP parameters)
+{
+  if(Rf_isNull(parameters))
+    return;
+  Rcpp::List values(parameters);
+  Rcpp::CharacterVector names = values.names();
+  for(int i = 0; i < values.size(); ++i)
+    setParam(list, Rcpp::as<std::string>(names[i]), values[i]);
+}
+
+// Number of bits needed to hold a state's largest value.
+static int stateLength(const Rcpp::NumericMatrix &states, int column)
+{
+  double largest = 0;
+  for(int i = 0; i < states.nrow(); ++i)
+    largest = std::max(largest, states(i, column));
+  int length = 1;
+  while(length < 64 && largest >= std::ldexp(1.0, length))
+    ++length;
+  return length;
+}
+
+// [[Rcpp::export]]
+void write_bcidat(std::string file, Rcpp::NumericMatrix signal, SEXP states=R_NilValue, SEXP template_file=R_NilValue, SEXP parameters=R_NilValue, std::string format="float32", bool raw=false)
+{
+  const int samples = signal.nrow(), channels = signal.ncol();
+
+  //parameters and states are taken from a template file, if given
+  ParamList params;
+  StateList stateList;
+  if(!Rf_isNull(template_file))
+  {
+    BCI2000FileReader reader;
+    std::string name = Rcpp::as<std::string>(template_file);
+    if(!openReader(reader, name, R_NilValue))
+      Rcpp::stop("could not open " + name);
+    params = *reader.Parameters();
+    stateList = *reader.States();
+  }
+
+  setParams(params, parameters);
+  if(!params.Exists("SamplingRate"))
+    Rcpp::stop("a SamplingRate parameter is required");
+  setParam(params, "SourceCh", Rcpp::NumericVector(1, channels));
+  //without calibration parameters, calibrated values are stored as they are
+  if(!params.Exists("SourceChOffset"))
+    setParam(params, "SourceChOffset", Rcpp::NumericVector(channels, 0.0));
+  if(!params.Exists("SourceChGain"))
+    setParam(params, "SourceChGain", Rcpp::NumericVector(channels, 1.0));
+
+  //state columns are matched by name, states missing from the matrix keep
+  //their values from the state list, and new states are sized to fit
+  Rcpp::NumericMatrix stateValues;
+  if(!Rf_isNull(states))
+  {
+    stateValues = Rcpp::NumericMatrix(states);
+    if(stateValues.nrow() != samples)
+      Rcpp::stop("'states' and 'signal' differ in the number of samples");
+    Rcpp::CharacterVector names = Rcpp::colnames(stateValues);
+    if(names.size() != stateValues.ncol())
+      Rcpp::stop("'states' must have column names");
+    bool added = false;
+    for(int j = 0; j < names.size(); ++j)
+    {
+      std::string name = Rcpp::as<std::string>(names[j]);
+      if(name.empty())
+        Rcpp::stop("'states' must have column names");
+      if(!stateList.Exists(name))
+      {
+        std::ostringstream definition;
+        definition << name << " " << stateLength(stateValues, j) << " 0 0 0";
+        stateList.Add(definition.str());
+        added = true;
+      }
+    }
+    if(added)
+      stateList.AssignPositions();
+  }
+
+  SignalType type = SignalType::none;
+  for(int i = 0; i < SignalType::numTypes; ++i)
+    if(format == SignalType(SignalType::Type(i)).Name())
+      type = SignalType::Type(i);
+
+  BCI2000FileWriter writer;
+  writer.Open(file.c_str(), channels, type, params, stateList);
+  if(writer.ErrorState() == BCI2000FileWriter::UnsupportedFormat)
+    Rcpp::stop("unsupported data format: " + format);
+  if(writer.ErrorState() != BCI2000FileWriter::NoError)
+    Rcpp::stop("could not write " + file);
+
+  std::vector<double> allStates;
+  if(!Rf_isNull(states))
+  {
+    //NaN values leave states at their values from the state list
+    allStates.resize(static_cast<size_t>(samples) * stateList.Size(), NAN);
+    Rcpp::CharacterVector names = Rcpp::colnames(stateValues);
+    for(int j = 0; j < names.size(); ++j)
+    {
+      int s = stateList.Index(Rcpp::as<std::string>(names[j]));
+      std::copy(stateValues.begin() + j * samples, stateValues.begin() + (j + 1) * samples,
+                allStates.begin() + s * samples);
+    }
+  }
+  writer.WriteBlock(samples, signal.begin(), samples, !raw,
+                    allStates.empty() ? NULL : &allStates[0], samples);
+  writer.Close();
+}
+
+// A range of samples to copy: [first, first + count), or from first to the
+// end of the file.
+struct SampleRange
+{
+  long long first, count;
+  bool toEnd;
+};
+
+// Copies sample ranges of the given files into a new file, without
+// decoding. The header is taken from the first file. The file is written
+// under a temporary name.
+static void writeRanges(const std::vector<std::string> &files, const std::vector<SampleRange> &ranges,
+                        const std::string &output, const std::string &temp, SEXP parameters)
+{
+  BCI2000FileWriter writer;
+  for(size_t i = 0; i < files.size(); ++i)
+  {
+    BCI2000FileReader reader;
+    if(!openReader(reader, files[i], R_NilValue))
+      Rcpp::stop("could not open " + files[i]);
+    const long long first = ranges[i].first,
+                    n = ranges[i].toEnd ? reader.NumSamples() - first : ranges[i].count;
+    if(first < 0 || n < 0 || first + n > reader.NumSamples())
+      Rcpp::stop("sample range is outside of " + files[i]);
+    if(i == 0)
+    {
+      ParamList params = *reader.Parameters();
+      setParams(params, parameters);
+      writer.Open(temp.c_str(), reader.SignalProperties().Channels(), reader.SignalProperties().Type(),
+                  params, *reader.States());
+      if(writer.ErrorState() != BCI2000FileWriter::NoError)
+        Rcpp::stop("could not write " + output);
+      if(!writer.SameLayout(reader))
+        Rcpp::stop("the state vector layout of " + files[i] + " cannot be reproduced");
+    }
+    else if(!writer.SameLayout(reader))
+      Rcpp::stop(files[i] + " differs from " + files[0] + " in channels, data format, or states");
+    writer.CopyRecords(reader, first, n);
+  }
+  writer.Close();
+}
+
+// As writeRanges(), but the output only appears if it is complete; on
+// error, an existing output file is left unchanged.
+static void copyRanges(const std::vector<std::string> &files, const std::vector<SampleRange> &ranges,
+                       const std::string &output, SEXP parameters)
+{
+  if(std::find(files.begin(), files.end(), output) != files.end())
+    Rcpp::stop("the output file must differ from the input files");
+  const std::string temp = AtomicFile::TempName(output);
+  try
+  {
+    writeRanges(files, ranges, output, temp, parameters);
+  }
+  catch(...)
+  {
+    std::remove(temp.c_str());
+    throw;
+  }
+  if(!AtomicFile::Replace(temp, output))
+    Rcpp::stop("could not write " + output);
+}
+
+// [[Rcpp::export]]
+void crop_bcidat(std::string file, std::string output, double from=1, SEXP to=R_NilValue, SEXP parameters=R_NilValue)
+{
+  //from and to are 1-based and inclusive
+  SampleRange range = { static_cast<long long>(from) - 1, 0, Rf_isNull(to) };
+  if(!range.toEnd)
+  {
+    long long last = static_cast<long long>(Rcpp::as<double>(to));
+    if(last < from)
+      Rcpp::stop("'to' must not be less than 'from'");
+    range.count = last - range.first;
+  }
+  copyRanges(std::vector<std::string>(1, file), std::vector<SampleRange>(1, range), output, parameters);
+}
+
+// [[Rcpp::export]]
+void concat_bcidat(std::vector<std::string> files, std::string output, SEXP parameters=R_NilValue)
+{
+  if(files.empty())
+    Rcpp::stop("no input files");
+  SampleRange all = { 0, 0, true };
+  copyRanges(files, std::vector<SampleRange>(files.size(), all), output, parameters);
+}
+
+// [[Rcpp::export]]
+void set_bcidat_state(std::string file, std::string state, Rcpp::NumericVector value, Rcpp::NumericVector from, SEXP to=R_NilValue)
+{
+  //ranges are 1-based and inclusive, and a single sample by default;
+  //values are recycled over the ranges
+  Rcpp::NumericVector last = Rf_isNull(to) ? from : Rcpp::NumericVector(to);
+  if(last.size() != from.size())
+    Rcpp::stop("'from' and 'to' differ in length");
+  if(value.size() == 0)
+    Rcpp::stop("no state value given");
+  BCI2000FilePatcher patcher;
+  patcher.Open(file.c_str());
+  if(patcher.ErrorState() == BCI2000FilePatcher::CompressedFile)
+    Rcpp::stop(file + " is compressed, and cannot be modified");
+  if(patcher.ErrorState() != BCI2000FilePatcher::NoError)
+    Rcpp::stop("could not open " + file + " for writing");
+  const BCI2000FileReader &reader = patcher.Reader();
+  if(!reader.States()->Exists(state))
+    Rcpp::stop("state " + state + " does not exist in " + file);
+  //ranges and values are checked before any of them is written, so an
+  //invalid argument leaves the file unchanged
+  const int length = (*reader.States())[state].Length();
+  const double limit = std::min(std::ldexp(1.0, length), static_cast<double>(~State::ValueType(0)) + 1);
+  const double samples = static_cast<double>(reader.NumSamples());
+  for(int i = 0; i < from.size(); ++i)
+  {
+    if(!(from[i] == std::floor(from[i]) && last[i] == std::floor(last[i])))
+      Rcpp::stop("'from' and 'to' must be whole numbers");
+    if(last[i] < from[i])
+      Rcpp::stop("'to' must not be less than 'from'");
+    if(from[i] < 1 || last[i] > samples)
+    {
+      std::ostringstream oss;
+      oss << "sample range " << from[i] << ".." << last[i] << " exceeds the file's " << samples << " samples";
+      Rcpp::stop(oss.str());
+    }
+  }
+  for(int i = 0; i < value.size(); ++i)
+  {
+    if(!(value[i] == std::floor(value[i])))
+      Rcpp::stop("state values must be whole numbers");
+    if(value[i] < 0 || value[i] >= limit)
+    {
+      std::ostringstream oss;
+      oss << "state value " << value[i] << " does not fit into the " << length << " bits of state " << state;
+      Rcpp::stop(oss.str());
+    }
+  }
+  //the patcher removes the file's column store before its first write
+  for(int i = 0; i < from.size(); ++i)
+  {
+    long long first = static_cast<long long>(from[i]) - 1,
+              count = static_cast<long long>(last[i]) - first;
+    patcher.SetStateValue(state, first, count, static_cast<State::ValueType>(value[i % value.size()]));
+  }
+  patcher.Close();
+}
+
+// [[Rcpp::export]]
+void write_bcidat_columns(std::string file, int chunk_samples=65536)
+{
+  BCI2000FileReader reader;
+  if(!openReader(reader, file, R_NilValue))
+    Rcpp::stop("could not open " + file);
+  if(!BCI2000ColumnStore::Create(reader, chunk_samples))
+    Rcpp::stop("could not write " + BCI2000ColumnStore::FileName(file));
+}
+
+// [[Rcpp::export]]
+void write_bcidat_envelope(std::string file, int bin_samples=64)
+{
+  BCI2000FileReader reader;
+  if(!openReader(reader, file, R_NilValue))
+    Rcpp::stop("could not open " + file);
+  if(bin_samples < 1)
+    Rcpp::stop("bin_samples must be at least 1");
+  if(!BCI2000Envelope::Create(reader, bin_samples))
+    Rcpp::stop("could not write " + BCI2000Envelope::FileName(file));
+}
+
+// [[Rcpp::export]]
+void compress_bcidat(std::string file, SEXP output=R_NilValue, int block_samples=4096)
+{
+  BCI2000FileReader reader;
+  if(!openReader(reader, file, R_NilValue))
+    Rcpp::stop("could not open " + file);
+  std::string name = Rf_isNull(output) ? file + ".bcz" : Rcpp::as<std::string>(output);
+  if(name == file)
+    Rcpp::stop("the output file must differ from the input file");
+  if(!BCI2000Archive::Create(reader, name, block_samples))
+    Rcpp::stop("could not write " + name);
+}
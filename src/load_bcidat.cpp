@@ -1,126 +1,497 @@
 #include <Rcpp.h>
 using namespace Rcpp;
 
-#include "BCI2000FileReader.h"
+#include "bcidat_glue.h"
+#include "Decimator.h"
 
-SEXP paramListToSEXP(const ParamList &list);
-SEXP paramToSEXP(const Param &list);
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+#include <vector>
 
-// [[Rcpp::export]]
-Rcpp::List load_bcidat(std::string file, bool raw=false)
+SEXP paramToSEXP(const Param &list, bool numeric, bool units);
+
+// Opens a file, trying `file.dat` if `file` does not exist.
+// header cache: NULL/FALSE disables it, TRUE keeps a sidecar next to the file,
+// a character string names a directory holding the cache files
+bool openReader(BCI2000FileReader &reader, const std::string &file, SEXP header_cache)
 {
-  BCI2000FileReader reader;
+  if(Rf_isString(header_cache))
+    reader.SetHeaderCache(true, Rcpp::as<std::string>(header_cache));
+  else if(Rf_isLogical(header_cache))
+    reader.SetHeaderCache(Rcpp::as<bool>(header_cache));
   reader.Open(file.c_str());
   if(!reader.IsOpen())
-  {
     reader.Open((file+".dat").c_str());
-    if(!reader.IsOpen())
-    return Rcpp::List();
+  return reader.IsOpen();
+}
+
+// Number of samples decoded at a time when processing the signal while
+// reading.
+static const long long cChunkSamples = 16384;
+
+static SEXP listElement(Rcpp::List &list, const char *name)
+{
+  if(!list.containsElementNamed(name))
+    return R_NilValue;
+  SEXP value = list[name];
+  return value;
+}
+
+// Creates a filter from a list with elements highpass and lowpass (cutoff
+// frequencies in Hz), order (of both, 4 by default), notch (frequencies in
+// Hz), notch_width (bandwidth in Hz, 2 by default), and zero_phase.
+// Returns false if the list is NULL.
+bool parseFilter(SEXP spec, double samplingRate, IIRFilter &filter, bool &zeroPhase)
+{
+  zeroPhase = false;
+  if(Rf_isNull(spec))
+    return false;
+  Rcpp::List list(spec);
+  SEXP order = listElement(list, "order"),
+       highpass = listElement(list, "highpass"),
+       lowpass = listElement(list, "lowpass"),
+       notch = listElement(list, "notch"),
+       notchWidth = listElement(list, "notch_width"),
+       zero = listElement(list, "zero_phase");
+  const int n = Rf_isNull(order) ? 4 : Rcpp::as<int>(order);
+  const double width = Rf_isNull(notchWidth) ? 2 : Rcpp::as<double>(notchWidth);
+  zeroPhase = !Rf_isNull(zero) && Rcpp::as<bool>(zero);
+  if(!Rf_isNull(highpass))
+    filter.AddHighpass(n, Rcpp::as<double>(highpass) / samplingRate);
+  if(!Rf_isNull(lowpass))
+    filter.AddLowpass(n, Rcpp::as<double>(lowpass) / samplingRate);
+  if(!Rf_isNull(notch))
+  {
+    Rcpp::NumericVector frequencies(notch);
+    for(int i = 0; i < frequencies.size(); ++i)
+      filter.AddNotch(frequencies[i] / samplingRate, width / samplingRate);
   }
-  int samples = reader.NumSamples();
-  int channels = reader.SignalProperties().Channels();
-  
-  //first - read all samples
-  Rcpp::NumericMatrix signal(samples,channels);
-  
-  for(int s=0; s<samples; ++s)
+  return true;
+}
+
+// Creates a montage from
+// - "car", a common average reference,
+// - "parameter", the file's SpatialFilter parameters,
+// - a list with element reference, channels whose mean is subtracted,
+// - a list with elements input, output, weight, a sparse matrix,
+// - a numeric matrix with an output channel per row, and a column per
+//   channel of the file.
+// Channels are one-based indices, or names from the ChannelNames parameter;
+// numbers are converted into strings by Rcpp, and resolved as indices.
+// Returns false if spec is NULL.
+bool parseMontage(SEXP spec, BCI2000FileReader &reader, Montage &montage)
+{
+  if(Rf_isNull(spec))
+    return false;
+  const ParamList &params = *reader.Parameters();
+  const int channels = reader.SignalProperties().Channels();
+  if(Rf_isString(spec))
+  {
+    std::string type = Rcpp::as<std::string>(spec);
+    if(type == "car")
+      montage = Montage::CommonAverage(channels);
+    else if(type == "parameter")
+      montage = Montage::FromParameters(params, channels);
+    else
+      Rcpp::stop("unknown montage: " + type);
+    return true;
+  }
+  if(Rf_isMatrix(spec))
+  {
+    Rcpp::NumericMatrix matrix(spec);
+    if(matrix.ncol() != channels)
+      Rcpp::stop("montage matrix must have a column per channel");
+    montage = Montage(channels);
+    for(int row = 0; row < matrix.nrow(); ++row)
+      for(int col = 0; col < matrix.ncol(); ++col)
+        montage.Add(row, col, matrix(row, col));
+    return true;
+  }
+  Rcpp::List list(spec);
+  SEXP reference = listElement(list, "reference"),
+       input = listElement(list, "input"),
+       output = listElement(list, "output"),
+       weight = listElement(list, "weight");
+  if(!Rf_isNull(reference))
+  {
+    Rcpp::CharacterVector names(reference);
+    std::vector<int> indices;
+    for(int i = 0; i < names.size(); ++i)
+      indices.push_back(Montage::FindChannel(params, channels, Rcpp::as<std::string>(names[i])));
+    montage = Montage::LinkedReference(channels, indices);
+    return true;
+  }
+  if(Rf_isNull(input) || Rf_isNull(output) || Rf_isNull(weight))
+    Rcpp::stop("montage list must have a reference element, or input, output and weight elements");
+  Rcpp::CharacterVector inputs(input);
+  Rcpp::IntegerVector outputs(output);
+  Rcpp::NumericVector weights(weight);
+  if(inputs.size() != outputs.size() || inputs.size() != weights.size())
+    Rcpp::stop("montage input, output and weight must have equal length");
+  montage = Montage(channels);
+  for(int i = 0; i < inputs.size(); ++i)
+  {
+    if(outputs[i] < 1)
+      Rcpp::stop("montage output index out of range");
+    montage.Add(outputs[i] - 1, Montage::FindChannel(params, channels, Rcpp::as<std::string>(inputs[i])), weights[i]);
+  }
+  return true;
+}
+
+// Resolves a selection of channels (1-based indices) into zero-based
+// indices; NULL selects all.
+std::vector<int> selectChannels(SEXP channels, int available)
+{
+  std::vector<int> channelIndex;
+  if(Rf_isNull(channels))
+    for(int ch = 0; ch < available; ++ch)
+      channelIndex.push_back(ch);
+  else
   {
-    for(int c=0; c<channels; ++c)
+    Rcpp::IntegerVector selected(channels);
+    for(int i = 0; i < selected.size(); ++i)
     {
-      signal(s,c) = raw?reader.RawValue(c, s):reader.CalibratedValue(c, s);
+      if(selected[i] < 1 || selected[i] > available)
+        Rcpp::stop("channel index out of range");
+      channelIndex.push_back(selected[i] - 1);
     }
   }
-  
-  //read all states
-  int numStates = reader.States()->Size();
-  //  read all names
-  
-  Rcpp::NumericMatrix states(samples, numStates);
-  
-  //  read values
-  for( int sample = 0; sample < samples; ++sample )
+  return channelIndex;
+}
+
+// Resolves a selection of states (names) into indices; NULL selects all.
+static std::vector<int> selectStates(BCI2000FileReader &reader, SEXP states)
+{
+  const StateList &stateList = *reader.States();
+  std::vector<int> stateIndex;
+  if(Rf_isNull(states))
+    for(int j = 0; j < stateList.Size(); ++j)
+      stateIndex.push_back(j);
+  else
   {
-    reader.ReadStateVector( sample );
-    for( int i = 0; i < numStates; ++i )
+    Rcpp::CharacterVector selected(states);
+    for(int i = 0; i < selected.size(); ++i)
     {
-      State::ValueType value  = reader.StateVector()->StateValue( (*reader.States())[i].Location(), (*reader.States())[i].Length() );
-      states(sample, i) = value;
+      std::string name = Rcpp::as<std::string>(selected[i]);
+      if(!stateList.Exists(name))
+        Rcpp::stop("no state named " + name);
+      stateIndex.push_back(stateList.Index(name));
     }
   }
-  
-  Rcpp::CharacterVector stateNames(numStates);
-  for(int j=0; j< numStates; ++j)
-    stateNames[j] = (*reader.States())[j].Name();
-    
-  Rcpp::List dimnms = Rcpp::List::create(R_NilValue, stateNames);
-
-    
-  states.attr("dimnames") = dimnms;
-  
-  //read parameters
-  SEXP params = paramListToSEXP(*reader.Parameters());
-  
+  return stateIndex;
+}
+
+static bool isAll(const std::vector<int> &index, int available)
+{
+  if(static_cast<int>(index.size()) != available)
+    return false;
+  for(int i = 0; i < available; ++i)
+    if(index[i] != i)
+      return false;
+  return true;
+}
+
+//when all channels and states are needed, read samples and states in a
+//single pass over the file, decoding straight into column-major arrays;
+//otherwise, only the columns involved are decoded
+static void decode(BCI2000FileReader &reader, long long first, long long count, bool raw,
+                   const std::vector<int> &channelIndex, double *signal, size_t signalStride,
+                   const std::vector<int> &stateIndex, double *states, size_t stateStride)
+{
+  if(isAll(channelIndex, reader.SignalProperties().Channels())
+     && isAll(stateIndex, reader.States()->Size()))
+    reader.ReadBlock(first, count, signal, signalStride, !raw, states, stateStride);
+  else
+    reader.ReadColumns(first, count, channelIndex, signal, signalStride, !raw,
+                       stateIndex, states, stateStride);
+}
+
+static Rcpp::List samplesToList(BCI2000FileReader &reader, const std::vector<int> &stateIndex,
+                                Rcpp::NumericMatrix signal, Rcpp::NumericMatrix stateValues)
+{
+  const StateList &stateList = *reader.States();
+  Rcpp::CharacterVector stateNames(stateIndex.size());
+  for(size_t j=0; j< stateIndex.size(); ++j)
+    stateNames[j] = stateList[stateIndex[j]].Name();
+  stateValues.attr("dimnames") = Rcpp::List::create(R_NilValue, stateNames);
+
   return Rcpp::List::create(Rcpp::Named("signal") = signal,
-                            Rcpp::Named("states") = states,
+                            Rcpp::Named("states") = stateValues);
+}
+
+// Reads count samples starting at first (zero-based) into a list of
+// signal and state matrices, processing the signal on the way: a montage
+// combines channels, a filter is applied continuing from its current
+// state, and decimation downsamples signal and states. Processing is done
+// in chunks as they are decoded, so only processed samples are held in
+// memory. Zero phase filtering is applied to all samples at the end, and
+// cannot be combined with decimation.
+// channels (1-based indices) select channels of the file, or outputs of the
+// montage; states (names) select states; NULL selects all.
+static Rcpp::List readProcessed(BCI2000FileReader &reader, long long first, long long count, bool raw,
+                                SEXP channels, SEXP states, const Montage *montage,
+                                IIRFilter *filter, bool zeroPhase,
+                                int factor, StateDecimator::Mode mode)
+{
+  std::vector<int> outputs = selectChannels(channels,
+                           montage ? montage->Outputs() : reader.SignalProperties().Channels()),
+                   inputs = outputs,
+                   stateIndex = selectStates(reader, states);
+  Montage applied;
+  if(montage)
+    applied = montage->Select(outputs).Compact(inputs);
+  const int numOutputs = static_cast<int>(outputs.size()),
+            numInputs = static_cast<int>(inputs.size()),
+            numStates = static_cast<int>(stateIndex.size());
+  const long long outCount = Decimator::OutputSamples(count, factor);
+  Rcpp::NumericMatrix signal(static_cast<int>(outCount), numOutputs);
+  Rcpp::NumericMatrix stateValues(static_cast<int>(outCount), numStates);
+
+  //without chunked processing, the file is decoded in one call; chunks are
+  //a multiple of the factor, so chunk boundaries fall on output samples
+  const bool chunked = montage || factor > 1 || (filter && !zeroPhase);
+  const long long chunk = chunked ? std::max<long long>(1, cChunkSamples / factor) * factor
+                                  : std::max<long long>(1, count);
+  //decoded channels are kept in a scratch buffer if a montage follows, and
+  //processed channels if decimation follows; otherwise, samples go straight
+  //into the result
+  std::vector<double> inputChunk(montage ? chunk * numInputs + 1 : 0),
+                      outputChunk(factor > 1 ? chunk * numOutputs + 1 : 0),
+                      stateChunk(factor > 1 ? chunk * numStates + 1 : 0);
+  Decimator decimator(factor, numOutputs);
+  StateDecimator stateDecimator(factor, numStates, mode);
+  if(filter)
+    filter->SetChannels(numOutputs);
+  long long signalOut = 0, statesOut = 0;
+  for(long long pos = 0; pos < count; pos += chunk)
+  {
+    const long long n = std::min(chunk, count - pos);
+    double *x = factor > 1 ? &outputChunk[0] : signal.begin() + pos,
+           *s = factor > 1 ? &stateChunk[0] : stateValues.begin() + pos;
+    const size_t stride = factor > 1 ? chunk : count;
+    if(montage)
+    {
+      decode(reader, first + pos, n, raw, inputs, &inputChunk[0], chunk, stateIndex, s, stride);
+      applied.Apply(&inputChunk[0], chunk, n, x, stride);
+    }
+    else
+      decode(reader, first + pos, n, raw, inputs, x, stride, stateIndex, s, stride);
+    if(filter && !zeroPhase)
+      filter->Process(x, stride, n, x, stride);
+    if(factor > 1)
+    {
+      signalOut += decimator.Process(x, stride, n, signal.begin() + signalOut, outCount);
+      statesOut += stateDecimator.Process(s, stride, n, stateValues.begin() + statesOut, outCount);
+    }
+    Rcpp::checkUserInterrupt();
+  }
+  if(factor > 1)
+    decimator.Flush(signal.begin() + signalOut, outCount);
+  if(filter && zeroPhase)
+    filter->ProcessZeroPhase(signal.begin(), outCount, outCount);
+  return samplesToList(reader, stateIndex, signal, stateValues);
+}
+
+// Reads count samples starting at first (zero-based), as readProcessed()
+// without decimation.
+Rcpp::List readSamples(BCI2000FileReader &reader, long long first, int count, bool raw,
+                       SEXP channels, SEXP states, const Montage *montage,
+                       IIRFilter *filter, bool zeroPhase)
+{
+  return readProcessed(reader, first, count, raw, channels, states, montage, filter, zeroPhase,
+                       1, StateDecimator::Hold);
+}
+
+// [[Rcpp::export]]
+Rcpp::List load_bcidat(std::string file, bool raw=false, bool numeric_params=false, bool param_units=false, SEXP header_cache=R_NilValue, SEXP channels=R_NilValue, SEXP states=R_NilValue, int decimate=1, std::string state_decimation="hold", SEXP filter=R_NilValue, SEXP montage=R_NilValue)
+{
+  if(decimate < 1)
+    Rcpp::stop("decimate must be a positive integer");
+  StateDecimator::Mode mode = StateDecimator::Hold;
+  if(state_decimation == "any")
+    mode = StateDecimator::AnyChange;
+  else if(state_decimation != "hold")
+    Rcpp::stop("state_decimation must be \"hold\" or \"any\"");
+
+  BCI2000FileReader reader;
+  if(!openReader(reader, file, header_cache))
+    return Rcpp::List();
+
+  IIRFilter iirFilter;
+  bool zeroPhase = false;
+  const bool filtered = parseFilter(filter, reader.SamplingRate(), iirFilter, zeroPhase);
+  if(zeroPhase && decimate > 1)
+    Rcpp::stop("zero phase filtering cannot be combined with decimation");
+
+  Montage spatialFilter;
+  const bool referenced = parseMontage(montage, reader, spatialFilter);
+
+  Rcpp::List data = readProcessed(reader, 0, reader.NumSamples(), raw, channels, states,
+                                  referenced ? &spatialFilter : NULL,
+                                  filtered ? &iirFilter : NULL, zeroPhase, decimate, mode);
+
+  //read parameters, reporting the sampling rate of the decimated signal
+  ParamList paramList = *reader.Parameters();
+  if(decimate > 1 && paramList.Exists("SamplingRate"))
+  {
+    std::string value = paramList["SamplingRate"].Value();
+    std::ostringstream oss;
+    oss << reader.SamplingRate() / decimate;
+    if(value.find("Hz") != std::string::npos)
+      oss << "Hz";
+    paramList["SamplingRate"].Value() = oss.str();
+  }
+  SEXP params = paramListToSEXP(paramList, numeric_params, param_units);
+  
+  return Rcpp::List::create(Rcpp::Named("signal") = data["signal"],
+                            Rcpp::Named("states") = data["states"],
                             Rcpp::Named("parameters") = params
                             );
 }
 
-SEXP paramListToSEXP(const ParamList &list)
+// Parses a parameter value as a number. With units enabled, values that
+// carry a physical unit (e.g. "10ms", "256Hz") are converted into base units.
+static bool parseNumeric(const std::string &value, bool units, double &out)
+{
+  const char *begin = value.c_str();
+  char *end = NULL;
+  out = ::strtod(begin, &end);
+  if(end == begin)
+    return false;
+  while(*end == ' ')
+    ++end;
+  if(*end == '\0')
+    return true;
+  if(!units)
+    return false;
+
+  static const char *symbols[] = { "s", "Hz", "V", "A", "m", "g", "deg", "Ohm" };
+  std::string suffix(end);
+  for(size_t i = 0; i < sizeof(symbols) / sizeof(*symbols); ++i)
+  {
+    std::string symbol = symbols[i];
+    if(suffix.length() < symbol.length()
+       || suffix.compare(suffix.length() - symbol.length(), symbol.length(), symbol) != 0)
+      continue;
+    PhysicalUnit unit;
+    unit.SetGain(1.0).SetOffset(0.0).SetSymbol(symbol);
+    if(unit.IsPhysical(value))
+    {
+      out = unit.PhysicalToRaw(value);
+      return true;
+    }
+  }
+  return false;
+}
+
+static SEXP labelsToSEXP(const LabelIndex &labels)
+{
+  if(labels.IsTrivial())
+    return R_NilValue;
+  Rcpp::CharacterVector names(labels.Size());
+  for(int i=0; i<labels.Size(); ++i)
+    names[i] = labels[i];
+  return names;
+}
+
+SEXP paramListToSEXP(const ParamList &list, bool numeric, bool units)
 {
-  Rcpp::List params;
+  // pre-size the list, assigning by name would reallocate on every insertion
+  Rcpp::List params(list.Size());
+  Rcpp::CharacterVector names(list.Size());
   for(int i=0; i<list.Size(); ++i)
   {
     const Param &param = list[i];
-    params[param.Name()] = paramToSEXP(param);
+    names[i] = param.Name();
+    params[i] = paramToSEXP(param, numeric, units);
   }
-  
+  params.attr("names") = names;
+
   return params;
 }
 
-SEXP paramToSEXP(const Param &param)
+SEXP paramToSEXP(const Param &param, bool numeric, bool units)
 {
-  if(param.NumRows() == 1 &&
-    param.NumColumns() == 1)
+  const int rows = param.NumRows(),
+            cols = param.NumColumns();
+  if(rows == 1 && cols == 1)
   {
+    double value;
+    if(numeric && parseNumeric(param.Value().ToString(), units, value))
+      return Rcpp::NumericVector(1, value);
     return Rcpp::CharacterVector(param.Value().ToString());
   }
   else
   {
     bool isNested = false;
-    for( int col = 0; !isNested && col < param.NumColumns(); ++col )
-      for( int row = 0; !isNested && row < param.NumRows(); ++row )
+    for( int col = 0; !isNested && col < cols; ++col )
+      for( int row = 0; !isNested && row < rows; ++row )
         if( param.Value(row, col).Kind() != Param::ParamValue::Single )
           isNested = true;
 
     if(isNested)
     {
       // list of lists
-      Rcpp::List out;
-      for(int row=0; row < param.NumRows(); ++row)
+      Rcpp::List out(rows);
+      for(int row=0; row < rows; ++row)
       {
-        Rcpp::List list;
-        for(int col=0; col < param.NumColumns(); ++col)
+        Rcpp::List list(cols);
+        for(int col=0; col < cols; ++col)
         {
-          list[col] = paramToSEXP(*param.Value(row, col).ToParam());
+          list[col] = paramToSEXP(*param.Value(row, col).ToParam(), numeric, units);
         }
         out[row] = list;
       }
       
       return out;
     }
-    else
+    else if(!numeric)
     {
       // simple matrix
-      Rcpp::CharacterMatrix mat(param.NumRows(), param.NumColumns());
-      for(int row=0; row < param.NumRows(); ++row)
+      Rcpp::CharacterMatrix mat(rows, cols);
+      for(int row=0; row < rows; ++row)
       {
-        for(int col=0; col < param.NumColumns(); ++col)
+        for(int col=0; col < cols; ++col)
         {
           mat(row,col) = param.Value(row, col).ToString();
         }
       }
       return mat;
     }
+    else
+    {
+      // typed values: numeric when every entry parses as a number
+      const bool isList = param.Type().find("list") != std::string::npos && cols == 1;
+      Rcpp::NumericVector values(rows * cols);
+      bool isNumeric = true;
+      for(int col=0; isNumeric && col < cols; ++col)
+        for(int row=0; isNumeric && row < rows; ++row)
+          isNumeric = parseNumeric(param.Value(row, col).ToString(), units, values[col * rows + row]);
+
+      Rcpp::RObject out;
+      if(isNumeric)
+        out = values;
+      else
+      {
+        Rcpp::CharacterVector strings(rows * cols);
+        for(int col=0; col < cols; ++col)
+          for(int row=0; row < rows; ++row)
+            strings[col * rows + row] = param.Value(row, col).ToString();
+        out = strings;
+      }
+
+      if(isList)
+        out.attr("names") = labelsToSEXP(param.RowLabels());
+      else
+      {
+        out.attr("dim") = Rcpp::IntegerVector::create(rows, cols);
+        Rcpp::RObject rowNames = labelsToSEXP(param.RowLabels()),
+                      colNames = labelsToSEXP(param.ColumnLabels());
+        if(!rowNames.isNULL() || !colNames.isNULL())
+          out.attr("dimnames") = Rcpp::List::create(rowNames, colNames);
+      }
+      return out;
+    }
   }
 }